@@ -13,6 +13,7 @@
 #include <error_handler.h>
 #include <RTT.h>
 #include <inc/bsp/bsp.h>
+#include <inc/bsp/lowpower.h>
 #include <blog.h>
 
 //-------------------------------- MACROS -------------------------------------
@@ -25,21 +26,77 @@
 #define ADC_REF         (3300u)
 #define ADC_OFFSET      (0u)
 #define ADC_DIV         (1.68)
+// mV per ADC LSB in Q16, folded at compile time: 3300 * 1.68 / 4096 * 65536.
+#define ADC_MV_SCALE_Q16    ((uint32_t)((((double)ADC_REF * ADC_DIV) * \
+                                         65536.0 / ADC_FULL_SCALE) + 0.5))
+
+// Background sampling: TIM6 TRGO starts one 16x oversampled conversion,
+// result shifted back to 12 bits.
+#define ADC_TIM_INSTANCE    TIM6
+#define ADC_TIM_BASE_FREQ   (10000u)
+#define ADC_IRQ_PRIO        (6u)
+// Exponential moving average, alpha = 1 / (1 << ADC_EMA_SHIFT).
+#define ADC_EMA_SHIFT       (3u)
+#define ADC_EMA_FRAC        (8u)
+// Seed conversion at sampling start, 16x oversampled conversion time.
+#define ADC_SEED_TIMEOUT_MS (20u)
 
 //----------------------------- DATA TYPES ------------------------------------
 
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
+/**
+ * @brief Configure ADC for single or 16x oversampled conversions, started by
+ *        software or by TIM6.
+ * @param oversampled true for 16x oversampled conversions
+ * @param triggered true for TIM6 triggered conversions
+ * @return true on success
+ */
+static bool adc_config (bool oversampled, bool triggered);
+
+/**
+ * @brief Seed filter and snapshot with one synchronous oversampled
+ *        conversion, so readers have a value before the first trigger.
+ * @return true on success
+ */
+static bool adc_seed (void);
+
+/**
+ * @brief Add conversion to the filter and publish the snapshot.
+ * @param adc_value 12-bit ADC value
+ * @return none
+ */
+static void adc_sample_add (uint32_t adc_value);
+
+/**
+ * @brief Convert ADC value to battery voltage.
+ * @param adc_value 12-bit ADC value
+ * @return Battery voltage in mV
+ */
+static uint16_t adc_to_mv (uint32_t adc_value);
+
+/**
+ * @brief Timer prescaler for ADC_TIM_BASE_FREQ at current APB1 clock.
+ * @return prescaler value
+ */
+static uint32_t adc_tim_prescaler (void);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 static ADC_HandleTypeDef hndl_adc1;
+static TIM_HandleTypeDef hndl_tim;
+
+static volatile bool adc_sampling;
+static uint32_t adc_ema;                            // Q ADC_EMA_FRAC, ISR only.
+// Latest filtered reading, mV in low and ADC value in high half. Written in
+// one store so readers never see a torn value.
+static volatile uint32_t adc_snapshot;
+static volatile uint32_t adc_sample_cnt;
 
 //------------------------------ GLOBAL DATA ----------------------------------
 
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
 void bsp_adc_init (void)
 {
-    ADC_ChannelConfTypeDef sConfig;
-
     /* ADC Periph clock enable */
     __HAL_RCC_ADC_CLK_ENABLE();
 
@@ -50,54 +107,109 @@ void bsp_adc_init (void)
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     HAL_GPIO_Init(ADC_PORT, &GPIO_InitStruct);
 
-    hndl_adc1.Instance                    = ADC_INSTANCE;
-    hndl_adc1.Init.ClockPrescaler         = ADC_CLOCK_ASYNC_DIV256;
-    hndl_adc1.Init.Resolution             = ADC_RESOLUTION_12B;
-    hndl_adc1.Init.DataAlign              = ADC_DATAALIGN_RIGHT;
-    hndl_adc1.Init.ScanConvMode           = ADC_SCAN_DISABLE;
-    hndl_adc1.Init.EOCSelection           = ADC_EOC_SINGLE_CONV;
-    hndl_adc1.Init.LowPowerAutoWait       = DISABLE;
-    hndl_adc1.Init.ContinuousConvMode     = DISABLE;
-    hndl_adc1.Init.NbrOfConversion        = 1;
-    hndl_adc1.Init.DiscontinuousConvMode  = DISABLE;
-    hndl_adc1.Init.NbrOfDiscConversion    = 1;
-    hndl_adc1.Init.ExternalTrigConv       = ADC_SOFTWARE_START;
-    hndl_adc1.Init.ExternalTrigConvEdge   = ADC_EXTERNALTRIGCONVEDGE_NONE;
-    hndl_adc1.Init.DMAContinuousRequests  = DISABLE;
-    hndl_adc1.Init.Overrun                = ADC_OVR_DATA_PRESERVED;
-    hndl_adc1.Init.OversamplingMode       = DISABLE;
-
-    if (HAL_OK != HAL_ADC_Init(&hndl_adc1))
+    if (!adc_config(false, false))
     {
         BL_RAISE_ERROR("ADC Init failed", EHALADC);
         EPRINT("ADC Init failed.\n");
     }
 
-    /**Configure Regular Channel
-    */
-    sConfig.Channel      = ADC_CHANNEL;
-    sConfig.Rank         = 1;
-    sConfig.SamplingTime = ADC_SAMPLETIME_92CYCLES_5;
-    sConfig.SingleDiff   = ADC_SINGLE_ENDED;
-    sConfig.OffsetNumber = ADC_OFFSET_NONE;
-    sConfig.Offset       = 0;
+    if (HAL_OK != HAL_ADCEx_Calibration_Start(&hndl_adc1, ADC_SINGLE_ENDED))
+    {
+        BL_RAISE_ERROR("ADC calibration failed", EHALADC);
+        EPRINT("ADC calibration failed\n");
+    }
+}
+
+bool bsp_adc_sampling_start (uint16_t rate_hz)
+{
+    bool is_ok = (!adc_sampling) && (0u < rate_hz) &&
+                 (ADC_TIM_BASE_FREQ / 2u >= rate_hz);
 
-    if (HAL_OK != HAL_ADC_ConfigChannel(&hndl_adc1, &sConfig))
+    if (is_ok)
     {
-        BL_RAISE_ERROR("ADC channel config failed", EHALADC);
-        EPRINT("ADC channel config failed\n");
+        __HAL_RCC_TIM6_CLK_ENABLE();
+
+        hndl_tim.Instance = ADC_TIM_INSTANCE;
+        hndl_tim.Init.Prescaler = adc_tim_prescaler();
+        hndl_tim.Init.Period = (ADC_TIM_BASE_FREQ / rate_hz) - 1u;
+        hndl_tim.Init.CounterMode = TIM_COUNTERMODE_UP;
+        hndl_tim.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+        hndl_tim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+        TIM_MasterConfigTypeDef master_cfg = {
+            .MasterOutputTrigger = TIM_TRGO_UPDATE,
+            .MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE,
+        };
+
+        adc_sample_cnt = 0u;
+
+        // No reading until the first trigger period otherwise, a failed
+        // seed only leaves the snapshot empty until then.
+        if (!(adc_config(true, false) && adc_seed()))
+        {
+            EPRINT("ADC seed conversion failed.\n");
+        }
+
+        is_ok = (HAL_OK == HAL_TIM_Base_Init(&hndl_tim)) &&
+                (HAL_OK == HAL_TIMEx_MasterConfigSynchronization(&hndl_tim,
+                                                                 &master_cfg)) &&
+                adc_config(true, true);
+
+        if (is_ok)
+        {
+            HAL_NVIC_SetPriority(ADC3_IRQn, ADC_IRQ_PRIO, 0);
+            HAL_NVIC_EnableIRQ(ADC3_IRQn);
+
+            is_ok = (HAL_OK == HAL_ADC_Start_IT(&hndl_adc1)) &&
+                    (HAL_OK == HAL_TIM_Base_Start(&hndl_tim));
+        }
+
+        adc_sampling = is_ok;
+        bsp_lowpower_stop_veto(BSP_LOWPOWER_ADC, is_ok);
+
+        if (!is_ok)
+        {
+            bsp_adc_sampling_stop();
+            EPRINT("ADC sampling start failed.\n");
+        }
     }
 
-    if (HAL_OK != HAL_ADCEx_Calibration_Start(&hndl_adc1, ADC_SINGLE_ENDED))
+    return is_ok;
+}
+
+void bsp_adc_sampling_stop (void)
+{
+    adc_sampling = false;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_ADC, false);
+
+    if (NULL != hndl_tim.Instance)
     {
-        BL_RAISE_ERROR("ADC calibration failed", EHALADC);
-        EPRINT("ADC calibration failed\n");
+        HAL_TIM_Base_Stop(&hndl_tim);
     }
+    HAL_ADC_Stop_IT(&hndl_adc1);
+    HAL_NVIC_DisableIRQ(ADC3_IRQn);
+
+    if (!adc_config(false, false))
+    {
+        EPRINT("ADC config failed.\n");
+    }
+}
+
+bool bsp_adc_sampling_is_on (void)
+{
+    return adc_sampling && (0u < adc_sample_cnt);
 }
 
 int32_t bsp_adc_val_get (void)
 {
     int32_t adc_value = 0;
+
+    if (adc_sampling)
+    {
+        // Conversions are owned by the trigger, return filtered value.
+        return (0u < adc_sample_cnt) ? (int32_t)(adc_snapshot >> 16) : -1;
+    }
+
     HAL_ADC_Start(&hndl_adc1);
 
     if (HAL_OK == HAL_ADC_PollForConversion(&hndl_adc1, 1000))
@@ -117,15 +229,20 @@ int32_t bsp_adc_val_get (void)
 
 /**
  * @brief Gets voltage on VBAT pin
- * @return Battery voltage in mV
+ * @return Battery voltage in mV, 0 if there is no reading
  */
 uint16_t bsp_battery_voltage_get (void)
 {
     uint32_t adc_value = 0;
-    uint32_t vbat;
     int32_t temp_adc;
     uint8_t cnt_avg = 0;
 
+    if (adc_sampling)
+    {
+        // Conversions are owned by the trigger, return filtered value.
+        return (0u < adc_sample_cnt) ? (uint16_t)adc_snapshot : 0u;
+    }
+
     // Take multiple ADC samples.
     adc_value = 0;
     cnt_avg = 0;
@@ -155,12 +272,136 @@ uint16_t bsp_battery_voltage_get (void)
     }
 
 
-    // Convert ADC value to mV.
-    vbat = (uint32_t)(((float)adc_value * (float)ADC_REF * ADC_DIV) /
-                      ((float)ADC_FULL_SCALE)) + ADC_OFFSET;
+    return adc_to_mv(adc_value);
+}
 
-    return (uint16_t) vbat;
+uint32_t bsp_adc_sample_cnt_get (void)
+{
+    return adc_sample_cnt;
 }
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 
+static bool adc_config (bool oversampled, bool triggered)
+{
+    ADC_ChannelConfTypeDef sConfig;
+
+    hndl_adc1.Instance                    = ADC_INSTANCE;
+    hndl_adc1.Init.ClockPrescaler         = ADC_CLOCK_ASYNC_DIV256;
+    hndl_adc1.Init.Resolution             = ADC_RESOLUTION_12B;
+    hndl_adc1.Init.DataAlign              = ADC_DATAALIGN_RIGHT;
+    hndl_adc1.Init.ScanConvMode           = ADC_SCAN_DISABLE;
+    hndl_adc1.Init.EOCSelection           = ADC_EOC_SINGLE_CONV;
+    hndl_adc1.Init.LowPowerAutoWait       = DISABLE;
+    hndl_adc1.Init.ContinuousConvMode     = DISABLE;
+    hndl_adc1.Init.NbrOfConversion        = 1;
+    hndl_adc1.Init.DiscontinuousConvMode  = DISABLE;
+    hndl_adc1.Init.NbrOfDiscConversion    = 1;
+    hndl_adc1.Init.ExternalTrigConv       = ADC_SOFTWARE_START;
+    hndl_adc1.Init.ExternalTrigConvEdge   = ADC_EXTERNALTRIGCONVEDGE_NONE;
+    hndl_adc1.Init.DMAContinuousRequests  = DISABLE;
+    hndl_adc1.Init.Overrun                = ADC_OVR_DATA_PRESERVED;
+    hndl_adc1.Init.OversamplingMode       = DISABLE;
+
+    if (triggered)
+    {
+        hndl_adc1.Init.ExternalTrigConv     = ADC_EXTERNALTRIG_T6_TRGO;
+        hndl_adc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+        hndl_adc1.Init.Overrun              = ADC_OVR_DATA_OVERWRITTEN;
+    }
+
+    if (oversampled)
+    {
+        hndl_adc1.Init.OversamplingMode     = ENABLE;
+        hndl_adc1.Init.Oversampling.Ratio         = ADC_OVERSAMPLING_RATIO_16;
+        hndl_adc1.Init.Oversampling.RightBitShift = ADC_RIGHTBITSHIFT_4;
+        // All 16 conversions run on a single trigger.
+        hndl_adc1.Init.Oversampling.TriggeredMode =
+            ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+        hndl_adc1.Init.Oversampling.OversamplingStopReset =
+            ADC_REGOVERSAMPLING_CONTINUED_MODE;
+    }
+
+    if (HAL_OK != HAL_ADC_Init(&hndl_adc1))
+    {
+        return false;
+    }
+
+    /**Configure Regular Channel
+    */
+    sConfig.Channel      = ADC_CHANNEL;
+    sConfig.Rank         = 1;
+    sConfig.SamplingTime = ADC_SAMPLETIME_92CYCLES_5;
+    sConfig.SingleDiff   = ADC_SINGLE_ENDED;
+    sConfig.OffsetNumber = ADC_OFFSET_NONE;
+    sConfig.Offset       = 0;
+
+    return (HAL_OK == HAL_ADC_ConfigChannel(&hndl_adc1, &sConfig));
+}
+
+static bool adc_seed (void)
+{
+    bool is_ok = (HAL_OK == HAL_ADC_Start(&hndl_adc1)) &&
+                 (HAL_OK == HAL_ADC_PollForConversion(&hndl_adc1,
+                                                      ADC_SEED_TIMEOUT_MS));
+
+    if (is_ok)
+    {
+        adc_sample_add(HAL_ADC_GetValue(&hndl_adc1));
+    }
+
+    HAL_ADC_Stop(&hndl_adc1);
+
+    return is_ok;
+}
+
+static void adc_sample_add (uint32_t adc_value)
+{
+    if (0u == adc_sample_cnt)
+    {
+        adc_ema = adc_value << ADC_EMA_FRAC;
+    }
+    else
+    {
+        adc_ema = adc_ema - (adc_ema >> ADC_EMA_SHIFT) +
+                  ((adc_value << ADC_EMA_FRAC) >> ADC_EMA_SHIFT);
+    }
+
+    adc_value = (adc_ema + (1u << (ADC_EMA_FRAC - 1u))) >> ADC_EMA_FRAC;
+    adc_snapshot = (adc_value << 16) | adc_to_mv(adc_value);
+    adc_sample_cnt++;
+}
+
+static uint16_t adc_to_mv (uint32_t adc_value)
+{
+    // Convert ADC value to mV, rounded. 12-bit value times scale fits 32 bits.
+    uint32_t vbat = ((adc_value * ADC_MV_SCALE_Q16) + 0x8000u) >> 16;
+    vbat = vbat + ADC_OFFSET;
+
+    return (uint16_t) vbat;
+}
+
+static uint32_t adc_tim_prescaler (void)
+{
+    uint32_t tim_clk = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at double PCLK1 once APB1 is divided.
+    if (0u != (RCC->CFGR & RCC_CFGR_PPRE1_2))
+    {
+        tim_clk *= 2u;
+    }
+
+    return (tim_clk / ADC_TIM_BASE_FREQ) - 1u;
+}
+
 //--------------------------- INTERRUPT HANDLERS ------------------------------
+
+void ADC3_IRQHandler (void)
+{
+    HAL_ADC_IRQHandler(&hndl_adc1);
+}
+
+void HAL_ADC_ConvCpltCallback (ADC_HandleTypeDef *hadc)
+{
+    adc_sample_add(HAL_ADC_GetValue(hadc));
+}
+
@@ -16,6 +16,7 @@ extern "C" {
 
 //------------------------------ INCLUDES -------------------------------------
 #include <stdint.h>
+#include <stdbool.h>
 
 //-------------------------- CONSTANTS & MACROS -------------------------------
 
@@ -29,14 +30,44 @@ extern "C" {
 void bsp_adc_init (void);
 
 /**
- * @brief Function that polls ADC value
- * @return ADC conversion value, or -1 if timeout.
+ * @brief Start background sampling, TIM6 triggers 16x oversampled conversions
+ *        which are filtered into a snapshot read by bsp_battery_voltage_get.
+ *        The snapshot is seeded by one conversion before the trigger starts
+ * @param rate_hz trigger rate, 1 Hz to 5 kHz
+ * @return true on success
+ */
+bool bsp_adc_sampling_start (uint16_t rate_hz);
+
+/**
+ * @brief Stop background sampling and return to polled conversions
+ * @return none
+ */
+void bsp_adc_sampling_stop (void);
+
+/**
+ * @brief Check whether background sampling runs and has a reading
+ * @return true if readings come from the snapshot
+ */
+bool bsp_adc_sampling_is_on (void);
+
+/**
+ * @brief Get number of background samples since sampling start, seed
+ *        conversion included
+ * @return sample count
+ */
+uint32_t bsp_adc_sample_cnt_get (void);
+
+/**
+ * @brief Function that polls ADC value, filtered value while sampling
+ *        in background
+ * @return ADC conversion value, or -1 if timeout or no sample yet.
  */
 int32_t bsp_adc_val_get (void);
 
 /**
- * @brief Gets voltage on VBAT pin
- * @return Battery voltage in mV
+ * @brief Gets voltage on VBAT pin. While sampling in background returns the
+ *        snapshot without waiting
+ * @return Battery voltage in mV, 0 if there is no reading
  */
 uint16_t bsp_battery_voltage_get (void);
 
@@ -0,0 +1,245 @@
+/** @file battery.c
+*
+* @brief Battery state of charge estimation.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/battery.h>
+#include <inc/bsp/adc.h>
+#include <inc/bsp/gps.h>
+#include <inc/bsp/wifi.h>
+#include <stddef.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define BATTERY_CAPACITY_MAH    (500u)
+#define BATTERY_CAPACITY_MAS    ((int32_t)(BATTERY_CAPACITY_MAH * 3600u))
+// Internal resistance, compensates voltage drop under modelled load.
+#define BATTERY_R_INT_MOHM      (150u)
+
+// Modelled average currents. MCU and BLE module are always powered.
+#define BATTERY_BASE_UA         (8000u)
+#define BATTERY_GPS_UA          (25000u)
+#define BATTERY_WIFI_UA         (80000u)
+
+// Time constant of the pull towards the OCV estimate.
+#define BATTERY_OCV_TAU_MS      (600000u)
+
+#define BATTERY_UA_MS_PER_MAS   (1000000u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint16_t mv;
+    uint16_t permille;
+} battery_ocv_point_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Look up state of charge of open circuit voltage.
+ * @param mv open circuit voltage in mV
+ * @return State of charge in per mille
+ */
+static uint16_t battery_ocv_lookup (uint32_t mv);
+
+/**
+ * @brief Estimate remaining charge from loaded battery voltage.
+ * @param mv battery voltage in mV
+ * @return Remaining charge in mAs
+ */
+static int32_t battery_ocv_charge (uint32_t mv);
+
+/**
+ * @brief Publish remaining charge as state of charge snapshot.
+ * @return none
+ */
+static void battery_soc_publish (void);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+// Single cell LiPo discharge curve at rest, ordered by falling voltage.
+static const battery_ocv_point_t battery_ocv[] = {
+    { 4200u, 1000u },
+    { 4100u,  900u },
+    { 4000u,  780u },
+    { 3900u,  650u },
+    { 3800u,  500u },
+    { 3750u,  400u },
+    { 3700u,  300u },
+    { 3650u,  200u },
+    { 3600u,  120u },
+    { 3500u,   50u },
+    { 3300u,    0u },
+};
+
+static int32_t battery_charge_mas;                  // Updating task only.
+static uint32_t battery_rem_uams;
+static volatile uint16_t battery_soc_permille;
+static volatile bool battery_charging;
+static volatile bool battery_reseed;
+static bool battery_seeded;                         // Updating task only.
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+void bsp_battery_soc_init (void)
+{
+    uint16_t mv = bsp_battery_voltage_get();
+
+    battery_rem_uams = 0u;
+    battery_reseed = false;
+
+    // No reading is no charge estimate, first sample seeds it instead.
+    battery_seeded = (0u != mv);
+    if (battery_seeded)
+    {
+        battery_charge_mas = battery_ocv_charge(mv);
+        battery_soc_publish();
+    }
+}
+
+void bsp_battery_soc_update (uint32_t dt_ms)
+{
+    if ((battery_reseed || (!battery_seeded)) && bsp_adc_sampling_is_on())
+    {
+        battery_reseed = false;
+        battery_seeded = true;
+        battery_charge_mas = battery_ocv_charge(bsp_battery_voltage_get());
+        battery_rem_uams = 0u;
+    }
+    else if (!battery_seeded)
+    {
+        // Nothing to integrate from until a voltage reading arrives.
+        return;
+    }
+    else if (!battery_charging)
+    {
+        // Integrate modelled current, remainder carries sub-mAs charge over.
+        uint64_t uams = ((uint64_t)bsp_battery_current_get() * dt_ms) +
+                        battery_rem_uams;
+
+        battery_rem_uams = (uint32_t)(uams % BATTERY_UA_MS_PER_MAS);
+        battery_charge_mas -= (int32_t)(uams / BATTERY_UA_MS_PER_MAS);
+
+        if (bsp_adc_sampling_is_on())
+        {
+            // Voltage corrects model error slowly, load transients average
+            // out over the time constant.
+            int32_t err = battery_ocv_charge(bsp_battery_voltage_get()) -
+                          battery_charge_mas;
+
+            if (dt_ms > BATTERY_OCV_TAU_MS)
+            {
+                dt_ms = BATTERY_OCV_TAU_MS;
+            }
+            battery_charge_mas += (int32_t)(((int64_t)err * dt_ms) /
+                                            BATTERY_OCV_TAU_MS);
+        }
+
+        if (0 > battery_charge_mas)
+        {
+            battery_charge_mas = 0;
+        }
+    }
+    else
+    {
+        // Charging, estimate is seeded again once charger is removed.
+    }
+
+    battery_soc_publish();
+}
+
+uint8_t bsp_battery_soc_get (void)
+{
+    return (uint8_t)((battery_soc_permille + 5u) / 10u);
+}
+
+void bsp_battery_soc_charging_set (bool is_charging)
+{
+    if (battery_charging && (!is_charging))
+    {
+        battery_reseed = true;
+    }
+
+    battery_charging = is_charging;
+}
+
+uint32_t bsp_battery_current_get (void)
+{
+    uint32_t current_ua = BATTERY_BASE_UA;
+
+    if (bsp_gps_is_on())
+    {
+        current_ua += BATTERY_GPS_UA;
+    }
+
+    if (bsp_wifi_is_on())
+    {
+        current_ua += BATTERY_WIFI_UA;
+    }
+
+    return current_ua;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static uint16_t battery_ocv_lookup (uint32_t mv)
+{
+    const size_t cnt = sizeof(battery_ocv) / sizeof(battery_ocv[0]);
+    uint16_t permille = battery_ocv[0].permille;
+
+    if (mv < battery_ocv[0].mv)
+    {
+        size_t index = 1u;
+
+        while ((index < (cnt - 1u)) && (mv < battery_ocv[index].mv))
+        {
+            index++;
+        }
+
+        const battery_ocv_point_t *p_hi = &battery_ocv[index - 1u];
+        const battery_ocv_point_t *p_lo = &battery_ocv[index];
+
+        if (mv <= p_lo->mv)
+        {
+            permille = p_lo->permille;
+        }
+        else
+        {
+            // Linear interpolation between table points.
+            permille = (uint16_t)(p_lo->permille +
+                                  (((mv - p_lo->mv) *
+                                    (uint32_t)(p_hi->permille - p_lo->permille)) /
+                                   (uint32_t)(p_hi->mv - p_lo->mv)));
+        }
+    }
+
+    return permille;
+}
+
+static int32_t battery_ocv_charge (uint32_t mv)
+{
+    // Add back voltage drop over internal resistance at modelled load.
+    mv += (bsp_battery_current_get() * BATTERY_R_INT_MOHM) / 1000000u;
+
+    return (int32_t)(((int64_t)BATTERY_CAPACITY_MAS *
+                      battery_ocv_lookup(mv)) / 1000);
+}
+
+static void battery_soc_publish (void)
+{
+    int32_t permille = (int32_t)(((int64_t)battery_charge_mas * 1000) /
+                                 BATTERY_CAPACITY_MAS);
+
+    if (1000 < permille)
+    {
+        permille = 1000;
+    }
+
+    battery_soc_permille = (uint16_t)permille;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,68 @@
+/** @file battery.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_BATTERY_H
+#define CROSSBOX_BATTERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Seed state of charge from battery voltage. Uses the background ADC
+ *        snapshot when sampling runs, otherwise a polled reading. Without a
+ *        reading the estimate stays unset and the first update that has a
+ *        background sample seeds it.
+ * @return none
+ */
+void bsp_battery_soc_init (void);
+
+/**
+ * @brief Advance estimate by elapsed time. Integrates the modelled current of
+ *        powered peripherals and pulls the result slowly towards the OCV
+ *        table value of the latest voltage snapshot. Never samples the ADC.
+ * @param dt_ms time since previous update
+ * @return none
+ */
+void bsp_battery_soc_update (uint32_t dt_ms);
+
+/**
+ * @brief Get latest estimate, O(1), 0 until the estimate is seeded
+ * @return State of charge in percent
+ */
+uint8_t bsp_battery_soc_get (void);
+
+/**
+ * @brief Tell estimator about charger state. Current integration pauses while
+ *        charging, estimate is seeded again from voltage when charging ends.
+ * @param is_charging true while charger is connected
+ * @return none
+ */
+void bsp_battery_soc_charging_set (bool is_charging);
+
+/**
+ * @brief Get modelled battery current of powered peripherals
+ * @return Current in uA
+ */
+uint32_t bsp_battery_current_get (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_BATTERY_H
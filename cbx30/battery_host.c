@@ -0,0 +1,196 @@
+/** @file battery_host.c
+*
+* @brief Host check of the state of charge estimator against a discharge
+*        trace. Each row sets battery voltage snapshot and GPS/WiFi power as
+*        the estimator would see them, runs bsp_battery_soc_update over the
+*        row interval and compares the estimate with the reference SoC of
+*        the row. Fails when the error leaves the bounds below. Estimator
+*        starts as right after boot, before the first ADC sample.
+*
+*        gcc -DBATTERY_HOST -Ihost -I. battery.c battery_host.c -o battery
+*        ./battery [-v] [host/battery_discharge.csv]
+*
+*        Trace columns: time s, loaded cell voltage mV, GPS on, WiFi on,
+*        reference SoC %. Lines starting with '#' and the header are skipped.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/battery.h>
+#include <inc/bsp/adc.h>
+#include <inc/bsp/gps.h>
+#include <inc/bsp/wifi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_TRACE                  "host/battery_discharge.csv"
+#define HOST_LINE_LEN               (128u)
+
+// Largest error anywhere in the trace, and mean absolute error, in percent.
+#define HOST_ERR_MAX_PCT            (5.0)
+#define HOST_ERR_MEAN_PCT           (2.0)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static uint16_t host_mv;
+static bool host_sampling;
+static bool host_gps;
+static bool host_wifi;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef BATTERY_HOST
+int main(int argc, char **argv)
+{
+    const char *p_path = HOST_TRACE;
+    char line[HOST_LINE_LEN];
+    bool verbose = false;
+    bool is_ok = true;
+    uint32_t rows = 0u;
+    uint32_t time_s;
+    uint32_t last_s = 0u;
+    uint32_t err_max_s = 0u;
+    unsigned mv;
+    unsigned gps;
+    unsigned wifi;
+    double soc_ref;
+    double err_max = 0.0;
+    double err_sum = 0.0;
+    double err_end = 0.0;
+    FILE *p_input;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "v")))
+    {
+        if ('v' == opt)
+        {
+            verbose = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-v] [trace.csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind < argc)
+    {
+        p_path = argv[optind];
+    }
+
+    if (NULL == (p_input = fopen(p_path, "r")))
+    {
+        fprintf(stderr, "can not open %s\n", p_path);
+        return 1;
+    }
+
+    // Boot: no conversion yet, voltage reads as none. Seeding 0 % here
+    // would show as large error at the start of the trace.
+    host_mv = 0u;
+    host_sampling = false;
+    bsp_battery_soc_init();
+    if (0u != bsp_battery_soc_get())
+    {
+        fprintf(stderr, "seeded without a reading\n");
+        is_ok = false;
+    }
+
+    // Updates before the first sample neither seed nor integrate.
+    bsp_battery_soc_update(1000u);
+    if (0u != bsp_battery_soc_get())
+    {
+        fprintf(stderr, "estimate without a reading\n");
+        is_ok = false;
+    }
+
+    host_sampling = true;
+
+    while (NULL != fgets(line, sizeof(line), p_input))
+    {
+        if (5 != sscanf(line, "%u,%u,%u,%u,%lf", &time_s, &mv, &gps, &wifi,
+                        &soc_ref))
+        {
+            continue;
+        }
+
+        host_mv = (uint16_t)mv;
+        host_gps = (0u != gps);
+        host_wifi = (0u != wifi);
+
+        bsp_battery_soc_update((0u == rows) ? 0u : ((time_s - last_s) * 1000u));
+        last_s = time_s;
+        rows++;
+
+        double err = (double)bsp_battery_soc_get() - soc_ref;
+        double abs_err = (0.0 > err) ? -err : err;
+
+        if (abs_err > err_max)
+        {
+            err_max = abs_err;
+            err_max_s = time_s;
+        }
+        err_sum += abs_err;
+        err_end = err;
+
+        if (verbose)
+        {
+            printf("%u,%u,%u,%.1f\n", time_s, mv, bsp_battery_soc_get(),
+                   soc_ref);
+        }
+    }
+
+    fclose(p_input);
+
+    if (0u == rows)
+    {
+        fprintf(stderr, "no rows in %s\n", p_path);
+        return 1;
+    }
+
+    fprintf(stderr, "%u rows, %.1f h: max error %.1f %% at %u s, "
+            "mean %.2f %%, end %+.1f %%\n", rows, (double)last_s / 3600.0,
+            err_max, err_max_s, err_sum / rows, err_end);
+
+    is_ok = is_ok && (HOST_ERR_MAX_PCT >= err_max) &&
+            (HOST_ERR_MEAN_PCT >= (err_sum / rows));
+
+    fprintf(stderr, "%s\n", is_ok ? "ok" : "failed");
+
+    return !is_ok;
+}
+#endif
+
+uint16_t bsp_battery_voltage_get(void)
+{
+    return host_mv;
+}
+
+bool bsp_adc_sampling_is_on(void)
+{
+    return host_sampling;
+}
+
+bool bsp_gps_is_on(void)
+{
+    return host_gps;
+}
+
+bool bsp_wifi_is_on(void)
+{
+    return host_wifi;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
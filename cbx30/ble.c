@@ -18,6 +18,9 @@
 #include <nrf.h>
 #include <transport/ser_phy/ser_phy.h>
 #include <inc/bsp/bsp.h>
+#include <inc/bsp/dma.h>
+#include <inc/bsp/lowpower.h>
+#include <string.h>
 
 //-------------------------------- MACROS -------------------------------------
 
@@ -43,10 +46,22 @@
 bool bluart_stm32_hal_TxCpltCallback (UART_HandleTypeDef *huart);
 bool bluart_stm32_hal_RxCpltCallback (UART_HandleTypeDef *huart);
 
+/**
+ * DMA TX completion, reports sent buffer to serialization layer.
+ */
+static void bsp_ble_tx_done(void *p_ctx, const uint8_t *p_data, size_t len);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 
 UART_HandleTypeDef huart1;
 
+// Receive request set by bsp_ble_set_rx, filled from DMA task.
+static uint8_t * volatile p_ble_rx_buf;
+static volatile uint16_t ble_rx_len;
+static volatile uint16_t ble_rx_cnt;
+// Reception gate, replaces USART1 RX interrupt masking.
+static volatile bool ble_rx_enabled = true;
+
 //------------------------------ GLOBAL DATA ----------------------------------
 
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
@@ -110,16 +125,22 @@ uint8_t bsp_ble_init(void)
 
     __HAL_UART_DISABLE_IT(&huart1, UART_IT_ERR);
 
+    bsp_dma_rx_uart_enable(BSP_DMA_RX_BLE);
+
     return (uint8_t)is_ok;
 }
 
-void bsp_ble_send (uint8_t *p_str, uint16_t len)
+bool bsp_ble_send (uint8_t *p_str, uint16_t len)
 {
+    bool is_ok = false;
 
     if ((NULL != p_str) && (0 < len))
     {
-        HAL_UART_Transmit_IT(&huart1, p_str, len);
+        is_ok = bsp_dma_tx_enqueue(BSP_DMA_TX_BLE, p_str, len,
+                                   bsp_ble_tx_done, NULL);
     }
+
+    return is_ok;
 }
 
 
@@ -146,26 +167,81 @@ void bsp_ble_set_rst(uint8_t state)
 
 bool bsp_ble_set_rx(uint8_t *p_buffer, uint16_t len)
 {
-    return (bool)HAL_UART_Receive_IT(&huart1, p_buffer, len);
+    bool is_err = true;
+
+    if ((NULL != p_buffer) && (0 < len) && (NULL == p_ble_rx_buf))
+    {
+        ble_rx_len = len;
+        ble_rx_cnt = 0;
+        p_ble_rx_buf = p_buffer;
+        is_err = false;
+
+        // Data may already be waiting in the DMA buffer.
+        bsp_dma_rx_kick();
+    }
+
+    return is_err;
 }
 
 void bsp_ble_enable_irq(void)
 {
     HAL_NVIC_SetPriority(BLE_SER_IRQ_HANDLE, BLE_SER_IRQ_PRIO, BLE_SER_IRQ_SUB_PRIO);
     HAL_NVIC_EnableIRQ(BLE_SER_IRQ_HANDLE);
+
+    ble_rx_enabled = true;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_BLE_RX, true);
+    bsp_dma_rx_kick();
 }
 
 void bsp_ble_disable_irq(void)
 {
+    ble_rx_enabled = false;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_BLE_RX, false);
     HAL_NVIC_DisableIRQ(BLE_SER_IRQ_HANDLE);
 }
+
+size_t bsp_ble_dma_rx_consumer(bsp_dma_rx_id_t id,
+                               const volatile uint8_t *p_data, size_t len,
+                               uint64_t rx_us)
+{
+    size_t accepted = 0;
+
+    // Callback may set the next receive buffer, keep filling while it does.
+    while ((ble_rx_enabled) && (NULL != p_ble_rx_buf) && (accepted < len))
+    {
+        size_t n = ble_rx_len - ble_rx_cnt;
+        if (n > (len - accepted))
+        {
+            n = len - accepted;
+        }
+
+        memcpy(&p_ble_rx_buf[ble_rx_cnt], (const uint8_t *)&p_data[accepted], n);
+        ble_rx_cnt = ble_rx_cnt + n;
+        accepted = accepted + n;
+
+        if (ble_rx_cnt == ble_rx_len)
+        {
+            p_ble_rx_buf = NULL;
+            uart_ser_callback_rx(&huart1);
+        }
+    }
+
+    bsp_dma_rx_release(id, accepted);
+
+    return accepted;
+}
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 
+static void bsp_ble_tx_done(void *p_ctx, const uint8_t *p_data, size_t len)
+{
+    uart_ser_callback_tx(&huart1);
+}
+
 //--------------------------- INTERRUPT HANDLERS ------------------------------
 
 void SER_UART_IRQ(void)
 {
-    HAL_UART_IRQHandler(&huart1);
+    bsp_dma_rx_uart_irq_handler(&huart1, BSP_DMA_RX_BLE);
 }
 
 bool bluart_stm32_hal_TxCpltCallback(UART_HandleTypeDef *huart)
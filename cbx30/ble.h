@@ -17,6 +17,8 @@ extern "C" {
 //------------------------------ INCLUDES -------------------------------------
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <inc/bsp/dma.h>
 
 //-------------------------- CONSTANTS & MACROS -------------------------------
 
@@ -31,11 +33,13 @@ extern "C" {
 uint8_t bsp_ble_init(void);
 
 /**
- * @brief Send transmit data to BLE module.
+ * @brief Queue transmit data to BLE module. Buffer must stay valid until
+ *      uart_ser_callback_tx() reports it sent.
  * @param p_str Tx buffer.
  * @param len Len of tx buffer.
+ * @return true if queued, false if TX queue is full.
  */
-void bsp_ble_send (uint8_t *p_str, uint16_t len);
+bool bsp_ble_send (uint8_t *p_str, uint16_t len);
 
 /**
  * @brief Reads received data.
@@ -59,6 +63,15 @@ void bsp_ble_set_rst(uint8_t state);
  */
 bool bsp_ble_set_rx(uint8_t *p_buffer, uint16_t len);
 
+/**
+ * @brief Default DMA consumer of the BLE link. Fills buffer set by
+ *      bsp_ble_set_rx and reports completion from the DMA task.
+ * @return Number of accepted bytes.
+ */
+size_t bsp_ble_dma_rx_consumer(bsp_dma_rx_id_t id,
+                               const volatile uint8_t *p_data, size_t len,
+                               uint64_t rx_us);
+
 /**
  * @brief Enables BLE_USART IRQ.
  */
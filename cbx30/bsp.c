@@ -10,6 +10,9 @@
 //------------------------------ INCLUDES -------------------------------------
 #include <inc/bsp/bsp.h>
 #include <inc/bsp/rtc.h>
+#include <inc/bsp/timestamp.h>
+#include <inc/bsp/lowpower.h>
+#include <inc/bsp/clock.h>
 #include <stm32l4xx_hal.h>
 #include <blgpio.h>
 #include <bluart.h>
@@ -29,7 +32,7 @@
 #include <inc/bsp/dma.h>
 
 //-------------------------------- MACROS -------------------------------------
-#define PRESCALER       (4799)
+#define TIM_USR_HZ      (10000u)    // Counter clock, prescaler follows SYSCLK.
 #define PERIOD          (199)       // Frequency of 50Hz
 #define TIM_USR_IRQ     TIM3_IRQn
 #define TIM_USR         TIM3
@@ -50,7 +53,6 @@
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
 static void system_clock_setup_48MHz (void);
-static void system_clock_setup_80MHz(void);
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 
 static TIM_HandleTypeDef struct1;
@@ -72,6 +74,8 @@ void bsp_init (void) {
     bloswrap_init();
 
     bsp_rtc_init();
+    bsp_timestamp_init();
+    bsp_lowpower_init();
 
     bsp_i2c_init();
 
@@ -96,6 +100,9 @@ void bsp_init (void) {
     }
 
     bsp_dma_init();
+
+    // Peripherals are set up at boot clock, governor rescales them.
+    bsp_clock_init();
 }
 
 void bsp_system_clock_config (void)
@@ -143,6 +150,12 @@ uint8_t bsp_get_timestamp(int32_t *p_unix_timestamp, uint16_t *p_milisec)
 {
     uint8_t ret_val = 1;
 
+    if ((NULL != p_unix_timestamp) && (NULL != p_milisec) &&
+        bsp_timestamp_unix_get(p_unix_timestamp, p_milisec))
+    {
+        ret_val = 0;
+    }
+
     return ret_val;
 }
 
@@ -154,7 +167,7 @@ void bsp_timer_init(void)
     //Define timer value
 
     struct1.Instance = TIM_USR;
-    struct1.Init.Prescaler = PRESCALER;
+    struct1.Init.Prescaler = (SystemCoreClock / TIM_USR_HZ) - 1u;
     struct1.Init.CounterMode = TIM_COUNTERMODE_UP;
     struct1.Init.Period = PERIOD;
     struct1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -169,6 +182,8 @@ void bsp_timer_init(void)
     HAL_NVIC_SetPriority(TIM_USR_IRQ, 6, 0);
     HAL_NVIC_EnableIRQ(TIM_USR_IRQ);
 
+    // Timer does not count in STOP2.
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_HW_TIMER, true);
 }
 
 void bsp_timer_enable(void)
@@ -184,83 +199,6 @@ void bsp_system_reset (void)
 
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 
-static void system_clock_setup_80MHz(void)
-{
-    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
-    RCC_PeriphCLKInitTypeDef PeriphClkInit = {0};
-
-    /**Configure LSE Drive Capability
-    */
-    HAL_PWR_EnableBkUpAccess();
-    __HAL_RCC_LSEDRIVE_CONFIG(RCC_LSEDRIVE_LOW);
-    /**Initializes the CPU, AHB and APB busses clocks
-    */
-    RCC_OscInitStruct.OscillatorType =
-            RCC_OSCILLATORTYPE_LSE|RCC_OSCILLATORTYPE_LSI|RCC_OSCILLATORTYPE_MSI;
-    RCC_OscInitStruct.LSEState = RCC_LSE_ON;
-    RCC_OscInitStruct.LSIState = RCC_LSI_ON;
-    RCC_OscInitStruct.MSIState = RCC_MSI_ON;
-    RCC_OscInitStruct.MSICalibrationValue = 0;
-    RCC_OscInitStruct.MSIClockRange = RCC_MSIRANGE_11;
-    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_MSI;
-    RCC_OscInitStruct.PLL.PLLM = 3;
-    RCC_OscInitStruct.PLL.PLLN = 10;
-    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV7;
-    RCC_OscInitStruct.PLL.PLLQ = RCC_PLLQ_DIV2;
-    RCC_OscInitStruct.PLL.PLLR = RCC_PLLR_DIV2;
-    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
-    {
-        BL_RAISE_ERROR("RCC oscillator config failed.", EHALRCC);
-        EPRINT("Rcc oscilator config failed\n");
-    }
-    /**Initializes the CPU, AHB and APB busses clocks
-    */
-    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
-                                  |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
-    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
-    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
-
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
-    {
-        BL_RAISE_ERROR("RCC oscillator config failed.", EHALRCC);
-        EPRINT("RCC oscillator config failed.\n");
-    }
-
-    PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_UART4|
-                                         RCC_PERIPHCLK_USB|
-                                         RCC_PERIPHCLK_SDMMC1|
-                                         RCC_PERIPHCLK_ADC|
-                                         RCC_PERIPHCLK_I2C2|
-                                         RCC_PERIPHCLK_RTC;
-    PeriphClkInit.Uart4ClockSelection = RCC_UART4CLKSOURCE_PCLK1;
-    PeriphClkInit.UsbClockSelection = RCC_USBCLKSOURCE_MSI;
-    PeriphClkInit.Sdmmc1ClockSelection = RCC_SDMMC1CLKSOURCE_MSI;
-    PeriphClkInit.AdcClockSelection = RCC_ADCCLKSOURCE_SYSCLK;
-    PeriphClkInit.RTCClockSelection = RCC_RTCCLKSOURCE_LSE;
-    PeriphClkInit.I2c2ClockSelection = RCC_I2C2CLKSOURCE_PCLK1;
-    if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) != HAL_OK)
-    {
-        BL_RAISE_ERROR("RCC oscillator config failed.", EHALRCC);
-        EPRINT("RCC oscillator config failed.\n");
-    }
-
-    /**Configure the main internal regulator output voltage
-    */
-    if (HAL_PWREx_ControlVoltageScaling(PWR_REGULATOR_VOLTAGE_SCALE1) != HAL_OK)
-    {
-        BL_RAISE_ERROR("RCC oscillator config failed.", EHALRCC);
-        EPRINT("RCC oscillator config failed.\n");
-    }
-
-    /**Enable MSI Auto calibration
-    */
-    HAL_RCCEx_EnableMSIPLLMode();
-}
-
 static void system_clock_setup_48MHz (void)
 {
     RCC_OscInitTypeDef RCC_OscInitStruct = {0};
@@ -37,10 +37,11 @@ void bsp_init(void);
 void bsp_delay_ms (uint32_t timeout);
 
 /**
- * Fetches unix timestamp and milliseconds
+ * Fetches unix timestamp and milliseconds from the timestamp service, cheap
+ * enough for every logged sample and safe from ISRs.
  * @param p_unix_timestamp location where unix timestamp is stored
  * @param p_milisec location where milliseconds value is stored
- * @return
+ * @return 0 on success, 1 if arguments are NULL or service is not started
  */
 uint8_t bsp_get_timestamp(int32_t *p_unix_timestamp, uint16_t *p_milisec);
 
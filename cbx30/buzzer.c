@@ -9,6 +9,7 @@
 
 //------------------------------ INCLUDES -------------------------------------
 #include <inc/bsp/buzzer.h>
+#include <inc/bsp/lowpower.h>
 #include <FreeRTOS.h>
 #include <timers.h>
 #include <RTT.h>
@@ -107,12 +108,14 @@ void bsp_buzzer_pwm_start (uint16_t frequency)
         sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
         HAL_TIM_PWM_ConfigChannel(p_htim, &sConfigOC, BUZZER_TIMER_CHANNEL);
         HAL_TIM_PWM_Start(p_htim, BUZZER_TIMER_CHANNEL);
+        bsp_lowpower_stop_veto(BSP_LOWPOWER_BUZZER, true);
     }
 }
 
 void bsp_buzzer_pwm_stop (void)
 {
     HAL_TIM_PWM_Stop(&BUZZER_TIMER_HANDLER, BUZZER_TIMER_CHANNEL);
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_BUZZER, false);
 }
 
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
@@ -0,0 +1,408 @@
+/** @file circular_buffer.c
+*
+* @brief Generic byte circular buffer with optional locking and signalling.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <circular_buffer.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Take buffer lock. Does nothing in SPSC mode or without lock callback.
+ */
+static void circ_buff_lock(circ_buff_t *gcb);
+
+/**
+ * @brief Release buffer lock. Does nothing in SPSC mode or without callback.
+ */
+static void circ_buff_unlock(circ_buff_t *gcb);
+
+/**
+ * @brief Load offset owned by the other side (acquire in SPSC mode).
+ */
+static size_t circ_buff_ofs_load(circ_buff_t *gcb, size_t *p_ofs);
+
+/**
+ * @brief Publish own offset (release in SPSC mode).
+ */
+static void circ_buff_ofs_store(circ_buff_t *gcb, size_t *p_ofs, size_t ofs);
+
+/**
+ * @brief Number of used bytes for given offsets.
+ */
+static size_t circ_buff_used_calc(const circ_buff_t *gcb, size_t rd, size_t wr);
+
+/**
+ * @brief Move offset forward by n bytes, wrapping at the end of memory.
+ */
+static size_t circ_buff_ofs_advance(const circ_buff_t *gcb, size_t ofs,
+                                    size_t n);
+
+/**
+ * @brief Copy data in, without locking. Returns number of bytes written.
+ */
+static size_t circ_buff_write_exec(circ_buff_t *gcb, const uint8_t *p_data,
+                                   size_t n);
+
+/**
+ * @brief Copy data out, without locking. Returns number of bytes read.
+ */
+static size_t circ_buff_read_exec(circ_buff_t *gcb, uint8_t *p_data, size_t n);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void circ_buff_init(circ_buff_t *gcb, void *mem, size_t mem_sz)
+{
+    memset(gcb, 0, sizeof(circ_buff_t));
+    gcb->mem = (uint8_t *)mem;
+    gcb->mem_sz = mem_sz;
+}
+
+void circ_buff_spsc_init(circ_buff_t *gcb, void *mem, size_t mem_sz)
+{
+    circ_buff_init(gcb, mem, mem_sz);
+    gcb->spsc = true;
+}
+
+void circ_buff_locking_init(circ_buff_t *gcb,
+                            circ_buff_lock_cb_t global_lock,
+                            circ_buff_lock_cb_t global_unlock,
+                            void *lock)
+{
+    gcb->global_lock = global_lock;
+    gcb->global_unlock = global_unlock;
+    gcb->lock = lock;
+}
+
+void circ_buff_signaling_init(circ_buff_t *gcb,
+                              circ_buff_signal_set_cb_t signal_set,
+                              circ_buff_signal_wait_cb_t signal_wait,
+                              void *signal)
+{
+    gcb->signal_set = signal_set;
+    gcb->signal_wait = signal_wait;
+    gcb->signal = signal;
+}
+
+void circ_buff_clear(circ_buff_t *gcb)
+{
+    // In SPSC mode only the consumer may clear, by catching up with producer.
+    circ_buff_lock(gcb);
+    circ_buff_ofs_store(gcb, &gcb->rd_ofs,
+                        circ_buff_ofs_load(gcb, &gcb->wr_ofs));
+    circ_buff_unlock(gcb);
+}
+
+bool circ_buff_push(circ_buff_t *gcb, uint8_t d, int timeout)
+{
+    bool result = (1u == circ_buff_write(gcb, &d, 1u));
+
+    if ((!result) && (0 != timeout) && (NULL != gcb->signal_wait))
+    {
+        if (gcb->signal_wait(gcb, gcb->signal, timeout))
+        {
+            result = (1u == circ_buff_write(gcb, &d, 1u));
+        }
+    }
+
+    return result;
+}
+
+int circ_buff_pop(circ_buff_t *gcb, int timeout)
+{
+    uint8_t d;
+    int result = -1;
+
+    if (1u == circ_buff_read(gcb, &d, 1u))
+    {
+        result = d;
+    }
+    else if ((0 != timeout) && (NULL != gcb->signal_wait))
+    {
+        if ((gcb->signal_wait(gcb, gcb->signal, timeout)) &&
+            (1u == circ_buff_read(gcb, &d, 1u)))
+        {
+            result = d;
+        }
+    }
+
+    return result;
+}
+
+size_t circ_buff_get_used_size(circ_buff_t *gcb)
+{
+    size_t result;
+
+    circ_buff_lock(gcb);
+    result = circ_buff_used_calc(gcb, circ_buff_ofs_load(gcb, &gcb->rd_ofs),
+                                 circ_buff_ofs_load(gcb, &gcb->wr_ofs));
+    circ_buff_unlock(gcb);
+
+    return result;
+}
+
+size_t circ_buff_get_free_size(circ_buff_t *gcb)
+{
+    // One byte is always kept empty to distinguish full from empty buffer.
+    return (gcb->mem_sz - 1u) - circ_buff_get_used_size(gcb);
+}
+
+size_t circ_buff_write(circ_buff_t *gcb, const uint8_t *p_data, size_t n)
+{
+    size_t result;
+
+    circ_buff_lock(gcb);
+    result = circ_buff_write_exec(gcb, p_data, n);
+    circ_buff_unlock(gcb);
+
+    if ((0u < result) && (NULL != gcb->signal_set))
+    {
+        gcb->signal_set(gcb, gcb->signal);
+    }
+
+    return result;
+}
+
+size_t circ_buff_read(circ_buff_t *gcb, uint8_t *p_data, size_t n)
+{
+    size_t result;
+
+    circ_buff_lock(gcb);
+    result = circ_buff_read_exec(gcb, p_data, n);
+    circ_buff_unlock(gcb);
+
+    if ((0u < result) && (NULL != gcb->signal_set))
+    {
+        gcb->signal_set(gcb, gcb->signal);
+    }
+
+    return result;
+}
+
+void circ_buff_peek_contiguous(circ_buff_t *gcb, uint8_t **pp_data,
+                               size_t *p_len)
+{
+    circ_buff_lock(gcb);
+
+    size_t wr = circ_buff_ofs_load(gcb, &gcb->wr_ofs);
+    size_t rd = gcb->rd_ofs;
+
+    // Readable data ends either at the write offset or at the end of memory.
+    size_t len = (wr >= rd) ? (wr - rd) : (gcb->mem_sz - rd);
+
+    circ_buff_unlock(gcb);
+
+    *pp_data = (0u < len) ? &gcb->mem[rd] : NULL;
+    *p_len = len;
+}
+
+bool circ_buff_consume(circ_buff_t *gcb, size_t n)
+{
+    circ_buff_lock(gcb);
+
+    size_t wr = circ_buff_ofs_load(gcb, &gcb->wr_ofs);
+    size_t rd = gcb->rd_ofs;
+    bool result = (n <= circ_buff_used_calc(gcb, rd, wr));
+
+    if (result)
+    {
+        circ_buff_ofs_store(gcb, &gcb->rd_ofs,
+                            circ_buff_ofs_advance(gcb, rd, n));
+    }
+
+    circ_buff_unlock(gcb);
+
+    if ((result) && (0u < n) && (NULL != gcb->signal_set))
+    {
+        gcb->signal_set(gcb, gcb->signal);
+    }
+
+    return result;
+}
+
+void circ_buff_reserve(circ_buff_t *gcb, uint8_t **pp_data, size_t *p_len)
+{
+    circ_buff_lock(gcb);
+
+    size_t rd = circ_buff_ofs_load(gcb, &gcb->rd_ofs);
+    size_t wr = gcb->wr_ofs;
+    size_t len;
+
+    // Writable space ends one byte before the read offset or at the end of
+    // memory. When read offset is 0 the last memory byte must stay empty.
+    if (wr >= rd)
+    {
+        len = gcb->mem_sz - wr;
+        if (0u == rd)
+        {
+            len = len - 1u;
+        }
+    }
+    else
+    {
+        len = (rd - wr) - 1u;
+    }
+
+    circ_buff_unlock(gcb);
+
+    *pp_data = (0u < len) ? &gcb->mem[wr] : NULL;
+    *p_len = len;
+}
+
+bool circ_buff_commit(circ_buff_t *gcb, size_t n)
+{
+    circ_buff_lock(gcb);
+
+    size_t rd = circ_buff_ofs_load(gcb, &gcb->rd_ofs);
+    size_t wr = gcb->wr_ofs;
+    size_t space = (gcb->mem_sz - 1u) - circ_buff_used_calc(gcb, rd, wr);
+    bool result = (n <= space);
+
+    if (result)
+    {
+        circ_buff_ofs_store(gcb, &gcb->wr_ofs,
+                            circ_buff_ofs_advance(gcb, wr, n));
+    }
+
+    circ_buff_unlock(gcb);
+
+    if ((result) && (0u < n) && (NULL != gcb->signal_set))
+    {
+        gcb->signal_set(gcb, gcb->signal);
+    }
+
+    return result;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void circ_buff_lock(circ_buff_t *gcb)
+{
+    if ((!gcb->spsc) && (NULL != gcb->global_lock))
+    {
+        gcb->global_lock(gcb, gcb->lock);
+    }
+}
+
+static void circ_buff_unlock(circ_buff_t *gcb)
+{
+    if ((!gcb->spsc) && (NULL != gcb->global_unlock))
+    {
+        gcb->global_unlock(gcb, gcb->lock);
+    }
+}
+
+static size_t circ_buff_ofs_load(circ_buff_t *gcb, size_t *p_ofs)
+{
+    size_t result;
+
+    if (gcb->spsc)
+    {
+        result = __atomic_load_n(p_ofs, __ATOMIC_ACQUIRE);
+    }
+    else
+    {
+        result = *p_ofs;
+    }
+
+    return result;
+}
+
+static void circ_buff_ofs_store(circ_buff_t *gcb, size_t *p_ofs, size_t ofs)
+{
+    if (gcb->spsc)
+    {
+        __atomic_store_n(p_ofs, ofs, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        *p_ofs = ofs;
+    }
+}
+
+static size_t circ_buff_used_calc(const circ_buff_t *gcb, size_t rd, size_t wr)
+{
+    return (wr >= rd) ? (wr - rd) : ((gcb->mem_sz - rd) + wr);
+}
+
+static size_t circ_buff_ofs_advance(const circ_buff_t *gcb, size_t ofs,
+                                    size_t n)
+{
+    ofs = ofs + n;
+    if (ofs >= gcb->mem_sz)
+    {
+        ofs = ofs - gcb->mem_sz;
+    }
+
+    return ofs;
+}
+
+static size_t circ_buff_write_exec(circ_buff_t *gcb, const uint8_t *p_data,
+                                   size_t n)
+{
+    size_t rd = circ_buff_ofs_load(gcb, &gcb->rd_ofs);
+    size_t wr = gcb->wr_ofs;
+    size_t space = (gcb->mem_sz - 1u) - circ_buff_used_calc(gcb, rd, wr);
+
+    if (n > space)
+    {
+        n = space;
+    }
+
+    // Copy in at most two chunks, up to the end of memory and from the start.
+    size_t chunk = gcb->mem_sz - wr;
+    if (chunk > n)
+    {
+        chunk = n;
+    }
+
+    memcpy(&gcb->mem[wr], p_data, chunk);
+    memcpy(&gcb->mem[0], &p_data[chunk], n - chunk);
+
+    circ_buff_ofs_store(gcb, &gcb->wr_ofs,
+                        circ_buff_ofs_advance(gcb, wr, n));
+
+    return n;
+}
+
+static size_t circ_buff_read_exec(circ_buff_t *gcb, uint8_t *p_data, size_t n)
+{
+    size_t wr = circ_buff_ofs_load(gcb, &gcb->wr_ofs);
+    size_t rd = gcb->rd_ofs;
+    size_t used = circ_buff_used_calc(gcb, rd, wr);
+
+    if (n > used)
+    {
+        n = used;
+    }
+
+    size_t chunk = gcb->mem_sz - rd;
+    if (chunk > n)
+    {
+        chunk = n;
+    }
+
+    memcpy(p_data, &gcb->mem[rd], chunk);
+    memcpy(&p_data[chunk], &gcb->mem[0], n - chunk);
+
+    circ_buff_ofs_store(gcb, &gcb->rd_ofs,
+                        circ_buff_ofs_advance(gcb, rd, n));
+
+    return n;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
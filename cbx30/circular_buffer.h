@@ -19,6 +19,7 @@ typedef struct _circ_buff_t {
     size_t mem_sz;          /**< memory block size */
     size_t rd_ofs;          /**< read offset */
     size_t wr_ofs;          /**< write offset */
+    bool spsc;              /**< single producer/single consumer, lock-free */
 
     // locking and signaling
     void *lock;             /**< a private value for the locking functions */
@@ -30,6 +31,14 @@ typedef struct _circ_buff_t {
 } circ_buff_t;
 
 void circ_buff_init(circ_buff_t *gcb, void *mem, size_t mem_sz);
+
+/**
+ * @brief Init buffer in single producer/single consumer mode. Offsets are
+ *      published with acquire/release ordering and the locking callbacks are
+ *      never called, so exactly one context may write and exactly one context
+ *      may read (e.g. ISR -> task).
+ */
+void circ_buff_spsc_init(circ_buff_t *gcb, void *mem, size_t mem_sz);
 void circ_buff_locking_init(circ_buff_t *gcb,
                             circ_buff_lock_cb_t global_lock,
                             circ_buff_lock_cb_t global_unlock,
@@ -44,4 +53,45 @@ int circ_buff_pop(circ_buff_t *gcb, int timeout);
 size_t circ_buff_get_used_size(circ_buff_t *gcb);
 size_t circ_buff_get_free_size(circ_buff_t *gcb);
 
+/**
+ * @brief Write up to n bytes without blocking. Lock is taken once per call.
+ * @return Number of bytes actually written.
+ */
+size_t circ_buff_write(circ_buff_t *gcb, const uint8_t *p_data, size_t n);
+
+/**
+ * @brief Read up to n bytes without blocking. Lock is taken once per call.
+ * @return Number of bytes actually read.
+ */
+size_t circ_buff_read(circ_buff_t *gcb, uint8_t *p_data, size_t n);
+
+/**
+ * @brief Get the longest readable region that is contiguous in memory.
+ *      Data stays in the buffer until released with circ_buff_consume().
+ * @param pp_data set to the start of the region, NULL when buffer is empty
+ * @param p_len set to the region length (may be less than used size on wrap)
+ */
+void circ_buff_peek_contiguous(circ_buff_t *gcb, uint8_t **pp_data,
+                               size_t *p_len);
+
+/**
+ * @brief Release n bytes previously obtained by circ_buff_peek_contiguous().
+ * @return false if n exceeds the number of used bytes, nothing is consumed.
+ */
+bool circ_buff_consume(circ_buff_t *gcb, size_t n);
+
+/**
+ * @brief Get the longest writable region that is contiguous in memory.
+ *      Data becomes visible to the consumer only after circ_buff_commit().
+ * @param pp_data set to the start of the region, NULL when buffer is full
+ * @param p_len set to the region length (may be less than free size on wrap)
+ */
+void circ_buff_reserve(circ_buff_t *gcb, uint8_t **pp_data, size_t *p_len);
+
+/**
+ * @brief Publish n bytes written into a region from circ_buff_reserve().
+ * @return false if n exceeds the free space, nothing is committed.
+ */
+bool circ_buff_commit(circ_buff_t *gcb, size_t n);
+
 #endif
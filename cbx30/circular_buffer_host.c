@@ -0,0 +1,459 @@
+/** @file circular_buffer_host.c
+*
+* @brief Host harness of circ_buff_t. Built with CIRC_BUFF_BENCH it streams
+*        bytes from a producer thread to a consumer thread and checks the
+*        byte sequence. The baseline is the per-byte path, circ_buff_push
+*        and circ_buff_pop with the mutex taken for every byte, and is run
+*        on a sixteenth of the data. It is followed by bulk calls with the
+*        mutex and bulk calls in SPSC mode. Prints throughput of each run
+*        and the speed-up over the baseline:
+*
+*        gcc -O2 -DCIRC_BUFF_BENCH -I. circular_buffer.c \
+*            circular_buffer_host.c -lpthread -o cb_bench
+*        ./cb_bench [megabytes] [chunk bytes] [buffer bytes]
+*
+*        Built with CIRC_BUFF_TEST it checks the zero-copy calls at the
+*        edges of the ring in both modes: reserve with read offset at 0,
+*        full ring, spans split by the end of memory and overlong
+*        consume/commit. Exits nonzero if any check fails:
+*
+*        gcc -DCIRC_BUFF_TEST -I. circular_buffer.c circular_buffer_host.c \
+*            -o cb_test && ./cb_test
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <circular_buffer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define BENCH_MEGABYTES             (256u)
+#define BENCH_CHUNK                 (64u)
+#define BENCH_BUFFER                (1024u)
+#define BENCH_CHUNK_MAX             (4096u)
+#define BENCH_BYTEWISE_SHIFT        (4u)
+#define TEST_SIZE                   (8u)
+
+#define TEST_CHECK(cond)            do { if (!(cond)) { \
+                                        test_fail(__LINE__, #cond); \
+                                        return false; } } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    circ_buff_t cb;
+    size_t total;
+    size_t chunk;
+    size_t errors;
+    bool is_bytewise;
+} bench_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+#ifdef CIRC_BUFF_BENCH
+static void bench_lock(circ_buff_t *gcb, void *lock);
+static void bench_unlock(circ_buff_t *gcb, void *lock);
+static void *bench_producer(void *p_arg);
+static void *bench_consumer(void *p_arg);
+static size_t bench_write(bench_t *p_bench, const uint8_t *p_data, size_t n);
+static size_t bench_read(bench_t *p_bench, uint8_t *p_data, size_t n);
+static double bench_run(bench_t *p_bench, const char *p_name);
+static double bench_now(void);
+#endif
+
+#ifdef CIRC_BUFF_TEST
+static bool test_reserve_rd0(circ_buff_t *p_cb);
+static bool test_full(circ_buff_t *p_cb);
+static bool test_split(circ_buff_t *p_cb);
+static bool test_overrun(circ_buff_t *p_cb);
+static void test_fill(circ_buff_t *p_cb, size_t n, uint8_t first);
+static void test_fail(int line, const char *p_cond);
+#endif
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef CIRC_BUFF_BENCH
+int main(int argc, char **argv)
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    size_t megabytes = (1 < argc) ? strtoul(argv[1], NULL, 0) :
+                                    BENCH_MEGABYTES;
+    size_t chunk = (2 < argc) ? strtoul(argv[2], NULL, 0) : BENCH_CHUNK;
+    size_t size = (3 < argc) ? strtoul(argv[3], NULL, 0) : BENCH_BUFFER;
+    uint8_t *p_mem = malloc(size);
+    bench_t bench;
+    double bytewise;
+    double locked;
+    double spsc;
+
+    if ((NULL == p_mem) || (0u == chunk) || (BENCH_CHUNK_MAX < chunk) ||
+        (2u > size))
+    {
+        fprintf(stderr, "usage: %s [megabytes] [chunk 1..%u] [buffer]\n",
+                argv[0], BENCH_CHUNK_MAX);
+        return 1;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.total = (megabytes << 20) >> BENCH_BYTEWISE_SHIFT;
+    bench.chunk = chunk;
+    bench.is_bytewise = true;
+
+    circ_buff_init(&bench.cb, p_mem, size);
+    circ_buff_locking_init(&bench.cb, bench_lock, bench_unlock, &mutex);
+    bytewise = bench_run(&bench, "bytewise");
+
+    bench.total = megabytes << 20;
+    bench.is_bytewise = false;
+
+    circ_buff_init(&bench.cb, p_mem, size);
+    circ_buff_locking_init(&bench.cb, bench_lock, bench_unlock, &mutex);
+    locked = bench_run(&bench, "locked");
+
+    circ_buff_spsc_init(&bench.cb, p_mem, size);
+    spsc = bench_run(&bench, "spsc");
+
+    printf("locked/bytewise %.2f, spsc/bytewise %.2f, spsc/locked %.2f\n",
+           locked / bytewise, spsc / bytewise, spsc / locked);
+
+    free(p_mem);
+
+    return (0u != bench.errors);
+}
+#endif
+
+#ifdef CIRC_BUFF_TEST
+int main(void)
+{
+    static bool (*const test[])(circ_buff_t *) = {
+        test_reserve_rd0, test_full, test_split, test_overrun
+    };
+    uint8_t mem[TEST_SIZE];
+    circ_buff_t cb;
+    int failed = 0;
+
+    for (int spsc = 0; spsc < 2; spsc++)
+    {
+        for (size_t index = 0u; index < (sizeof(test) / sizeof(test[0]));
+             index++)
+        {
+            if (spsc)
+            {
+                circ_buff_spsc_init(&cb, mem, sizeof(mem));
+            }
+            else
+            {
+                circ_buff_init(&cb, mem, sizeof(mem));
+            }
+
+            if (!test[index](&cb))
+            {
+                fprintf(stderr, "  test %zu, %s mode\n", index,
+                        spsc ? "spsc" : "locked");
+                failed++;
+            }
+        }
+    }
+
+    printf("%s\n", (0 == failed) ? "ok" : "failed");
+
+    return (0 != failed);
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+#ifdef CIRC_BUFF_BENCH
+static void bench_lock(circ_buff_t *gcb, void *lock)
+{
+    (void)gcb;
+    pthread_mutex_lock((pthread_mutex_t *)lock);
+}
+
+static void bench_unlock(circ_buff_t *gcb, void *lock)
+{
+    (void)gcb;
+    pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+static void *bench_producer(void *p_arg)
+{
+    bench_t *p_bench = (bench_t *)p_arg;
+    uint8_t data[BENCH_CHUNK_MAX];
+    uint8_t seq = 0u;
+    size_t sent = 0u;
+
+    while (sent < p_bench->total)
+    {
+        size_t n = p_bench->total - sent;
+        if (n > p_bench->chunk)
+        {
+            n = p_bench->chunk;
+        }
+
+        for (size_t index = 0u; index < n; index++)
+        {
+            data[index] = (uint8_t)(seq + index);
+        }
+
+        // Partial writes keep the remainder for the next call.
+        size_t done = bench_write(p_bench, data, n);
+        if (0u == done)
+        {
+            sched_yield();
+        }
+
+        seq = (uint8_t)(seq + done);
+        sent += done;
+
+        if (done < n)
+        {
+            memmove(data, &data[done], n - done);
+        }
+    }
+
+    return NULL;
+}
+
+static void *bench_consumer(void *p_arg)
+{
+    bench_t *p_bench = (bench_t *)p_arg;
+    uint8_t data[BENCH_CHUNK_MAX];
+    uint8_t seq = 0u;
+    size_t received = 0u;
+
+    while (received < p_bench->total)
+    {
+        size_t done = bench_read(p_bench, data, p_bench->chunk);
+        if (0u == done)
+        {
+            sched_yield();
+        }
+
+        for (size_t index = 0u; index < done; index++)
+        {
+            if (data[index] != seq++)
+            {
+                p_bench->errors++;
+            }
+        }
+
+        received += done;
+    }
+
+    return NULL;
+}
+
+static size_t bench_write(bench_t *p_bench, const uint8_t *p_data, size_t n)
+{
+    size_t done = 0u;
+
+    if (!p_bench->is_bytewise)
+    {
+        return circ_buff_write(&p_bench->cb, p_data, n);
+    }
+
+    // Baseline, one lock round trip per byte as callers did before bulk calls.
+    while ((done < n) && circ_buff_push(&p_bench->cb, p_data[done], 0))
+    {
+        done++;
+    }
+
+    return done;
+}
+
+static size_t bench_read(bench_t *p_bench, uint8_t *p_data, size_t n)
+{
+    size_t done = 0u;
+    int d;
+
+    if (!p_bench->is_bytewise)
+    {
+        return circ_buff_read(&p_bench->cb, p_data, n);
+    }
+
+    while ((done < n) && (0 <= (d = circ_buff_pop(&p_bench->cb, 0))))
+    {
+        p_data[done++] = (uint8_t)d;
+    }
+
+    return done;
+}
+
+static double bench_run(bench_t *p_bench, const char *p_name)
+{
+    pthread_t producer;
+    pthread_t consumer;
+    size_t errors = p_bench->errors;
+    double start = bench_now();
+    double elapsed;
+
+    pthread_create(&consumer, NULL, bench_consumer, p_bench);
+    pthread_create(&producer, NULL, bench_producer, p_bench);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    elapsed = bench_now() - start;
+
+    printf("%-8s %zu bytes in %.3f s, %.1f MB/s, chunk %zu, %zu errors\n",
+           p_name, p_bench->total, elapsed,
+           (double)p_bench->total / elapsed / 1e6, p_bench->chunk,
+           p_bench->errors - errors);
+
+    return (double)p_bench->total / elapsed;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+#endif
+
+#ifdef CIRC_BUFF_TEST
+static bool test_reserve_rd0(circ_buff_t *p_cb)
+{
+    uint8_t *p_data;
+    size_t len;
+
+    // Empty ring at 0: all but the last byte, which would make wr == rd.
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[0] == p_data) && ((TEST_SIZE - 1u) == len));
+
+    // Read offset still 0 with data in the ring.
+    TEST_CHECK(circ_buff_commit(p_cb, 3u));
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[3] == p_data) && ((TEST_SIZE - 4u) == len));
+
+    TEST_CHECK(circ_buff_commit(p_cb, len));
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((NULL == p_data) && (0u == len));
+    TEST_CHECK(0u == p_cb->rd_ofs);
+
+    return true;
+}
+
+static bool test_full(circ_buff_t *p_cb)
+{
+    uint8_t *p_data;
+    size_t len;
+    uint8_t data[TEST_SIZE];
+
+    // Full with offsets away from 0, free space is one byte before rd.
+    test_fill(p_cb, 5u, 0u);
+    TEST_CHECK(5u == circ_buff_read(p_cb, data, sizeof(data)));
+    test_fill(p_cb, TEST_SIZE - 1u, 0x10u);
+
+    TEST_CHECK(0u == circ_buff_get_free_size(p_cb));
+    TEST_CHECK((TEST_SIZE - 1u) == circ_buff_get_used_size(p_cb));
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((NULL == p_data) && (0u == len));
+    TEST_CHECK(!circ_buff_commit(p_cb, 1u));
+    TEST_CHECK(0u == circ_buff_write(p_cb, data, 1u));
+
+    // Whole content comes back in order across the wrap.
+    TEST_CHECK((TEST_SIZE - 1u) == circ_buff_read(p_cb, data, sizeof(data)));
+    for (size_t index = 0u; index < (TEST_SIZE - 1u); index++)
+    {
+        TEST_CHECK((0x10u + index) == data[index]);
+    }
+    TEST_CHECK(0u == circ_buff_get_used_size(p_cb));
+
+    return true;
+}
+
+static bool test_split(circ_buff_t *p_cb)
+{
+    uint8_t *p_data;
+    size_t len;
+    uint8_t data[TEST_SIZE];
+
+    // rd = wr = 5, reserve stops at the end of memory, not at rd - 1.
+    test_fill(p_cb, 5u, 0u);
+    TEST_CHECK(5u == circ_buff_read(p_cb, data, sizeof(data)));
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[5] == p_data) && ((TEST_SIZE - 5u) == len));
+    memset(p_data, 0x20, len);
+    TEST_CHECK(circ_buff_commit(p_cb, len));
+    TEST_CHECK(0u == p_cb->wr_ofs);
+
+    // Second part of the span from the start of memory up to rd - 1.
+    circ_buff_reserve(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[0] == p_data) && (4u == len));
+    memset(p_data, 0x21, len);
+    TEST_CHECK(circ_buff_commit(p_cb, len));
+    TEST_CHECK((TEST_SIZE - 1u) == circ_buff_get_used_size(p_cb));
+
+    // Peek returns the two parts one after the other.
+    circ_buff_peek_contiguous(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[5] == p_data) && (3u == len));
+    TEST_CHECK((0x20u == p_data[0]) && (0x20u == p_data[2]));
+    TEST_CHECK(circ_buff_consume(p_cb, len));
+    TEST_CHECK(0u == p_cb->rd_ofs);
+
+    circ_buff_peek_contiguous(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[0] == p_data) && (4u == len));
+    TEST_CHECK((0x21u == p_data[0]) && (0x21u == p_data[3]));
+
+    // Partial consume leaves the rest of the span.
+    TEST_CHECK(circ_buff_consume(p_cb, 1u));
+    circ_buff_peek_contiguous(p_cb, &p_data, &len);
+    TEST_CHECK((&p_cb->mem[1] == p_data) && (3u == len));
+    TEST_CHECK(circ_buff_consume(p_cb, len));
+
+    circ_buff_peek_contiguous(p_cb, &p_data, &len);
+    TEST_CHECK((NULL == p_data) && (0u == len));
+
+    return true;
+}
+
+static bool test_overrun(circ_buff_t *p_cb)
+{
+    uint8_t *p_data;
+    size_t len;
+
+    test_fill(p_cb, 3u, 0u);
+
+    // Nothing moves when more is released than available.
+    TEST_CHECK(!circ_buff_consume(p_cb, 4u));
+    TEST_CHECK(3u == circ_buff_get_used_size(p_cb));
+    TEST_CHECK(!circ_buff_commit(p_cb, TEST_SIZE - 3u));
+    TEST_CHECK(3u == p_cb->wr_ofs);
+
+    TEST_CHECK(circ_buff_consume(p_cb, 3u));
+    TEST_CHECK(circ_buff_consume(p_cb, 0u));
+    circ_buff_peek_contiguous(p_cb, &p_data, &len);
+    TEST_CHECK((NULL == p_data) && (0u == len));
+
+    return true;
+}
+
+static void test_fill(circ_buff_t *p_cb, size_t n, uint8_t first)
+{
+    for (size_t index = 0u; index < n; index++)
+    {
+        uint8_t d = (uint8_t)(first + index);
+        circ_buff_write(p_cb, &d, 1u);
+    }
+}
+
+static void test_fail(int line, const char *p_cond)
+{
+    fprintf(stderr, "line %d: %s\n", line, p_cond);
+}
+#endif
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
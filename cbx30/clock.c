@@ -0,0 +1,375 @@
+/** @file clock.c
+*
+* @brief System clock governor. Clients vote for a clock level, the highest
+*        vote is applied once no transfer is running. Peripherals clocked
+*        from HCLK (UART baud, I2C timing, timer prescalers, SysTick) are
+*        re-derived on every change. APB prescalers stay at 1.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/clock.h>
+#include <inc/bsp/i2c.h>
+#include <inc/bsp/lowpower.h>
+#include <inc/bsp/timestamp.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <stm32l4xx_hal.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+// Transfers a clock change would corrupt, tracked through STOP2 vetoes.
+#define CLOCK_BUSY_MASK             ((1u << BSP_LOWPOWER_I2C1) | \
+                                     (1u << BSP_LOWPOWER_I2C2) | \
+                                     (1u << BSP_LOWPOWER_I2C3) | \
+                                     (1u << BSP_LOWPOWER_IMU_SPI) | \
+                                     (1u << BSP_LOWPOWER_BLE_TX) | \
+                                     (1u << BSP_LOWPOWER_WIFI_TX))
+
+// Ticks a vote waits for transfers to end, change is retried on next vote.
+#define CLOCK_BUSY_RETRIES          (10u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint32_t hpre;                                  // AHB prescaler.
+    uint32_t latency;                               // Flash wait states, range 1.
+    bool pll;                                       // SYSCLK from PLL, else MSI 48 MHz.
+} clock_cfg_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Highest level voted for.
+ */
+static bsp_clock_level_t clock_target(void);
+
+/**
+ * @brief Change level unless a transfer is running.
+ * @param level new level.
+ * @return false if busy.
+ */
+static bool clock_switch(bsp_clock_level_t level);
+
+/**
+ * @brief Program RCC and flash for level.
+ */
+static void clock_apply(bsp_clock_level_t level);
+
+/**
+ * @brief Check if any UART is sending or receiving.
+ */
+static bool clock_uart_busy(void);
+
+/**
+ * @brief Keep baud rate of enabled UARTs.
+ */
+static void clock_uart_update(uint32_t old_hz, uint32_t new_hz);
+
+/**
+ * @brief Keep counting rate of running timers.
+ */
+static void clock_tim_update(uint32_t old_hz, uint32_t new_hz);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static const clock_cfg_t clock_cfg[BSP_CLOCK_LEVEL_CNT] = {
+    [BSP_CLOCK_LOW]   = { RCC_SYSCLK_DIV2, FLASH_LATENCY_1, false },
+    [BSP_CLOCK_48MHZ] = { RCC_SYSCLK_DIV1, FLASH_LATENCY_2, false },
+    [BSP_CLOCK_80MHZ] = { RCC_SYSCLK_DIV1, FLASH_LATENCY_4, true },
+};
+
+static USART_TypeDef * const clock_uarts[] = {
+    USART1,                                         // BLE
+    USART3,                                         // WiFi
+    UART4,                                          // GPS
+};
+
+static TIM_TypeDef * const clock_tims[] = {
+    TIM3,                                           // User timer
+    TIM4,                                           // Buzzer
+    TIM6,                                           // ADC trigger
+};
+
+static SemaphoreHandle_t clock_mutex;
+static bsp_clock_level_t clock_votes[BSP_CLOCK_CLIENT_CNT];
+static volatile bsp_clock_level_t clock_level;
+static uint64_t clock_since_us;
+static bsp_clock_stats_t clock_stats;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void bsp_clock_init(void)
+{
+    memset(clock_votes, 0, sizeof(clock_votes));
+    memset(&clock_stats, 0, sizeof(clock_stats));
+
+    clock_mutex = xSemaphoreCreateMutex();
+
+    // Boot clock from bsp_system_clock_config.
+    clock_level = BSP_CLOCK_48MHZ;
+    clock_since_us = bsp_timestamp_now();
+
+    (void)clock_switch(clock_target());
+}
+
+bool bsp_clock_vote(bsp_clock_client_t client, bsp_clock_level_t level)
+{
+    bool rtos = (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState());
+    bool is_ok;
+
+    if ((BSP_CLOCK_CLIENT_CNT <= client) || (BSP_CLOCK_LEVEL_CNT <= level))
+    {
+        return false;
+    }
+
+    if (rtos)
+    {
+        xSemaphoreTake(clock_mutex, portMAX_DELAY);
+    }
+
+    clock_votes[client] = level;
+
+    for (uint32_t retry = 0u; !clock_switch(clock_target()); retry++)
+    {
+        if ((!rtos) || (CLOCK_BUSY_RETRIES <= retry))
+        {
+            clock_stats.deferred++;
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    is_ok = (clock_level >= level);
+
+    if (rtos)
+    {
+        xSemaphoreGive(clock_mutex);
+    }
+
+    return is_ok;
+}
+
+bsp_clock_level_t bsp_clock_level_get(void)
+{
+    return clock_level;
+}
+
+void bsp_clock_stats_get(bsp_clock_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        *p_stats = clock_stats;
+        p_stats->time_us[clock_level] += bsp_timestamp_now() - clock_since_us;
+        p_stats->level = clock_level;
+
+        __set_PRIMASK(primask);
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static bsp_clock_level_t clock_target(void)
+{
+    bsp_clock_level_t level = BSP_CLOCK_LOW;
+
+    for (uint32_t client = 0u; client < BSP_CLOCK_CLIENT_CNT; client++)
+    {
+        if (level < clock_votes[client])
+        {
+            level = clock_votes[client];
+        }
+    }
+
+    return level;
+}
+
+static bool clock_switch(bsp_clock_level_t level)
+{
+    if (level == clock_level)
+    {
+        return true;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Transfers start from tasks and ISRs, none can start until restored.
+    if ((0u != (bsp_lowpower_veto_get() & CLOCK_BUSY_MASK)) ||
+        clock_uart_busy())
+    {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    uint64_t start_us = bsp_timestamp_now();
+    uint32_t old_hz = SystemCoreClock;
+
+    clock_apply(level);
+    SystemCoreClockUpdate();
+
+    SysTick->LOAD = (SystemCoreClock / configTICK_RATE_HZ) - 1u;
+    SysTick->VAL = 0u;
+
+    bsp_timestamp_clock_update();
+    clock_uart_update(old_hz, SystemCoreClock);
+    clock_tim_update(old_hz, SystemCoreClock);
+    bsp_i2c_clock_update(old_hz, SystemCoreClock);
+
+    uint32_t switch_us = (uint32_t)(bsp_timestamp_now() - start_us);
+
+    clock_stats.time_us[clock_level] += start_us - clock_since_us;
+    clock_stats.switches++;
+    if (clock_stats.switch_us_max < switch_us)
+    {
+        clock_stats.switch_us_max = switch_us;
+    }
+    clock_since_us = start_us;
+    clock_level = level;
+
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+static void clock_apply(bsp_clock_level_t level)
+{
+    const clock_cfg_t *p_cfg = &clock_cfg[level];
+
+    // Wait states go up before the clock does.
+    if (p_cfg->latency > __HAL_FLASH_GET_LATENCY())
+    {
+        __HAL_FLASH_SET_LATENCY(p_cfg->latency);
+        while (p_cfg->latency != __HAL_FLASH_GET_LATENCY())
+        {
+        }
+    }
+
+    if ((!p_cfg->pll) &&
+        (RCC_SYSCLKSOURCE_STATUS_PLLCLK == __HAL_RCC_GET_SYSCLK_SOURCE()))
+    {
+        __HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_MSI);
+        while (RCC_SYSCLKSOURCE_STATUS_MSI != __HAL_RCC_GET_SYSCLK_SOURCE())
+        {
+        }
+    }
+
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_HPRE, p_cfg->hpre);
+
+    if (p_cfg->pll)
+    {
+        // 48 MHz MSI / 3 * 10 / 2 = 80 MHz.
+        __HAL_RCC_PLL_CONFIG(RCC_PLLSOURCE_MSI, 3u, 10u, RCC_PLLP_DIV7,
+                             RCC_PLLQ_DIV2, RCC_PLLR_DIV2);
+        __HAL_RCC_PLLCLKOUT_ENABLE(RCC_PLL_SYSCLK);
+        __HAL_RCC_PLL_ENABLE();
+        while (0u == (RCC->CR & RCC_CR_PLLRDY))
+        {
+        }
+
+        __HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_PLLCLK);
+        while (RCC_SYSCLKSOURCE_STATUS_PLLCLK != __HAL_RCC_GET_SYSCLK_SOURCE())
+        {
+        }
+    }
+    else
+    {
+        __HAL_RCC_PLL_DISABLE();
+    }
+
+    if (p_cfg->latency < __HAL_FLASH_GET_LATENCY())
+    {
+        __HAL_FLASH_SET_LATENCY(p_cfg->latency);
+    }
+}
+
+static bool clock_uart_busy(void)
+{
+    for (uint32_t index = 0u;
+         index < (sizeof(clock_uarts) / sizeof(clock_uarts[0]));
+         index++)
+    {
+        USART_TypeDef *p_uart = clock_uarts[index];
+        uint32_t cr1 = p_uart->CR1;
+        uint32_t isr = p_uart->ISR;
+
+        if (0u == (cr1 & USART_CR1_UE))
+        {
+            continue;
+        }
+
+        if ((0u != (cr1 & USART_CR1_TE)) && (0u == (isr & USART_ISR_TC)))
+        {
+            return true;
+        }
+
+        // Clearing UE drops a character being received into the RX DMA and
+        // resets an IDLE flag its handler has not seen yet.
+        if ((0u != (cr1 & USART_CR1_RE)) &&
+            ((0u != (isr & USART_ISR_BUSY)) ||
+             ((0u != (cr1 & USART_CR1_IDLEIE)) &&
+              (0u != (isr & USART_ISR_IDLE)))))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void clock_uart_update(uint32_t old_hz, uint32_t new_hz)
+{
+    for (uint32_t index = 0u;
+         index < (sizeof(clock_uarts) / sizeof(clock_uarts[0]));
+         index++)
+    {
+        USART_TypeDef *p_uart = clock_uarts[index];
+        uint32_t cr1 = p_uart->CR1;
+        uint32_t brr = p_uart->BRR;
+        uint32_t div;
+
+        if (0u == (cr1 & USART_CR1_UE))
+        {
+            continue;
+        }
+
+        // With 8x oversampling lowest BRR bits hold USARTDIV[3:0] >> 1.
+        div = (0u != (cr1 & USART_CR1_OVER8)) ?
+              ((brr & ~0xFu) | ((brr & 0x7u) << 1)) : brr;
+        div = (uint32_t)((((uint64_t)div * new_hz) + (old_hz / 2u)) / old_hz);
+        brr = (0u != (cr1 & USART_CR1_OVER8)) ?
+              ((div & ~0xFu) | ((div & 0xFu) >> 1)) : div;
+
+        // BRR is written only while disabled, DMA requests are kept. Line is
+        // quiet in both directions, checked by clock_uart_busy.
+        p_uart->CR1 = cr1 & ~USART_CR1_UE;
+        p_uart->BRR = brr;
+        p_uart->CR1 = cr1;
+    }
+}
+
+static void clock_tim_update(uint32_t old_hz, uint32_t new_hz)
+{
+    for (uint32_t index = 0u;
+         index < (sizeof(clock_tims) / sizeof(clock_tims[0]));
+         index++)
+    {
+        TIM_TypeDef *p_tim = clock_tims[index];
+
+        if (0u != (p_tim->CR1 & TIM_CR1_CEN))
+        {
+            // Loaded at next update, current period runs at the new clock.
+            p_tim->PSC = (uint32_t)(((((uint64_t)p_tim->PSC + 1u) * new_hz) +
+                                     (old_hz / 2u)) / old_hz) - 1u;
+        }
+    }
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
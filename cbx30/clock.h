@@ -0,0 +1,84 @@
+/** @file clock.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __BSP_CLOCK_H__
+#define __BSP_CLOCK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+/// System clock levels, ascending.
+typedef enum {
+    BSP_CLOCK_LOW = 0,                              // 24 MHz, MSI divided.
+    BSP_CLOCK_48MHZ,                                // MSI.
+    BSP_CLOCK_80MHZ,                                // PLL from MSI.
+    BSP_CLOCK_LEVEL_CNT
+} bsp_clock_level_t;
+
+/// Voters, each holds one level. Highest vote wins.
+typedef enum {
+    BSP_CLOCK_EMMC = 0,
+    BSP_CLOCK_WIFI,
+    BSP_CLOCK_BLE,
+    BSP_CLOCK_FUSION,
+    BSP_CLOCK_GPS,
+    BSP_CLOCK_APP,
+    BSP_CLOCK_CLIENT_CNT
+} bsp_clock_client_t;
+
+/// Governor statistics.
+typedef struct {
+    uint64_t time_us[BSP_CLOCK_LEVEL_CNT];          // Time spent at each level.
+    uint32_t switches;                              // Level changes.
+    uint32_t deferred;                              // Changes delayed by running transfers.
+    uint32_t switch_us_max;                         // Longest change, interrupts off.
+    bsp_clock_level_t level;                        // Current level.
+} bsp_clock_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Start governor at the level set by bsp_system_clock_config and drop
+ *      to the lowest level. Call at the end of bsp_init.
+ */
+void bsp_clock_init(void);
+
+/**
+ * @brief Set vote of a client and switch to the highest level voted for.
+ *      Task context only, waits a few ms while I2C, SPI or UART transfers
+ *      are running.
+ * @param client voter.
+ * @param level required level, BSP_CLOCK_LOW when nothing is needed.
+ * @return true if the voted level is in effect.
+ */
+bool bsp_clock_vote(bsp_clock_client_t client, bsp_clock_level_t level);
+
+/**
+ * @brief Get current system clock level.
+ */
+bsp_clock_level_t bsp_clock_level_get(void);
+
+/**
+ * @brief Get governor statistics, time of current level included.
+ * @param p_stats output.
+ */
+void bsp_clock_stats_get(bsp_clock_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BSP_CLOCK_H__
@@ -0,0 +1,43 @@
+/** @file cycles.h
+*
+* @brief CPU cycle counter for cost measurements, DWT->CYCCNT on target.
+*        Host builds define CYCLES() themselves, e.g. -D'CYCLES()=0u', and
+*        get an empty CYCLES_INIT().
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_CYCLES_H
+#define CROSSBOX_CYCLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+//------------------------------ INCLUDES -------------------------------------
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+#ifndef CYCLES
+#include <stm32l4xx_hal.h>
+#define CYCLES()                    (DWT->CYCCNT)
+#define CYCLES_INIT()                                           \
+    do {                                                        \
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;         \
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                    \
+    } while (0)
+#endif
+#ifndef CYCLES_INIT
+#define CYCLES_INIT()               do { } while (0)
+#endif
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_CYCLES_H
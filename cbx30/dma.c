@@ -8,105 +8,920 @@
 */
 
 //------------------------------ INCLUDES -------------------------------------
-#include <bluart.h>
-#include <bluart-stm32-hal.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
 #include <RTT.h>
 #include <stm32l4xx_ll_dma.h>
 #include <stm32l4xx_ll_bus.h>
+#include <stm32l4xx_ll_usart.h>
+#include <inc/bsp/dma.h>
+#include <inc/bsp/wifi.h>
+#include <inc/bsp/gps.h>
+#include <inc/bsp/ble.h>
+#include <inc/bsp/lowpower.h>
+#include <inc/bsp/timestamp.h>
+#include <string.h>
 //-------------------------------- MACROS -------------------------------------
 
-#define     DMA_BUFFER_SIZE          (512u)
+#define     DMA_WIFI_BUFFER_SIZE     (512u)
+#define     DMA_GPS_BUFFER_SIZE      (512u)
+#define     DMA_BLE_BUFFER_SIZE      (1024u)
+#define     DMA_IRQ_PRIO             (5u)
 #define     ARRAY_LEN(x)             (sizeof(x) / sizeof((x)[0]))
 
+// Maximum length of single DMA transfer, CNDTR is 16 bit.
+#define     DMA_TX_CHUNK_MAX         (0xFFFFu)
+
+// LL channel values are 0 based, every channel owns 4 bits in ISR/IFCR.
+#define     DMA_FLAG_SHIFT(ch)       ((ch) * 4u)
+
 //----------------------------- DATA TYPES ------------------------------------
 
+/// Static description of one circular DMA receive link.
+typedef struct {
+    DMA_TypeDef *dma;                   // DMA controller
+    uint32_t channel;                   // LL_DMA_CHANNEL_x
+    uint32_t request;                   // LL_DMA_REQUEST_x
+    IRQn_Type irq;                      // DMA channel interrupt
+    USART_TypeDef *usart;               // source USART, IDLE line detection
+    volatile uint8_t *p_buf;            // circular buffer
+    size_t buf_len;                     // circular buffer length
+    bsp_dma_rx_consumer_t consumer;     // default consumer
+} dma_rx_desc_t;
+
+/// Runtime state of one circular DMA receive link.
+typedef struct {
+    bsp_dma_rx_consumer_t consumer;     // active consumer
+    size_t dma_pos;                     // DMA position seen on last process
+    size_t rd_pos;                      // first byte not accepted yet
+    size_t pending;                     // received bytes not accepted yet
+    volatile size_t rel_pos;            // oldest accepted unreleased byte
+    volatile size_t held;               // accepted bytes not released yet
+    volatile bool stale;                // unreleased data was overwritten
+    volatile uint32_t overrun_cnt;      // overruns of unreleased data
+    uint64_t rx_us;                     // time of last IDLE, HT or TC event
+    size_t rx_pos;                      // DMA position at rx_us
+} dma_rx_state_t;
+
+/// Static description of one DMA transmit link.
+typedef struct {
+    DMA_TypeDef *dma;                   // DMA controller
+    uint32_t channel;                   // LL_DMA_CHANNEL_x
+    uint32_t request;                   // LL_DMA_REQUEST_x
+    IRQn_Type irq;                      // DMA channel interrupt
+    USART_TypeDef *usart;               // destination USART
+} dma_tx_desc_t;
+
+/// Queued transmit buffer.
+typedef struct {
+    const uint8_t *p_data;
+    size_t len;
+    bsp_dma_tx_cb_t cb;
+    void *p_ctx;
+    bool last;                          // last buffer of its request
+} dma_tx_entry_t;
+
+/// Runtime state of one DMA transmit link.
+typedef struct {
+    dma_tx_entry_t queue[BSP_DMA_TX_QUEUE_LEN];
+    uint32_t head;                      // entry in flight or next to send
+    uint32_t cnt;                       // queued entries including head
+    size_t sent;                        // bytes of head already sent
+    size_t chunk;                       // bytes of head in flight
+    bool busy;                          // DMA transfer running
+    bool mid_request;                   // between buffers of one request
+    bsp_dma_tx_hal_start_t hal_start;   // IT transfer waiting for the queue
+    void *p_hal_ctx;
+    bsp_dma_tx_stats_t stats;
+} dma_tx_state_t;
+
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
+/**
+ * Configures one circular DMA receive channel and starts it.
+ * @param p_desc link description
+ */
+static void dma_rx_channel_init(const dma_rx_desc_t *p_desc);
+
+/**
+ * Gets position DMA writes next in the circular buffer.
+ * @param p_desc link description
+ * @return index in the buffer
+ */
+static size_t dma_rx_pos(const dma_rx_desc_t *p_desc);
+
+/**
+ * Accounts newly received data of the link and offers it to the consumer.
+ * @param id link
+ */
+static void dma_rx_process(bsp_dma_rx_id_t id);
+
+/**
+ * Drops the oldest data if received and held bytes do not fit the buffer,
+ * which means DMA lapped them.
+ * @param id link
+ */
+static void dma_rx_lap_check(bsp_dma_rx_id_t id);
+
+/**
+ * Checks from DMA ISR if the half of the buffer DMA just started to fill
+ * holds data not yet released by the consumer.
+ * @param id link
+ * @param half_start first index of the half DMA is now writing
+ */
+static void dma_rx_overrun_check_isr(bsp_dma_rx_id_t id, size_t half_start);
+
+/**
+ * Records from USART or DMA ISR when and up to where data was received,
+ * the time consumers get with the span.
+ * @param id link
+ */
+static void dma_rx_stamp_isr(bsp_dma_rx_id_t id);
+
+/**
+ * Common DMA channel interrupt handling, HT and TC events.
+ * @param id link
+ */
+static void dma_rx_irq_handle(bsp_dma_rx_id_t id);
+
+/**
+ * Signals the processing task.
+ */
+static void dma_rx_signal(void);
+
+/**
+ * Configures one DMA transmit channel, transfers are started on demand.
+ * @param p_desc link description
+ */
+static void dma_tx_channel_init(const dma_tx_desc_t *p_desc);
+
+/**
+ * Masks interrupts, TX queues and RX time stamps are used from tasks and
+ * from several ISRs.
+ * @return previous PRIMASK value
+ */
+static uint32_t dma_lock(void);
+
+/**
+ * Restores interrupt mask saved by dma_lock().
+ * @param primask previous PRIMASK value
+ */
+static void dma_unlock(uint32_t primask);
+
+/**
+ * Starts transfer of the next chunk if link is idle and has queued data.
+ * Called with lock held or from the link DMA ISR.
+ * @param id link
+ */
+static void dma_tx_start(bsp_dma_tx_id_t id);
+
+/**
+ * Runs waiting interrupt driven transfer if the link is between two
+ * requests, otherwise continues the queue. Called with lock held or from
+ * the link DMA ISR.
+ * @param id link
+ */
+static void dma_tx_next(bsp_dma_tx_id_t id);
+
+/**
+ * Common DMA TX channel interrupt handling, TC and TE events.
+ * @param id link
+ */
+static void dma_tx_irq_handle(bsp_dma_tx_id_t id);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 
-// dma buffer
-static volatile uint8_t usart_rx_dma_buffer[DMA_BUFFER_SIZE];
+// dma buffers
+static volatile uint8_t usart_rx_dma_buffer[DMA_WIFI_BUFFER_SIZE];
+static volatile uint8_t gps_rx_dma_buffer[DMA_GPS_BUFFER_SIZE];
+static volatile uint8_t ble_rx_dma_buffer[DMA_BLE_BUFFER_SIZE];
+
+static const dma_rx_desc_t dma_rx_desc[BSP_DMA_RX_CNT] = {
+    [BSP_DMA_RX_WIFI] = {
+        .dma = DMA1,
+        .channel = LL_DMA_CHANNEL_3,
+        .request = LL_DMA_REQUEST_2,
+        .irq = DMA1_Channel3_IRQn,
+        .usart = USART3,
+        .p_buf = usart_rx_dma_buffer,
+        .buf_len = ARRAY_LEN(usart_rx_dma_buffer),
+        .consumer = bsp_wifi_dma_rx_consumer,
+    },
+    [BSP_DMA_RX_GPS] = {
+        .dma = DMA2,
+        .channel = LL_DMA_CHANNEL_5,
+        .request = LL_DMA_REQUEST_2,
+        .irq = DMA2_Channel5_IRQn,
+        .usart = UART4,
+        .p_buf = gps_rx_dma_buffer,
+        .buf_len = ARRAY_LEN(gps_rx_dma_buffer),
+        .consumer = bsp_gps_dma_rx_consumer,
+    },
+    [BSP_DMA_RX_BLE] = {
+        .dma = DMA2,
+        .channel = LL_DMA_CHANNEL_7,
+        .request = LL_DMA_REQUEST_2,
+        .irq = DMA2_Channel7_IRQn,
+        .usart = USART1,
+        .p_buf = ble_rx_dma_buffer,
+        .buf_len = ARRAY_LEN(ble_rx_dma_buffer),
+        .consumer = bsp_ble_dma_rx_consumer,
+    },
+};
+
+static dma_rx_state_t dma_rx_state[BSP_DMA_RX_CNT];
+
+static const dma_tx_desc_t dma_tx_desc[BSP_DMA_TX_CNT] = {
+    [BSP_DMA_TX_BLE] = {
+        .dma = DMA2,
+        .channel = LL_DMA_CHANNEL_6,
+        .request = LL_DMA_REQUEST_2,
+        .irq = DMA2_Channel6_IRQn,
+        .usart = USART1,
+    },
+    [BSP_DMA_TX_WIFI] = {
+        .dma = DMA1,
+        .channel = LL_DMA_CHANNEL_2,
+        .request = LL_DMA_REQUEST_2,
+        .irq = DMA1_Channel2_IRQn,
+        .usart = USART3,
+    },
+};
+
+static dma_tx_state_t dma_tx_state[BSP_DMA_TX_CNT];
 
 //------------------------------ GLOBAL DATA ----------------------------------
 
-extern bluart_t g_uart_wifi;
+// Signals DMA task for all links, name kept from the time only WiFi used DMA.
 extern SemaphoreHandle_t osid_wifi_dma_smphr;
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
 
 void bsp_dma_init(void)
 {
     LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+
+    for (int id = 0; id < BSP_DMA_RX_CNT; id++)
+    {
+        dma_rx_state[id].consumer = dma_rx_desc[id].consumer;
+        dma_rx_channel_init(&dma_rx_desc[id]);
+    }
+
+    for (int id = 0; id < BSP_DMA_TX_CNT; id++)
+    {
+        dma_tx_channel_init(&dma_tx_desc[id]);
+    }
+}
+
+void bsp_dma_process_data(void)
+{
+    for (int id = 0; id < BSP_DMA_RX_CNT; id++)
+    {
+        dma_rx_process((bsp_dma_rx_id_t)id);
+    }
+}
+
+void bsp_dma_rx_uart_enable(bsp_dma_rx_id_t id)
+{
+    if (BSP_DMA_RX_CNT > id)
+    {
+        LL_USART_EnableDMAReq_RX(dma_rx_desc[id].usart);
+        LL_USART_EnableIT_IDLE(dma_rx_desc[id].usart);
+    }
+}
+
+void bsp_dma_rx_consumer_set(bsp_dma_rx_id_t id,
+                             bsp_dma_rx_consumer_t consumer)
+{
+    if (BSP_DMA_RX_CNT > id)
+    {
+        const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+        dma_rx_state_t *p_state = &dma_rx_state[id];
+
+        NVIC_DisableIRQ(p_desc->irq);
+
+        // Whatever is still held belongs to the previous consumer, drop it.
+        p_state->rel_pos = (p_state->rel_pos + p_state->held) %
+                           p_desc->buf_len;
+        p_state->held = 0;
+        p_state->stale = false;
+        p_state->consumer = (NULL != consumer) ? consumer : p_desc->consumer;
+
+        NVIC_EnableIRQ(p_desc->irq);
+    }
+}
+
+bool bsp_dma_rx_release(bsp_dma_rx_id_t id, size_t len)
+{
+    bool is_ok = false;
 
-    /* USART3 DMA init */
-    LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_3, LL_DMA_REQUEST_2);
-    LL_DMA_SetDataTransferDirection(DMA1, LL_DMA_CHANNEL_3, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
-    LL_DMA_SetChannelPriorityLevel(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PRIORITY_LOW);
-    LL_DMA_SetMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MODE_CIRCULAR);
-    LL_DMA_SetPeriphIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PERIPH_NOINCREMENT);
-    LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT);
-    LL_DMA_SetPeriphSize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PDATAALIGN_BYTE);
-    LL_DMA_SetMemorySize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MDATAALIGN_BYTE);
+    if (BSP_DMA_RX_CNT > id)
+    {
+        const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+        dma_rx_state_t *p_state = &dma_rx_state[id];
 
-    LL_DMA_SetPeriphAddress(DMA1, LL_DMA_CHANNEL_3, (uint32_t)&USART3->RDR);
-    LL_DMA_SetMemoryAddress(DMA1, LL_DMA_CHANNEL_3, (uint32_t)usart_rx_dma_buffer);
-    LL_DMA_SetDataLength(DMA1, LL_DMA_CHANNEL_3, ARRAY_LEN(usart_rx_dma_buffer));
+        NVIC_DisableIRQ(p_desc->irq);
+
+        if (len > p_state->held)
+        {
+            len = p_state->held;
+        }
+
+        p_state->rel_pos = (p_state->rel_pos + len) % p_desc->buf_len;
+        p_state->held = p_state->held - len;
+
+        is_ok = !p_state->stale;
+        p_state->stale = false;
+
+        NVIC_EnableIRQ(p_desc->irq);
+    }
+
+    return is_ok;
+}
+
+uint32_t bsp_dma_rx_overrun_cnt_get(bsp_dma_rx_id_t id)
+{
+    return (BSP_DMA_RX_CNT > id) ? dma_rx_state[id].overrun_cnt : 0u;
+}
+
+void bsp_dma_rx_kick(void)
+{
+    dma_rx_signal();
+}
+
+void bsp_dma_rx_uart_irq_handler(UART_HandleTypeDef *huart,
+                                 bsp_dma_rx_id_t id)
+{
+    uint32_t isrflags   = READ_REG(huart->Instance->ISR);
+    uint32_t cr1its     = READ_REG(huart->Instance->CR1);
+    uint32_t cr3its     = READ_REG(huart->Instance->CR3);
+
+    // Next part is copied from HAL IRQ Handler to ensure bluart TX compatibility
+
+    /* UART in mode Transmitter ------------------------------------------------*/
+#if defined(USART_CR1_FIFOEN)
+    if(((isrflags & USART_ISR_TXE_TXFNF) != RESET)
+     && (   ((cr1its & USART_CR1_TXEIE_TXFNFIE) != RESET)
+         || ((cr3its & USART_CR3_TXFTIE) != RESET)) )
+#else
+    (void)cr3its;
+    if(((isrflags & USART_ISR_TXE) != RESET)
+       && ((cr1its & USART_CR1_TXEIE) != RESET))
+#endif
+    {
+        if (huart->TxISR != NULL) {huart->TxISR(huart);}
+        return;
+    }
+
+    /* UART in mode Transmitter (transmission end) -----------------------------*/
+    if(((isrflags & USART_ISR_TC) != RESET) && ((cr1its & USART_CR1_TCIE) != RESET))
+    {
+        /* Disable the UART Transmit Complete Interrupt */
+        CLEAR_BIT(huart->Instance->CR1, USART_CR1_TCIE);
+
+        /* Tx process is ended, restore huart->gState to Ready */
+        huart->gState = HAL_UART_STATE_READY;
+
+        /* Cleat TxISR function pointer */
+        huart->TxISR = NULL;
+
+        HAL_UART_TxCpltCallback(huart);
+
+        // DMA queue waits for interrupt driven transfers to finish.
+        for (int tx_id = 0; tx_id < BSP_DMA_TX_CNT; tx_id++)
+        {
+            if (dma_tx_desc[tx_id].usart == huart->Instance)
+            {
+                uint32_t primask = dma_lock();
+                dma_tx_next((bsp_dma_tx_id_t)tx_id);
+                dma_unlock(primask);
+            }
+        }
+        return;
+    }
+
+    // Code for catching IDLE interrupt which HAL handler is missing
+
+    if (BSP_DMA_RX_CNT > id)
+    {
+        USART_TypeDef *p_usart = dma_rx_desc[id].usart;
+
+        /* Check for IDLE line interrupt */
+        if (LL_USART_IsEnabledIT_IDLE(p_usart) &&
+            LL_USART_IsActiveFlag_IDLE(p_usart))
+        {
+            LL_USART_ClearFlag_IDLE(p_usart);   /* Clear IDLE line flag */
+
+            dma_rx_stamp_isr(id);
+            dma_rx_signal();
+        }
+    }
+}
+
+bool bsp_dma_tx_enqueue(bsp_dma_tx_id_t id, const uint8_t *p_data, size_t len,
+                        bsp_dma_tx_cb_t cb, void *p_ctx)
+{
+    bsp_dma_tx_buf_t buf = { .p_data = p_data, .len = len };
+
+    return bsp_dma_tx_enqueue_v(id, &buf, 1u, cb, p_ctx);
+}
+
+bool bsp_dma_tx_enqueue_v(bsp_dma_tx_id_t id, const bsp_dma_tx_buf_t *p_bufs,
+                          size_t cnt, bsp_dma_tx_cb_t cb, void *p_ctx)
+{
+    bool is_ok = (BSP_DMA_TX_CNT > id) && (NULL != p_bufs) && (0u < cnt);
+
+    for (size_t i = 0; (is_ok) && (i < cnt); i++)
+    {
+        is_ok = (NULL != p_bufs[i].p_data) && (0u < p_bufs[i].len);
+    }
+
+    if (is_ok)
+    {
+        dma_tx_state_t *p_state = &dma_tx_state[id];
+        uint32_t primask = dma_lock();
+
+        if ((BSP_DMA_TX_QUEUE_LEN - p_state->cnt) < cnt)
+        {
+            p_state->stats.full_cnt++;
+            is_ok = false;
+        }
+        else
+        {
+            for (size_t i = 0; i < cnt; i++)
+            {
+                dma_tx_entry_t *p_entry = &p_state->queue[
+                    (p_state->head + p_state->cnt) % BSP_DMA_TX_QUEUE_LEN];
+
+                p_entry->p_data = p_bufs[i].p_data;
+                p_entry->len = p_bufs[i].len;
+                // Only the last buffer of the request reports completion.
+                p_entry->last = ((cnt - 1u) == i);
+                p_entry->cb = p_entry->last ? cb : NULL;
+                p_entry->p_ctx = p_ctx;
+                p_state->cnt++;
+            }
+
+            p_state->stats.enq_cnt += cnt;
+            p_state->stats.depth = p_state->cnt;
+            if (p_state->stats.high_water < p_state->cnt)
+            {
+                p_state->stats.high_water = p_state->cnt;
+            }
+
+            dma_tx_start(id);
+        }
+
+        dma_unlock(primask);
+    }
+
+    return is_ok;
+}
+
+bool bsp_dma_tx_hal_start(bsp_dma_tx_id_t id, bsp_dma_tx_hal_start_t start,
+                          void *p_ctx)
+{
+    bool is_ok = (BSP_DMA_TX_CNT > id) && (NULL != start);
+
+    if (is_ok)
+    {
+        dma_tx_state_t *p_state = &dma_tx_state[id];
+        uint32_t primask = dma_lock();
+
+        // Started under the lock, so no DMA request can slip in before
+        // TXE/TC interrupt enables mark the UART busy.
+        if ((!p_state->busy) && (0u == p_state->cnt))
+        {
+            is_ok = start(p_ctx);
+        }
+        else
+        {
+            p_state->hal_start = start;
+            p_state->p_hal_ctx = p_ctx;
+        }
+
+        dma_unlock(primask);
+    }
+
+    return is_ok;
+}
+
+void bsp_dma_tx_stats_get(bsp_dma_tx_id_t id, bsp_dma_tx_stats_t *p_stats,
+                          bool reset)
+{
+    if ((BSP_DMA_TX_CNT > id) && (NULL != p_stats))
+    {
+        dma_tx_state_t *p_state = &dma_tx_state[id];
+        uint32_t primask = dma_lock();
+
+        *p_stats = p_state->stats;
+
+        if (reset)
+        {
+            memset(&p_state->stats, 0, sizeof(p_state->stats));
+            p_state->stats.depth = p_state->cnt;
+            p_state->stats.high_water = p_state->cnt;
+        }
+
+        dma_unlock(primask);
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void dma_rx_channel_init(const dma_rx_desc_t *p_desc)
+{
+    DMA_TypeDef *p_dma = p_desc->dma;
+    uint32_t ch = p_desc->channel;
+
+    LL_DMA_SetPeriphRequest(p_dma, ch, p_desc->request);
+    LL_DMA_SetDataTransferDirection(p_dma, ch, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetChannelPriorityLevel(p_dma, ch, LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetMode(p_dma, ch, LL_DMA_MODE_CIRCULAR);
+    LL_DMA_SetPeriphIncMode(p_dma, ch, LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(p_dma, ch, LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(p_dma, ch, LL_DMA_PDATAALIGN_BYTE);
+    LL_DMA_SetMemorySize(p_dma, ch, LL_DMA_MDATAALIGN_BYTE);
+
+    LL_DMA_SetPeriphAddress(p_dma, ch, (uint32_t)&p_desc->usart->RDR);
+    LL_DMA_SetMemoryAddress(p_dma, ch, (uint32_t)p_desc->p_buf);
+    LL_DMA_SetDataLength(p_dma, ch, p_desc->buf_len);
 
     /* Enable HT & TC interrupts */
-    LL_DMA_EnableIT_HT(DMA1, LL_DMA_CHANNEL_3);
-    LL_DMA_EnableIT_TC(DMA1, LL_DMA_CHANNEL_3);
+    LL_DMA_EnableIT_HT(p_dma, ch);
+    LL_DMA_EnableIT_TC(p_dma, ch);
 
     /* DMA interrupt init */
-    NVIC_SetPriority(DMA1_Channel3_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 5, 0));
-    NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+    NVIC_SetPriority(p_desc->irq,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(),
+                                         DMA_IRQ_PRIO, 0));
+    NVIC_EnableIRQ(p_desc->irq);
 
-    LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_3);
+    LL_DMA_EnableChannel(p_dma, ch);
 }
 
-void bsp_dma_process_data(void) {
-    static size_t old_pos;
+static size_t dma_rx_pos(const dma_rx_desc_t *p_desc)
+{
     size_t pos;
 
-    /* Calculate current position in buffer */
-    pos = ARRAY_LEN(usart_rx_dma_buffer) - LL_DMA_GetDataLength(DMA1, LL_DMA_CHANNEL_3);
-    if (pos != old_pos) {                       /* Check change in received data */
-        if (pos > old_pos) {                    /* Current position is over previous one */
-            /* We are in "linear" mode */
-            /* Process data directly by subtracting "pointers" */
-            bluart_rx_data(g_uart_wifi.hw, &usart_rx_dma_buffer[old_pos], pos - old_pos);
-        } else {
-            /* We are in "overflow" mode */
-            /* First process data to the end of buffer */
-            bluart_rx_data(g_uart_wifi.hw,&usart_rx_dma_buffer[old_pos], ARRAY_LEN(usart_rx_dma_buffer) - old_pos);
-            /* Check and continue with beginning of buffer */
-            if (pos > 0) {
-                bluart_rx_data(g_uart_wifi.hw,&usart_rx_dma_buffer[0], pos);
-            }
+    pos = p_desc->buf_len - LL_DMA_GetDataLength(p_desc->dma, p_desc->channel);
+    if (pos == p_desc->buf_len)
+    {
+        pos = 0;
+    }
+
+    return pos;
+}
+
+static void dma_rx_process(bsp_dma_rx_id_t id)
+{
+    const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+    dma_rx_state_t *p_state = &dma_rx_state[id];
+    uint32_t primask;
+    uint64_t rx_us;
+    size_t pos;
+
+    /* Calculate current position in buffer, with the time of its last event */
+    primask = dma_lock();
+    pos = dma_rx_pos(p_desc);
+    rx_us = p_state->rx_us;
+    if (pos != p_state->rx_pos)
+    {
+        // Bytes past the last event are still arriving, line has not been
+        // idle for a character yet, so the newest one is just in.
+        rx_us = bsp_timestamp_now();
+    }
+    dma_unlock(primask);
+
+    /* Account data received since last call, buffer may have wrapped */
+    p_state->pending += (pos + p_desc->buf_len - p_state->dma_pos) %
+                        p_desc->buf_len;
+    p_state->dma_pos = pos;
+
+    dma_rx_lap_check(id);
+
+    /* Offer data up to the end of buffer, then from its beginning */
+    while (0u < p_state->pending)
+    {
+        size_t chunk = p_desc->buf_len - p_state->rd_pos;
+        if (chunk > p_state->pending)
+        {
+            chunk = p_state->pending;
+        }
+
+        // Held is raised before the call so the consumer may release
+        // accepted bytes from within the callback.
+        NVIC_DisableIRQ(p_desc->irq);
+        p_state->held = p_state->held + chunk;
+        NVIC_EnableIRQ(p_desc->irq);
+
+        size_t accepted = p_state->consumer(id, &p_desc->p_buf[p_state->rd_pos],
+                                            chunk, rx_us);
+        if (accepted > chunk)
+        {
+            accepted = chunk;
+        }
+
+        NVIC_DisableIRQ(p_desc->irq);
+        p_state->held = p_state->held - (chunk - accepted);
+        NVIC_EnableIRQ(p_desc->irq);
+
+        p_state->rd_pos = (p_state->rd_pos + accepted) % p_desc->buf_len;
+        p_state->pending = p_state->pending - accepted;
+
+        if (accepted < chunk)
+        {
+            break;
         }
     }
-    old_pos = pos;                              /* Save current position as old */
+}
+
+static void dma_rx_lap_check(bsp_dma_rx_id_t id)
+{
+    const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+    dma_rx_state_t *p_state = &dma_rx_state[id];
+
+    NVIC_DisableIRQ(p_desc->irq);
+
+    size_t used = p_state->held + p_state->pending;
+    if (used > p_desc->buf_len)
+    {
+        size_t excess = used - p_desc->buf_len;
+
+        if (!p_state->stale)
+        {
+            p_state->overrun_cnt++;
+            p_state->stale = true;
+        }
+
+        // Oldest held bytes are gone first, then oldest pending ones.
+        size_t drop = (excess < p_state->held) ? excess : p_state->held;
+        p_state->rel_pos = (p_state->rel_pos + drop) % p_desc->buf_len;
+        p_state->held = p_state->held - drop;
+        excess = excess - drop;
 
-    /* Check and manually update if we reached end of buffer */
-    if (old_pos == ARRAY_LEN(usart_rx_dma_buffer)) {
-        old_pos = 0;
+        p_state->rd_pos = (p_state->rd_pos + excess) % p_desc->buf_len;
+        p_state->pending = p_state->pending - excess;
     }
+
+    NVIC_EnableIRQ(p_desc->irq);
 }
-//--------------------------- PRIVATE FUNCTIONS -------------------------------
 
-//--------------------------- INTERRUPT HANDLERS ------------------------------
+static void dma_rx_overrun_check_isr(bsp_dma_rx_id_t id, size_t half_start)
+{
+    const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+    dma_rx_state_t *p_state = &dma_rx_state[id];
+    const size_t half = p_desc->buf_len / 2u;
+
+    if ((0u < p_state->held) && (!p_state->stale))
+    {
+        // Distance from the half start to the first held byte, going forward.
+        size_t dist = (p_state->rel_pos + p_desc->buf_len - half_start) %
+                      p_desc->buf_len;
+
+        // Held region overlaps the half if it starts inside it or wraps into
+        // it from the other half.
+        if ((dist < half) || ((dist + p_state->held) > p_desc->buf_len))
+        {
+            p_state->overrun_cnt++;
+            p_state->stale = true;
+        }
+    }
+}
+
+static void dma_rx_stamp_isr(bsp_dma_rx_id_t id)
+{
+    dma_rx_state_t *p_state = &dma_rx_state[id];
+    // USART and DMA interrupts of a link run at different priorities.
+    uint32_t primask = dma_lock();
+
+    p_state->rx_us = bsp_timestamp_now();
+    p_state->rx_pos = dma_rx_pos(&dma_rx_desc[id]);
+
+    dma_unlock(primask);
+}
+
+static void dma_rx_irq_handle(bsp_dma_rx_id_t id)
+{
+    const dma_rx_desc_t *p_desc = &dma_rx_desc[id];
+    uint32_t shift = DMA_FLAG_SHIFT(p_desc->channel);
 
-void DMA1_Channel3_IRQHandler(void) {
     /* Check half-transfer complete interrupt */
-    if (LL_DMA_IsEnabledIT_HT(DMA1, LL_DMA_CHANNEL_3) && LL_DMA_IsActiveFlag_HT3(DMA1)) {
-        LL_DMA_ClearFlag_HT3(DMA1);             /* Clear half-transfer complete flag */
+    if (LL_DMA_IsEnabledIT_HT(p_desc->dma, p_desc->channel) &&
+        (p_desc->dma->ISR & (DMA_ISR_HTIF1 << shift)))
+    {
+        /* Clear half-transfer complete flag */
+        p_desc->dma->IFCR = (DMA_IFCR_CHTIF1 << shift);
 
-        xSemaphoreGiveFromISR(osid_wifi_dma_smphr, NULL);
+        dma_rx_overrun_check_isr(id, p_desc->buf_len / 2u);
+        dma_rx_stamp_isr(id);
+        dma_rx_signal();
     }
 
     /* Check transfer-complete interrupt */
-    if (LL_DMA_IsEnabledIT_TC(DMA1, LL_DMA_CHANNEL_3) && LL_DMA_IsActiveFlag_TC3(DMA1)) {
-        LL_DMA_ClearFlag_TC3(DMA1);             /* Clear transfer complete flag */
+    if (LL_DMA_IsEnabledIT_TC(p_desc->dma, p_desc->channel) &&
+        (p_desc->dma->ISR & (DMA_ISR_TCIF1 << shift)))
+    {
+        /* Clear transfer complete flag */
+        p_desc->dma->IFCR = (DMA_IFCR_CTCIF1 << shift);
+
+        dma_rx_overrun_check_isr(id, 0u);
+        dma_rx_stamp_isr(id);
+        dma_rx_signal();
+    }
+}
+
+static void dma_rx_signal(void)
+{
+    if (NULL != osid_wifi_dma_smphr)
+    {
+        if (0u != __get_IPSR())
+        {
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+            xSemaphoreGiveFromISR(osid_wifi_dma_smphr,
+                                  &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
+        else
+        {
+            xSemaphoreGive(osid_wifi_dma_smphr);
+        }
+    }
+}
+
+static void dma_tx_channel_init(const dma_tx_desc_t *p_desc)
+{
+    DMA_TypeDef *p_dma = p_desc->dma;
+    uint32_t ch = p_desc->channel;
+
+    LL_DMA_SetPeriphRequest(p_dma, ch, p_desc->request);
+    LL_DMA_SetDataTransferDirection(p_dma, ch, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetChannelPriorityLevel(p_dma, ch, LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetMode(p_dma, ch, LL_DMA_MODE_NORMAL);
+    LL_DMA_SetPeriphIncMode(p_dma, ch, LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(p_dma, ch, LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(p_dma, ch, LL_DMA_PDATAALIGN_BYTE);
+    LL_DMA_SetMemorySize(p_dma, ch, LL_DMA_MDATAALIGN_BYTE);
+
+    LL_DMA_SetPeriphAddress(p_dma, ch, (uint32_t)&p_desc->usart->TDR);
+
+    /* Enable TC & TE interrupts */
+    LL_DMA_EnableIT_TC(p_dma, ch);
+    LL_DMA_EnableIT_TE(p_dma, ch);
 
-        xSemaphoreGiveFromISR(osid_wifi_dma_smphr, NULL);
+    /* DMA interrupt init */
+    NVIC_SetPriority(p_desc->irq,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(),
+                                         DMA_IRQ_PRIO, 0));
+    NVIC_EnableIRQ(p_desc->irq);
+}
+
+static uint32_t dma_lock(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    return primask;
+}
+
+static void dma_unlock(uint32_t primask)
+{
+    __set_PRIMASK(primask);
+}
+
+static void dma_tx_start(bsp_dma_tx_id_t id)
+{
+    const dma_tx_desc_t *p_desc = &dma_tx_desc[id];
+    dma_tx_state_t *p_state = &dma_tx_state[id];
+
+    // Interrupt driven HAL transfer (e.g. bluart) owns TDR until it ends,
+    // UART IRQ handler restarts the queue then.
+    bool hal_tx_busy = LL_USART_IsEnabledIT_TXE(p_desc->usart) ||
+                       LL_USART_IsEnabledIT_TC(p_desc->usart);
+
+    if ((!p_state->busy) && (0u < p_state->cnt) && (!hal_tx_busy))
+    {
+        const dma_tx_entry_t *p_entry = &p_state->queue[p_state->head];
+
+        p_state->chunk = p_entry->len - p_state->sent;
+        if (p_state->chunk > DMA_TX_CHUNK_MAX)
+        {
+            p_state->chunk = DMA_TX_CHUNK_MAX;
+        }
+        p_state->busy = true;
+        bsp_lowpower_stop_veto(BSP_LOWPOWER_BLE_TX + id, true);
+
+        LL_DMA_DisableChannel(p_desc->dma, p_desc->channel);
+        LL_DMA_SetMemoryAddress(p_desc->dma, p_desc->channel,
+                                (uint32_t)&p_entry->p_data[p_state->sent]);
+        LL_DMA_SetDataLength(p_desc->dma, p_desc->channel, p_state->chunk);
+
+        // UART reconfiguration may clear the request, set it every time.
+        LL_USART_EnableDMAReq_TX(p_desc->usart);
+        LL_DMA_EnableChannel(p_desc->dma, p_desc->channel);
+    }
+}
+
+static void dma_tx_next(bsp_dma_tx_id_t id)
+{
+    dma_tx_state_t *p_state = &dma_tx_state[id];
+
+    if ((NULL != p_state->hal_start) && (!p_state->busy) &&
+        (!p_state->mid_request) && (0u == p_state->sent))
+    {
+        bsp_dma_tx_hal_start_t start = p_state->hal_start;
+
+        p_state->hal_start = NULL;
+        if (!start(p_state->p_hal_ctx))
+        {
+            dprintf("DMA TX %d deferred IT transfer failed\n", id);
+        }
     }
 
-}
\ No newline at end of file
+    // Waits while the IT transfer just started owns TDR.
+    dma_tx_start(id);
+}
+
+static void dma_tx_irq_handle(bsp_dma_tx_id_t id)
+{
+    const dma_tx_desc_t *p_desc = &dma_tx_desc[id];
+    dma_tx_state_t *p_state = &dma_tx_state[id];
+    uint32_t shift = DMA_FLAG_SHIFT(p_desc->channel);
+    uint32_t isr = p_desc->dma->ISR;
+
+    if (isr & ((DMA_ISR_TCIF1 | DMA_ISR_TEIF1) << shift))
+    {
+        dma_tx_entry_t done = { .cb = NULL };
+        bool is_err = (0u != (isr & (DMA_ISR_TEIF1 << shift)));
+
+        /* Clear all channel flags */
+        p_desc->dma->IFCR = (DMA_IFCR_CGIF1 << shift);
+        LL_DMA_DisableChannel(p_desc->dma, p_desc->channel);
+
+        uint32_t primask = dma_lock();
+
+        const dma_tx_entry_t *p_entry = &p_state->queue[p_state->head];
+
+        p_state->busy = false;
+        p_state->sent += p_state->chunk;
+        p_state->stats.bytes += p_state->chunk;
+
+        // Buffer is released even on transfer error so callers never stall.
+        if ((p_state->sent >= p_entry->len) || (is_err))
+        {
+            done = *p_entry;
+            p_state->mid_request = !p_entry->last;
+
+            p_state->head = (p_state->head + 1u) % BSP_DMA_TX_QUEUE_LEN;
+            p_state->cnt--;
+            p_state->sent = 0;
+            p_state->stats.depth = p_state->cnt;
+        }
+
+        // Start next chunk before the callback to keep the line busy.
+        dma_tx_next(id);
+        if (!p_state->busy)
+        {
+            bsp_lowpower_stop_veto(BSP_LOWPOWER_BLE_TX + id, false);
+        }
+
+        dma_unlock(primask);
+
+        if (is_err)
+        {
+            dprintf("DMA TX %d transfer error\n", id);
+        }
+
+        if (NULL != done.cb)
+        {
+            done.cb(done.p_ctx, done.p_data, done.len);
+        }
+    }
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
+
+void DMA1_Channel3_IRQHandler(void)
+{
+    dma_rx_irq_handle(BSP_DMA_RX_WIFI);
+}
+
+void DMA2_Channel5_IRQHandler(void)
+{
+    dma_rx_irq_handle(BSP_DMA_RX_GPS);
+}
+
+void DMA2_Channel7_IRQHandler(void)
+{
+    dma_rx_irq_handle(BSP_DMA_RX_BLE);
+}
+
+void DMA1_Channel2_IRQHandler(void)
+{
+    dma_tx_irq_handle(BSP_DMA_TX_WIFI);
+}
+
+void DMA2_Channel6_IRQHandler(void)
+{
+    dma_tx_irq_handle(BSP_DMA_TX_BLE);
+}
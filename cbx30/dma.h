@@ -10,18 +10,207 @@
 #ifndef CROSSBOX_BSP_DMA_H
 #define CROSSBOX_BSP_DMA_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 //------------------------------ INCLUDES -------------------------------------
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stm32l4xx_hal.h>
 
 //-------------------------- CONSTANTS & MACROS -------------------------------
 
+/*
+ * DMA channel allocation (RM0351, DMA request mapping):
+ *   DMA1 CH3 REQ2 - USART3 RX (WiFi)
+ *   DMA2 CH5 REQ2 - UART4 RX (GPS)
+ *   DMA2 CH7 REQ2 - USART1 RX (BLE)
+ *   DMA2 CH6 REQ2 - USART1 TX (BLE)
+ *   DMA1 CH2 REQ2 - USART3 TX (WiFi)
+ * Used outside this module:
+ *   DMA1 CH4/CH5 REQ3 - I2C2 TX/RX (i2c.c)
+ *   DMA1 CH6/CH7 REQ3 - I2C1 TX/RX (i2c.c)
+ *   DMA2 CH3/CH4 REQ4 - SPI1 RX/TX (imu.c FIFO burst)
+ */
+
+/// Number of buffers that can wait in one TX queue.
+#define BSP_DMA_TX_QUEUE_LEN    (16u)
+
 //----------------------------- DATA TYPES ------------------------------------
 
+/// UART links received through circular DMA.
+typedef enum {
+    BSP_DMA_RX_WIFI = 0,
+    BSP_DMA_RX_GPS,
+    BSP_DMA_RX_BLE,
+    BSP_DMA_RX_CNT
+} bsp_dma_rx_id_t;
+
+/**
+ * Consumer of received data. Called from bsp_dma_process_data() with a
+ * read-only span pointing straight into the circular DMA buffer, at most
+ * twice per call and link (before and after buffer wrap).
+ * Accepted bytes stay valid until released with bsp_dma_rx_release(), which
+ * may also be called from within the consumer. Bytes not accepted are offered
+ * again on the next call.
+ * rx_us is bsp_timestamp_now() of the newest byte offered in this call,
+ * taken in the UART IDLE or DMA HT/TC interrupt that followed it, or when
+ * the span was taken if no interrupt followed it yet.
+ * @return number of bytes accepted, from the start of the span
+ */
+typedef size_t (*bsp_dma_rx_consumer_t)(bsp_dma_rx_id_t id,
+                                        const volatile uint8_t *p_data,
+                                        size_t len, uint64_t rx_us);
+
+/// UART links transmitted through DMA queue.
+typedef enum {
+    BSP_DMA_TX_BLE = 0,
+    BSP_DMA_TX_WIFI,
+    BSP_DMA_TX_CNT
+} bsp_dma_tx_id_t;
+
+/**
+ * TX completion callback, called from DMA ISR once the buffer is no longer
+ * used by DMA and may be reused or freed.
+ */
+typedef void (*bsp_dma_tx_cb_t)(void *p_ctx, const uint8_t *p_data,
+                                size_t len);
+
+/**
+ * Starts interrupt driven transmission on the UART of a TX link, e.g. the
+ * write op of a bluart instance. Called with interrupts masked.
+ * @return true if transfer was started
+ */
+typedef bool (*bsp_dma_tx_hal_start_t)(void *p_ctx);
+
+/// One element of a scatter/gather transmit request.
+typedef struct {
+    const uint8_t *p_data;
+    size_t len;
+} bsp_dma_tx_buf_t;
+
+/// TX queue statistics.
+typedef struct {
+    uint32_t depth;         // buffers queued or in flight now
+    uint32_t high_water;    // maximum depth since last reset
+    uint32_t enq_cnt;       // accepted buffers
+    uint32_t full_cnt;      // requests refused because queue was full
+    uint32_t bytes;         // transmitted bytes
+} bsp_dma_tx_stats_t;
+
 //---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
 
+/**
+ * Configures and starts circular DMA reception for all links.
+ */
 void bsp_dma_init(void);
 
+/**
+ * Hands newly received data of all links to their consumers. Called from
+ * task context when DMA or IDLE line event is signalled.
+ */
 void bsp_dma_process_data(void);
 
+/**
+ * Enables USART DMA request and IDLE line interrupt of the link. Has to be
+ * called after every UART (re)configuration as it resets these flags.
+ * @param id link
+ */
+void bsp_dma_rx_uart_enable(bsp_dma_rx_id_t id);
+
+/**
+ * Replaces default consumer of the link, e.g. with a zero-copy parser.
+ * @param id link
+ * @param consumer span consumer, NULL to restore the default one
+ */
+void bsp_dma_rx_consumer_set(bsp_dma_rx_id_t id,
+                             bsp_dma_rx_consumer_t consumer);
+
+/**
+ * Releases the oldest len accepted bytes of the link, making room for DMA to
+ * write there again.
+ * @param id link
+ * @param len number of bytes to release
+ * @return false if DMA overran unreleased data since it was handed out,
+ *      released spans may contain corrupted data in that case
+ */
+bool bsp_dma_rx_release(bsp_dma_rx_id_t id, size_t len);
+
+/**
+ * Gets number of detected DMA overruns of unreleased data.
+ * @param id link
+ * @return overrun counter
+ */
+uint32_t bsp_dma_rx_overrun_cnt_get(bsp_dma_rx_id_t id);
+
+/**
+ * Requests processing of pending data, e.g. when consumer becomes ready to
+ * accept bytes it refused before. Safe to call from ISR.
+ */
+void bsp_dma_rx_kick(void);
+
+/**
+ * UART IRQ handler of DMA receive links. Runs HAL interrupt driven TX, so
+ * bluart and HAL transmit keep working, and signals processing on IDLE line.
+ * @param huart HAL handle of the link UART
+ * @param id link
+ */
+void bsp_dma_rx_uart_irq_handler(UART_HandleTypeDef *huart,
+                                 bsp_dma_rx_id_t id);
+
+/**
+ * Queues buffer for DMA transmission without blocking. Buffer has to stay
+ * valid until the callback is called. Safe to call from ISR.
+ * @param id link
+ * @param p_data data to send
+ * @param len data length, may exceed single DMA transfer size
+ * @param cb completion callback, may be NULL
+ * @param p_ctx callback context
+ * @return true if queued, false if queue is full or arguments are invalid
+ */
+bool bsp_dma_tx_enqueue(bsp_dma_tx_id_t id, const uint8_t *p_data, size_t len,
+                        bsp_dma_tx_cb_t cb, void *p_ctx);
+
+/**
+ * Queues several buffers to be sent back to back, all or none. Callback is
+ * called once, after the last buffer, with the last buffer as argument.
+ * @param id link
+ * @param p_bufs buffers to send
+ * @param cnt number of buffers
+ * @param cb completion callback, may be NULL
+ * @param p_ctx callback context
+ * @return true if queued, false if queue is full or arguments are invalid
+ */
+bool bsp_dma_tx_enqueue_v(bsp_dma_tx_id_t id, const bsp_dma_tx_buf_t *p_bufs,
+                          size_t cnt, bsp_dma_tx_cb_t cb, void *p_ctx);
+
+/**
+ * Starts interrupt driven transmission on the UART of a TX link without
+ * interleaving with queued buffers. Runs start right away when the queue is
+ * idle, otherwise from DMA ISR once the request in flight has ended. Queued
+ * requests then wait until the interrupt driven transfer ends. One start can
+ * wait per link, a later one replaces it. Safe to call from ISR.
+ * @param id link
+ * @param start transfer start
+ * @param p_ctx start context
+ * @return false if arguments are invalid or start ran right away and failed
+ */
+bool bsp_dma_tx_hal_start(bsp_dma_tx_id_t id, bsp_dma_tx_hal_start_t start,
+                          void *p_ctx);
+
+/**
+ * Gets TX queue statistics of the link.
+ * @param id link
+ * @param p_stats output
+ * @param reset true to restart high water mark and counters
+ */
+void bsp_dma_tx_stats_get(bsp_dma_tx_id_t id, bsp_dma_tx_stats_t *p_stats,
+                          bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif //CROSSBOX_BSP_DMA_H
@@ -13,6 +13,13 @@
 #include <blgpio.h>
 #include <tps65721.h>
 #include <inc/bsp/bsp.h>
+#include <inc/bsp/dma.h>
+#include <inc/bsp/lowpower.h>
+#include <inc/bsp/nmea.h>
+#include <inc/bsp/rtc.h>
+#include <inc/bsp/ubx.h>
+#include <stm32l4xx_hal.h>
+#include <string.h>
 
 //-------------------------------- MACROS -------------------------------------
 #define PIN_GPS_TX                  BLGPIO_STM32_GPIO_ID('A', 0u)
@@ -22,14 +29,68 @@
 #define GPS_TX_BUF_SIZE             (256u)
 #define RST_OVER_PIN                (0u)
 #define GPS_RST_DELAY_MS            (500u)
+#define GPS_DEFAULT_BAUD            (9600u)
+// Time for the receiver to switch baud after CFG-PRT went out.
+#define GPS_UBX_BAUD_SETTLE_MS      (50u)
+#define GPS_UBX_ACK_TIMEOUT_MS      (200u)
+#define GPS_UBX_TX_TIMEOUT_MS       (100u)
+#define GPS_UBX_RETRIES             (3u)
 
 //----------------------------- DATA TYPES ------------------------------------
+typedef enum {
+    GPS_UBX_ACK_PENDING = 0,
+    GPS_UBX_ACK_OK,
+    GPS_UBX_ACK_NAK,
+} gps_ubx_ack_t;
 
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
+/**
+ * Overrides default bluart start_read op, data is received by circular DMA
+ * @param hw bluart_hw_t instance
+ * @return bluart error status
+ */
+static bluart_error_t bsp_gps_start_dma_read(bluart_hw_t *hw);
+
+/**
+ * Handles UBX frames received from the module, runs in DMA RX context.
+ */
+static void gps_ubx_frame(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                          uint16_t len, void *p_ctx);
+
+/**
+ * Writes bytes to GPS UART by polling, UART4 has no free TX DMA channel.
+ * Returns once the last stop bit is out so baud may be changed after it.
+ * @return false on timeout
+ */
+static bool gps_ubx_write(const uint8_t *p_data, size_t len);
+
+/**
+ * Sends CFG frame and waits for its ACK, with retries.
+ * @return true if acknowledged
+ */
+static bool gps_ubx_send(const uint8_t *p_frame, size_t len);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 static bluart_t                     bluart_gps;
 static bluart_stm32_hal_hw_t        bluart_gps_dev;
+static bluart_hw_ops_t              bluart_gps_ops;
+static volatile bool                gps_powered;
+static nmea_parser_t                gps_nmea;
+static ubx_decoder_t                gps_ubx;
+static volatile bool                gps_ubx_mode;
+static uint16_t                     gps_rate_ms;
+// CFG message waiting for ACK, set by task, completed by frame handler.
+static volatile uint8_t             gps_ubx_ack_cls;
+static volatile uint8_t             gps_ubx_ack_id;
+static volatile gps_ubx_ack_t       gps_ubx_ack;
+// Latest NAV-PVT, written from DMA RX context only.
+static ubx_nav_pvt_t                gps_pvt[2];
+static uint64_t                     gps_pvt_rx_us[2];
+static volatile uint8_t             gps_pvt_active;
+static volatile uint32_t            gps_pvt_seq;
+// Receive time of the span being decoded, handed to frame handler.
+static uint64_t                     gps_span_rx_us;
 
 //------------------------------ GLOBAL DATA ----------------------------------
 
@@ -45,9 +106,20 @@ bluart_t * bsp_gps_uart_init(void)
     bsp_gps_rst_off();
     bsp_delay_ms(GPS_RST_DELAY_MS);
 
+    nmea_init(&gps_nmea, NULL, NULL);
+    ubx_decoder_init(&gps_ubx, gps_ubx_frame, NULL);
+
     err = bluart_stm32_hal_init(&bluart_gps_dev, PIN_GPS_TX,
                                 PIN_GPS_RX, (-1), (-1));
 
+    if(!err)
+    {
+        // overriding default start_read to do nothing
+        memcpy(&bluart_gps_ops, bluart_gps_dev.hw.ops, sizeof(bluart_hw_ops_t));
+        bluart_gps_ops.start_read = bsp_gps_start_dma_read;
+        bluart_gps_dev.hw.ops = &bluart_gps_ops;
+    }
+
     if(!err)
     {
         static uint8_t gps_buf[GPS_TX_BUF_SIZE + GPS_RX_BUF_SIZE];
@@ -57,6 +129,7 @@ bluart_t * bsp_gps_uart_init(void)
 
     if(BLUART_ERROR_OK == err)
     {
+        bsp_gps_enable_rx_flags();
         p_result = &bluart_gps;
     }
 
@@ -66,10 +139,144 @@ bluart_t * bsp_gps_uart_init(void)
 void bsp_gps_change_baud(uint32_t baud)
 {
     bluart_set_baudrate(&bluart_gps, baud);
+    bsp_gps_enable_rx_flags();
+}
+
+void bsp_gps_enable_rx_flags(void)
+{
+    bsp_dma_rx_uart_enable(BSP_DMA_RX_GPS);
+}
+
+size_t bsp_gps_dma_rx_consumer(bsp_dma_rx_id_t id,
+                               const volatile uint8_t *p_data, size_t len,
+                               uint64_t rx_us)
+{
+    // Parse in place before the span is copied and released. NMEA output is
+    // off in UBX mode, binary payload would only feed the parser garbage.
+    gps_span_rx_us = rx_us;
+    ubx_decode(&gps_ubx, p_data, len);
+    if (!gps_ubx_mode)
+    {
+        nmea_parse(&gps_nmea, p_data, len);
+    }
+    bluart_rx_data(bluart_gps.hw, (const uint8_t *)p_data, len);
+    bsp_dma_rx_release(id, len);
+
+    return len;
+}
+
+nmea_parser_t * bsp_gps_nmea_get(void)
+{
+    return &gps_nmea;
+}
+
+bool bsp_gps_ubx_start(uint32_t baud)
+{
+    uint8_t frame[UBX_CFG_PRT_FRAME_LEN];
+    size_t len;
+    bool is_ok;
+
+    // Receiver comes out of reset at default baud with NMEA output.
+    gps_ubx_mode = false;
+    bsp_gps_change_baud(GPS_DEFAULT_BAUD);
+
+    // ACK of CFG-PRT goes out at either baud, so it is not waited for. Output
+    // protocol is set to UBX only which also drops all NMEA sentences.
+    len = ubx_cfg_prt_encode(baud, frame, sizeof(frame));
+    is_ok = gps_ubx_write(frame, len);
+
+    if (is_ok)
+    {
+        bsp_delay_ms(GPS_UBX_BAUD_SETTLE_MS);
+        bsp_gps_change_baud(baud);
+
+        // First ACK at new baud confirms the switch.
+        len = ubx_cfg_msg_encode(UBX_CLASS_NAV, UBX_ID_NAV_PVT, 1u, frame,
+                                 sizeof(frame));
+        is_ok = gps_ubx_send(frame, len);
+    }
+
+    if (is_ok)
+    {
+        is_ok = bsp_gps_nav_rate_set((0u != gps_rate_ms) ? gps_rate_ms :
+                                     BSP_GPS_RATE_IDLE_MS);
+    }
+
+    if (is_ok)
+    {
+        gps_ubx_mode = true;
+    }
+    else
+    {
+        bsp_gps_change_baud(GPS_DEFAULT_BAUD);
+    }
+
+    return is_ok;
+}
+
+bool bsp_gps_ubx_is_on(void)
+{
+    return gps_ubx_mode;
+}
+
+bool bsp_gps_nav_rate_set(uint16_t meas_ms)
+{
+    uint8_t frame[UBX_CFG_RATE_FRAME_LEN];
+    size_t len = ubx_cfg_rate_encode(meas_ms, frame, sizeof(frame));
+    // Powered off module would only time out, rate is applied at next start.
+    bool is_ok = gps_powered && gps_ubx_send(frame, len);
+
+    if (is_ok)
+    {
+        gps_rate_ms = meas_ms;
+    }
+
+    return is_ok;
+}
+
+bool bsp_gps_pvt_get(ubx_nav_pvt_t *p_pvt, uint64_t *p_rx_us)
+{
+    uint32_t seq;
+    uint64_t rx_us;
+
+    // Writer is the DMA RX task through gps_ubx_frame, it may preempt the
+    // caller, retry if it ran while copying.
+    do
+    {
+        seq = gps_pvt_seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        *p_pvt = gps_pvt[gps_pvt_active];
+        rx_us = gps_pvt_rx_us[gps_pvt_active];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != gps_pvt_seq);
+
+    if (NULL != p_rx_us)
+    {
+        *p_rx_us = rx_us;
+    }
+
+    return (0u != seq);
+}
+
+void bsp_gps_ubx_stats_get(ubx_stats_t *p_stats)
+{
+    ubx_stats_get(&gps_ubx, p_stats);
+}
+
+bool bsp_gps_is_on(void)
+{
+    return gps_powered;
 }
 
 void bsp_gps_rst_on(void)
 {
+    gps_powered = false;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_GPS_RX, false);
+    // Receiver loses its configuration, rate is kept for next UBX start.
+    gps_ubx_mode = false;
+
 #if RST_OVER_PIN
     blgpio_dir(PIN_GPS_RST, (BLGPIO_DIR_OUT | BLGPIO_DIR_FAST));
     blgpio_set(PIN_GPS_RST, false);
@@ -86,8 +293,110 @@ void bsp_gps_rst_off(void)
 #else
     tps65721_ldo_on();
 #endif
+
+    gps_powered = true;
+    // Receiver streams on its own, UART4 does not receive in STOP2.
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_GPS_RX, true);
 }
 
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 
+static bluart_error_t bsp_gps_start_dma_read(bluart_hw_t *hw)
+{
+    return BLUART_ERROR_OK;
+}
+
+static void gps_ubx_frame(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                          uint16_t len, void *p_ctx)
+{
+    (void)p_ctx;
+
+    if ((UBX_CLASS_NAV == cls) && (UBX_ID_NAV_PVT == id))
+    {
+        uint8_t inactive = gps_pvt_active ^ 1u;
+
+        if (ubx_nav_pvt_decode(p_payload, len, &gps_pvt[inactive]))
+        {
+            // Stamped in the UART IDLE interrupt one character after the
+            // last byte, NAV-PVT is the only output so it ends the span.
+            gps_pvt_rx_us[inactive] = gps_span_rx_us;
+            gps_pvt_seq++;
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            gps_pvt_active = inactive;
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            gps_pvt_seq++;
+        }
+    }
+    else if ((UBX_CLASS_ACK == cls) && (2u <= len) &&
+             (gps_ubx_ack_cls == p_payload[0]) &&
+             (gps_ubx_ack_id == p_payload[1]))
+    {
+        gps_ubx_ack = (UBX_ID_ACK_ACK == id) ? GPS_UBX_ACK_OK :
+                                               GPS_UBX_ACK_NAK;
+    }
+}
+
+static bool gps_ubx_write(const uint8_t *p_data, size_t len)
+{
+    uint32_t start = bsp_rtc_tick_get();
+    size_t index = 0u;
+    bool is_ok = (0u < len);
+
+    while (is_ok && (index < len))
+    {
+        if (0u != (UART4->ISR & USART_ISR_TXE))
+        {
+            UART4->TDR = p_data[index];
+            index++;
+        }
+        else if (GPS_UBX_TX_TIMEOUT_MS < (bsp_rtc_tick_get() - start))
+        {
+            is_ok = false;
+        }
+    }
+
+    while (is_ok && (0u == (UART4->ISR & USART_ISR_TC)))
+    {
+        if (GPS_UBX_TX_TIMEOUT_MS < (bsp_rtc_tick_get() - start))
+        {
+            is_ok = false;
+        }
+    }
+
+    return is_ok;
+}
+
+static bool gps_ubx_send(const uint8_t *p_frame, size_t len)
+{
+    gps_ubx_ack_t ack = GPS_UBX_ACK_PENDING;
+
+    for (uint32_t attempt = 0u; (GPS_UBX_ACK_OK != ack) &&
+         (attempt < GPS_UBX_RETRIES); attempt++)
+    {
+        gps_ubx_ack_cls = p_frame[2];
+        gps_ubx_ack_id = p_frame[3];
+        gps_ubx_ack = GPS_UBX_ACK_PENDING;
+
+        if (gps_ubx_write(p_frame, len))
+        {
+            uint32_t start = bsp_rtc_tick_get();
+
+            while ((GPS_UBX_ACK_PENDING == gps_ubx_ack) &&
+                   (GPS_UBX_ACK_TIMEOUT_MS > (bsp_rtc_tick_get() - start)))
+            {
+                bsp_delay_ms(1u);
+            }
+        }
+
+        ack = gps_ubx_ack;
+    }
+
+    return (GPS_UBX_ACK_OK == ack);
+}
+
 //--------------------------- INTERRUPT HANDLERS ------------------------------
+
+void bsp_gps_UART4_IRQHandler(UART_HandleTypeDef *huart)
+{
+    bsp_dma_rx_uart_irq_handler(huart, BSP_DMA_RX_GPS);
+}
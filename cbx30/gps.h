@@ -16,9 +16,20 @@ extern "C" {
 
 //------------------------------ INCLUDES -------------------------------------
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <bluart.h>
+#include <inc/bsp/dma.h>
+#include <inc/bsp/nmea.h>
+#include <inc/bsp/ubx.h>
 
 //-------------------------- CONSTANTS & MACROS -------------------------------
+/// UART baud rate used in UBX mode.
+#define BSP_GPS_UBX_BAUD            (115200u)
+
+/// Navigation rates, session runs 10 Hz, idle only needs fix status.
+#define BSP_GPS_RATE_SESSION_MS     (100u)
+#define BSP_GPS_RATE_IDLE_MS        (1000u)
 
 //----------------------------- DATA TYPES ------------------------------------
 
@@ -35,6 +46,78 @@ bluart_t * bsp_gps_uart_init(void);
  */
 void bsp_gps_change_baud(uint32_t baud);
 
+/**
+ * @brief Reenables GPS UART DMA RX flags which get reset on UART
+ *      (re)configuration. Call after configuring returned bluart directly.
+ */
+void bsp_gps_enable_rx_flags(void);
+
+/**
+ * @brief Default DMA consumer of the GPS link, runs NMEA parser over the
+ *      received span and copies data into GPS bluart.
+ * @return Number of accepted bytes.
+ */
+size_t bsp_gps_dma_rx_consumer(bsp_dma_rx_id_t id,
+                               const volatile uint8_t *p_data, size_t len,
+                               uint64_t rx_us);
+
+/**
+ * @brief Custom UART4 IRQ handler for bypassing HAL RX code.
+ * @param huart GPS UART instance.
+ */
+void bsp_gps_UART4_IRQHandler(UART_HandleTypeDef *huart);
+
+/**
+ * @brief Get NMEA parser fed by bsp_gps_dma_rx_consumer. Use nmea_fix_get()
+ *      and nmea_sky_get() on it for latest position and satellites.
+ * @return GPS NMEA parser.
+ */
+nmea_parser_t * bsp_gps_nmea_get(void);
+
+/**
+ * @brief Switch module from NMEA to UBX binary: raise baud, turn NMEA output
+ *      off and enable NAV-PVT at last navigation rate (idle rate at first).
+ *      Blocks for a few hundred ms, call after bsp_gps_uart_init from task.
+ * @param baud new baud rate, e.g. BSP_GPS_UBX_BAUD.
+ * @return true if the module acknowledged at new baud, else stays in NMEA.
+ */
+bool bsp_gps_ubx_start(uint32_t baud);
+
+/**
+ * @brief Check whether module was switched to UBX mode.
+ * @return true in UBX mode.
+ */
+bool bsp_gps_ubx_is_on(void);
+
+/**
+ * @brief Set navigation rate, waits for ACK. Use BSP_GPS_RATE_SESSION_MS
+ *      when session becomes active and BSP_GPS_RATE_IDLE_MS when it stops.
+ * @param meas_ms measurement period in ms.
+ * @return true if acknowledged.
+ */
+bool bsp_gps_nav_rate_set(uint16_t meas_ms);
+
+/**
+ * @brief Copy latest NAV-PVT. Lock free, safe from any task.
+ * @param p_pvt output.
+ * @param p_rx_us output, bsp_timestamp_now of the UART IDLE interrupt
+ *      after the frame, may be NULL.
+ * @return false if no NAV-PVT was received yet.
+ */
+bool bsp_gps_pvt_get(ubx_nav_pvt_t *p_pvt, uint64_t *p_rx_us);
+
+/**
+ * @brief Get UBX decoder statistics.
+ * @param p_stats output.
+ */
+void bsp_gps_ubx_stats_get(ubx_stats_t *p_stats);
+
+/**
+ * @brief Check whether GPS module is out of reset and powered.
+ * @return true if GPS is on.
+ */
+bool bsp_gps_is_on(void);
+
 /**
  * @brief Assert reset on GPS.
  * @return void.
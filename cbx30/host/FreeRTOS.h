@@ -0,0 +1,34 @@
+/** @file FreeRTOS.h
+*
+* @brief Host stand-in for FreeRTOS, single threaded. Only what the modules
+*        built by the *_host.c harnesses use. See mcu_host.c.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_FREERTOS_H
+#define CROSSBOX_HOST_FREERTOS_H
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+#define pdFALSE                     (0)
+#define pdTRUE                      (1)
+#define pdPASS                      (pdTRUE)
+#define pdFAIL                      (pdFALSE)
+#define portMAX_DELAY               (0xFFFFFFFFu)
+#define portTICK_PERIOD_MS          (1u)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
+#define configASSERT(x)             ((void)(x))
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#endif //CROSSBOX_HOST_FREERTOS_H
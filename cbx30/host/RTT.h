@@ -0,0 +1,18 @@
+/** @file RTT.h
+*
+* @brief Host stand-in for RTT debug output, goes to stdout.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_RTT_H
+#define CROSSBOX_HOST_RTT_H
+
+#include <stdio.h>
+
+#define dprintf                     printf
+#define dprint(s)                   fputs((s), stdout)
+
+#endif //CROSSBOX_HOST_RTT_H
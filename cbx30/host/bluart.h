@@ -0,0 +1,16 @@
+/** @file bluart.h
+*
+* @brief Host stand-in for the buffered UART library, handle is opaque to
+*        modules built on host.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_BLUART_H
+#define CROSSBOX_HOST_BLUART_H
+
+typedef struct bluart bluart_t;
+
+#endif //CROSSBOX_HOST_BLUART_H
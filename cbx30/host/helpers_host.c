@@ -0,0 +1,56 @@
+/** @file helpers_host.c
+*
+* @brief Checksums of helpers.h for host tools, the application helpers.c
+*        is not part of this tree. CRC-16/CCITT-FALSE: polynomial 0x1021,
+*        initial value 0xFFFF, no reflection, as stored in session files.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <helpers.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HELPERS_CRC16_POLY          (0x1021u)
+#define HELPERS_CRC16_INIT          (0xFFFFu)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+uint16_t crc16i(uint16_t icrc, const char * p_data, uint16_t length)
+{
+    uint16_t crc = icrc;
+
+    for (uint16_t index = 0u; index < length; index++)
+    {
+        crc ^= (uint16_t)((uint16_t)(uint8_t)p_data[index] << 8);
+
+        for (uint32_t bit = 0u; bit < 8u; bit++)
+        {
+            crc = (0u != (crc & 0x8000u)) ?
+                  (uint16_t)((crc << 1) ^ HELPERS_CRC16_POLY) :
+                  (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+uint16_t crc16(const uint8_t * data, uint16_t length)
+{
+    return crc16i(HELPERS_CRC16_INIT, (const char *)data, length);
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
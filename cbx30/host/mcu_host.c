@@ -0,0 +1,277 @@
+/** @file mcu_host.c
+*
+* @brief Host stand-in for the MCU core, peripheral register blocks and
+*        FreeRTOS, linked into the *_host.c harnesses that build firmware
+*        modules with -Ihost. Single threaded: interrupts are modelled by the
+*        harness calling handlers with host_ipsr set.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stm32l4xx_hal.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <timers.h>
+#include <stdlib.h>
+
+//-------------------------------- MACROS -------------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+struct host_semaphore {
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct host_timer {
+    TickType_t period;
+    void *p_id;
+    TimerCallbackFunction_t callback;
+    bool auto_reload;
+    bool running;
+};
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static SemaphoreHandle_t host_semaphore_create(UBaseType_t count,
+                                               UBaseType_t max);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static DWT_Type host_dwt;
+static CoreDebug_Type host_core_debug;
+static TimerHandle_t host_timer_last;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+DWT_Type *DWT = &host_dwt;
+CoreDebug_Type *CoreDebug = &host_core_debug;
+uint32_t SystemCoreClock = 80000000u;
+
+I2C_TypeDef host_i2c[3];
+DMA_Channel_TypeDef host_dma1_channel[7];
+
+uint32_t host_primask;
+uint32_t host_ipsr;
+
+volatile TickType_t host_tick;
+BaseType_t host_scheduler_state = taskSCHEDULER_RUNNING;
+void (*host_rtos_wait_hook)(void);
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+uint32_t __get_PRIMASK(void)
+{
+    return host_primask;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+    host_primask = primask;
+}
+
+void __disable_irq(void)
+{
+    host_primask = 1u;
+}
+
+void __enable_irq(void)
+{
+    host_primask = 0u;
+}
+
+uint32_t __get_IPSR(void)
+{
+    return host_ipsr;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t prio, uint32_t sub_prio)
+{
+    (void)irq;
+    (void)prio;
+    (void)sub_prio;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type irq)
+{
+    (void)irq;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type irq)
+{
+    (void)irq;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return host_tick;
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return host_tick;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+    return host_scheduler_state;
+}
+
+void vTaskSuspendAll(void)
+{
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    return pdFALSE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_tick += ticks;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return host_semaphore_create(1u, 1u);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return host_semaphore_create(0u, 1u);
+}
+
+void vQueueDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    // Whatever would run while the caller blocks gets its chance first.
+    if ((0u == sem->count) && (0u != ticks) && (NULL != host_rtos_wait_hook))
+    {
+        host_rtos_wait_hook();
+    }
+
+    if (0u == sem->count)
+    {
+        host_tick += ticks;
+        return pdFALSE;
+    }
+
+    sem->count--;
+
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count >= sem->max)
+    {
+        return pdFALSE;
+    }
+
+    sem->count++;
+
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *p_woken)
+{
+    if (NULL != p_woken)
+    {
+        *p_woken = pdFALSE;
+    }
+
+    return xSemaphoreGive(sem);
+}
+
+TimerHandle_t xTimerCreate(const char *p_name, TickType_t period,
+                           UBaseType_t auto_reload, void *p_id,
+                           TimerCallbackFunction_t callback)
+{
+    TimerHandle_t timer = malloc(sizeof(*timer));
+
+    (void)p_name;
+
+    if (NULL != timer)
+    {
+        timer->period = period;
+        timer->p_id = p_id;
+        timer->callback = callback;
+        timer->auto_reload = (pdFALSE != auto_reload);
+        timer->running = false;
+        host_timer_last = timer;
+    }
+
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks)
+{
+    (void)ticks;
+    timer->running = true;
+
+    return pdPASS;
+}
+
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t *p_woken)
+{
+    if (NULL != p_woken)
+    {
+        *p_woken = pdFALSE;
+    }
+
+    return xTimerStart(timer, 0);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks)
+{
+    (void)ticks;
+    timer->running = false;
+
+    return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->p_id;
+}
+
+bool host_timer_fire(TimerHandle_t timer)
+{
+    if (NULL == timer)
+    {
+        timer = host_timer_last;
+    }
+
+    if ((NULL == timer) || (!timer->running))
+    {
+        return false;
+    }
+
+    // One-shot timer expires before its callback, which may start it again.
+    timer->running = timer->auto_reload;
+    timer->callback(timer);
+
+    return true;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static SemaphoreHandle_t host_semaphore_create(UBaseType_t count,
+                                               UBaseType_t max)
+{
+    SemaphoreHandle_t sem = malloc(sizeof(*sem));
+
+    if (NULL != sem)
+    {
+        sem->count = count;
+        sem->max = max;
+    }
+
+    return sem;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
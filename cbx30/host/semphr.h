@@ -0,0 +1,35 @@
+/** @file semphr.h
+*
+* @brief Host stand-in for FreeRTOS semaphores, counters without blocking.
+*        A take that would block runs host_rtos_wait_hook first, standing in
+*        for the ISRs that would run meanwhile, then times out by advancing
+*        the tick.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_SEMPHR_H
+#define CROSSBOX_HOST_SEMPHR_H
+
+//------------------------------ INCLUDES -------------------------------------
+#include <FreeRTOS.h>
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+/// Called when a take would block, may give the semaphore.
+extern void (*host_rtos_wait_hook)(void);
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+void vQueueDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *p_woken);
+
+#endif //CROSSBOX_HOST_SEMPHR_H
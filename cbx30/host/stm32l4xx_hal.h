@@ -0,0 +1,286 @@
+/** @file stm32l4xx_hal.h
+*
+* @brief Host stand-in for the STM32L4 HAL and CMSIS core. Registers are
+*        plain memory, bit values follow the reference manual. HAL transfer
+*        functions are only declared, each harness implements the ones its
+*        module calls to model the peripheral. See mcu_host.c for the core.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_STM32L4XX_HAL_H
+#define CROSSBOX_HOST_STM32L4XX_HAL_H
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+#define SET_BIT(reg, bit)           ((reg) |= (bit))
+#define CLEAR_BIT(reg, bit)         ((reg) &= ~(bit))
+#define READ_BIT(reg, bit)          ((reg) & (bit))
+
+// Core
+#define CoreDebug_DEMCR_TRCENA_Msk  (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1u << 0)
+
+// I2C
+#define I2C_CR1_PE                  (1u << 0)
+#define I2C_CR1_TXIE                (1u << 1)
+#define I2C_CR1_RXIE                (1u << 2)
+#define I2C_CR1_ADDRIE              (1u << 3)
+#define I2C_CR1_NACKIE              (1u << 4)
+#define I2C_CR1_STOPIE              (1u << 5)
+#define I2C_CR1_TCIE                (1u << 6)
+#define I2C_CR1_ERRIE               (1u << 7)
+#define I2C_CR1_TXDMAEN             (1u << 14)
+#define I2C_CR1_RXDMAEN             (1u << 15)
+
+#define I2C_IT_ERRI                 I2C_CR1_ERRIE
+#define I2C_IT_TCI                  I2C_CR1_TCIE
+#define I2C_IT_STOPI                I2C_CR1_STOPIE
+#define I2C_IT_NACKI                I2C_CR1_NACKIE
+#define I2C_IT_ADDRI                I2C_CR1_ADDRIE
+#define I2C_IT_RXI                  I2C_CR1_RXIE
+#define I2C_IT_TXI                  I2C_CR1_TXIE
+
+#define HAL_I2C_ERROR_NONE          (0x00u)
+#define HAL_I2C_ERROR_BERR          (0x01u)
+#define HAL_I2C_ERROR_ARLO          (0x02u)
+#define HAL_I2C_ERROR_AF            (0x04u)
+#define HAL_I2C_ERROR_OVR           (0x08u)
+#define HAL_I2C_ERROR_DMA           (0x10u)
+#define HAL_I2C_ERROR_TIMEOUT       (0x20u)
+
+#define I2C_ADDRESSINGMODE_7BIT     (0x00000001u)
+#define I2C_DUALADDRESS_DISABLE     (0x00000000u)
+#define I2C_OA2_NOMASK              (0x00u)
+#define I2C_GENERALCALL_DISABLE     (0x00000000u)
+#define I2C_NOSTRETCH_DISABLE       (0x00000000u)
+#define I2C_ANALOGFILTER_ENABLE     (0x00000000u)
+
+#define I2C_FIRST_FRAME             (0x00000000u)
+#define I2C_FIRST_AND_NEXT_FRAME    (0x00000001u)
+#define I2C_NEXT_FRAME              (0x00000002u)
+#define I2C_FIRST_AND_LAST_FRAME    (0x02000000u)
+#define I2C_LAST_FRAME              (0x02000001u)
+
+#define __HAL_I2C_ENABLE(h)         SET_BIT((h)->Instance->CR1, I2C_CR1_PE)
+#define __HAL_I2C_DISABLE(h)        CLEAR_BIT((h)->Instance->CR1, I2C_CR1_PE)
+#define __HAL_I2C_ENABLE_IT(h, it)  SET_BIT((h)->Instance->CR1, (it))
+#define __HAL_I2C_DISABLE_IT(h, it) CLEAR_BIT((h)->Instance->CR1, (it))
+
+// DMA
+#define DMA_REQUEST_3               (3u)
+#define DMA_MEMORY_TO_PERIPH        (0x00000010u)
+#define DMA_PERIPH_TO_MEMORY        (0x00000000u)
+#define DMA_PINC_DISABLE            (0x00000000u)
+#define DMA_MINC_ENABLE             (0x00000080u)
+#define DMA_PDATAALIGN_BYTE         (0x00000000u)
+#define DMA_MDATAALIGN_BYTE         (0x00000000u)
+#define DMA_NORMAL                  (0x00000000u)
+#define DMA_PRIORITY_LOW            (0x00000000u)
+
+#define __HAL_LINKDMA(h, field, dma) \
+    do { (h)->field = &(dma); (dma).Parent = (h); } while (0)
+
+// RCC
+#define __HAL_RCC_DMA1_CLK_ENABLE() do { } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef enum {
+    HAL_OK = 0x00,
+    HAL_ERROR = 0x01,
+    HAL_BUSY = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+    DMA1_Channel1_IRQn = 11,
+    DMA1_Channel2_IRQn = 12,
+    DMA1_Channel3_IRQn = 13,
+    DMA1_Channel4_IRQn = 14,
+    DMA1_Channel5_IRQn = 15,
+    DMA1_Channel6_IRQn = 16,
+    DMA1_Channel7_IRQn = 17,
+    I2C1_EV_IRQn = 31,
+    I2C2_EV_IRQn = 33,
+    I2C3_EV_IRQn = 72,
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t TIMINGR;
+    volatile uint32_t ISR;
+    volatile uint32_t ICR;
+} I2C_TypeDef;
+
+typedef struct {
+    volatile uint32_t CCR;
+    volatile uint32_t CNDTR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    uint32_t Request;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct {
+    DMA_Channel_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+} DMA_HandleTypeDef;
+
+typedef struct {
+    uint32_t Timing;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t OwnAddress2Masks;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum {
+    HAL_I2C_STATE_RESET = 0x00u,
+    HAL_I2C_STATE_READY = 0x20u,
+    HAL_I2C_STATE_BUSY = 0x24u,
+    HAL_I2C_STATE_BUSY_TX = 0x21u,
+    HAL_I2C_STATE_BUSY_RX = 0x22u,
+} HAL_I2C_StateTypeDef;
+
+typedef struct __I2C_HandleTypeDef {
+    I2C_TypeDef *Instance;
+    I2C_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    volatile HAL_I2C_StateTypeDef State;
+    volatile uint32_t ErrorCode;
+    HAL_StatusTypeDef (*XferISR)(struct __I2C_HandleTypeDef *hi2c,
+                                 uint32_t ITFlags, uint32_t ITSources);
+} I2C_HandleTypeDef;
+
+/// UART is only passed through by modules built on host so far.
+typedef struct __UART_HandleTypeDef UART_HandleTypeDef;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+extern DWT_Type *DWT;
+extern CoreDebug_Type *CoreDebug;
+extern uint32_t SystemCoreClock;
+
+extern I2C_TypeDef host_i2c[3];
+#define I2C1                        (&host_i2c[0])
+#define I2C2                        (&host_i2c[1])
+#define I2C3                        (&host_i2c[2])
+
+extern DMA_Channel_TypeDef host_dma1_channel[7];
+#define DMA1_Channel4               (&host_dma1_channel[3])
+#define DMA1_Channel5               (&host_dma1_channel[4])
+#define DMA1_Channel6               (&host_dma1_channel[5])
+#define DMA1_Channel7               (&host_dma1_channel[6])
+
+/// PRIMASK and IPSR as modules see them, harness sets IPSR around ISRs.
+extern uint32_t host_primask;
+extern uint32_t host_ipsr;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+// Core, in mcu_host.c.
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_IPSR(void);
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t prio, uint32_t sub_prio);
+void HAL_NVIC_EnableIRQ(IRQn_Type irq);
+void HAL_NVIC_DisableIRQ(IRQn_Type irq);
+
+// DMA, implemented by harness.
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+// I2C, implemented by harness.
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c,
+                                               uint32_t filter);
+HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c,
+                                                uint32_t filter);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c,
+                                          uint16_t address, uint8_t *p_data,
+                                          uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c,
+                                         uint16_t address, uint8_t *p_data,
+                                         uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                    uint16_t mem_addr, uint16_t mem_addr_len,
+                                    uint8_t *p_data, uint16_t size,
+                                    uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                   uint16_t mem_addr, uint16_t mem_addr_len,
+                                   uint8_t *p_data, uint16_t size,
+                                   uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c,
+                                             uint16_t address, uint8_t *p_data,
+                                             uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c,
+                                            uint16_t address, uint8_t *p_data,
+                                            uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c,
+                                              uint16_t address,
+                                              uint8_t *p_data, uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c,
+                                             uint16_t address, uint8_t *p_data,
+                                             uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t address, uint16_t mem_addr,
+                                       uint16_t mem_addr_len, uint8_t *p_data,
+                                       uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t address, uint16_t mem_addr,
+                                      uint16_t mem_addr_len, uint8_t *p_data,
+                                      uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c,
+                                        uint16_t address, uint16_t mem_addr,
+                                        uint16_t mem_addr_len, uint8_t *p_data,
+                                        uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c,
+                                       uint16_t address, uint16_t mem_addr,
+                                       uint16_t mem_addr_len, uint8_t *p_data,
+                                       uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Master_Sequential_Transmit_IT(
+    I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *p_data,
+    uint16_t size, uint32_t options);
+HAL_StatusTypeDef HAL_I2C_Master_Sequential_Receive_IT(
+    I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *p_data,
+    uint16_t size, uint32_t options);
+
+// I2C callbacks, implemented by module under test.
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+#endif //CROSSBOX_HOST_STM32L4XX_HAL_H
@@ -0,0 +1,16 @@
+/** @file stm32l4xx_ll_usart.h
+*
+* @brief Host stand-in for the LL USART driver, headers of UART modules
+*        include it for types only.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_LL_USART_H
+#define CROSSBOX_HOST_LL_USART_H
+
+#include <stm32l4xx_hal.h>
+
+#endif //CROSSBOX_HOST_LL_USART_H
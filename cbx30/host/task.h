@@ -0,0 +1,40 @@
+/** @file task.h
+*
+* @brief Host stand-in for FreeRTOS tasks. Tick only moves when a harness
+*        advances it or a blocking call times out.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_TASK_H
+#define CROSSBOX_HOST_TASK_H
+
+//------------------------------ INCLUDES -------------------------------------
+#include <FreeRTOS.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+#define taskSCHEDULER_SUSPENDED     (0)
+#define taskSCHEDULER_NOT_STARTED   (1)
+#define taskSCHEDULER_RUNNING       (2)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef void *TaskHandle_t;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+/// Current tick, harness advances it.
+extern volatile TickType_t host_tick;
+/// Scheduler state returned to modules, running unless harness sets it.
+extern BaseType_t host_scheduler_state;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+BaseType_t xTaskGetSchedulerState(void);
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+void vTaskDelay(TickType_t ticks);
+
+#endif //CROSSBOX_HOST_TASK_H
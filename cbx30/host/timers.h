@@ -0,0 +1,38 @@
+/** @file timers.h
+*
+* @brief Host stand-in for FreeRTOS software timers. Timers never expire on
+*        their own, harness runs the callback with host_timer_fire.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_TIMERS_H
+#define CROSSBOX_HOST_TIMERS_H
+
+//------------------------------ INCLUDES -------------------------------------
+#include <FreeRTOS.h>
+#include <stdbool.h>
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct host_timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+TimerHandle_t xTimerCreate(const char *p_name, TickType_t period,
+                           UBaseType_t auto_reload, void *p_id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t *p_woken);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+/**
+ * @brief Run callback of a started timer, as the timer task would on expiry.
+ * @param timer timer, NULL runs the most recently created one.
+ * @return false if timer is not running.
+ */
+bool host_timer_fire(TimerHandle_t timer);
+
+#endif //CROSSBOX_HOST_TIMERS_H
@@ -0,0 +1,13 @@
+/** @file wdtm.h
+*
+* @brief Host stand-in for the watchdog manager, nothing is watched.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HOST_WDTM_H
+#define CROSSBOX_HOST_WDTM_H
+
+#endif //CROSSBOX_HOST_WDTM_H
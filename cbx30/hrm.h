@@ -47,6 +47,8 @@ typedef struct hrm_message_
 /**
  * Adds message queue to queue set
  * @param queue_set logger queue set
+ * @deprecated Logger wakes once per message this way. Session records go
+ *             through the SESSION_LOG_HRM ring instead, see session_log.h.
  */
 void hrm_queue_to_set (QueueSetHandle_t queue_set);
 
@@ -0,0 +1,312 @@
+/** @file hrv.c
+*
+* @brief Streaming heart rate variability from RR intervals. Accepted
+*        intervals enter a rolling window of fixed duration, sums of
+*        intervals, their squares and squared successive differences are
+*        updated as intervals enter and leave, so every interval costs the
+*        same whatever the window length. Metrics come from the sums in
+*        integers, no drift over long sessions.
+*
+*        RMSSD:  root mean square of successive differences
+*        SDNN:   sample standard deviation of intervals
+*        pNN50:  share of successive differences above 50 ms
+*
+*        A difference is only taken between two accepted intervals that
+*        follow each other, a rejected interval breaks the chain.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <hrv.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HRV_DIFF_NONE               (INT16_MIN)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Append accepted interval to window.
+ */
+static void hrv_push(hrv_t *p_hrv, uint16_t rr_ms, int16_t diff);
+
+/**
+ * @brief Remove oldest interval, and the difference of the next one that
+ *      referred to it.
+ */
+static void hrv_pop(hrv_t *p_hrv);
+
+/**
+ * @brief Count rejected interval.
+ * @return false
+ */
+static bool hrv_reject(hrv_t *p_hrv);
+
+/**
+ * @brief Square root rounded to nearest.
+ */
+static uint32_t hrv_isqrt(uint64_t value);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void hrv_init(hrv_t *p_hrv, uint32_t window_ms, uint32_t period_s)
+{
+    memset(p_hrv, 0, sizeof(*p_hrv));
+    p_hrv->window_ms = window_ms;
+    p_hrv->period_us = (uint64_t)period_s * 1000000u;
+}
+
+bool hrv_add(hrv_t *p_hrv, uint16_t rr_ms)
+{
+    int16_t diff = HRV_DIFF_NONE;
+
+    if ((HRV_RR_MIN_MS > rr_ms) || (HRV_RR_MAX_MS < rr_ms))
+    {
+        return hrv_reject(p_hrv);
+    }
+
+    if (0u != p_hrv->ref_rr)
+    {
+        uint32_t dev = (rr_ms > p_hrv->ref_rr) ? (rr_ms - p_hrv->ref_rr) :
+                                                 (p_hrv->ref_rr - rr_ms);
+
+        if ((dev * 100u) > ((uint32_t)p_hrv->ref_rr * HRV_RR_DEV_PCT))
+        {
+            if (HRV_RESEED_CNT > ++p_hrv->rejects)
+            {
+                return hrv_reject(p_hrv);
+            }
+
+            // Rhythm changed, ectopic beats do not repeat like this.
+            p_hrv->chained = false;
+        }
+    }
+
+    if (p_hrv->chained)
+    {
+        diff = (int16_t)((int32_t)rr_ms - (int32_t)p_hrv->ref_rr);
+    }
+
+    if (HRV_WINDOW_MAX == p_hrv->cnt)
+    {
+        hrv_pop(p_hrv);
+    }
+
+    hrv_push(p_hrv, rr_ms, diff);
+
+    while ((1u < p_hrv->cnt) && (p_hrv->sum_rr > p_hrv->window_ms))
+    {
+        hrv_pop(p_hrv);
+    }
+
+    p_hrv->ref_rr = rr_ms;
+    p_hrv->chained = true;
+    p_hrv->rejects = 0u;
+
+    return true;
+}
+
+void hrv_gap(hrv_t *p_hrv)
+{
+    p_hrv->chained = false;
+    p_hrv->rejects = 0u;
+}
+
+void hrv_get(const hrv_t *p_hrv, hrv_summary_t *p_summary)
+{
+    uint32_t n = p_hrv->cnt;
+
+    memset(p_summary, 0, sizeof(*p_summary));
+
+    p_summary->intervals = (uint16_t)n;
+    p_summary->diffs = (uint16_t)p_hrv->diffs;
+    p_summary->artifacts = p_hrv->artifacts;
+
+    if (0u != n)
+    {
+        p_summary->mean_rr = (uint16_t)((p_hrv->sum_rr + (n / 2u)) / n);
+    }
+
+    if (1u < n)
+    {
+        // n * sum(x^2) - sum(x)^2 over n * (n - 1), in 0.01 ms squared.
+        uint64_t var = ((uint64_t)n * p_hrv->sum_rr2) -
+                       ((uint64_t)p_hrv->sum_rr * p_hrv->sum_rr);
+
+        p_summary->sdnn = hrv_isqrt((var * 10000u) /
+                                    ((uint64_t)n * (n - 1u)));
+    }
+
+    if (0u != p_hrv->diffs)
+    {
+        p_summary->rmssd = hrv_isqrt((p_hrv->sum_d2 * 10000u) / p_hrv->diffs);
+        p_summary->pnn50 = (uint16_t)(((p_hrv->nn50 * 10000u) +
+                                       (p_hrv->diffs / 2u)) / p_hrv->diffs);
+    }
+}
+
+bool hrv_summary_poll(hrv_t *p_hrv, uint64_t time_us,
+                      hrv_summary_t *p_summary)
+{
+    if (0u == p_hrv->cnt)
+    {
+        return false;
+    }
+
+    if (0u == p_hrv->summary_us)
+    {
+        p_hrv->summary_us = time_us + p_hrv->period_us;
+        return false;
+    }
+
+    if (time_us < p_hrv->summary_us)
+    {
+        return false;
+    }
+
+    hrv_get(p_hrv, p_summary);
+    p_hrv->artifacts = 0u;
+
+    // Missed periods are not made up for.
+    p_hrv->summary_us += p_hrv->period_us;
+    if (p_hrv->summary_us <= time_us)
+    {
+        p_hrv->summary_us = time_us + p_hrv->period_us;
+    }
+
+    return true;
+}
+
+void hrv_record_fill(const hrv_summary_t *p_summary, uint64_t time_us,
+                     session_record_t *p_rec)
+{
+    p_rec->type = SESSION_RECORD_HRV;
+    p_rec->cnt = HRV_RECORD_CH;
+    p_rec->time_us = time_us;
+    p_rec->ch[0] = (int32_t)p_summary->rmssd;
+    p_rec->ch[1] = (int32_t)p_summary->sdnn;
+    p_rec->ch[2] = p_summary->pnn50;
+    p_rec->ch[3] = p_summary->mean_rr;
+    p_rec->ch[4] = p_summary->intervals;
+    p_rec->ch[5] = p_summary->diffs;
+    p_rec->ch[6] = p_summary->artifacts;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void hrv_push(hrv_t *p_hrv, uint16_t rr_ms, int16_t diff)
+{
+    uint32_t index = (p_hrv->head + p_hrv->cnt) % HRV_WINDOW_MAX;
+
+    // Oldest interval has nothing before it in the window.
+    if (0u == p_hrv->cnt)
+    {
+        diff = HRV_DIFF_NONE;
+    }
+
+    p_hrv->rr[index] = rr_ms;
+    p_hrv->diff[index] = diff;
+    p_hrv->cnt++;
+
+    p_hrv->sum_rr += rr_ms;
+    p_hrv->sum_rr2 += (uint32_t)rr_ms * rr_ms;
+
+    if (HRV_DIFF_NONE != diff)
+    {
+        uint32_t abs_diff = (uint32_t)((0 > diff) ? -diff : diff);
+
+        p_hrv->diffs++;
+        p_hrv->sum_d2 += abs_diff * abs_diff;
+        if (HRV_NN50_MS < abs_diff)
+        {
+            p_hrv->nn50++;
+        }
+    }
+}
+
+static void hrv_pop(hrv_t *p_hrv)
+{
+    uint16_t rr_ms = p_hrv->rr[p_hrv->head];
+    int16_t diff;
+
+    p_hrv->sum_rr -= rr_ms;
+    p_hrv->sum_rr2 -= (uint32_t)rr_ms * rr_ms;
+
+    p_hrv->head = (p_hrv->head + 1u) % HRV_WINDOW_MAX;
+    p_hrv->cnt--;
+
+    if (0u == p_hrv->cnt)
+    {
+        return;
+    }
+
+    diff = p_hrv->diff[p_hrv->head];
+    if (HRV_DIFF_NONE != diff)
+    {
+        uint32_t abs_diff = (uint32_t)((0 > diff) ? -diff : diff);
+
+        p_hrv->diffs--;
+        p_hrv->sum_d2 -= abs_diff * abs_diff;
+        if (HRV_NN50_MS < abs_diff)
+        {
+            p_hrv->nn50--;
+        }
+        p_hrv->diff[p_hrv->head] = HRV_DIFF_NONE;
+    }
+}
+
+static bool hrv_reject(hrv_t *p_hrv)
+{
+    p_hrv->chained = false;
+
+    if (UINT16_MAX > p_hrv->artifacts)
+    {
+        p_hrv->artifacts++;
+    }
+
+    return false;
+}
+
+static uint32_t hrv_isqrt(uint64_t value)
+{
+    uint64_t root = 0u;
+    uint64_t bit = (uint64_t)1u << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (0u != bit)
+    {
+        if (value >= (root + bit))
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    // Rounded, value holds remainder above root squared.
+    if (value > root)
+    {
+        root++;
+    }
+
+    return (uint32_t)root;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
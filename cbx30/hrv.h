@@ -0,0 +1,137 @@
+/** @file hrv.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_HRV_H
+#define CROSSBOX_HRV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <session_record.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Intervals held by the rolling window, about 2 minutes at 120 bpm.
+#define HRV_WINDOW_MAX              (256u)
+/// Intervals outside are rejected as artifacts.
+#define HRV_RR_MIN_MS               (300u)
+#define HRV_RR_MAX_MS               (2000u)
+/// Largest change to the last accepted interval, in percent.
+#define HRV_RR_DEV_PCT              (20u)
+/// Rejects in a row after which the rhythm is taken as real.
+#define HRV_RESEED_CNT              (3u)
+/// Successive difference counted by pNN50.
+#define HRV_NN50_MS                 (50u)
+
+/// BLE heart rate RR interval, 1/1024 s, to ms.
+#define HRV_RR_FROM_1024(rr)        ((uint16_t)((((uint32_t)(rr) * 1000u) + \
+                                                 512u) / 1024u))
+
+/// Summary record channels.
+#define HRV_RECORD_CH               (7u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+typedef struct {
+    uint32_t rmssd;                 // 0.01 ms, 0 without differences
+    uint32_t sdnn;                  // 0.01 ms, 0 below 2 intervals
+    uint16_t pnn50;                 // 0.01 %
+    uint16_t mean_rr;               // ms
+    uint16_t intervals;             // in window
+    uint16_t diffs;                 // successive differences in window
+    uint16_t artifacts;             // rejected since last summary
+} hrv_summary_t;
+
+/// Engine state, one per RR stream.
+typedef struct {
+    uint16_t rr[HRV_WINDOW_MAX];    // ms, oldest at head
+    int16_t diff[HRV_WINDOW_MAX];   // to previous interval, INT16_MIN if
+                                    // that one was rejected or left
+    uint32_t head;
+    uint32_t cnt;
+    uint32_t window_ms;
+    uint64_t period_us;
+
+    uint32_t sum_rr;
+    uint64_t sum_rr2;
+    uint64_t sum_d2;
+    uint32_t diffs;
+    uint32_t nn50;
+
+    uint16_t ref_rr;                // last accepted, 0 if none
+    bool chained;                   // next interval follows ref_rr
+    uint8_t rejects;                // deviation rejects in a row
+    uint16_t artifacts;
+    uint64_t summary_us;            // next summary, 0 until first poll
+} hrv_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Reset engine.
+ * @param p_hrv engine
+ * @param window_ms rolling window length, capped by HRV_WINDOW_MAX intervals
+ * @param period_s summary period
+ */
+void hrv_init(hrv_t *p_hrv, uint32_t window_ms, uint32_t period_s);
+
+/**
+ * @brief Add RR interval. Out of range intervals and jumps above
+ *      HRV_RR_DEV_PCT from the last accepted one are rejected, until
+ *      HRV_RESEED_CNT in a row show a new rhythm. Amortized constant
+ *      time.
+ * @param p_hrv engine
+ * @param rr_ms interval, see HRV_RR_FROM_1024
+ * @return false if rejected as artifact
+ */
+bool hrv_add(hrv_t *p_hrv, uint16_t rr_ms);
+
+/**
+ * @brief Break successive differences, e.g. after HRM reconnects. Window
+ *      is kept.
+ * @param p_hrv engine
+ */
+void hrv_gap(hrv_t *p_hrv);
+
+/**
+ * @brief Metrics of current window.
+ * @param p_hrv engine
+ * @param p_summary output, artifacts since last summary
+ */
+void hrv_get(const hrv_t *p_hrv, hrv_summary_t *p_summary);
+
+/**
+ * @brief Get summary once per period, artifact count restarts.
+ * @param p_hrv engine
+ * @param time_us current time
+ * @param p_summary output
+ * @return true if summary is due and was written
+ */
+bool hrv_summary_poll(hrv_t *p_hrv, uint64_t time_us,
+                      hrv_summary_t *p_summary);
+
+/**
+ * @brief Fill session record: rmssd, sdnn, pnn50, mean rr, intervals,
+ *      differences, artifacts.
+ * @param p_summary summary
+ * @param time_us record time
+ * @param p_rec output
+ */
+void hrv_record_fill(const hrv_summary_t *p_summary, uint64_t time_us,
+                     session_record_t *p_rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_HRV_H
@@ -0,0 +1,303 @@
+/** @file hrv_host.c
+*
+* @brief Host runner of the HRV engine, for comparing it with reference
+*        tools on recorded RR series. Reads intervals in ms, one per line,
+*        time advances by each interval. Prints a summary per period as CSV:
+*        time in s, RMSSD ms, SDNN ms, pNN50 %, mean RR ms, intervals,
+*        artifacts.
+*
+*        gcc -DHRV_HOST -I. hrv.c hrv_host.c -lm -o hrv
+*        ./hrv [-w window_s] [-p period_s] [rr.txt] > hrv.csv
+*        ./hrv -t
+*
+*        -t runs fixed RR sequences with hand computed RMSSD, SDNN and
+*        pNN50 (artifacts, rhythm change, window eviction) and a long series
+*        against a floating point two pass reference, and fails on mismatch.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <hrv.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_WINDOW_S               (120u)
+#define HOST_PERIOD_S               (10u)
+#define HOST_SERIES_LEN             (200u)
+
+#define HOST_CASE(name, window, exp, ...) \
+    { .p_name = (name), .window_s = (window), .expect = exp, \
+      .p_rr = (const uint16_t []){ __VA_ARGS__ }, \
+      .cnt = sizeof((const uint16_t []){ __VA_ARGS__ }) / sizeof(uint16_t) }
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// RR sequence and the summary expected after it, metrics in 0.01 units.
+typedef struct {
+    const char *p_name;
+    uint32_t window_s;
+    const uint16_t *p_rr;
+    uint32_t cnt;
+    hrv_summary_t expect;
+} hrv_host_case_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+static void hrv_host_print(uint64_t time_us, const hrv_summary_t *p_summary);
+static bool hrv_host_case(const hrv_host_case_t *p_case);
+static bool hrv_host_series(void);
+static bool hrv_host_near(uint32_t value, double ref);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+static const hrv_host_case_t hrv_host_cases[] = {
+    // Differences +10 -20 +60 -70: RMSSD sqrt(9000 / 4) = 47.43, two of
+    // four above 50 ms. Mean 806, squared deviations 2920: SDNN
+    // sqrt(2920 / 4) = 27.02.
+    HOST_CASE("basic", 120u,
+              ((hrv_summary_t){ .rmssd = 4743u, .sdnn = 2702u,
+                                .pnn50 = 5000u, .mean_rr = 806u,
+                                .intervals = 5u, .diffs = 4u }),
+              800u, 810u, 790u, 850u, 780u),
+
+    HOST_CASE("constant", 120u,
+              ((hrv_summary_t){ .mean_rr = 1000u, .intervals = 10u,
+                                .diffs = 9u }),
+              1000u, 1000u, 1000u, 1000u, 1000u, 1000u, 1000u, 1000u,
+              1000u, 1000u),
+
+    // 1200 deviates over 20 % and 250 is out of range, both break the
+    // chain: differences +10 and -15 only, RMSSD sqrt(325 / 2) = 12.75.
+    // Mean 810, squared deviations 250: SDNN sqrt(250 / 4) = 7.91.
+    HOST_CASE("artifacts", 120u,
+              ((hrv_summary_t){ .rmssd = 1275u, .sdnn = 791u,
+                                .pnn50 = 0u, .mean_rr = 810u,
+                                .intervals = 5u, .diffs = 2u,
+                                .artifacts = 2u }),
+              800u, 810u, 1200u, 820u, 805u, 250u, 815u),
+
+    // Third interval at the new rate is accepted without a difference to
+    // the old one. Mean 720, squared deviations 108000: SDNN
+    // sqrt(108000 / 4) = 164.32.
+    HOST_CASE("rhythm change", 120u,
+              ((hrv_summary_t){ .rmssd = 0u, .sdnn = 16432u,
+                                .pnn50 = 0u, .mean_rr = 720u,
+                                .intervals = 5u, .diffs = 3u,
+                                .artifacts = 2u }),
+              600u, 600u, 600u, 900u, 900u, 900u, 900u),
+
+    // 3 s window drops the first interval and the +100 difference to it:
+    // -200 and +100 remain, RMSSD sqrt(50000 / 2) = 158.11, both above
+    // 50 ms. Mean 1000, SDNN sqrt(20000 / 2) = 100.00.
+    HOST_CASE("window", 3u,
+              ((hrv_summary_t){ .rmssd = 15811u, .sdnn = 10000u,
+                                .pnn50 = 10000u, .mean_rr = 1000u,
+                                .intervals = 3u, .diffs = 2u }),
+              1000u, 1100u, 900u, 1000u),
+};
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef HRV_HOST
+int main(int argc, char **argv)
+{
+    static hrv_t hrv;
+    hrv_summary_t summary;
+    FILE *p_input = stdin;
+    uint32_t window_s = HOST_WINDOW_S;
+    uint32_t period_s = HOST_PERIOD_S;
+    uint64_t time_us = 0u;
+    uint32_t rejected = 0u;
+    uint32_t total = 0u;
+    double rr;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "w:p:t")))
+    {
+        switch (opt)
+        {
+            case 't':
+            {
+                bool is_ok = hrv_host_series();
+
+                for (uint32_t index = 0u; index < (sizeof(hrv_host_cases) /
+                     sizeof(hrv_host_cases[0])); index++)
+                {
+                    is_ok = hrv_host_case(&hrv_host_cases[index]) && is_ok;
+                }
+
+                printf("%s\n", is_ok ? "ok" : "failed");
+                return !is_ok;
+            }
+            case 'w':
+                window_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                period_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t] [-w window_s] [-p period_s] "
+                        "[rr file]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((optind < argc) && (NULL == (p_input = fopen(argv[optind], "r"))))
+    {
+        fprintf(stderr, "can not open %s\n", argv[optind]);
+        return 1;
+    }
+
+    hrv_init(&hrv, window_s * 1000u, period_s);
+
+    while (1 == fscanf(p_input, "%lf", &rr))
+    {
+        uint16_t rr_ms = (uint16_t)((0.0 > rr) ? 0.0 :
+                                    ((65535.0 < rr) ? 65535.0 : (rr + 0.5)));
+
+        total++;
+        time_us += (uint64_t)rr_ms * 1000u;
+
+        if (!hrv_add(&hrv, rr_ms))
+        {
+            rejected++;
+        }
+
+        if (hrv_summary_poll(&hrv, time_us, &summary))
+        {
+            hrv_host_print(time_us, &summary);
+        }
+    }
+
+    hrv_get(&hrv, &summary);
+    hrv_host_print(time_us, &summary);
+
+    if (stdin != p_input)
+    {
+        fclose(p_input);
+    }
+
+    fprintf(stderr, "%u intervals, %u rejected\n", total, rejected);
+
+    return 0;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void hrv_host_print(uint64_t time_us, const hrv_summary_t *p_summary)
+{
+    printf("%.3f,%u.%02u,%u.%02u,%u.%02u,%u,%u,%u\n",
+           (double)time_us / 1e6,
+           p_summary->rmssd / 100u, p_summary->rmssd % 100u,
+           p_summary->sdnn / 100u, p_summary->sdnn % 100u,
+           p_summary->pnn50 / 100u, p_summary->pnn50 % 100u,
+           p_summary->mean_rr, p_summary->intervals, p_summary->artifacts);
+}
+
+static bool hrv_host_case(const hrv_host_case_t *p_case)
+{
+    static hrv_t hrv;
+    hrv_summary_t summary;
+    const hrv_summary_t *p_exp = &p_case->expect;
+
+    hrv_init(&hrv, p_case->window_s * 1000u, HOST_PERIOD_S);
+    for (uint32_t index = 0u; index < p_case->cnt; index++)
+    {
+        (void)hrv_add(&hrv, p_case->p_rr[index]);
+    }
+    hrv_get(&hrv, &summary);
+
+    if ((p_exp->rmssd != summary.rmssd) || (p_exp->sdnn != summary.sdnn) ||
+        (p_exp->pnn50 != summary.pnn50) ||
+        (p_exp->mean_rr != summary.mean_rr) ||
+        (p_exp->intervals != summary.intervals) ||
+        (p_exp->diffs != summary.diffs) ||
+        (p_exp->artifacts != summary.artifacts))
+    {
+        fprintf(stderr, "%s: got %u %u %u %u %u %u %u, expected "
+                "%u %u %u %u %u %u %u\n", p_case->p_name,
+                summary.rmssd, summary.sdnn, summary.pnn50, summary.mean_rr,
+                summary.intervals, summary.diffs, summary.artifacts,
+                p_exp->rmssd, p_exp->sdnn, p_exp->pnn50, p_exp->mean_rr,
+                p_exp->intervals, p_exp->diffs, p_exp->artifacts);
+        return false;
+    }
+
+    return true;
+}
+
+static bool hrv_host_series(void)
+{
+    static hrv_t hrv;
+    uint16_t rr[HOST_SERIES_LEN];
+    hrv_summary_t summary;
+    double mean = 0.0;
+    double dev2 = 0.0;
+    double diff2 = 0.0;
+    uint32_t nn50 = 0u;
+
+    // Respiratory and slower rhythm, all intervals accepted and in window.
+    for (uint32_t index = 0u; index < HOST_SERIES_LEN; index++)
+    {
+        rr[index] = (uint16_t)lround(800.0 + (45.0 * sin(index * 1.3)) +
+                                     (30.0 * sin(index * 0.11)));
+        mean += rr[index];
+    }
+    mean /= HOST_SERIES_LEN;
+
+    for (uint32_t index = 0u; index < HOST_SERIES_LEN; index++)
+    {
+        dev2 += (rr[index] - mean) * (rr[index] - mean);
+
+        if (0u < index)
+        {
+            double diff = (double)rr[index] - rr[index - 1u];
+
+            diff2 += diff * diff;
+            nn50 += (50.0 < fabs(diff)) ? 1u : 0u;
+        }
+    }
+
+    hrv_init(&hrv, 3600u * 1000u, HOST_PERIOD_S);
+    for (uint32_t index = 0u; index < HOST_SERIES_LEN; index++)
+    {
+        (void)hrv_add(&hrv, rr[index]);
+    }
+    hrv_get(&hrv, &summary);
+
+    if ((HOST_SERIES_LEN != summary.intervals) || (0u != summary.artifacts) ||
+        !hrv_host_near(summary.rmssd,
+                       sqrt(diff2 / (HOST_SERIES_LEN - 1u)) * 100.0) ||
+        !hrv_host_near(summary.sdnn,
+                       sqrt(dev2 / (HOST_SERIES_LEN - 1u)) * 100.0) ||
+        !hrv_host_near(summary.pnn50,
+                       (nn50 * 10000.0) / (HOST_SERIES_LEN - 1u)) ||
+        !hrv_host_near(summary.mean_rr, mean))
+    {
+        fprintf(stderr, "series: got %u %u %u %u, expected %.2f %.2f %.2f "
+                "%.1f\n", summary.rmssd, summary.sdnn, summary.pnn50,
+                summary.mean_rr, sqrt(diff2 / (HOST_SERIES_LEN - 1u)),
+                sqrt(dev2 / (HOST_SERIES_LEN - 1u)),
+                (nn50 * 100.0) / (HOST_SERIES_LEN - 1u), mean);
+        return false;
+    }
+
+    return true;
+}
+
+static bool hrv_host_near(uint32_t value, double ref)
+{
+    // Integer metrics are rounded once, allow one unit either way.
+    return (fabs((double)value - ref) <= 1.0);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
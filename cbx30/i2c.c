@@ -9,10 +9,14 @@
 
 //------------------------------ INCLUDES -------------------------------------
 #include <inc/bsp/i2c.h>
+#include <inc/bsp/lowpower.h>
+#include <cycles.h>
 #include <string.h>
+#include <stdbool.h>
 #include <FreeRTOS.h>
 #include <task.h>
 #include <semphr.h>
+#include <timers.h>
 #include <stm32l4xx_hal.h>
 #include <RTT.h>
 #include <wdtm.h>
@@ -20,6 +24,10 @@
 //-------------------------------- MACROS -------------------------------------
 #define BSP_I2C_DEFAULT_TIMEOUT_MS  (10u)
 
+// Shorter transfers are interrupt driven, DMA setup costs more than it saves.
+#define I2C_DMA_MIN_LEN             (4u)
+#define I2C_DMA_IRQ_PRIO            (5u)
+
 #define DBGI2C(...)
 //#define DBGI2C dprintf
 
@@ -31,6 +39,35 @@ typedef struct {
     SemaphoreHandle_t mutex_id;
     // Used for signaling end of interrupt
     SemaphoreHandle_t signal_id;
+    // DMA channels, linked to handle when use_dma is set.
+    DMA_HandleTypeDef hdma_tx;
+    DMA_HandleTypeDef hdma_rx;
+    bool use_dma;
+    // Asynchronous job queue, head is the running job while busy is set.
+    bsp_i2c_job_t *p_head;
+    bsp_i2c_job_t *p_tail;
+    volatile bool busy;
+    // Index of running transfer in head job chain.
+    int trx_index;
+    // Generation of last started and last ended transfer. A transfer ends
+    // once, by its completion ISR or by timeout/cancel, whichever claims it.
+    volatile uint32_t trx_gen;
+    volatile uint32_t trx_end_gen;
+    // Start tick and timeout of running transfer.
+    TickType_t trx_tick;
+    TickType_t trx_timeout;
+    // Result of synchronous transfer, set from job callback.
+    volatile int sync_result;
+    // DWT cycle counter at start of running transfer.
+    uint32_t trx_cyc;
+    // Timing as configured and its kernel clock, rescaled on clock change.
+    uint32_t timing_ref;
+    uint32_t timing_ref_hz;
+    // Statistics, device slots are assigned on first use.
+    bsp_i2c_stats_t stats;
+    uint8_t dev_address[BSP_I2C_STATS_DEV_MAX];
+    bsp_i2c_dev_stats_t dev_stats[BSP_I2C_STATS_DEV_MAX];
+    uint8_t dev_cnt;
 } i2c_master_t;
 
 // Used for debugging purpose.
@@ -39,7 +76,8 @@ static int dbg_i2c_error;
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
 /*!
-* @brief Single transfer (Send/Receive) via i2c.
+* @brief Single blocking transfer (Send/Receive) via i2c, used before
+*   scheduler is started.
 * @param[in] instance of i2c to transfer data with.
 * @param[in] transfer structure containing mode, eventual mode attributes
 *   (BSP_I2C_MODE_MEMORY mode applicable), device address (shifted one bit
@@ -49,6 +87,167 @@ static int dbg_i2c_error;
 */
 static int i2c_transfer_single(int instance, bsp_i2c_transfer_t *p_trx);
 
+/*!
+* @brief Transfer chain through the job queue and wait for its end.
+* @param[in] instance of i2c to transfer data with.
+* @param[in] transfers to process.
+* @param[in] number of transfers.
+* @param[in] cycle counter when transfer was requested, before locking.
+* @return 0 on success
+*/
+static int i2c_transfer_sync(int instance, bsp_i2c_transfer_t *p_trx,
+                             int trx_len, uint32_t start_cyc);
+
+/*!
+* @brief Job callback of synchronous transfer, signals waiting thread.
+* @param[in] transfer result.
+* @param[in] i2c master.
+* @return none.
+*/
+static void i2c_sync_done(int result, void *p_ctx);
+
+/*!
+* @brief Start interrupt/DMA driven transfer. End is reported through HAL
+*   callbacks.
+* @param[in] instance of i2c to transfer data with.
+* @param[in] transfer structure.
+* @return 0 if transfer started.
+*/
+static int i2c_trx_start(int instance, bsp_i2c_transfer_t *p_trx);
+
+/*!
+* @brief Append job to instance queue, start it if bus is idle.
+* @param[in] instance of i2c.
+* @param[in] job to queue.
+* @return none.
+*/
+static void i2c_job_queue(int instance, bsp_i2c_job_t *p_job);
+
+/*!
+* @brief Job state machine step. Starts next transfer of running job or
+*   completes it and starts the following job. Called on transfer end from
+*   ISR, or from task when starting idle bus or failing timed out transfer.
+* @param[in] instance of i2c.
+* @param[in] result of finished transfer, 0 when starting new job.
+* @return none.
+*/
+static void i2c_job_next(int instance, int result);
+
+/*!
+* @brief Remove job from queue, failing it if it is running.
+* @param[in] instance of i2c.
+* @param[in] job to remove.
+* @return none.
+*/
+static void i2c_job_cancel(int instance, bsp_i2c_job_t *p_job);
+
+/*!
+* @brief Arm poll timer for queued asynchronous job if it is not armed yet.
+*   Safe to call from ISR.
+* @return none.
+*/
+static void i2c_poll_arm(void);
+
+/*!
+* @brief Poll timer callback. Fails stuck transfers and re-arms itself while
+*   any instance is busy, so an idle bus costs no timer wakeups.
+* @param[in] poll timer.
+* @return none.
+*/
+static void i2c_poll_tick(TimerHandle_t timer);
+
+/*!
+* @brief Claim end of running transfer. Called with interrupts masked.
+* @param[in] i2c master.
+* @return true for the first caller after transfer start, false if no
+*   transfer is running or it has already ended.
+*/
+static bool i2c_trx_claim(i2c_master_t *p_master);
+
+/*!
+* @brief Stop running transfer so none of its events reaches HAL callbacks
+*   any more: DMA channels aborted, peripheral and its interrupts disabled,
+*   HAL state reset. Called with interrupts masked, i2c_reset enables the
+*   instance again.
+* @param[in] instance of i2c.
+* @return none.
+*/
+static void i2c_trx_abort(int instance);
+
+/*!
+* @brief Start DWT cycle counter used for time statistics.
+* @return none.
+*/
+static void i2c_cycles_init(void);
+
+/*!
+* @brief Read DWT cycle counter.
+* @return cycle count.
+*/
+static uint32_t i2c_cycles_now(void);
+
+/*!
+* @brief Find or assign statistics slot of device.
+* @param[in] instance of i2c.
+* @param[in] transfer address (shifted, with read/write flag).
+* @return device statistics.
+*/
+static bsp_i2c_dev_stats_t *i2c_stats_dev(int instance, uint8_t address);
+
+/*!
+* @brief Add duration to histogram and maximum.
+* @param[in] histogram.
+* @param[in] maximum.
+* @param[in] elapsed cycles.
+* @return none.
+*/
+static void i2c_stats_hist_add(uint32_t *p_hist, uint32_t *p_max,
+                               uint32_t cycles);
+
+/*!
+* @brief Record time from request to start of first transfer.
+* @param[in] instance of i2c.
+* @param[in] first transfer of request.
+* @param[in] elapsed cycles.
+* @return none.
+*/
+static void i2c_stats_wait(int instance, const bsp_i2c_transfer_t *p_trx,
+                           uint32_t cycles);
+
+/*!
+* @brief Record end of transfer.
+* @param[in] instance of i2c.
+* @param[in] finished transfer.
+* @param[in] elapsed cycles.
+* @param[in] transfer result.
+* @return none.
+*/
+static void i2c_stats_trx(int instance, const bsp_i2c_transfer_t *p_trx,
+                          uint32_t cycles, int result);
+
+/*!
+* @brief Print one statistics record.
+* @param[in] record title.
+* @param[in] instance number or device address.
+* @param[in] statistics.
+* @return none.
+*/
+static void i2c_stats_print(const char *p_title, int id,
+                            const bsp_i2c_dev_stats_t *p_stats);
+
+/*!
+* @brief Mask interrupts, job queue is shared by tasks and ISRs.
+* @return previous PRIMASK value.
+*/
+static uint32_t i2c_irq_lock(void);
+
+/*!
+* @brief Restore interrupt mask saved by i2c_irq_lock.
+* @param[in] previous PRIMASK value.
+* @return none.
+*/
+static void i2c_irq_unlock(uint32_t primask);
+
 /*!
 * @brief Clear eventual Notify/Signal. Called before starting transfer.
 * @param[in] instance of i2c to clear Notify/Signal.
@@ -62,10 +261,11 @@ static int i2c_signal_clear(int instance);
 * @param[in] timeout in ms to wait for Notify/Signal.
 * @return 0 on success, 1 on timeout.
 */
-static int i2c_signal_wait(int instance, uint8_t timeout);
+static int i2c_signal_wait(int instance, uint32_t timeout);
 
 /*!
-* @brief Notify/Signal end of transfer. Called from I2C transfer complete ISR.
+* @brief Notify/Signal end of transfer. Called from I2C transfer complete ISR,
+*   or from task if transfer could not be started.
 * @param[in] instance of i2c to send Notify/Signal.
 * @return 0 on success.
 */
@@ -109,6 +309,17 @@ static int i2c_instances_max(void);
 */
 static int i2c_sequence_translate(bsp_i2c_mode_t sequence);
 
+/*!
+* @brief Convert TIMINGR value to another kernel clock. Every phase keeps at
+*   least its previous duration.
+* @param[in] timing TIMINGR value at old_hz.
+* @param[in] old_hz previous kernel clock.
+* @param[in] new_hz new kernel clock.
+* @return TIMINGR value at new_hz.
+*/
+static uint32_t i2c_timing_scale(uint32_t timing, uint32_t old_hz,
+                                 uint32_t new_hz);
+
 /*!
 * @brief Assert function prints file and line where error is detected. Called on
 *   setup failure (wrong parameters).
@@ -136,6 +347,16 @@ static void hal_i2c2_mx_init(i2c_master_t *master);
 */
 static void hal_i2c3_mx_init(i2c_master_t *master);
 
+/*!
+* @brief DMA initialization for i2c instance, request 3 on DMA1.
+* @return none
+*/
+static void hal_i2c_dma_init(i2c_master_t *master,
+                             DMA_Channel_TypeDef *p_tx_channel,
+                             IRQn_Type tx_irq,
+                             DMA_Channel_TypeDef *p_rx_channel,
+                             IRQn_Type rx_irq);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 
 // I2C master for every i2c peripheral on STM32L476RG device.
@@ -146,6 +367,11 @@ static i2c_master_t i2c_master[3u];
 static int rtos_mode_flag;
 
 static uint8_t b_i2c_init_flag = 0;
+
+// One-shot timer running bsp_i2c_async_poll while asynchronous jobs are
+// queued, armed flag is owned under i2c_irq_lock.
+static TimerHandle_t i2c_poll_timer;
+static volatile bool i2c_poll_armed;
 //------------------------------ GLOBAL DATA ----------------------------------
 
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
@@ -156,282 +382,966 @@ uint8_t bsp_i2c_get_init_flag()
 
 void bsp_i2c_init_nortos(void)
 {
+    i2c_cycles_init();
+
     // CubeMX init inside.
     hal_i2c1_mx_init(&i2c_master[0]);
     hal_i2c2_mx_init(&i2c_master[1]);
     hal_i2c3_mx_init(&i2c_master[2]);
 }
 
-int bsp_i2c_init (void)
+int bsp_i2c_init (void)
+{
+    static int result = 1u;
+
+    if (result)
+    {
+        result = 0;
+
+        i2c_cycles_init();
+
+        // CubeMX init inside.
+        hal_i2c1_mx_init(&i2c_master[0]);
+        hal_i2c2_mx_init(&i2c_master[1]);
+        hal_i2c3_mx_init(&i2c_master[2]);
+
+        // Create mutexes and signals.
+        for (int index = 0; index < i2c_instances_max(); index++)
+        {
+            i2c_master[index].mutex_id = xSemaphoreCreateMutex();
+            result = result || (NULL == i2c_master[index].mutex_id);
+            i2c_master[index].signal_id = xSemaphoreCreateBinary();
+            result = result || (NULL == i2c_master[index].signal_id);
+        }
+
+        i2c_poll_timer = xTimerCreate("i2c_poll",
+                                      pdMS_TO_TICKS(BSP_I2C_DEFAULT_TIMEOUT_MS),
+                                      pdFALSE, NULL, i2c_poll_tick);
+        result = result || (NULL == i2c_poll_timer);
+
+        // Clear mutexes and signals on failure.
+        for (int index = 0; ((index < i2c_instances_max()) && (result));
+             index++)
+        {
+            if (NULL != i2c_master[index].mutex_id)
+            {
+                vQueueDelete(i2c_master[index].mutex_id);
+                i2c_master[index].mutex_id = NULL;
+            }
+
+            if (NULL != i2c_master[index].signal_id)
+            {
+                vQueueDelete(i2c_master[index].signal_id);
+                i2c_master[index].signal_id = NULL;
+            }
+
+        }
+    }
+
+    if (result)
+    {
+        DBGI2C("\nbsp_i2c_init failed.");
+    }
+
+    b_i2c_init_flag = !result;
+
+    return result;
+}
+
+
+int bsp_i2c_transfer
+    (int instance, bsp_i2c_transfer_t *p_trx, int trx_len)
+{
+    int result = !((0 < trx_len) &&
+                (NULL != p_trx) &&
+                (0 < instance) &&
+                (i2c_instances_max() > (instance - 1)));
+    uint32_t start_cyc = i2c_cycles_now();
+
+    rtos_mode_flag = (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState());
+
+    if (!result)
+    {
+        // Normalize instance (index).
+        instance = instance - 1;
+
+        i2c_lock(instance);
+
+        if (rtos_mode_flag)
+        {
+            result = i2c_transfer_sync(instance, p_trx, trx_len, start_cyc);
+        }
+        else
+        {
+            i2c_stats_wait(instance, p_trx, i2c_cycles_now() - start_cyc);
+
+            for (int index = 0; ((index < trx_len) && (0 == result)); index++)
+            {
+                if (NULL != p_trx[index].prepare)
+                {
+                    p_trx[index].prepare(p_trx);
+                }
+
+                result = i2c_transfer_single(instance, &p_trx[index]);
+            }
+        }
+
+        i2c_unlock(instance);
+    }
+
+    if (result)
+    {
+        DBGI2C("\nbsp_i2c_transfer failed.");
+    }
+
+    if (dbg_i2c_error)
+    {
+        DBGI2C("\ni2c_error: %d.", dbg_i2c_error);
+    }
+
+    return result;
+}
+
+
+int bsp_i2c_transfer_async(int instance, bsp_i2c_job_t *p_job)
+{
+    int result = !((NULL != p_job) &&
+                   (NULL != p_job->p_trx) &&
+                   (0 < p_job->trx_len) &&
+                   (0 < instance) &&
+                   (i2c_instances_max() > (instance - 1)));
+
+    if (!result)
+    {
+        p_job->queued_cyc = i2c_cycles_now();
+        i2c_job_queue(instance - 1, p_job);
+        i2c_poll_arm();
+    }
+    else
+    {
+        DBGI2C("\nbsp_i2c_transfer_async failed.");
+    }
+
+    return result;
+}
+
+
+void bsp_i2c_async_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    for (int index = 0; index < i2c_instances_max(); index++)
+    {
+        i2c_master_t *p_master = &i2c_master[index];
+
+        uint32_t primask = i2c_irq_lock();
+        bool expired = p_master->busy &&
+            ((TickType_t)(now - p_master->trx_tick) > p_master->trx_timeout) &&
+            i2c_trx_claim(p_master);
+        if (expired)
+        {
+            // Completion ISR can not advance the job any more, the transfer
+            // is stopped before it is failed from here.
+            i2c_trx_abort(index);
+        }
+        i2c_irq_unlock(primask);
+
+        if (expired)
+        {
+            DBGI2C("\ni2c async timeout.");
+            i2c_job_next(index, BSP_I2C_RESULT_TIMEOUT);
+        }
+    }
+}
+
+
+void *bsp_i2c_handle_get(int instance)
+{
+    void *p_result = NULL;
+    if ((0 < instance) && (i2c_instances_max() > (instance - 1)))
+    {
+        instance = instance - 1;
+        p_result = &i2c_master[instance].handle;
+    }
+
+    return p_result;
+}
+
+
+void bsp_i2c_reset(int instance)
+{
+    if ((0 < instance) && (i2c_instances_max() > (instance - 1)))
+    {
+        i2c_reset(instance - 1);
+    }
+}
+
+
+int bsp_i2c_stats_get(int instance, bsp_i2c_stats_t *p_stats)
+{
+    int result = !((NULL != p_stats) &&
+                   (0 < instance) &&
+                   (i2c_instances_max() > (instance - 1)));
+
+    if (!result)
+    {
+        uint32_t primask = i2c_irq_lock();
+        *p_stats = i2c_master[instance - 1].stats;
+        i2c_irq_unlock(primask);
+    }
+
+    return result;
+}
+
+
+int bsp_i2c_dev_stats_get(int instance, int slot, uint8_t *p_address,
+                          bsp_i2c_dev_stats_t *p_stats)
+{
+    int result = !((NULL != p_stats) &&
+                   (NULL != p_address) &&
+                   (0 < instance) &&
+                   (i2c_instances_max() > (instance - 1)) &&
+                   (0 <= slot));
+
+    if (!result)
+    {
+        i2c_master_t *p_master = &i2c_master[instance - 1];
+
+        uint32_t primask = i2c_irq_lock();
+        result = (p_master->dev_cnt <= slot);
+        if (!result)
+        {
+            *p_address = p_master->dev_address[slot];
+            *p_stats = p_master->dev_stats[slot];
+        }
+        i2c_irq_unlock(primask);
+    }
+
+    return result;
+}
+
+
+void bsp_i2c_stats_reset(int instance)
+{
+    if ((0 < instance) && (i2c_instances_max() > (instance - 1)))
+    {
+        i2c_master_t *p_master = &i2c_master[instance - 1];
+
+        uint32_t primask = i2c_irq_lock();
+        memset(&p_master->stats, 0, sizeof(p_master->stats));
+        memset(p_master->dev_stats, 0, sizeof(p_master->dev_stats));
+        p_master->dev_cnt = 0;
+        i2c_irq_unlock(primask);
+    }
+}
+
+
+void bsp_i2c_stats_dump(void)
+{
+    bsp_i2c_stats_t stats;
+    bsp_i2c_dev_stats_t dev_stats;
+    uint8_t address;
+
+    for (int instance = 1; instance <= i2c_instances_max(); instance++)
+    {
+        if (0 == bsp_i2c_stats_get(instance, &stats))
+        {
+            dprintf("\nI2C%d resets %lu", instance,
+                    (unsigned long)stats.resets);
+            i2c_stats_print("I2C", instance, &stats.total);
+        }
+
+        for (int slot = 0;
+             0 == bsp_i2c_dev_stats_get(instance, slot, &address, &dev_stats);
+             slot++)
+        {
+            i2c_stats_print(" dev", address, &dev_stats);
+        }
+    }
+}
+
+
+void bsp_i2c_clock_update(uint32_t old_hz, uint32_t new_hz)
+{
+    for (int instance = 0; instance < i2c_instances_max(); instance++)
+    {
+        i2c_master_t *p_master = &i2c_master[instance];
+        I2C_HandleTypeDef *p_handle = &p_master->handle;
+
+        if ((NULL != p_handle->Instance) && (old_hz != new_hz))
+        {
+            if (0u == p_master->timing_ref_hz)
+            {
+                p_master->timing_ref = p_handle->Init.Timing;
+                p_master->timing_ref_hz = old_hz;
+            }
+
+            // Scaled from configured value so rounding does not accumulate.
+            // Kept in handle as well, HAL_I2C_Init may run again.
+            p_handle->Init.Timing = i2c_timing_scale(p_master->timing_ref,
+                                                     p_master->timing_ref_hz,
+                                                     new_hz);
+
+            // TIMINGR is written only while peripheral is disabled.
+            __HAL_I2C_DISABLE(p_handle);
+            p_handle->Instance->TIMINGR = p_handle->Init.Timing;
+            __HAL_I2C_ENABLE(p_handle);
+        }
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static int i2c_transfer_single(int instance, bsp_i2c_transfer_t *p_trx)
+{
+    I2C_HandleTypeDef *p_handle = &i2c_master[instance].handle;
+    uint32_t start_cyc = i2c_cycles_now();
+    int result = 0;
+
+    uint8_t timeout = p_trx->timeout;
+    if (0 == timeout)
+    {
+        timeout = BSP_I2C_DEFAULT_TIMEOUT_MS;
+    }
+
+
+    if (BSP_I2C_READ_FLAG & p_trx->address)
+    {
+        uint8_t address = (p_trx->address & (~BSP_I2C_READ_FLAG));
+        if (BSP_I2C_MODE_NORMAL == p_trx->mode)
+        {
+            result = (HAL_OK != HAL_I2C_Master_Receive(p_handle,
+                                                       address,
+                                                       p_trx->data,
+                                                       p_trx->length,
+                                                       timeout));
+        }
+        else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
+        {
+            result = (HAL_OK != HAL_I2C_Mem_Read(p_handle, address,
+                                                 p_trx->mem_addr,
+                                                 p_trx->mem_addr_len,
+                                                 p_trx->data,
+                                                 p_trx->length,
+                                                 timeout));
+        }
+        else
+        {
+            bsp_i2c_assert(__FILE__, __LINE__);
+        }
+    }
+    else
+    {
+        uint8_t address = p_trx->address;
+        if (BSP_I2C_MODE_NORMAL == p_trx->mode)
+        {
+            result = (HAL_OK != HAL_I2C_Master_Transmit(p_handle,
+                                                        address,
+                                                        p_trx->data,
+                                                        p_trx->length,
+                                                        timeout));
+        }
+        else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
+        {
+            result = (HAL_OK != HAL_I2C_Mem_Write(p_handle, address,
+                                                  p_trx->mem_addr,
+                                                  p_trx->mem_addr_len,
+                                                  p_trx->data,
+                                                  p_trx->length,
+                                                  timeout));
+        }
+        else
+        {
+            bsp_i2c_assert(__FILE__, __LINE__);
+        }
+    }
+
+    if (result)
+    {
+        result = (HAL_I2C_ERROR_TIMEOUT & HAL_I2C_GetError(p_handle)) ?
+                 BSP_I2C_RESULT_TIMEOUT :
+                 (HAL_I2C_ERROR_AF & HAL_I2C_GetError(p_handle)) ?
+                 BSP_I2C_RESULT_NACK : BSP_I2C_RESULT_ERROR;
+    }
+
+    i2c_stats_trx(instance, p_trx, i2c_cycles_now() - start_cyc, result);
+
+    if (result)
+    {
+        DBGI2C("\nbsp_i2c_transfer_single failed.");
+        i2c_reset(instance);
+    }
+
+
+    return result;
+}
+
+
+static int i2c_transfer_sync(int instance, bsp_i2c_transfer_t *p_trx,
+                             int trx_len, uint32_t start_cyc)
+{
+    bsp_i2c_job_t job = {
+        .p_trx = p_trx,
+        .trx_len = trx_len,
+        .done = i2c_sync_done,
+        .p_ctx = &i2c_master[instance],
+        .queued_cyc = start_cyc,
+    };
+    uint32_t timeout = 0;
+    int result;
+
+    // Whole chain has to finish within sum of transfer timeouts.
+    for (int index = 0; index < trx_len; index++)
+    {
+        timeout += (0 == p_trx[index].timeout) ? BSP_I2C_DEFAULT_TIMEOUT_MS :
+                                                 p_trx[index].timeout;
+    }
+
+    i2c_signal_clear(instance);
+    i2c_job_queue(instance, &job);
+
+    result = i2c_signal_wait(instance, timeout);
+
+    if (result)
+    {
+        // Job lives on this stack, it must not stay queued.
+        i2c_job_cancel(instance, &job);
+    }
+    else
+    {
+        result = i2c_master[instance].sync_result;
+    }
+
+    return result;
+}
+
+
+static void i2c_sync_done(int result, void *p_ctx)
+{
+    i2c_master_t *p_master = (i2c_master_t *)p_ctx;
+
+    p_master->sync_result = result;
+    i2c_signal_send_isr(p_master - i2c_master);
+}
+
+
+static int i2c_trx_start(int instance, bsp_i2c_transfer_t *p_trx)
+{
+    i2c_master_t *p_master = &i2c_master[instance];
+    I2C_HandleTypeDef *p_handle = &p_master->handle;
+    bool use_dma = p_master->use_dma && (I2C_DMA_MIN_LEN <= p_trx->length);
+    HAL_StatusTypeDef status = HAL_ERROR;
+
+    uint8_t timeout = p_trx->timeout;
+    if (0 == timeout)
+    {
+        timeout = BSP_I2C_DEFAULT_TIMEOUT_MS;
+    }
+
+    p_master->trx_tick = xTaskGetTickCountFromISR();
+    p_master->trx_timeout = (timeout / portTICK_PERIOD_MS) + 1u;
+    p_master->trx_cyc = i2c_cycles_now();
+    // Before HAL call, transfer may end in ISR before it returns.
+    p_master->trx_gen++;
+
+    if (BSP_I2C_READ_FLAG & p_trx->address)
+    {
+        uint8_t address = (p_trx->address & (~BSP_I2C_READ_FLAG));
+        if (BSP_I2C_MODE_NORMAL == p_trx->mode)
+        {
+            status = use_dma ?
+                HAL_I2C_Master_Receive_DMA(p_handle, address, p_trx->data,
+                                           p_trx->length) :
+                HAL_I2C_Master_Receive_IT(p_handle, address, p_trx->data,
+                                          p_trx->length);
+        }
+        else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
+        {
+            status = use_dma ?
+                HAL_I2C_Mem_Read_DMA(p_handle, address, p_trx->mem_addr,
+                                     p_trx->mem_addr_len, p_trx->data,
+                                     p_trx->length) :
+                HAL_I2C_Mem_Read_IT(p_handle, address, p_trx->mem_addr,
+                                    p_trx->mem_addr_len, p_trx->data,
+                                    p_trx->length);
+        }
+        else if ((BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME <= p_trx->mode) &&
+                 (BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME >= p_trx->mode))
+        {
+            // HAL has no DMA variant of sequential transfers.
+            uint32_t sequence = i2c_sequence_translate(p_trx->mode);
+            status = HAL_I2C_Master_Sequential_Receive_IT(p_handle,
+                                                          address,
+                                                          p_trx->data,
+                                                          p_trx->length,
+                                                          sequence);
+        }
+        else
+        {
+            bsp_i2c_assert(__FILE__, __LINE__);
+        }
+    }
+    else
+    {
+        uint8_t address = p_trx->address;
+        if (BSP_I2C_MODE_NORMAL == p_trx->mode)
+        {
+            status = use_dma ?
+                HAL_I2C_Master_Transmit_DMA(p_handle, address, p_trx->data,
+                                            p_trx->length) :
+                HAL_I2C_Master_Transmit_IT(p_handle, address, p_trx->data,
+                                           p_trx->length);
+        }
+        else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
+        {
+            status = use_dma ?
+                HAL_I2C_Mem_Write_DMA(p_handle, address, p_trx->mem_addr,
+                                      p_trx->mem_addr_len, p_trx->data,
+                                      p_trx->length) :
+                HAL_I2C_Mem_Write_IT(p_handle, address, p_trx->mem_addr,
+                                     p_trx->mem_addr_len, p_trx->data,
+                                     p_trx->length);
+        }
+        else if ((BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME <= p_trx->mode) &&
+                 (BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME >= p_trx->mode))
+        {
+            uint32_t sequence = i2c_sequence_translate(p_trx->mode);
+            status = HAL_I2C_Master_Sequential_Transmit_IT(p_handle,
+                                                           address,
+                                                           p_trx->data,
+                                                           p_trx->length,
+                                                           sequence);
+        }
+        else
+        {
+            bsp_i2c_assert(__FILE__, __LINE__);
+        }
+    }
+
+    if (HAL_OK != status)
+    {
+        p_master->trx_end_gen = p_master->trx_gen;
+    }
+
+    return (HAL_OK != status);
+}
+
+
+static void i2c_job_queue(int instance, bsp_i2c_job_t *p_job)
+{
+    i2c_master_t *p_master = &i2c_master[instance];
+    bool start;
+
+    p_job->p_next = NULL;
+
+    uint32_t primask = i2c_irq_lock();
+
+    if (NULL == p_master->p_tail)
+    {
+        p_master->p_head = p_job;
+    }
+    else
+    {
+        p_master->p_tail->p_next = p_job;
+    }
+    p_master->p_tail = p_job;
+
+    start = !p_master->busy;
+    if (start)
+    {
+        p_master->busy = true;
+        p_master->trx_index = -1;
+        p_master->trx_tick = xTaskGetTickCountFromISR();
+        bsp_lowpower_stop_veto(BSP_LOWPOWER_I2C1 + instance, true);
+    }
+
+    i2c_irq_unlock(primask);
+
+    if (start)
+    {
+        i2c_job_next(instance, 0);
+    }
+}
+
+
+static void i2c_job_next(int instance, int result)
+{
+    i2c_master_t *p_master = &i2c_master[instance];
+    bsp_i2c_job_t *p_job = p_master->p_head;
+
+    if ((NULL != p_job) && (0 <= p_master->trx_index))
+    {
+        // Transfer started earlier has ended.
+        i2c_stats_trx(instance, &p_job->p_trx[p_master->trx_index],
+                      i2c_cycles_now() - p_master->trx_cyc, result);
+    }
+
+    while (NULL != p_job)
+    {
+        if (!result)
+        {
+            p_master->trx_index++;
+        }
+
+        if ((!result) && (p_master->trx_index < p_job->trx_len))
+        {
+            bsp_i2c_transfer_t *p_trx = &p_job->p_trx[p_master->trx_index];
+
+            if (0 == p_master->trx_index)
+            {
+                i2c_stats_wait(instance, p_trx,
+                               i2c_cycles_now() - p_job->queued_cyc);
+            }
+
+            if (NULL != p_trx->prepare)
+            {
+                p_trx->prepare(p_job->p_trx);
+            }
+
+            result = i2c_trx_start(instance, p_trx);
+            if (!result)
+            {
+                // Running, continued from transfer end callback.
+                break;
+            }
+
+            result = BSP_I2C_RESULT_ERROR;
+            i2c_stats_trx(instance, p_trx, 0, result);
+        }
+        else
+        {
+            if (result)
+            {
+                DBGI2C("\ni2c job failed.");
+                i2c_reset(instance);
+            }
+
+            uint32_t primask = i2c_irq_lock();
+
+            p_master->p_head = p_job->p_next;
+            if (NULL == p_master->p_head)
+            {
+                p_master->p_tail = NULL;
+                p_master->busy = false;
+                bsp_lowpower_stop_veto(BSP_LOWPOWER_I2C1 + instance, false);
+            }
+            p_master->trx_index = -1;
+
+            bsp_i2c_job_t *p_done = p_job;
+            p_job = p_master->p_head;
+
+            i2c_irq_unlock(primask);
+
+            // Queue is released, callback may queue new job.
+            if (NULL != p_done->done)
+            {
+                p_done->done(result, p_done->p_ctx);
+            }
+
+            result = 0;
+        }
+    }
+}
+
+
+static void i2c_job_cancel(int instance, bsp_i2c_job_t *p_job)
 {
-    static int result = 1u;
+    i2c_master_t *p_master = &i2c_master[instance];
+    bool running;
+    bool claimed = false;
 
-    if (result)
-    {
-        result = 0;
+    uint32_t primask = i2c_irq_lock();
 
-        // CubeMX init inside.
-        hal_i2c1_mx_init(&i2c_master[0]);
-        hal_i2c2_mx_init(&i2c_master[1]);
-        hal_i2c3_mx_init(&i2c_master[2]);
+    running = p_master->busy && (p_master->p_head == p_job);
+    if (running)
+    {
+        claimed = i2c_trx_claim(p_master);
+        if (claimed)
+        {
+            i2c_trx_abort(instance);
+        }
+    }
+    else
+    {
+        bsp_i2c_job_t *p_prev = NULL;
+        bsp_i2c_job_t *p_iter = p_master->p_head;
 
-        // Create mutexes and signals.
-        for (int index = 0; index < i2c_instances_max(); index++)
+        while ((NULL != p_iter) && (p_iter != p_job))
         {
-            i2c_master[index].mutex_id = xSemaphoreCreateMutex();
-            result = result || (NULL == i2c_master[index].mutex_id);
-            i2c_master[index].signal_id = xSemaphoreCreateBinary();
-            result = result || (NULL == i2c_master[index].signal_id);
+            p_prev = p_iter;
+            p_iter = p_iter->p_next;
         }
 
-        // Clear mutexes and signals on failure.
-        for (int index = 0; ((index < i2c_instances_max()) && (result));
-             index++)
+        if (NULL != p_iter)
         {
-            if (NULL != i2c_master[index].mutex_id)
+            if (NULL == p_prev)
             {
-                vQueueDelete(i2c_master[index].mutex_id);
-                i2c_master[index].mutex_id = NULL;
+                p_master->p_head = p_iter->p_next;
             }
-
-            if (NULL != i2c_master[index].signal_id)
+            else
             {
-                vQueueDelete(i2c_master[index].signal_id);
-                i2c_master[index].signal_id = NULL;
+                p_prev->p_next = p_iter->p_next;
             }
 
+            if (p_master->p_tail == p_iter)
+            {
+                p_master->p_tail = p_prev;
+            }
         }
     }
 
-    if (result)
+    i2c_irq_unlock(primask);
+
+    if (claimed)
     {
-        DBGI2C("\nbsp_i2c_init failed.");
+        i2c_job_next(instance, BSP_I2C_RESULT_TIMEOUT);
     }
-
-    b_i2c_init_flag = !result;
-
-    return result;
 }
 
 
-int bsp_i2c_transfer
-    (int instance, bsp_i2c_transfer_t *p_trx, int trx_len)
+static void i2c_poll_arm(void)
 {
-    int result = !((0 < trx_len) &&
-                (NULL != p_trx) &&
-                (0 < instance) &&
-                (i2c_instances_max() > (instance - 1)));
-
-    rtos_mode_flag = (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState());
+    bool arm;
 
-    if (!result)
+    if (NULL == i2c_poll_timer)
     {
-        // Normalize instance (index).
-        instance = instance - 1;
+        return;
+    }
 
-        i2c_lock(instance);
+    uint32_t primask = i2c_irq_lock();
+    arm = !i2c_poll_armed;
+    i2c_poll_armed = true;
+    i2c_irq_unlock(primask);
 
-        for (int index = 0; ((index < trx_len) && (0 == result)); index++)
+    if (arm)
+    {
+        if (0u != __get_IPSR())
         {
-            if (NULL != p_trx[index].prepare)
-            {
-                p_trx[index].prepare(p_trx);
-            }
-
-            result = i2c_transfer_single(instance, &p_trx[index]);
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+            xTimerStartFromISR(i2c_poll_timer, &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
         }
+        else
+        {
+            xTimerStart(i2c_poll_timer, 0);
+        }
+    }
+}
 
-        i2c_unlock(instance);
+
+static void i2c_poll_tick(TimerHandle_t timer)
+{
+    bool busy = false;
+
+    bsp_i2c_async_poll();
+
+    // Cleared under the same lock jobs are queued under, a job queued after
+    // this sees the timer disarmed and arms it again.
+    uint32_t primask = i2c_irq_lock();
+    for (int index = 0; index < i2c_instances_max(); index++)
+    {
+        busy = busy || i2c_master[index].busy;
     }
+    i2c_poll_armed = busy;
+    i2c_irq_unlock(primask);
 
-    if (result)
+    if (busy)
     {
-        DBGI2C("\nbsp_i2c_transfer failed.");
+        xTimerStart(timer, 0);
     }
+}
 
-    if (dbg_i2c_error)
+
+static bool i2c_trx_claim(i2c_master_t *p_master)
+{
+    bool result = p_master->busy &&
+                  (p_master->trx_gen != p_master->trx_end_gen);
+
+    if (result)
     {
-        DBGI2C("\ni2c_error: %d.", dbg_i2c_error);
+        p_master->trx_end_gen = p_master->trx_gen;
     }
 
     return result;
 }
 
 
-void *bsp_i2c_handle_get(int instance)
+static void i2c_trx_abort(int instance)
 {
-    void *p_result = NULL;
-    if ((0 < instance) && (i2c_instances_max() > (instance - 1)))
+    i2c_master_t *p_master = &i2c_master[instance];
+    I2C_HandleTypeDef *p_handle = &p_master->handle;
+
+    if (p_master->use_dma)
     {
-        instance = instance - 1;
-        p_result = &i2c_master[instance].handle;
+        // Channel of failed transfer may still be enabled.
+        HAL_DMA_Abort(&p_master->hdma_tx);
+        HAL_DMA_Abort(&p_master->hdma_rx);
     }
 
-    return p_result;
+    // Cleared PE resets event flags, disabled sources keep them from firing
+    // once PE is set again without a transfer.
+    __HAL_I2C_DISABLE(p_handle);
+    __HAL_I2C_DISABLE_IT(p_handle, I2C_IT_ERRI | I2C_IT_TCI | I2C_IT_STOPI |
+                                   I2C_IT_NACKI | I2C_IT_ADDRI | I2C_IT_RXI |
+                                   I2C_IT_TXI);
+    CLEAR_BIT(p_handle->Instance->CR1, I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN);
+    p_handle->XferISR = NULL;
+    p_handle->State = (volatile HAL_I2C_StateTypeDef)HAL_I2C_STATE_READY;
 }
 
 
-void bsp_i2c_reset(int instance)
+static void i2c_cycles_init(void)
 {
-    if ((0 < instance) && (i2c_instances_max() > (instance - 1)))
-    {
-        i2c_reset(instance);
-    }
+    CYCLES_INIT();
 }
 
-//--------------------------- PRIVATE FUNCTIONS -------------------------------
 
-static int i2c_transfer_single(int instance, bsp_i2c_transfer_t *p_trx)
+static uint32_t i2c_cycles_now(void)
 {
-    I2C_HandleTypeDef *p_handle = &i2c_master[instance].handle;
-    int result = 0;
+    return CYCLES();
+}
 
-    i2c_signal_clear(instance);
 
-    uint8_t timeout = p_trx->timeout;
-    if (0 == timeout)
-    {
-        timeout = BSP_I2C_DEFAULT_TIMEOUT_MS;
-    }
+static bsp_i2c_dev_stats_t *i2c_stats_dev(int instance, uint8_t address)
+{
+    i2c_master_t *p_master = &i2c_master[instance];
+    int slot;
 
+    address = address >> 1;
 
-    if (BSP_I2C_READ_FLAG & p_trx->address)
+    for (slot = 0; slot < p_master->dev_cnt; slot++)
     {
-        uint8_t address = (p_trx->address & (~BSP_I2C_READ_FLAG));
-        if (rtos_mode_flag)
+        if (p_master->dev_address[slot] == address)
         {
-            if (BSP_I2C_MODE_NORMAL == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Master_Receive_IT(p_handle,
-                                                              address,
-                                                              p_trx->data,
-                                                              p_trx->length));
-            }
-            else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Mem_Read_IT(p_handle, address,
-                                                        p_trx->mem_addr,
-                                                        p_trx->mem_addr_len,
-                                                        p_trx->data,
-                                                        p_trx->length));
+            break;
+        }
+    }
 
-            }
-            else if ((BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME <= p_trx->mode) &&
-                     (BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME >= p_trx->mode))
-            {
-                uint32_t sequence = i2c_sequence_translate(p_trx->mode);
-                result = (HAL_OK !=
-                          HAL_I2C_Master_Sequential_Receive_IT(p_handle,
-                                                               address,
-                                                               p_trx->data,
-                                                               p_trx->length,
-                                                               sequence));
-            }
-            else
-            {
-                bsp_i2c_assert(__FILE__, __LINE__);
-            }
+    if (slot == p_master->dev_cnt)
+    {
+        if ((int)(BSP_I2C_STATS_DEV_MAX - 1u) <= slot)
+        {
+            // Last slot collects all devices which did not fit.
+            slot = BSP_I2C_STATS_DEV_MAX - 1u;
+            address = BSP_I2C_STATS_DEV_OTHER;
+            p_master->dev_cnt = BSP_I2C_STATS_DEV_MAX;
         }
         else
         {
-            if (BSP_I2C_MODE_NORMAL == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Master_Receive(p_handle,
-                                                              address,
-                                                              p_trx->data,
-                                                              p_trx->length,
-                                                              timeout));
-            }
-            else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Mem_Read(p_handle, address,
-                                                        p_trx->mem_addr,
-                                                        p_trx->mem_addr_len,
-                                                        p_trx->data,
-                                                        p_trx->length,
-                                                        timeout));
-            }
-            else
-            {
-                bsp_i2c_assert(__FILE__, __LINE__);
-            }
+            p_master->dev_cnt++;
         }
+        p_master->dev_address[slot] = address;
     }
-    else
+
+    return &p_master->dev_stats[slot];
+}
+
+
+static void i2c_stats_hist_add(uint32_t *p_hist, uint32_t *p_max,
+                               uint32_t cycles)
+{
+    uint32_t us = cycles / (SystemCoreClock / 1000000u);
+    uint32_t bin = 0;
+
+    while (((BSP_I2C_HIST_BINS - 1u) > bin) &&
+           ((BSP_I2C_HIST_BIN0_US << bin) <= us))
     {
-        uint8_t address = p_trx->address;
-        if (rtos_mode_flag)
+        bin++;
+    }
+
+    p_hist[bin]++;
+    if (*p_max < us)
+    {
+        *p_max = us;
+    }
+}
+
+
+static void i2c_stats_wait(int instance, const bsp_i2c_transfer_t *p_trx,
+                           uint32_t cycles)
+{
+    bsp_i2c_stats_t *p_stats = &i2c_master[instance].stats;
+
+    uint32_t primask = i2c_irq_lock();
+
+    bsp_i2c_dev_stats_t *p_dev = i2c_stats_dev(instance, p_trx->address);
+    i2c_stats_hist_add(p_dev->lock_wait_hist, &p_dev->lock_wait_max_us,
+                       cycles);
+    i2c_stats_hist_add(p_stats->total.lock_wait_hist,
+                       &p_stats->total.lock_wait_max_us, cycles);
+
+    i2c_irq_unlock(primask);
+}
+
+
+static void i2c_stats_trx(int instance, const bsp_i2c_transfer_t *p_trx,
+                          uint32_t cycles, int result)
+{
+    bsp_i2c_stats_t *p_stats = &i2c_master[instance].stats;
+
+    uint32_t primask = i2c_irq_lock();
+
+    bsp_i2c_dev_stats_t *p_record[] = {
+        i2c_stats_dev(instance, p_trx->address),
+        &p_stats->total
+    };
+
+    for (int index = 0; index < 2; index++)
+    {
+        bsp_i2c_dev_stats_t *p_dev = p_record[index];
+
+        p_dev->transfers++;
+        if (result)
         {
-            if (BSP_I2C_MODE_NORMAL == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Master_Transmit_IT(p_handle,
-                                                               address,
-                                                               p_trx->data,
-                                                               p_trx->length));
-            }
-            else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Mem_Write_IT(p_handle, address,
-                                                         p_trx->mem_addr,
-                                                         p_trx->mem_addr_len,
-                                                         p_trx->data,
-                                                         p_trx->length));
-            }
-            else if ((BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME <= p_trx->mode) &&
-                     (BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME >= p_trx->mode))
-            {
-                uint32_t sequence = i2c_sequence_translate(p_trx->mode);
-                result = (HAL_OK !=
-                          HAL_I2C_Master_Sequential_Transmit_IT(p_handle,
-                                                                address,
-                                                                p_trx->data,
-                                                                p_trx->length,
-                                                                sequence));
-            }
-            else
-            {
-                bsp_i2c_assert(__FILE__, __LINE__);
-            }
+            p_dev->errors++;
+            p_dev->nacks += (BSP_I2C_RESULT_NACK == result);
+            p_dev->timeouts += (BSP_I2C_RESULT_TIMEOUT == result);
         }
         else
         {
-            if (BSP_I2C_MODE_NORMAL == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Master_Transmit(p_handle,
-                                                            address,
-                                                            p_trx->data,
-                                                            p_trx->length,
-                                                            timeout));
-            }
-            else if (BSP_I2C_MODE_MEMORY == p_trx->mode)
-            {
-                result = (HAL_OK != HAL_I2C_Mem_Write(p_handle, address,
-                                                      p_trx->mem_addr,
-                                                      p_trx->mem_addr_len,
-                                                      p_trx->data,
-                                                      p_trx->length,
-                                                      timeout));
-            }
-            else
-            {
-                bsp_i2c_assert(__FILE__, __LINE__);
-            }
+            p_dev->bytes += p_trx->length;
         }
+        i2c_stats_hist_add(p_dev->wire_hist, &p_dev->wire_max_us, cycles);
     }
 
-    if (!result)
+    i2c_irq_unlock(primask);
+}
+
+
+static void i2c_stats_print(const char *p_title, int id,
+                            const bsp_i2c_dev_stats_t *p_stats)
+{
+    dprintf("\n%s 0x%02x trx %lu bytes %lu err %lu nack %lu tmo %lu",
+            p_title, id, (unsigned long)p_stats->transfers,
+            (unsigned long)p_stats->bytes, (unsigned long)p_stats->errors,
+            (unsigned long)p_stats->nacks, (unsigned long)p_stats->timeouts);
+
+    dprintf("\n  wait max %luus:", (unsigned long)p_stats->lock_wait_max_us);
+    for (uint32_t bin = 0; bin < BSP_I2C_HIST_BINS; bin++)
     {
-        result = i2c_signal_wait(instance, timeout);
+        dprintf(" %lu", (unsigned long)p_stats->lock_wait_hist[bin]);
     }
 
-    if (result)
+    dprintf("\n  wire max %luus:", (unsigned long)p_stats->wire_max_us);
+    for (uint32_t bin = 0; bin < BSP_I2C_HIST_BINS; bin++)
     {
-        DBGI2C("\nbsp_i2c_transfer_single failed.");
-        i2c_reset(instance);
+        dprintf(" %lu", (unsigned long)p_stats->wire_hist[bin]);
     }
+}
 
 
-    return result;
+static uint32_t i2c_irq_lock(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    return primask;
+}
+
+
+static void i2c_irq_unlock(uint32_t primask)
+{
+    __set_PRIMASK(primask);
 }
 
 
@@ -446,7 +1356,7 @@ static int i2c_signal_clear(int instance)
 }
 
 
-static int i2c_signal_wait(int instance, uint8_t timeout)
+static int i2c_signal_wait(int instance, uint32_t timeout)
 {
     int result = 0;
 
@@ -473,7 +1383,7 @@ static int i2c_signal_send_isr (int instance)
 {
     int result = 0;
 
-    if (rtos_mode_flag)
+    if ((rtos_mode_flag) && (0u != __get_IPSR()))
     {
         BaseType_t xHigherPriorityTaskWoken = pdFALSE;
         result = (pdPASS !=
@@ -481,6 +1391,10 @@ static int i2c_signal_send_isr (int instance)
                                         &xHigherPriorityTaskWoken));
         portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
     }
+    else if (rtos_mode_flag)
+    {
+        result = (pdPASS != xSemaphoreGive(i2c_master[instance].signal_id));
+    }
 
     return result;
 }
@@ -490,19 +1404,15 @@ static int i2c_reset (int instance)
 {
     I2C_HandleTypeDef *p_handle = &i2c_master[instance].handle;
 
-    if (p_handle)
-    {
-        dprint("X1-");
-        __HAL_I2C_DISABLE(p_handle);
-        dprint("X2-");
-        DBGI2C("\ni2c reset");
-        dprint("X3-");
-        // Reinit i2c instance here if simply reset is not enough.
-        p_handle->State = (volatile HAL_I2C_StateTypeDef)HAL_I2C_STATE_READY;
-        dprint("X4-");
-        __HAL_I2C_ENABLE(p_handle);
-        dprint("X5-");
-    }
+    // Runs from ISR as well, no debug output here.
+    uint32_t primask = i2c_irq_lock();
+
+    i2c_master[instance].stats.resets++;
+    i2c_trx_abort(instance);
+    // Reinit i2c instance here if simply reset is not enough.
+    __HAL_I2C_ENABLE(p_handle);
+
+    i2c_irq_unlock(primask);
 
     return 0;
 }
@@ -578,6 +1488,59 @@ static int i2c_sequence_translate(bsp_i2c_mode_t sequence)
 }
 
 
+static uint32_t i2c_timing_scale(uint32_t timing, uint32_t old_hz,
+                                 uint32_t new_hz)
+{
+    uint32_t presc = ((timing >> 28) & 0xFu) + 1u;
+    // Phase lengths in kernel clocks: SCLL, SCLH, SDADEL, SCLDEL.
+    const uint32_t max[4] = { 256u, 256u, 15u, 16u };
+    uint32_t len[4] = {
+        (((timing >> 0) & 0xFFu) + 1u) * presc,
+        (((timing >> 8) & 0xFFu) + 1u) * presc,
+        ((timing >> 16) & 0xFu) * presc,
+        (((timing >> 20) & 0xFu) + 1u) * presc,
+    };
+    uint32_t cnt[4];
+
+    for (uint32_t index = 0; index < 4u; index++)
+    {
+        len[index] = (uint32_t)((((uint64_t)len[index] * new_hz) +
+                                 old_hz - 1u) / old_hz);
+    }
+
+    // Finest prescaler all phases fit with, saturated at the coarsest.
+    for (presc = 1u; ; presc++)
+    {
+        bool fits = true;
+
+        for (uint32_t index = 0; index < 4u; index++)
+        {
+            cnt[index] = (len[index] + presc - 1u) / presc;
+            fits = fits && (cnt[index] <= max[index]);
+        }
+
+        if (fits || (16u == presc))
+        {
+            break;
+        }
+    }
+
+    for (uint32_t index = 0; index < 4u; index++)
+    {
+        if (cnt[index] > max[index])
+        {
+            cnt[index] = max[index];
+        }
+    }
+
+    return ((presc - 1u) << 28) |
+           ((((0u < cnt[3]) ? cnt[3] : 1u) - 1u) << 20) |
+           (cnt[2] << 16) |
+           ((((0u < cnt[1]) ? cnt[1] : 1u) - 1u) << 8) |
+           (((0u < cnt[0]) ? cnt[0] : 1u) - 1u);
+}
+
+
 static void bsp_i2c_assert(const char *p_file, int line)
 {
     dprintf("\nI2C setup error in file %s, line %d.", p_file, line);
@@ -624,6 +1587,9 @@ static void hal_i2c1_mx_init(i2c_master_t *master)
     {
         hal_i2c_init_error(p_handle->Instance);
     }
+
+    hal_i2c_dma_init(master, DMA1_Channel6, DMA1_Channel6_IRQn,
+                     DMA1_Channel7, DMA1_Channel7_IRQn);
 }
 
 
@@ -661,9 +1627,13 @@ static void hal_i2c2_mx_init(i2c_master_t *master)
     {
         hal_i2c_init_error(p_handle->Instance);
     }
+
+    hal_i2c_dma_init(master, DMA1_Channel4, DMA1_Channel4_IRQn,
+                     DMA1_Channel5, DMA1_Channel5_IRQn);
 }
 
-// CubeMX i2c init for ACC.
+// CubeMX i2c init for ACC. I2C3 DMA channels (DMA1 CH2/CH3) are taken by
+// USART3, transfers stay interrupt driven.
 static void hal_i2c3_mx_init(i2c_master_t *master)
 {
     I2C_HandleTypeDef *p_handle = &master->handle;
@@ -703,7 +1673,49 @@ static void hal_i2c3_mx_init(i2c_master_t *master)
 }
 
 
-static void i2c_transfer_complete (I2C_HandleTypeDef *hi2c)
+static void hal_i2c_dma_init(i2c_master_t *master,
+                             DMA_Channel_TypeDef *p_tx_channel,
+                             IRQn_Type tx_irq,
+                             DMA_Channel_TypeDef *p_rx_channel,
+                             IRQn_Type rx_irq)
+{
+    DMA_HandleTypeDef *p_dma[] = { &master->hdma_tx, &master->hdma_rx };
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    master->hdma_tx.Instance = p_tx_channel;
+    master->hdma_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    master->hdma_rx.Instance = p_rx_channel;
+    master->hdma_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+
+    for (int index = 0; index < 2; index++)
+    {
+        p_dma[index]->Init.Request = DMA_REQUEST_3;
+        p_dma[index]->Init.PeriphInc = DMA_PINC_DISABLE;
+        p_dma[index]->Init.MemInc = DMA_MINC_ENABLE;
+        p_dma[index]->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        p_dma[index]->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        p_dma[index]->Init.Mode = DMA_NORMAL;
+        p_dma[index]->Init.Priority = DMA_PRIORITY_LOW;
+        if (HAL_DMA_Init(p_dma[index]) != HAL_OK)
+        {
+            hal_i2c_init_error(master->handle.Instance);
+        }
+    }
+
+    __HAL_LINKDMA(&master->handle, hdmatx, master->hdma_tx);
+    __HAL_LINKDMA(&master->handle, hdmarx, master->hdma_rx);
+
+    HAL_NVIC_SetPriority(tx_irq, I2C_DMA_IRQ_PRIO, 0);
+    HAL_NVIC_EnableIRQ(tx_irq);
+    HAL_NVIC_SetPriority(rx_irq, I2C_DMA_IRQ_PRIO, 0);
+    HAL_NVIC_EnableIRQ(rx_irq);
+
+    master->use_dma = true;
+}
+
+
+static void i2c_transfer_complete (I2C_HandleTypeDef *hi2c, int result)
 {
     int max = i2c_instances_max();
 
@@ -711,7 +1723,15 @@ static void i2c_transfer_complete (I2C_HandleTypeDef *hi2c)
     {
         if (i2c_master[index].handle.Instance == hi2c->Instance)
         {
-            i2c_signal_send_isr(index);
+            // Ignore late events of transfers already failed by timeout.
+            uint32_t primask = i2c_irq_lock();
+            bool ended = i2c_trx_claim(&i2c_master[index]);
+            i2c_irq_unlock(primask);
+
+            if (ended)
+            {
+                i2c_job_next(index, result);
+            }
             index = max;
         }
     }
@@ -724,7 +1744,7 @@ static void i2c_transfer_complete (I2C_HandleTypeDef *hi2c)
  */
 void HAL_I2C_MasterRxCpltCallback (I2C_HandleTypeDef *hi2c)
 {
-    i2c_transfer_complete(hi2c);
+    i2c_transfer_complete(hi2c, 0);
 }
 
 
@@ -734,7 +1754,7 @@ void HAL_I2C_MasterRxCpltCallback (I2C_HandleTypeDef *hi2c)
  */
 void HAL_I2C_MasterTxCpltCallback (I2C_HandleTypeDef *hi2c)
 {
-    i2c_transfer_complete(hi2c);
+    i2c_transfer_complete(hi2c, 0);
 }
 
 /**
@@ -743,7 +1763,7 @@ void HAL_I2C_MasterTxCpltCallback (I2C_HandleTypeDef *hi2c)
  */
 void HAL_I2C_MemRxCpltCallback (I2C_HandleTypeDef *hi2c)
 {
-    i2c_transfer_complete(hi2c);
+    i2c_transfer_complete(hi2c, 0);
 }
 
 
@@ -753,16 +1773,38 @@ void HAL_I2C_MemRxCpltCallback (I2C_HandleTypeDef *hi2c)
  */
 void HAL_I2C_MemTxCpltCallback (I2C_HandleTypeDef *hi2c)
 {
-    i2c_transfer_complete(hi2c);
+    i2c_transfer_complete(hi2c, 0);
 }
 
 
 void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
 {
     dbg_i2c_error++;
+    i2c_transfer_complete(hi2c, (HAL_I2C_ERROR_AF & HAL_I2C_GetError(hi2c)) ?
+                                BSP_I2C_RESULT_NACK : BSP_I2C_RESULT_ERROR);
 }
 
 void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
 {
     dbg_i2c_error++;
 }
+
+void DMA1_Channel4_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&i2c_master[1].hdma_tx);
+}
+
+void DMA1_Channel5_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&i2c_master[1].hdma_rx);
+}
+
+void DMA1_Channel6_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&i2c_master[0].hdma_tx);
+}
+
+void DMA1_Channel7_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&i2c_master[0].hdma_rx);
+}
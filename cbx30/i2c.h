@@ -21,6 +21,20 @@ extern "C" {
 #define BSP_I2C_READ_FLAG      (0x01)
 #define BSP_I2C_WRITE_FLAG     (0x00)
 
+// Transfer results other than 0.
+#define BSP_I2C_RESULT_ERROR   (1)                  // Bus/arbitration/DMA error or start failure.
+#define BSP_I2C_RESULT_NACK    (2)                  // Device did not acknowledge.
+#define BSP_I2C_RESULT_TIMEOUT (3)                  // Transfer did not end in time.
+
+// Histogram bin i counts durations below (16 << i) us, last bin the rest.
+#define BSP_I2C_HIST_BINS      (12u)
+#define BSP_I2C_HIST_BIN0_US   (16u)
+
+// Devices tracked per instance, further devices are counted in the last slot
+// with address BSP_I2C_STATS_DEV_OTHER.
+#define BSP_I2C_STATS_DEV_MAX  (8u)
+#define BSP_I2C_STATS_DEV_OTHER (0xFFu)
+
 
 //----------------------------- DATA TYPES ------------------------------------
 typedef enum {
@@ -44,6 +58,40 @@ typedef struct {
     uint8_t timeout;                                // Time to wait for end of transfer. BSP_I2C_DEFAULT_TIMEOUT_MS value used if set to 0.
 } bsp_i2c_transfer_t;
 
+/*!
+* @brief Asynchronous job completion callback. Called from ISR, or from caller
+*   context if the first transfer cannot be started.
+* @param[in] result 0 on success, BSP_I2C_RESULT_ value otherwise.
+* @param[in] p_ctx context given with the job.
+*/
+typedef void (*bsp_i2c_done_cb_t)(int result, void *p_ctx);
+
+typedef struct bsp_i2c_job {
+    bsp_i2c_transfer_t *p_trx;                      // Chain of transfers, executed in order.
+    int trx_len;                                    // Number of transfers in chain.
+    bsp_i2c_done_cb_t done;                         // Completion callback, may be NULL.
+    void *p_ctx;                                    // Completion callback context.
+    struct bsp_i2c_job *p_next;                     // Internal, queue link.
+    uint32_t queued_cyc;                            // Internal, queueing time for statistics.
+} bsp_i2c_job_t;
+
+typedef struct {
+    uint32_t transfers;                             // Finished transfers, failed included.
+    uint32_t bytes;                                 // Bytes of successful transfers.
+    uint32_t errors;                                // Failed transfers, NACKs and timeouts included.
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t lock_wait_max_us;
+    uint32_t wire_max_us;
+    uint32_t lock_wait_hist[BSP_I2C_HIST_BINS];     // Time from request to first transfer start.
+    uint32_t wire_hist[BSP_I2C_HIST_BINS];          // Time from transfer start to its end.
+} bsp_i2c_dev_stats_t;
+
+typedef struct {
+    bsp_i2c_dev_stats_t total;                      // Sum of all devices.
+    uint32_t resets;                                // Instance resets.
+} bsp_i2c_stats_t;
+
 
 //---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
 /**
@@ -82,6 +130,58 @@ int bsp_i2c_transfer
     (int instance, bsp_i2c_transfer_t *p_trx, int trx_len);
 
 
+/*!
+* @brief Queue chain of transfers without blocking. Jobs on one instance are
+*   executed in queueing order, transfers run from ISR using DMA where the
+*   instance has DMA channels. Prepare functions are called from ISR for all
+*   but the first transfer of an idle bus. Job and transfers must stay valid
+*   until the callback is called. Safe to call from ISR.
+* @param[in] instance of i2c to transfer data with (1, 2 or 3).
+* @param[in] job to queue.
+* @return 0 if queued, error if arguments are invalid.
+*/
+int bsp_i2c_transfer_async(int instance, bsp_i2c_job_t *p_job);
+
+/*!
+* @brief Fail running asynchronous transfers which exceeded their timeout.
+*   Run by the driver poll timer while jobs queued with
+*   bsp_i2c_transfer_async are pending, may also be called from task context.
+* @return none.
+*/
+void bsp_i2c_async_poll(void);
+
+/*!
+* @brief Get instance statistics.
+* @param[in] instance of i2c (1, 2 or 3).
+* @param[out] statistics.
+* @return 0 on success.
+*/
+int bsp_i2c_stats_get(int instance, bsp_i2c_stats_t *p_stats);
+
+/*!
+* @brief Get statistics of one device seen on the instance.
+* @param[in] instance of i2c (1, 2 or 3).
+* @param[in] slot 0 to BSP_I2C_STATS_DEV_MAX - 1.
+* @param[out] 7-bit device address of the slot.
+* @param[out] statistics.
+* @return 0 on success, error if slot is unused.
+*/
+int bsp_i2c_dev_stats_get(int instance, int slot, uint8_t *p_address,
+                          bsp_i2c_dev_stats_t *p_stats);
+
+/*!
+* @brief Clear statistics of the instance and its devices.
+* @param[in] instance of i2c (1, 2 or 3).
+* @return none.
+*/
+void bsp_i2c_stats_reset(int instance);
+
+/*!
+* @brief Print statistics of all instances and devices over debug output.
+* @return none.
+*/
+void bsp_i2c_stats_dump(void);
+
 /*!
 * @brief Return pointer to i2c handle. Used for accesing handle from i2c irq
 * @param[in] instance of i2c (1, 2 or 3).
@@ -97,6 +197,15 @@ void *bsp_i2c_handle_get(int instance);
 */
 void bsp_i2c_reset(int instance);
 
+/*!
+* @brief Recalculate bus timing of all instances after PCLK1 changed. Must be
+*   called with no transfer running.
+* @param[in] old_hz previous PCLK1 frequency.
+* @param[in] new_hz current PCLK1 frequency.
+* @return none.
+*/
+void bsp_i2c_clock_update(uint32_t old_hz, uint32_t new_hz);
+
 #ifdef __cplusplus
 }
 #endif
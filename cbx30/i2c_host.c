@@ -0,0 +1,785 @@
+/** @file i2c_host.c
+*
+* @brief Host test of the asynchronous I2C job queue against a mock HAL.
+*        Started transfers are recorded, the harness ends them by calling
+*        the HAL callbacks as the I2C/DMA ISR would. Checks job and transfer
+*        order, failure of a chain, timeout from the driver poll timer and
+*        cancel of a synchronous transfer with the completion ISR arriving
+*        late, then measures queue throughput:
+*
+*        gcc -O2 -DI2C_HOST -Ihost -I. i2c.c i2c_host.c host/mcu_host.c \
+*            -o i2c_host
+*        ./i2c_host [jobs]
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/i2c.h>
+#include <inc/bsp/lowpower.h>
+#include <stm32l4xx_hal.h>
+#include <task.h>
+#include <semphr.h>
+#include <timers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_JOBS                   (1000000u)
+#define HOST_LOG_LEN                (64u)
+#define HOST_INSTANCES              (3u)
+
+#define HOST_CHECK(cond)            do { if (!(cond)) { \
+                                        host_fail(__LINE__, #cond); \
+                                        return false; } } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// Transfer as started through the mock HAL.
+typedef struct {
+    int instance;
+    uint8_t address;
+    uint16_t length;
+    bool mem;
+    bool rx;
+    bool dma;
+} host_trx_t;
+
+/// Mock bus of one instance.
+typedef struct {
+    bool active;
+    host_trx_t trx;
+} host_bus_t;
+
+/// Completion record of a job.
+typedef struct {
+    int id;
+    int result;
+} host_done_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static bool test_order(void);
+static bool test_chain_error(void);
+static bool test_poll_timeout(void);
+static bool test_sync(void);
+static bool test_throughput(uint32_t jobs);
+
+static HAL_StatusTypeDef host_start(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                    uint16_t size, bool mem, bool rx,
+                                    bool dma);
+static HAL_StatusTypeDef host_xfer_isr(I2C_HandleTypeDef *hi2c, uint32_t flags,
+                                       uint32_t sources);
+static bool host_isr(int instance, uint32_t error);
+static void host_isr_late(int instance);
+static void host_isr_all(void);
+static void host_job_done(int result, void *p_ctx);
+static void host_prepare(void *p_trx);
+static void host_reset(void);
+static void host_fail(int line, const char *p_cond);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static host_bus_t host_bus[HOST_INSTANCES];
+static host_trx_t host_log[HOST_LOG_LEN];
+static uint32_t host_log_cnt;
+static host_done_t host_done[HOST_LOG_LEN];
+static uint32_t host_done_cnt;
+static uint32_t host_prepare_cnt;
+static uint32_t host_dma_abort_cnt;
+static bool host_log_on = true;
+// Job queued from completion callback of job with this id, -1 for none.
+static int host_requeue_id = -1;
+static bsp_i2c_job_t host_requeue_job;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef I2C_HOST
+int main(int argc, char **argv)
+{
+    uint32_t jobs = (1 < argc) ? (uint32_t)strtoul(argv[1], NULL, 0) :
+                                 HOST_JOBS;
+    bool is_ok;
+
+    is_ok = (0 == bsp_i2c_init());
+    is_ok = is_ok && test_order();
+    is_ok = is_ok && test_chain_error();
+    is_ok = is_ok && test_poll_timeout();
+    is_ok = is_ok && test_sync();
+    is_ok = is_ok && test_throughput(jobs);
+
+    printf("%s\n", is_ok ? "ok" : "failed");
+
+    return !is_ok;
+}
+#endif
+
+void bsp_lowpower_stop_veto(bsp_lowpower_client_t client, bool veto)
+{
+    (void)client;
+    (void)veto;
+}
+
+//---- Mock HAL ----
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+    hi2c->State = HAL_I2C_STATE_READY;
+    __HAL_I2C_ENABLE(hi2c);
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c,
+                                               uint32_t filter)
+{
+    (void)hi2c;
+    (void)filter;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c,
+                                                uint32_t filter)
+{
+    (void)hi2c;
+    (void)filter;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    (void)hdma;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    hdma->Instance->CCR = 0u;
+    host_dma_abort_cnt++;
+
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+    (void)hdma;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c)
+{
+    return hi2c->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c,
+                                          uint16_t address, uint8_t *p_data,
+                                          uint16_t size, uint32_t timeout)
+{
+    (void)hi2c;
+    (void)address;
+    (void)p_data;
+    (void)size;
+    (void)timeout;
+
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c,
+                                         uint16_t address, uint8_t *p_data,
+                                         uint16_t size, uint32_t timeout)
+{
+    return HAL_I2C_Master_Transmit(hi2c, address, p_data, size, timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                    uint16_t mem_addr, uint16_t mem_addr_len,
+                                    uint8_t *p_data, uint16_t size,
+                                    uint32_t timeout)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+
+    return HAL_I2C_Master_Transmit(hi2c, address, p_data, size, timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                   uint16_t mem_addr, uint16_t mem_addr_len,
+                                   uint8_t *p_data, uint16_t size,
+                                   uint32_t timeout)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+
+    return HAL_I2C_Master_Transmit(hi2c, address, p_data, size, timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c,
+                                             uint16_t address, uint8_t *p_data,
+                                             uint16_t size)
+{
+    (void)p_data;
+
+    return host_start(hi2c, address, size, false, false, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c,
+                                            uint16_t address, uint8_t *p_data,
+                                            uint16_t size)
+{
+    (void)p_data;
+
+    return host_start(hi2c, address, size, false, true, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c,
+                                              uint16_t address,
+                                              uint8_t *p_data, uint16_t size)
+{
+    (void)p_data;
+
+    return host_start(hi2c, address, size, false, false, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c,
+                                             uint16_t address, uint8_t *p_data,
+                                             uint16_t size)
+{
+    (void)p_data;
+
+    return host_start(hi2c, address, size, false, true, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t address, uint16_t mem_addr,
+                                       uint16_t mem_addr_len, uint8_t *p_data,
+                                       uint16_t size)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+    (void)p_data;
+
+    return host_start(hi2c, address, size, true, false, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t address, uint16_t mem_addr,
+                                      uint16_t mem_addr_len, uint8_t *p_data,
+                                      uint16_t size)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+    (void)p_data;
+
+    return host_start(hi2c, address, size, true, true, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c,
+                                        uint16_t address, uint16_t mem_addr,
+                                        uint16_t mem_addr_len, uint8_t *p_data,
+                                        uint16_t size)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+    (void)p_data;
+
+    return host_start(hi2c, address, size, true, false, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c,
+                                       uint16_t address, uint16_t mem_addr,
+                                       uint16_t mem_addr_len, uint8_t *p_data,
+                                       uint16_t size)
+{
+    (void)mem_addr;
+    (void)mem_addr_len;
+    (void)p_data;
+
+    return host_start(hi2c, address, size, true, true, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Sequential_Transmit_IT(
+    I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *p_data,
+    uint16_t size, uint32_t options)
+{
+    (void)p_data;
+    (void)options;
+
+    return host_start(hi2c, address, size, false, false, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Sequential_Receive_IT(
+    I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *p_data,
+    uint16_t size, uint32_t options)
+{
+    (void)p_data;
+    (void)options;
+
+    return host_start(hi2c, address, size, false, true, false);
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+//---- Tests ----
+
+static bool test_order(void)
+{
+    static uint8_t data[16];
+    bsp_i2c_transfer_t trx_a[] = {
+        { .data = data, .length = 1, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x30, .prepare = host_prepare },
+        { .data = data, .length = 6, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x31, .prepare = host_prepare },
+    };
+    bsp_i2c_transfer_t trx_b[] = {
+        { .data = data, .length = 2, .address = 0x40 },
+    };
+    bsp_i2c_transfer_t trx_c[] = {
+        { .data = data, .length = 12, .address = 0x51 },
+        { .data = data, .length = 3, .address = 0x50 },
+        { .data = data, .length = 4, .address = 0x51 },
+    };
+    bsp_i2c_job_t job[3] = {
+        { .p_trx = trx_a, .trx_len = 2, .done = host_job_done,
+          .p_ctx = (void *)1 },
+        { .p_trx = trx_b, .trx_len = 1, .done = host_job_done,
+          .p_ctx = (void *)2 },
+        { .p_trx = trx_c, .trx_len = 3, .done = host_job_done,
+          .p_ctx = (void *)3 },
+    };
+    const uint8_t address[] = { 0x30, 0x31, 0x40, 0x51, 0x50, 0x51, 0x40 };
+    const bool dma[] = { false, true, false, true, false, true, false };
+
+    host_reset();
+
+    // Job 1 ends with job 4 (transfers of job 2) queued from its callback.
+    host_requeue_id = 1;
+    host_requeue_job = job[1];
+    host_requeue_job.p_ctx = (void *)4;
+
+    for (int index = 0; index < 3; index++)
+    {
+        HOST_CHECK(0 == bsp_i2c_transfer_async(1, &job[index]));
+    }
+
+    // Only the first transfer starts from task context.
+    HOST_CHECK((1u == host_log_cnt) && (0u == host_done_cnt));
+
+    host_isr_all();
+
+    HOST_CHECK(sizeof(address) == host_log_cnt);
+    for (uint32_t index = 0; index < host_log_cnt; index++)
+    {
+        HOST_CHECK(address[index] == host_log[index].address);
+        HOST_CHECK(dma[index] == host_log[index].dma);
+        HOST_CHECK(0 == host_log[index].instance);
+    }
+    HOST_CHECK(host_log[0].mem && (!host_log[0].rx));
+    HOST_CHECK(host_log[1].mem && host_log[1].rx);
+    HOST_CHECK((!host_log[2].mem) && (!host_log[2].rx));
+
+    HOST_CHECK(4u == host_done_cnt);
+    for (uint32_t index = 0; index < host_done_cnt; index++)
+    {
+        HOST_CHECK(((int)index + 1) == host_done[index].id);
+        HOST_CHECK(0 == host_done[index].result);
+    }
+    HOST_CHECK(2u == host_prepare_cnt);
+
+    // I2C3 has no DMA channels, long transfers stay interrupt driven.
+    host_reset();
+    HOST_CHECK(0 == bsp_i2c_transfer_async(3, &job[2]));
+    host_isr_all();
+    HOST_CHECK((3u == host_log_cnt) && (1u == host_done_cnt));
+    HOST_CHECK((2 == host_log[0].instance) && (!host_log[0].dma));
+
+    return true;
+}
+
+static bool test_chain_error(void)
+{
+    static uint8_t data[8];
+    bsp_i2c_transfer_t trx_a[] = {
+        { .data = data, .length = 4, .address = 0x20 },
+        { .data = data, .length = 4, .address = 0x21 },
+        { .data = data, .length = 4, .address = 0x22 },
+    };
+    bsp_i2c_transfer_t trx_b[] = {
+        { .data = data, .length = 1, .address = 0x23 },
+    };
+    bsp_i2c_job_t job[2] = {
+        { .p_trx = trx_a, .trx_len = 3, .done = host_job_done,
+          .p_ctx = (void *)1 },
+        { .p_trx = trx_b, .trx_len = 1, .done = host_job_done,
+          .p_ctx = (void *)2 },
+    };
+    bsp_i2c_stats_t before;
+    bsp_i2c_stats_t after;
+
+    host_reset();
+    bsp_i2c_stats_get(2, &before);
+
+    HOST_CHECK(0 == bsp_i2c_transfer_async(2, &job[0]));
+    HOST_CHECK(0 == bsp_i2c_transfer_async(2, &job[1]));
+
+    // Second transfer NACKed, third is skipped, next job runs.
+    HOST_CHECK(host_isr(1, HAL_I2C_ERROR_NONE));
+    HOST_CHECK(host_isr(1, HAL_I2C_ERROR_AF));
+    HOST_CHECK((1u == host_done_cnt) &&
+               (BSP_I2C_RESULT_NACK == host_done[0].result));
+    HOST_CHECK(3u == host_log_cnt);
+    HOST_CHECK(0x23 == host_log[2].address);
+
+    HOST_CHECK(host_isr(1, HAL_I2C_ERROR_NONE));
+    HOST_CHECK((2u == host_done_cnt) && (0 == host_done[1].result));
+    HOST_CHECK(!host_bus[1].active);
+
+    bsp_i2c_stats_get(2, &after);
+    HOST_CHECK((before.resets + 1u) == after.resets);
+    HOST_CHECK((before.total.nacks + 1u) == after.total.nacks);
+    HOST_CHECK((before.total.transfers + 3u) == after.total.transfers);
+
+    return true;
+}
+
+static bool test_poll_timeout(void)
+{
+    static uint8_t data[8];
+    bsp_i2c_transfer_t trx_a[] = {
+        { .data = data, .length = 4, .address = 0x60, .timeout = 5 },
+        { .data = data, .length = 4, .address = 0x61, .timeout = 5 },
+    };
+    bsp_i2c_transfer_t trx_b[] = {
+        { .data = data, .length = 4, .address = 0x62, .timeout = 5 },
+        { .data = data, .length = 4, .address = 0x63, .timeout = 5 },
+    };
+    bsp_i2c_job_t job[3] = {
+        { .p_trx = trx_a, .trx_len = 2, .done = host_job_done,
+          .p_ctx = (void *)1 },
+        { .p_trx = trx_b, .trx_len = 2, .done = host_job_done,
+          .p_ctx = (void *)2 },
+        { .p_trx = trx_a, .trx_len = 1, .done = host_job_done,
+          .p_ctx = (void *)3 },
+    };
+    I2C_HandleTypeDef *p_handle = bsp_i2c_handle_get(1);
+
+    host_reset();
+
+    // Poll timer armed by earlier jobs expires on the idle bus and stays off
+    // until a job is queued.
+    host_timer_fire(NULL);
+    HOST_CHECK(!host_timer_fire(NULL));
+    HOST_CHECK(0 == bsp_i2c_transfer_async(1, &job[0]));
+
+    // Not yet expired, timer stays armed.
+    host_tick += 5u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK((0u == host_done_cnt) && (1u == host_log_cnt));
+
+    host_tick += 2u;
+    HOST_CHECK(host_timer_fire(NULL));
+
+    // Stuck transfer stopped before job failed: no event source left.
+    HOST_CHECK(0u < host_dma_abort_cnt);
+    HOST_CHECK((1u == host_done_cnt) &&
+               (BSP_I2C_RESULT_TIMEOUT == host_done[0].result));
+    HOST_CHECK(NULL == p_handle->XferISR);
+    HOST_CHECK(HAL_I2C_STATE_READY == p_handle->State);
+    HOST_CHECK(0u != (p_handle->Instance->CR1 & I2C_CR1_PE));
+    HOST_CHECK(0u == (p_handle->Instance->CR1 &
+                      (I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN | I2C_CR1_TCIE |
+                       I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE)));
+
+    // Pending event of the stopped transfer is dropped by HAL, a callback
+    // already on its way finds the transfer ended.
+    HOST_CHECK(!host_isr(0, HAL_I2C_ERROR_NONE));
+    host_isr_late(0);
+    HOST_CHECK((1u == host_done_cnt) && (1u == host_log_cnt));
+
+    // Queue is idle, next job starts right away. It expires as well while
+    // another job waits, that one starts from the poll.
+    HOST_CHECK(0 == bsp_i2c_transfer_async(1, &job[1]));
+    HOST_CHECK(0 == bsp_i2c_transfer_async(1, &job[2]));
+    HOST_CHECK((2u == host_log_cnt) && (0x62 == host_log[1].address));
+
+    host_tick += 7u;
+    bsp_i2c_async_poll();
+    HOST_CHECK((2u == host_done_cnt) &&
+               (BSP_I2C_RESULT_TIMEOUT == host_done[1].result));
+    HOST_CHECK((3u == host_log_cnt) && (0x60 == host_log[2].address));
+
+    // Running transfer is within its time.
+    bsp_i2c_async_poll();
+    HOST_CHECK(2u == host_done_cnt);
+
+    host_isr_all();
+    HOST_CHECK((3u == host_done_cnt) && (3 == host_done[2].id) &&
+               (0 == host_done[2].result));
+    HOST_CHECK(3u == host_log_cnt);
+
+    // Bus idle, last expiry does not arm the timer again.
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(!host_timer_fire(NULL));
+
+    return true;
+}
+
+static bool test_sync(void)
+{
+    static uint8_t data[8];
+    bsp_i2c_transfer_t trx[] = {
+        { .data = data, .length = 2, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x71, .timeout = 3 },
+        { .data = data, .length = 8, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x71, .timeout = 3 },
+    };
+    bsp_i2c_transfer_t trx_b[] = {
+        { .data = data, .length = 1, .address = 0x72 },
+    };
+    bsp_i2c_job_t job = { .p_trx = trx_b, .trx_len = 1,
+                          .done = host_job_done, .p_ctx = (void *)9 };
+
+    host_reset();
+
+    // Completions run while the caller waits.
+    host_rtos_wait_hook = host_isr_all;
+    HOST_CHECK(0 == bsp_i2c_transfer(2, trx, 2));
+    HOST_CHECK(2u == host_log_cnt);
+
+    // Nothing completes, wait times out and the stack job is cancelled.
+    host_rtos_wait_hook = NULL;
+    HOST_CHECK(0 != bsp_i2c_transfer(2, trx, 2));
+    HOST_CHECK(3u == host_log_cnt);
+
+    // Late completion finds nothing to end, queue is idle again.
+    host_isr_late(1);
+    HOST_CHECK(0 == bsp_i2c_transfer_async(2, &job));
+    HOST_CHECK((4u == host_log_cnt) && (0x72 == host_log[3].address));
+    host_isr_all();
+    HOST_CHECK((1u == host_done_cnt) && (9 == host_done[0].id) &&
+               (0 == host_done[0].result));
+
+    return true;
+}
+
+static bool test_throughput(uint32_t jobs)
+{
+    static uint8_t data[8];
+    bsp_i2c_transfer_t trx[] = {
+        { .data = data, .length = 1, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x33 },
+        { .data = data, .length = 6, .mode = BSP_I2C_MODE_MEMORY,
+          .address = 0x33 | BSP_I2C_READ_FLAG },
+    };
+    bsp_i2c_job_t job[4];
+    bsp_i2c_stats_t before;
+    bsp_i2c_stats_t after;
+    struct timespec start;
+    struct timespec end;
+
+    host_reset();
+    host_log_on = false;
+    bsp_i2c_stats_get(1, &before);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Few jobs in flight, each requeued by the harness once it is done.
+    for (uint32_t cnt = 0; cnt < jobs; cnt++)
+    {
+        bsp_i2c_job_t *p_job = &job[cnt % 4u];
+
+        if (4u <= cnt)
+        {
+            // Oldest job has to be done before it is reused.
+            while ((cnt - 3u) > host_done_cnt)
+            {
+                host_isr(0, HAL_I2C_ERROR_NONE);
+            }
+        }
+
+        *p_job = (bsp_i2c_job_t){ .p_trx = trx, .trx_len = 2,
+                                  .done = host_job_done };
+        bsp_i2c_transfer_async(1, p_job);
+    }
+    host_isr_all();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (double)(end.tv_sec - start.tv_sec) +
+                     ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+
+    bsp_i2c_stats_get(1, &after);
+    host_log_on = true;
+
+    HOST_CHECK(jobs == host_done_cnt);
+    HOST_CHECK((2u * jobs) == (after.total.transfers - before.total.transfers));
+    HOST_CHECK(before.total.errors == after.total.errors);
+
+    printf("%u jobs, %u transfers in %.3f s: %.0f jobs/s, %.0f ns/transfer\n",
+           jobs, 2u * jobs, elapsed, (double)jobs / elapsed,
+           (elapsed * 1e9) / (2.0 * (double)jobs));
+
+    return true;
+}
+
+//---- Mock bus ----
+
+static HAL_StatusTypeDef host_start(I2C_HandleTypeDef *hi2c, uint16_t address,
+                                    uint16_t size, bool mem, bool rx, bool dma)
+{
+    int instance = (int)(hi2c->Instance - I2C1);
+    host_bus_t *p_bus = &host_bus[instance];
+
+    // HAL refuses to start while its state machine is not ready.
+    if ((HAL_I2C_STATE_READY != hi2c->State) ||
+        (0u == (hi2c->Instance->CR1 & I2C_CR1_PE)))
+    {
+        return HAL_BUSY;
+    }
+
+    hi2c->State = rx ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    hi2c->XferISR = host_xfer_isr;
+    __HAL_I2C_ENABLE_IT(hi2c, I2C_IT_ERRI | I2C_IT_TCI | I2C_IT_STOPI |
+                              I2C_IT_NACKI);
+    if (dma)
+    {
+        SET_BIT(hi2c->Instance->CR1, rx ? I2C_CR1_RXDMAEN : I2C_CR1_TXDMAEN);
+    }
+
+    p_bus->active = true;
+    p_bus->trx = (host_trx_t){
+        .instance = instance,
+        .address = (uint8_t)(address | (rx ? BSP_I2C_READ_FLAG : 0u)),
+        .length = size, .mem = mem, .rx = rx, .dma = dma
+    };
+
+    if (host_log_on && (HOST_LOG_LEN > host_log_cnt))
+    {
+        host_log[host_log_cnt++] = p_bus->trx;
+    }
+
+    return HAL_OK;
+}
+
+// Marks a transfer in progress, events are raised by host_isr().
+static HAL_StatusTypeDef host_xfer_isr(I2C_HandleTypeDef *hi2c, uint32_t flags,
+                                       uint32_t sources)
+{
+    (void)hi2c;
+    (void)flags;
+    (void)sources;
+
+    return HAL_OK;
+}
+
+// End running transfer as its ISR would, false if bus is idle.
+static bool host_isr(int instance, uint32_t error)
+{
+    host_bus_t *p_bus = &host_bus[instance];
+    I2C_HandleTypeDef *p_handle = bsp_i2c_handle_get(instance + 1);
+
+    // Aborted transfer leaves no event behind.
+    if ((!p_bus->active) || (NULL == p_handle->XferISR))
+    {
+        p_bus->active = false;
+        return false;
+    }
+
+    p_bus->active = false;
+    p_handle->State = HAL_I2C_STATE_READY;
+    p_handle->XferISR = NULL;
+    p_handle->ErrorCode = error;
+
+    host_ipsr = 16u + I2C1_EV_IRQn;
+
+    if (HAL_I2C_ERROR_NONE != error)
+    {
+        HAL_I2C_ErrorCallback(p_handle);
+    }
+    else if (p_bus->trx.mem)
+    {
+        p_bus->trx.rx ? HAL_I2C_MemRxCpltCallback(p_handle) :
+                        HAL_I2C_MemTxCpltCallback(p_handle);
+    }
+    else
+    {
+        p_bus->trx.rx ? HAL_I2C_MasterRxCpltCallback(p_handle) :
+                        HAL_I2C_MasterTxCpltCallback(p_handle);
+    }
+
+    host_ipsr = 0u;
+
+    return true;
+}
+
+// Completion callback of a transfer that was already stopped, as when its
+// ISR was pending while the task failed it.
+static void host_isr_late(int instance)
+{
+    I2C_HandleTypeDef *p_handle = bsp_i2c_handle_get(instance + 1);
+
+    host_ipsr = 16u + I2C1_EV_IRQn;
+    HAL_I2C_MemRxCpltCallback(p_handle);
+    HAL_I2C_MasterTxCpltCallback(p_handle);
+    host_ipsr = 0u;
+}
+
+static void host_isr_all(void)
+{
+    bool ran = true;
+
+    while (ran)
+    {
+        ran = false;
+        for (int instance = 0; instance < (int)HOST_INSTANCES; instance++)
+        {
+            ran = host_isr(instance, HAL_I2C_ERROR_NONE) || ran;
+        }
+    }
+}
+
+static void host_job_done(int result, void *p_ctx)
+{
+    int id = (int)(intptr_t)p_ctx;
+
+    if (HOST_LOG_LEN > host_done_cnt)
+    {
+        host_done[host_done_cnt] = (host_done_t){ .id = id,
+                                                  .result = result };
+    }
+    host_done_cnt++;
+
+    if ((0 <= host_requeue_id) && (id == host_requeue_id))
+    {
+        host_requeue_id = -1;
+        bsp_i2c_transfer_async(1, &host_requeue_job);
+    }
+}
+
+static void host_prepare(void *p_trx)
+{
+    (void)p_trx;
+    host_prepare_cnt++;
+}
+
+static void host_reset(void)
+{
+    host_log_cnt = 0u;
+    host_done_cnt = 0u;
+    host_prepare_cnt = 0u;
+    host_dma_abort_cnt = 0u;
+    host_rtos_wait_hook = NULL;
+}
+
+static void host_fail(int line, const char *p_cond)
+{
+    fprintf(stderr, "line %d: %s\n", line, p_cond);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
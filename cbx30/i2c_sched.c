@@ -0,0 +1,274 @@
+/** @file i2c_sched.c
+*
+* @brief Periodic I2C register reads scheduled on top of async bsp_i2c queue.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/i2c_sched.h>
+#include <inc/bsp/i2c.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+#include <RTT.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define I2C_SCHED_INSTANCES_MAX     (3u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    bsp_i2c_sched_cfg_t cfg;
+    // Register address write and data read, one sequential frame pair.
+    bsp_i2c_transfer_t trx[2];
+    bsp_i2c_job_t job;
+    uint8_t reg;
+    TickType_t last_tick;
+    volatile bool in_flight;
+    // Double buffered readings, buf[active] holds the latest complete one.
+    uint8_t buf[2][BSP_I2C_SCHED_DATA_MAX];
+    volatile uint8_t active;
+    volatile uint32_t seq;                          // Odd while publishing.
+    volatile uint32_t tick;
+    volatile bool valid;
+    volatile uint32_t err_cnt;
+} i2c_sched_entry_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Timer callback, queues reads of all due entries by priority.
+ * @param timer scheduler timer.
+ */
+static void i2c_sched_tick(TimerHandle_t timer);
+
+/**
+ * @brief Read job completion, publishes reading. Called from I2C ISR.
+ * @param result 0 on success.
+ * @param p_ctx entry.
+ */
+static void i2c_sched_done(int result, void *p_ctx);
+
+/**
+ * @brief Check entry handle.
+ * @param handle entry handle.
+ * @return true if handle refers to registered entry.
+ */
+static bool i2c_sched_handle_valid(int handle);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+// Entries never move once registered, ISR keeps pointers to them.
+static i2c_sched_entry_t i2c_sched_entry[BSP_I2C_SCHED_ENTRIES_MAX];
+static volatile int i2c_sched_entry_cnt;
+
+// Entry indexes sorted by priority.
+static uint8_t i2c_sched_order[BSP_I2C_SCHED_ENTRIES_MAX];
+
+static TimerHandle_t i2c_sched_timer;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+bool bsp_i2c_sched_init(uint32_t tick_ms)
+{
+    bool is_ok = (NULL != i2c_sched_timer);
+
+    if ((!is_ok) && (0u < tick_ms))
+    {
+        i2c_sched_timer = xTimerCreate("i2c_sched", pdMS_TO_TICKS(tick_ms),
+                                       pdTRUE, NULL, i2c_sched_tick);
+        is_ok = (NULL != i2c_sched_timer) &&
+                (pdPASS == xTimerStart(i2c_sched_timer, 0));
+    }
+
+    if (!is_ok)
+    {
+        dprintf("\ni2c_sched init failed.");
+    }
+
+    return is_ok;
+}
+
+int bsp_i2c_sched_register(const bsp_i2c_sched_cfg_t *p_cfg)
+{
+    int handle = -1;
+
+    if ((NULL != p_cfg) &&
+        (0u < p_cfg->instance) && (I2C_SCHED_INSTANCES_MAX >= p_cfg->instance) &&
+        (0u < p_cfg->length) && (BSP_I2C_SCHED_DATA_MAX >= p_cfg->length))
+    {
+        vTaskSuspendAll();
+
+        if ((int)BSP_I2C_SCHED_ENTRIES_MAX > i2c_sched_entry_cnt)
+        {
+            handle = i2c_sched_entry_cnt;
+
+            i2c_sched_entry_t *p_entry = &i2c_sched_entry[handle];
+            memset(p_entry, 0, sizeof(i2c_sched_entry_t));
+            p_entry->cfg = *p_cfg;
+            p_entry->reg = p_cfg->reg;
+            p_entry->last_tick = xTaskGetTickCount() -
+                                 pdMS_TO_TICKS(p_cfg->period_ms);
+
+            // Register write without STOP, direction changes in next frame.
+            p_entry->trx[0].data = &p_entry->reg;
+            p_entry->trx[0].length = 1u;
+            p_entry->trx[0].mode = BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME;
+            p_entry->trx[0].address = (p_cfg->address << 1) |
+                                      BSP_I2C_WRITE_FLAG;
+
+            // Repeated START read ending with STOP, buffer set when queued.
+            p_entry->trx[1].length = p_cfg->length;
+            p_entry->trx[1].mode = BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME;
+            p_entry->trx[1].address = (p_cfg->address << 1) |
+                                      BSP_I2C_READ_FLAG;
+
+            p_entry->job.p_trx = p_entry->trx;
+            p_entry->job.trx_len = 2;
+            p_entry->job.done = i2c_sched_done;
+            p_entry->job.p_ctx = p_entry;
+
+            // Insert into priority order, equal priorities keep registration
+            // order.
+            int pos = handle;
+            while ((0 < pos) &&
+                   (i2c_sched_entry[i2c_sched_order[pos - 1]].cfg.priority >
+                    p_cfg->priority))
+            {
+                i2c_sched_order[pos] = i2c_sched_order[pos - 1];
+                pos--;
+            }
+            i2c_sched_order[pos] = (uint8_t)handle;
+
+            i2c_sched_entry_cnt = handle + 1;
+        }
+
+        xTaskResumeAll();
+    }
+
+    return handle;
+}
+
+void bsp_i2c_sched_period_set(int handle, uint16_t period_ms)
+{
+    if (i2c_sched_handle_valid(handle))
+    {
+        i2c_sched_entry[handle].cfg.period_ms = period_ms;
+    }
+}
+
+bool bsp_i2c_sched_read(int handle, uint8_t *p_data, size_t len,
+                        uint32_t *p_tick)
+{
+    bool is_ok = i2c_sched_handle_valid(handle) && (NULL != p_data) &&
+                 (len <= i2c_sched_entry[handle].cfg.length);
+
+    if (is_ok)
+    {
+        i2c_sched_entry_t *p_entry = &i2c_sched_entry[handle];
+        uint32_t seq;
+        uint32_t tick;
+
+        // Retry if a reading was published while copying, the copied buffer
+        // may have been refilled by the following transfer.
+        do
+        {
+            seq = p_entry->seq;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            memcpy(p_data, p_entry->buf[p_entry->active], len);
+            tick = p_entry->tick;
+            is_ok = p_entry->valid;
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((seq & 1u) || (seq != p_entry->seq));
+
+        if ((is_ok) && (NULL != p_tick))
+        {
+            *p_tick = tick;
+        }
+    }
+
+    return is_ok;
+}
+
+uint32_t bsp_i2c_sched_error_cnt_get(int handle)
+{
+    return i2c_sched_handle_valid(handle) ? i2c_sched_entry[handle].err_cnt :
+                                            0u;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void i2c_sched_tick(TimerHandle_t timer)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    (void)timer;
+
+    // A read stuck on the bus keeps its entry in flight and every job behind
+    // it waiting. Failed here first, the entry is queued again in this pass.
+    bsp_i2c_async_poll();
+
+    vTaskSuspendAll();
+
+    for (int index = 0; index < i2c_sched_entry_cnt; index++)
+    {
+        i2c_sched_entry_t *p_entry = &i2c_sched_entry[i2c_sched_order[index]];
+        TickType_t period = pdMS_TO_TICKS(p_entry->cfg.period_ms);
+
+        if ((0u < period) && (!p_entry->in_flight) &&
+            ((TickType_t)(now - p_entry->last_tick) >= period))
+        {
+            p_entry->last_tick = now;
+            p_entry->in_flight = true;
+
+            // Read into inactive buffer, readers keep using active one.
+            p_entry->trx[1].data = p_entry->buf[p_entry->active ^ 1u];
+
+            if (bsp_i2c_transfer_async(p_entry->cfg.instance, &p_entry->job))
+            {
+                p_entry->in_flight = false;
+                p_entry->err_cnt++;
+            }
+        }
+    }
+
+    xTaskResumeAll();
+}
+
+static void i2c_sched_done(int result, void *p_ctx)
+{
+    i2c_sched_entry_t *p_entry = (i2c_sched_entry_t *)p_ctx;
+
+    if (0 == result)
+    {
+        p_entry->seq++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        p_entry->active ^= 1u;
+        p_entry->tick = xTaskGetTickCountFromISR();
+        p_entry->valid = true;
+
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        p_entry->seq++;
+    }
+    else
+    {
+        p_entry->err_cnt++;
+    }
+
+    p_entry->in_flight = false;
+}
+
+static bool i2c_sched_handle_valid(int handle)
+{
+    return (0 <= handle) && (i2c_sched_entry_cnt > handle);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,83 @@
+/** @file i2c_sched.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __BSP_I2C_SCHED_H__
+#define __BSP_I2C_SCHED_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+#define BSP_I2C_SCHED_ENTRIES_MAX   (16u)
+#define BSP_I2C_SCHED_DATA_MAX      (32u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint8_t instance;                               // I2C instance (1, 2 or 3).
+    uint8_t address;                                // 7-bit device address, not shifted.
+    uint8_t reg;                                    // First register to read.
+    uint8_t length;                                 // Bytes to read, up to BSP_I2C_SCHED_DATA_MAX.
+    uint16_t period_ms;                             // Read period, 0 keeps entry paused.
+    uint8_t priority;                               // 0 is highest, served first within a tick.
+} bsp_i2c_sched_cfg_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Create and start scheduler timer. Requires bsp_i2c_init.
+ * @param tick_ms scheduler resolution, periods are rounded up to it.
+ * @return true on success.
+ */
+bool bsp_i2c_sched_init(uint32_t tick_ms);
+
+/**
+ * @brief Register periodic register read. Reads of all due entries are queued
+ *      back to back on every tick, each as register write without STOP
+ *      followed by repeated START read.
+ * @param p_cfg entry configuration.
+ * @return entry handle, negative on error.
+ */
+int bsp_i2c_sched_register(const bsp_i2c_sched_cfg_t *p_cfg);
+
+/**
+ * @brief Change period of registered entry.
+ * @param handle entry handle.
+ * @param period_ms new period, 0 pauses the entry.
+ */
+void bsp_i2c_sched_period_set(int handle, uint16_t period_ms);
+
+/**
+ * @brief Copy latest complete reading of the entry. Lock free, safe to call
+ *      from any task while readings are published.
+ * @param handle entry handle.
+ * @param p_data output buffer.
+ * @param len bytes to copy, up to registered length.
+ * @param p_tick optional output, RTOS tick of the reading.
+ * @return false if there is no reading yet or arguments are invalid.
+ */
+bool bsp_i2c_sched_read(int handle, uint8_t *p_data, size_t len,
+                        uint32_t *p_tick);
+
+/**
+ * @brief Get number of failed reads of the entry.
+ * @param handle entry handle.
+ * @return failed reads.
+ */
+uint32_t bsp_i2c_sched_error_cnt_get(int handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BSP_I2C_SCHED_H__
@@ -0,0 +1,463 @@
+/** @file i2c_sched_host.c
+*
+* @brief Host test of the I2C scheduler. Jobs handed to the I2C queue are
+*        recorded instead of run, the harness fires the scheduler timer and
+*        completes jobs itself. Checks priority order of due reads, periods,
+*        pausing, error counting, the published readings and recovery from
+*        a read that never completes, failed by the queue timeout the
+*        scheduler polls for on every tick. Then reads
+*        latest reading in a loop while a timer signal, standing in for the
+*        I2C ISR, publishes new ones at random points of the copy, and counts
+*        torn copies:
+*
+*        gcc -O2 -DI2C_SCHED_HOST -Ihost -I. i2c_sched.c i2c_sched_host.c \
+*            host/mcu_host.c -o i2c_sched_host
+*        ./i2c_sched_host [publishes]
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/i2c_sched.h>
+#include <inc/bsp/i2c.h>
+#include <task.h>
+#include <timers.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_PUBLISHES              (20000u)
+#define HOST_ISR_US                 (20)
+#define HOST_QUEUE_LEN              (32u)
+// Default transfer timeout of the queue, 10 ms plus one tick.
+#define HOST_TIMEOUT_TICKS          (11u)
+
+#define HOST_CHECK(cond)            do { if (!(cond)) { \
+                                        host_fail(__LINE__, #cond); \
+                                        return false; } } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static bool test_order(void);
+static bool test_readings(void);
+static bool test_hung(void);
+static bool test_seqlock(uint32_t publishes);
+
+static void host_isr(int signal);
+static bool host_queue_check(const uint8_t *p_address, uint32_t cnt);
+static void host_complete(uint32_t index, int result, uint8_t fill);
+static void host_fail(int line, const char *p_cond);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static bsp_i2c_job_t *host_queue[HOST_QUEUE_LEN];
+static uint32_t host_queue_cnt;
+static bool host_queue_fail;
+// Read that never completes, failed by bsp_i2c_async_poll once timed out.
+static bsp_i2c_job_t *host_hung_job;
+static uint32_t host_hung_tick;
+static uint32_t host_poll_cnt;
+// Read completed by next interrupt, set by task once queued.
+static bsp_i2c_job_t *volatile host_isr_job;
+static volatile sig_atomic_t host_isr_cnt;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef I2C_SCHED_HOST
+int main(int argc, char **argv)
+{
+    uint32_t publishes = (1 < argc) ? (uint32_t)strtoul(argv[1], NULL, 0) :
+                                      HOST_PUBLISHES;
+    bool is_ok;
+
+    is_ok = bsp_i2c_sched_init(10u);
+    is_ok = is_ok && test_order();
+    is_ok = is_ok && test_readings();
+    is_ok = is_ok && test_hung();
+    is_ok = is_ok && test_seqlock(publishes);
+
+    printf("%s\n", is_ok ? "ok" : "failed");
+
+    return !is_ok;
+}
+#endif
+
+int bsp_i2c_transfer_async(int instance, bsp_i2c_job_t *p_job)
+{
+    (void)instance;
+
+    if (host_queue_fail)
+    {
+        return -1;
+    }
+
+    host_queue[host_queue_cnt % HOST_QUEUE_LEN] = p_job;
+    host_queue_cnt++;
+
+    return 0;
+}
+
+void bsp_i2c_async_poll(void)
+{
+    bsp_i2c_job_t *p_job = host_hung_job;
+
+    host_poll_cnt++;
+
+    // Queue timeout as in i2c.c, tested with the real queue in i2c_host.c.
+    if ((NULL != p_job) &&
+        ((uint32_t)(host_tick - host_hung_tick) > HOST_TIMEOUT_TICKS))
+    {
+        host_hung_job = NULL;
+        p_job->done(BSP_I2C_RESULT_TIMEOUT, p_job->p_ctx);
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+//---- Tests ----
+
+static bool test_order(void)
+{
+    const bsp_i2c_sched_cfg_t cfg[] = {
+        { .instance = 1, .address = 0x10, .reg = 0x20, .length = 2,
+          .period_ms = 10, .priority = 2 },
+        { .instance = 1, .address = 0x11, .reg = 0x21, .length = 6,
+          .period_ms = 10, .priority = 0 },
+        { .instance = 2, .address = 0x12, .reg = 0x22, .length = 1,
+          .period_ms = 20, .priority = 1 },
+        { .instance = 1, .address = 0x13, .reg = 0x23, .length = 4,
+          .period_ms = 10, .priority = 0 },
+        { .instance = 1, .address = 0x14, .reg = 0x24, .length = 4,
+          .period_ms = 0, .priority = 1 },
+    };
+    int handle[5];
+
+    for (int index = 0; index < 5; index++)
+    {
+        handle[index] = bsp_i2c_sched_register(&cfg[index]);
+        HOST_CHECK(index == handle[index]);
+    }
+
+    // Invalid configurations are refused.
+    bsp_i2c_sched_cfg_t bad = cfg[0];
+    bad.instance = 4;
+    HOST_CHECK(0 > bsp_i2c_sched_register(&bad));
+    bad = cfg[0];
+    bad.length = BSP_I2C_SCHED_DATA_MAX + 1u;
+    HOST_CHECK(0 > bsp_i2c_sched_register(&bad));
+
+    // All running entries are due at once, by priority, equal priorities in
+    // registration order, paused entry left out.
+    host_tick = 0u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(host_queue_check((const uint8_t []){ 0x11, 0x13, 0x12, 0x10 },
+                                4u));
+
+    // Register write without STOP, then repeated START read.
+    bsp_i2c_job_t *p_job = host_queue[0];
+    HOST_CHECK(2 == p_job->trx_len);
+    HOST_CHECK((0x11 << 1) == p_job->p_trx[0].address);
+    HOST_CHECK((1u == p_job->p_trx[0].length) &&
+               (0x21 == p_job->p_trx[0].data[0]));
+    HOST_CHECK(BSP_I2C_MODE_SEQUENTIAL_FIRST_FRAME == p_job->p_trx[0].mode);
+    HOST_CHECK(((0x11 << 1) | BSP_I2C_READ_FLAG) == p_job->p_trx[1].address);
+    HOST_CHECK(6u == p_job->p_trx[1].length);
+    HOST_CHECK(BSP_I2C_MODE_SEQUENTIAL_LAST_FRAME == p_job->p_trx[1].mode);
+
+    // Entries in flight are not queued again.
+    host_tick = 10u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(0u == host_queue_cnt);
+
+    for (uint32_t index = 0; index < 4u; index++)
+    {
+        host_complete(index, 0, 0u);
+    }
+
+    // Entry with 20 ms period is not due yet.
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(host_queue_check((const uint8_t []){ 0x11, 0x13, 0x10 }, 3u));
+    for (uint32_t index = 0; index < 3u; index++)
+    {
+        host_complete(index, 0, 0u);
+    }
+
+    // Resumed entry takes its place by priority.
+    bsp_i2c_sched_period_set(handle[4], 10u);
+    host_tick = 20u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(host_queue_check((const uint8_t []){ 0x11, 0x13, 0x12, 0x14,
+                                                    0x10 }, 5u));
+    for (uint32_t index = 0; index < 5u; index++)
+    {
+        host_complete(index, 0, 0u);
+    }
+
+    // Queue refusal and failed reads are counted, entry is retried.
+    host_tick = 30u;
+    host_queue_cnt = 0u;
+    host_queue_fail = true;
+    HOST_CHECK(host_timer_fire(NULL));
+    host_queue_fail = false;
+    HOST_CHECK(1u == bsp_i2c_sched_error_cnt_get(handle[1]));
+
+    host_tick = 40u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(5u == host_queue_cnt);
+    host_complete(0, BSP_I2C_RESULT_NACK, 0u);
+    HOST_CHECK(2u == bsp_i2c_sched_error_cnt_get(handle[1]));
+    for (uint32_t index = 1; index < 5u; index++)
+    {
+        host_complete(index, 0, 0u);
+    }
+
+    // Pause all, following tests use their own entries.
+    for (int index = 0; index < 5; index++)
+    {
+        bsp_i2c_sched_period_set(handle[index], 0u);
+    }
+
+    return true;
+}
+
+static bool test_readings(void)
+{
+    const bsp_i2c_sched_cfg_t cfg = {
+        .instance = 3, .address = 0x40, .reg = 0x00, .length = 8,
+        .period_ms = 10, .priority = 0
+    };
+    uint8_t data[BSP_I2C_SCHED_DATA_MAX];
+    uint32_t tick = 0u;
+    int handle = bsp_i2c_sched_register(&cfg);
+
+    HOST_CHECK(0 <= handle);
+
+    // Nothing read yet, bad arguments.
+    HOST_CHECK(!bsp_i2c_sched_read(handle, data, 8u, &tick));
+    HOST_CHECK(!bsp_i2c_sched_read(handle, data, 9u, &tick));
+    HOST_CHECK(!bsp_i2c_sched_read(handle + 1, data, 1u, &tick));
+    HOST_CHECK(!bsp_i2c_sched_read(-1, data, 1u, &tick));
+
+    host_tick = 100u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL) && (1u == host_queue_cnt));
+    host_tick = 103u;
+    host_complete(0, 0, 0xA1);
+
+    HOST_CHECK(bsp_i2c_sched_read(handle, data, 8u, &tick));
+    HOST_CHECK((0xA1 == data[0]) && (0xA1 == data[7]) && (103u == tick));
+
+    // Failed read keeps the previous reading.
+    host_tick = 110u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL) && (1u == host_queue_cnt));
+    host_complete(0, BSP_I2C_RESULT_TIMEOUT, 0xB2);
+    HOST_CHECK(bsp_i2c_sched_read(handle, data, 8u, NULL));
+    HOST_CHECK((0xA1 == data[0]) && (0xA1 == data[7]));
+
+    // Next read lands in the other buffer and becomes the latest.
+    host_tick = 120u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL) && (1u == host_queue_cnt));
+    host_complete(0, 0, 0xC3);
+    HOST_CHECK(bsp_i2c_sched_read(handle, data, 4u, &tick));
+    HOST_CHECK((0xC3 == data[0]) && (0xC3 == data[3]) && (120u == tick));
+
+    bsp_i2c_sched_period_set(handle, 0u);
+
+    return true;
+}
+
+static bool test_hung(void)
+{
+    const bsp_i2c_sched_cfg_t cfg[] = {
+        { .instance = 2, .address = 0x30, .reg = 0x00, .length = 2,
+          .period_ms = 10, .priority = 0 },
+        { .instance = 2, .address = 0x31, .reg = 0x00, .length = 2,
+          .period_ms = 10, .priority = 1 },
+    };
+    uint8_t data[2];
+    int handle[2];
+
+    for (int index = 0; index < 2; index++)
+    {
+        handle[index] = bsp_i2c_sched_register(&cfg[index]);
+        HOST_CHECK(0 <= handle[index]);
+    }
+
+    // First read hangs on the bus, the second waits behind it.
+    host_tick = 200u;
+    host_queue_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(host_queue_check((const uint8_t []){ 0x30, 0x31 }, 2u));
+    host_hung_job = host_queue[0];
+    host_hung_tick = host_tick;
+    bsp_i2c_job_t *p_waiting = host_queue[1];
+
+    // Due again but within timeout, both stay in flight.
+    host_tick = 211u;
+    host_queue_cnt = 0u;
+    host_poll_cnt = 0u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK((1u == host_poll_cnt) && (0u == host_queue_cnt));
+    HOST_CHECK(0u == bsp_i2c_sched_error_cnt_get(handle[0]));
+
+    // Timed out from the tick, counted and queued again in the same pass.
+    host_tick = 212u;
+    HOST_CHECK(host_timer_fire(NULL));
+    HOST_CHECK(NULL == host_hung_job);
+    HOST_CHECK(1u == bsp_i2c_sched_error_cnt_get(handle[0]));
+    HOST_CHECK(host_queue_check((const uint8_t []){ 0x30 }, 1u));
+
+    // Job behind the failed one runs, then the retried read.
+    memset(p_waiting->p_trx[1].data, 0x5B, p_waiting->p_trx[1].length);
+    p_waiting->done(0, p_waiting->p_ctx);
+    HOST_CHECK(bsp_i2c_sched_read(handle[1], data, sizeof(data), NULL));
+    HOST_CHECK(0x5B == data[1]);
+
+    HOST_CHECK(!bsp_i2c_sched_read(handle[0], data, sizeof(data), NULL));
+    host_complete(0, 0, 0x5A);
+    HOST_CHECK(bsp_i2c_sched_read(handle[0], data, sizeof(data), NULL));
+    HOST_CHECK(0x5A == data[1]);
+    HOST_CHECK(1u == bsp_i2c_sched_error_cnt_get(handle[0]));
+
+    for (int index = 0; index < 2; index++)
+    {
+        bsp_i2c_sched_period_set(handle[index], 0u);
+    }
+
+    return true;
+}
+
+static bool test_seqlock(uint32_t publishes)
+{
+    const bsp_i2c_sched_cfg_t cfg = {
+        .instance = 1, .address = 0x50, .reg = 0x00,
+        .length = BSP_I2C_SCHED_DATA_MAX, .period_ms = 1, .priority = 0
+    };
+    const struct itimerval period = {
+        .it_interval = { .tv_usec = HOST_ISR_US },
+        .it_value = { .tv_usec = HOST_ISR_US }
+    };
+    uint8_t data[BSP_I2C_SCHED_DATA_MAX];
+    uint32_t tick;
+    uint32_t last = 0u;
+    uint32_t reads = 0u;
+    uint32_t changes = 0u;
+    uint32_t torn = 0u;
+    int handle = bsp_i2c_sched_register(&cfg);
+
+    HOST_CHECK(0 <= handle);
+
+    signal(SIGALRM, host_isr);
+    HOST_CHECK(0 == setitimer(ITIMER_REAL, &period, NULL));
+
+    // Task side: queue next read once the previous one is published and
+    // seen, read latest reading and check it is one whole reading.
+    while (publishes > changes)
+    {
+        if ((NULL == host_isr_job) && (changes == (uint32_t)host_isr_cnt))
+        {
+            host_queue_cnt = 0u;
+            host_timer_fire(NULL);
+            if (0u < host_queue_cnt)
+            {
+                host_isr_job = host_queue[0];
+            }
+        }
+
+        if (!bsp_i2c_sched_read(handle, data, sizeof(data), &tick))
+        {
+            continue;
+        }
+
+        reads++;
+        changes += (tick != last);
+        last = tick;
+
+        for (uint32_t index = 0; index < sizeof(data); index++)
+        {
+            if ((uint8_t)tick != data[index])
+            {
+                torn++;
+                break;
+            }
+        }
+    }
+
+    setitimer(ITIMER_REAL, &(struct itimerval){ 0 }, NULL);
+    signal(SIGALRM, SIG_DFL);
+
+    printf("%u publishes from ISR, %u reads, %u changes seen, %u torn\n",
+           (uint32_t)host_isr_cnt, reads, changes, torn);
+
+    HOST_CHECK(0u == torn);
+    HOST_CHECK((0u < reads) && (publishes == changes));
+
+    return true;
+}
+
+//---- Helpers ----
+
+// Completes queued read as the I2C ISR, preempting the task at any point.
+static void host_isr(int signal)
+{
+    bsp_i2c_job_t *p_job = host_isr_job;
+
+    (void)signal;
+
+    if (NULL != p_job)
+    {
+        host_tick++;
+        memset(p_job->p_trx[1].data, (uint8_t)host_tick,
+               p_job->p_trx[1].length);
+        p_job->done(0, p_job->p_ctx);
+        host_isr_job = NULL;
+        host_isr_cnt++;
+    }
+}
+
+static bool host_queue_check(const uint8_t *p_address, uint32_t cnt)
+{
+    if (cnt != host_queue_cnt)
+    {
+        return false;
+    }
+
+    for (uint32_t index = 0; index < cnt; index++)
+    {
+        if ((p_address[index] << 1) != host_queue[index]->p_trx[0].address)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fill read buffer of a queued job and run its completion as the I2C ISR.
+static void host_complete(uint32_t index, int result, uint8_t fill)
+{
+    bsp_i2c_job_t *p_job = host_queue[index];
+
+    memset(p_job->p_trx[1].data, fill, p_job->p_trx[1].length);
+    p_job->done(result, p_job->p_ctx);
+}
+
+static void host_fail(int line, const char *p_cond)
+{
+    fprintf(stderr, "line %d: %s\n", line, p_cond);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
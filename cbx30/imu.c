@@ -16,6 +16,14 @@
 #include <blspi-gpio.h>
 #include <blgpio.h>
 #include <blgpio-stm32-hal.h>
+#include <stm32l4xx_hal.h>
+#include <stm32l4xx_ll_bus.h>
+#include <stm32l4xx_ll_dma.h>
+#include <stm32l4xx_ll_spi.h>
+#include <inc/bsp/bsp.h>
+#include <inc/bsp/rtc.h>
+#include <inc/bsp/lowpower.h>
+#include <string.h>
 
 //-------------------------------- MACROS -------------------------------------
 #define     PIN_ACC_MOSI    BLGPIO_STM32_GPIO_ID('E', 15)
@@ -25,10 +33,124 @@
 
 #define     PIN_ACC_IN      BLGPIO_STM32_GPIO_ID('B', 11)
 
+// Register level access of the same pins for the FIFO burst.
+#define     IMU_CS_PORT     GPIOB
+#define     IMU_CS_PIN      GPIO_PIN_12
+#define     IMU_INT1_PORT   GPIOB
+#define     IMU_INT1_PIN    GPIO_PIN_11
+#define     IMU_INT1_IRQ    EXTI15_10_IRQn
+#define     IMU_IRQ_PRIO    (5u)
+
+#define     IMU_SPI         SPI1
+// LSM6DSL SPI clock limit.
+#define     IMU_SPI_MAX_HZ  (10000000u)
+
+// SPI1 DMA, RM0351 request mapping.
+#define     IMU_DMA         DMA2
+#define     IMU_DMA_RX_CH   LL_DMA_CHANNEL_3
+#define     IMU_DMA_TX_CH   LL_DMA_CHANNEL_4
+#define     IMU_DMA_REQ     LL_DMA_REQUEST_4
+#define     IMU_DMA_RX_IRQ  DMA2_Channel3_IRQn
+
+// LSM6DSL registers.
+#define     IMU_REG_FIFO_CTRL1      (0x06u)
+#define     IMU_REG_FIFO_CTRL3      (0x08u)
+#define     IMU_REG_FIFO_CTRL5      (0x0Au)
+#define     IMU_REG_INT1_CTRL       (0x0Du)
+#define     IMU_REG_WHO_AM_I        (0x0Fu)
+#define     IMU_REG_CTRL1_XL        (0x10u)
+#define     IMU_REG_CTRL2_G         (0x11u)
+#define     IMU_REG_CTRL3_C         (0x12u)
+#define     IMU_REG_FIFO_STATUS1    (0x3Au)
+#define     IMU_REG_FIFO_DATA_OUT_L (0x3Eu)
+
+#define     IMU_WHO_AM_I            (0x6Au)
+#define     IMU_CTRL3_C_BDU_IF_INC  (0x44u)
+#define     IMU_FS_XL_8G            (0x0Cu)
+#define     IMU_FS_G_2000DPS        (0x0Cu)
+#define     IMU_FIFO_NO_DECIMATION  (0x09u)
+#define     IMU_FIFO_MODE_BYPASS    (0x00u)
+#define     IMU_FIFO_MODE_CONT      (0x06u)
+#define     IMU_INT1_FTH            (0x08u)
+#define     IMU_FIFO_DIFF_MASK      (0x07FFu)
+#define     IMU_FIFO_OVER_RUN       (0x4000u)
+#define     IMU_FIFO_PATTERN_MASK   (0x03FFu)
+
+// FIFO holds 2048 words, one data set is gyro XYZ followed by acc XYZ.
+#define     IMU_FIFO_WORDS          (2048u)
+#define     IMU_SET_WORDS           (6u)
+#define     IMU_WATERMARK_MAX       ((IMU_FIFO_WORDS - 1u) / IMU_SET_WORDS)
+#define     IMU_BURST_BUF_SIZE      (IMU_FIFO_WORDS * 2u)
+// Samples decoded per consumer call.
+#define     IMU_CB_CHUNK            (16u)
+// Sample period estimate, ms in Q16, filtered with 1 / (1 << shift).
+#define     IMU_PERIOD_EMA_SHIFT    (3u)
+
 //----------------------------- DATA TYPES ------------------------------------
 
+// Owner of the SPI bus, register access from task or FIFO burst.
+typedef enum {
+    IMU_SPI_FREE = 0,
+    IMU_SPI_TASK,
+    IMU_SPI_FIFO,
+} imu_spi_owner_t;
+
 //--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
 
+/**
+ * @brief Try to take the SPI bus. Safe from ISR.
+ * @param owner new owner
+ * @return true if taken
+ */
+static bool imu_spi_acquire (imu_spi_owner_t owner);
+
+/**
+ * @brief Take the SPI bus for register access from task, waits for a
+ *        running FIFO burst.
+ */
+static void imu_spi_task_acquire (void);
+
+/**
+ * @brief Release the SPI bus taken from task, starts a FIFO burst deferred
+ *        while the bus was taken.
+ */
+static void imu_spi_task_release (void);
+
+/**
+ * @brief Start FIFO burst if FIFO has data, bus is free and previous burst
+ *        was processed, otherwise remember it for later. Safe from ISR.
+ */
+static void imu_fifo_kick (void);
+
+/**
+ * @brief Exchange one byte over SPI by polling.
+ * @param out byte to send
+ * @return received byte
+ */
+static uint8_t imu_spi_xfer (uint8_t out);
+
+/**
+ * @brief Save SPI configuration of blspi and switch to FIFO burst settings.
+ */
+static void imu_spi_burst_cfg (void);
+
+/**
+ * @brief End FIFO burst, restore blspi SPI configuration and release bus.
+ */
+static void imu_spi_burst_end (void);
+
+/**
+ * @brief Decode finished burst into timestamped samples for the consumer.
+ */
+static void imu_fifo_parse (void);
+
+/**
+ * @brief Update sample period estimate from burst timing.
+ * @param tick status read time of the new burst
+ * @param new_sets sets which arrived since previous burst status read
+ */
+static void imu_period_update (uint32_t tick, uint32_t new_sets);
+
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 static blspi_master_t master0;
 static blspi_stm32_hal_t hspi1;
@@ -37,7 +159,7 @@ static blspi_device_t dev0 = {
         .cs = PIN_ACC_CS,
         .config = {
                 .mode = 0,
-                .speed_hz = 500000,
+                .speed_hz = IMU_SPI_MAX_HZ,
                 .lsb_ordering = false,
         },
 };
@@ -45,6 +167,36 @@ static blspi_device_t dev0 = {
 static uint8_t init_flag = 0;
 static uint8_t init_stat = 0;
 
+// ODR of gyro, accelerometer and FIFO in Hz, index is register ODR code.
+static const uint16_t imu_odr_hz[] = { 0u, 13u, 26u, 52u, 104u, 208u, 416u,
+                                       833u, 1660u };
+
+static volatile uint8_t imu_spi_owner;
+static volatile bool imu_fifo_running;
+static volatile bool imu_fifo_pending;
+static bsp_imu_fifo_cb_t imu_fifo_cb;
+static bsp_imu_fifo_signal_t imu_fifo_signal;
+
+// Raw burst, owned by DMA until imu_burst_ready and by task until processed.
+static uint8_t imu_burst_buf[IMU_BURST_BUF_SIZE];
+static volatile bool imu_burst_ready;
+static uint16_t imu_burst_words;
+static uint16_t imu_burst_skip;                     // Words before first set.
+static uint32_t imu_burst_tick;                     // Status read time.
+static uint32_t imu_burst_sets_total;               // Sets in FIFO at status.
+static uint16_t imu_tx_dummy;
+
+// Burst timing, used from burst start only.
+static uint32_t imu_prev_tick;
+static uint32_t imu_prev_left;                      // Sets left unread.
+static bool imu_prev_valid;
+static volatile uint32_t imu_period_q16;
+
+static uint32_t imu_spi_cr1;
+static uint32_t imu_spi_cr2;
+
+static bsp_imu_fifo_stats_t imu_fifo_stats;
+
 //------------------------------ GLOBAL DATA ----------------------------------
 uint8_t bsp_imu_spi_init ()
 {
@@ -93,7 +245,9 @@ uint8_t bsp_imu_spi_read (uint8_t reg_addr, uint8_t *p_buff, uint16_t buff_len)
             },
     };
 
+    imu_spi_task_acquire();
     ret = blspi_dev_transfer_multiple(&dev0, conversation, 2);
+    imu_spi_task_release();
 
     return ret;
 }
@@ -113,13 +267,436 @@ uint8_t bsp_imu_spi_write (uint8_t reg_addr, uint8_t *p_buff, uint16_t buff_len)
             },
     };
 
+    imu_spi_task_acquire();
     ret = blspi_dev_transfer_multiple(&dev0, conversation, 2);
+    imu_spi_task_release();
 
     return ret;
 }
 
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
 
+uint8_t bsp_imu_fifo_start (uint16_t odr_hz, uint16_t watermark,
+                            bsp_imu_fifo_cb_t cb, bsp_imu_fifo_signal_t signal)
+{
+    uint8_t ret = BLSPI_ERROR_OK;
+    uint8_t odr = 0u;
+    uint8_t reg;
+
+    for (uint8_t index = 1u; index < (sizeof(imu_odr_hz) / sizeof(imu_odr_hz[0]));
+         index++)
+    {
+        if (imu_odr_hz[index] == odr_hz)
+        {
+            odr = index;
+        }
+    }
+
+    if ((0u == odr) || (0u == watermark) || (IMU_WATERMARK_MAX < watermark) ||
+        (NULL == cb) || (imu_fifo_running))
+    {
+        ret = BLSPI_ERROR_UNKNOWN;
+    }
+    else
+    {
+        ret = bsp_imu_spi_init();
+    }
+
+    if (BLSPI_ERROR_OK == ret)
+    {
+        ret = bsp_imu_spi_read(IMU_REG_WHO_AM_I, &reg, 1u);
+        if ((BLSPI_ERROR_OK == ret) && (IMU_WHO_AM_I != reg))
+        {
+            ret = BLSPI_ERROR_NO_DEVICE;
+        }
+    }
+
+    if (BLSPI_ERROR_OK == ret)
+    {
+        uint16_t fth = watermark * IMU_SET_WORDS;
+        uint8_t cfg[] = {
+            // FIFO_CTRL1..FIFO_CTRL5, bypass mode clears the FIFO.
+            (uint8_t)fth,
+            (uint8_t)(fth >> 8),
+            IMU_FIFO_NO_DECIMATION,
+            0u,
+            IMU_FIFO_MODE_BYPASS,
+        };
+        uint8_t ctrl[] = {
+            // CTRL1_XL..CTRL3_C
+            (uint8_t)((odr << 4) | IMU_FS_XL_8G),
+            (uint8_t)((odr << 4) | IMU_FS_G_2000DPS),
+            IMU_CTRL3_C_BDU_IF_INC,
+        };
+
+        imu_fifo_cb = cb;
+        imu_fifo_signal = signal;
+        imu_fifo_pending = false;
+        imu_burst_ready = false;
+        imu_prev_valid = false;
+        imu_prev_left = 0u;
+        imu_period_q16 = (1000u << 16) / odr_hz;
+        memset(&imu_fifo_stats, 0, sizeof(imu_fifo_stats));
+
+        ret |= bsp_imu_spi_write(IMU_REG_FIFO_CTRL1, cfg, sizeof(cfg));
+        ret |= bsp_imu_spi_write(IMU_REG_CTRL1_XL, ctrl, sizeof(ctrl));
+        ret |= bsp_imu_spi_read(IMU_REG_INT1_CTRL, &reg, 1u);
+        reg |= IMU_INT1_FTH;
+        ret |= bsp_imu_spi_write(IMU_REG_INT1_CTRL, &reg, 1u);
+
+        reg = (uint8_t)((odr << 3) | IMU_FIFO_MODE_CONT);
+        ret |= bsp_imu_spi_write(IMU_REG_FIFO_CTRL5, &reg, 1u);
+    }
+
+    if (BLSPI_ERROR_OK == ret)
+    {
+        GPIO_InitTypeDef gpio = {
+            .Pin = IMU_INT1_PIN,
+            .Mode = GPIO_MODE_IT_RISING,
+            .Pull = GPIO_NOPULL,
+        };
+
+        LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+
+        LL_DMA_SetPeriphRequest(IMU_DMA, IMU_DMA_RX_CH, IMU_DMA_REQ);
+        LL_DMA_ConfigTransfer(IMU_DMA, IMU_DMA_RX_CH,
+                              LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+                              LL_DMA_PRIORITY_HIGH | LL_DMA_MODE_NORMAL |
+                              LL_DMA_PERIPH_NOINCREMENT |
+                              LL_DMA_MEMORY_INCREMENT |
+                              LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE);
+        LL_DMA_SetPeriphAddress(IMU_DMA, IMU_DMA_RX_CH,
+                                (uint32_t)&IMU_SPI->DR);
+        LL_DMA_EnableIT_TC(IMU_DMA, IMU_DMA_RX_CH);
+        LL_DMA_EnableIT_TE(IMU_DMA, IMU_DMA_RX_CH);
+
+        // TX only clocks the read, it repeats one dummy byte.
+        LL_DMA_SetPeriphRequest(IMU_DMA, IMU_DMA_TX_CH, IMU_DMA_REQ);
+        LL_DMA_ConfigTransfer(IMU_DMA, IMU_DMA_TX_CH,
+                              LL_DMA_DIRECTION_MEMORY_TO_PERIPH |
+                              LL_DMA_PRIORITY_HIGH | LL_DMA_MODE_NORMAL |
+                              LL_DMA_PERIPH_NOINCREMENT |
+                              LL_DMA_MEMORY_NOINCREMENT |
+                              LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE);
+        LL_DMA_SetPeriphAddress(IMU_DMA, IMU_DMA_TX_CH,
+                                (uint32_t)&IMU_SPI->DR);
+        LL_DMA_SetMemoryAddress(IMU_DMA, IMU_DMA_TX_CH,
+                                (uint32_t)&imu_tx_dummy);
+
+        NVIC_SetPriority(IMU_DMA_RX_IRQ,
+                         NVIC_EncodePriority(NVIC_GetPriorityGrouping(),
+                                             IMU_IRQ_PRIO, 0));
+        NVIC_EnableIRQ(IMU_DMA_RX_IRQ);
+
+        HAL_GPIO_Init(IMU_INT1_PORT, &gpio);
+        HAL_NVIC_SetPriority(IMU_INT1_IRQ, IMU_IRQ_PRIO, 0);
+        HAL_NVIC_EnableIRQ(IMU_INT1_IRQ);
+
+        imu_fifo_running = true;
+
+        // Watermark may already be reached, its edge is gone then.
+        imu_fifo_kick();
+    }
+
+    return ret;
+}
+
+void bsp_imu_fifo_stop (void)
+{
+    uint8_t reg = IMU_FIFO_MODE_BYPASS;
+
+    imu_fifo_running = false;
+    CLEAR_BIT(EXTI->IMR1, IMU_INT1_PIN);
+
+    // Waits for running burst, FIFO is cleared in bypass mode.
+    bsp_imu_spi_write(IMU_REG_FIFO_CTRL5, &reg, 1u);
+
+    imu_burst_ready = false;
+    imu_fifo_pending = false;
+}
+
+void bsp_imu_fifo_process (void)
+{
+    if (imu_burst_ready)
+    {
+        imu_fifo_parse();
+        imu_burst_ready = false;
+    }
+
+    // Watermark edge may have been missed while the burst waited here.
+    if (imu_fifo_pending ||
+        (GPIO_PIN_SET == HAL_GPIO_ReadPin(IMU_INT1_PORT, IMU_INT1_PIN)))
+    {
+        imu_fifo_kick();
+    }
+}
+
+void bsp_imu_fifo_irq_handler (void)
+{
+    imu_fifo_stats.irqs++;
+    imu_fifo_kick();
+}
+
+void bsp_imu_fifo_stats_get (bsp_imu_fifo_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        *p_stats = imu_fifo_stats;
+        p_stats->period_q16 = imu_period_q16;
+    }
+}
+
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 
+static void imu_fifo_parse (void)
+{
+    bsp_imu_sample_t samples[IMU_CB_CHUNK];
+    size_t cnt = 0u;
+    const uint8_t *p_raw = &imu_burst_buf[imu_burst_skip * 2u];
+    uint32_t sets = (imu_burst_words - imu_burst_skip) / IMU_SET_WORDS;
+    uint32_t period_q16 = imu_period_q16;
+
+    for (uint32_t set = 0u; set < sets; set++)
+    {
+        bsp_imu_sample_t *p_sample = &samples[cnt];
+
+        // Newest set in FIFO was sampled at status read time.
+        uint32_t age = imu_burst_sets_total - 1u - set;
+        p_sample->tick = imu_burst_tick -
+                         (uint32_t)(((uint64_t)age * period_q16) >> 16);
+
+        for (uint32_t axis = 0u; axis < 3u; axis++)
+        {
+            p_sample->gyro[axis] = (int16_t)(p_raw[0] | (p_raw[1] << 8));
+            p_sample->acc[axis] = (int16_t)(p_raw[6] | (p_raw[7] << 8));
+            p_raw += 2u;
+        }
+        p_raw += 6u;
+
+        cnt++;
+        if ((IMU_CB_CHUNK == cnt) || ((set + 1u) == sets))
+        {
+            imu_fifo_cb(samples, cnt);
+            cnt = 0u;
+        }
+    }
+
+    imu_fifo_stats.samples += sets;
+}
+
+static bool imu_spi_acquire (imu_spi_owner_t owner)
+{
+    uint8_t expected = IMU_SPI_FREE;
+    bool taken = __atomic_compare_exchange_n(&imu_spi_owner, &expected,
+                                             (uint8_t)owner, false,
+                                             __ATOMIC_ACQUIRE,
+                                             __ATOMIC_RELAXED);
+
+    if (taken)
+    {
+        // SPI and DMA clocks are needed, SCK must not change meanwhile.
+        bsp_lowpower_stop_veto(BSP_LOWPOWER_IMU_SPI, true);
+    }
+
+    return taken;
+}
+
+static void imu_spi_task_acquire (void)
+{
+    while (!imu_spi_acquire(IMU_SPI_TASK))
+    {
+        bsp_delay_ms(1u);
+    }
+}
+
+static void imu_spi_task_release (void)
+{
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_IMU_SPI, false);
+    __atomic_store_n(&imu_spi_owner, IMU_SPI_FREE, __ATOMIC_RELEASE);
+
+    if (imu_fifo_pending)
+    {
+        imu_fifo_kick();
+    }
+}
+
+static void imu_fifo_kick (void)
+{
+    if ((!imu_fifo_running) || imu_burst_ready ||
+        (!imu_spi_acquire(IMU_SPI_FIFO)))
+    {
+        imu_fifo_pending = imu_fifo_running;
+        return;
+    }
+
+    imu_fifo_pending = false;
+    imu_spi_burst_cfg();
+
+    // FIFO_STATUS1..4: unread words, flags and pattern of next word.
+    uint8_t status[4];
+
+    HAL_GPIO_WritePin(IMU_CS_PORT, IMU_CS_PIN, GPIO_PIN_RESET);
+    imu_spi_xfer(0x80u | IMU_REG_FIFO_STATUS1);
+    for (uint32_t index = 0u; index < sizeof(status); index++)
+    {
+        status[index] = imu_spi_xfer(0u);
+    }
+    HAL_GPIO_WritePin(IMU_CS_PORT, IMU_CS_PIN, GPIO_PIN_SET);
+
+    uint32_t tick = bsp_rtc_tick_get();
+    uint32_t diff = (uint32_t)(status[0] | (status[1] << 8));
+    uint32_t pattern = (uint32_t)(status[2] | (status[3] << 8)) &
+                       IMU_FIFO_PATTERN_MASK;
+    uint32_t words = diff & IMU_FIFO_DIFF_MASK;
+
+    if (diff & IMU_FIFO_OVER_RUN)
+    {
+        imu_fifo_stats.overruns++;
+        // Samples were lost, period can not be derived from this burst.
+        imu_prev_valid = false;
+    }
+
+    // Words of a set started before, FIFO restarted after overrun.
+    uint32_t skip = (0u == pattern) ? 0u : (IMU_SET_WORDS - pattern);
+    uint32_t sets = (words > skip) ? ((words - skip) / IMU_SET_WORDS) : 0u;
+    uint32_t read_sets = sets;
+
+    if (read_sets > ((IMU_BURST_BUF_SIZE / 2u) - skip) / IMU_SET_WORDS)
+    {
+        read_sets = ((IMU_BURST_BUF_SIZE / 2u) - skip) / IMU_SET_WORDS;
+    }
+
+    if (0u == sets)
+    {
+        imu_spi_burst_end();
+        return;
+    }
+
+    if (sets > imu_prev_left)
+    {
+        imu_period_update(tick, sets - imu_prev_left);
+    }
+    imu_prev_left = sets - read_sets;
+
+    imu_burst_tick = tick;
+    imu_burst_sets_total = sets;
+    imu_burst_skip = (uint16_t)skip;
+    imu_burst_words = (uint16_t)(skip + (read_sets * IMU_SET_WORDS));
+
+    uint32_t len = imu_burst_words * 2u;
+
+    // Address is sent by polling, FIFO output rolls over 0x3E/0x3F.
+    HAL_GPIO_WritePin(IMU_CS_PORT, IMU_CS_PIN, GPIO_PIN_RESET);
+    imu_spi_xfer(0x80u | IMU_REG_FIFO_DATA_OUT_L);
+
+    LL_DMA_SetMemoryAddress(IMU_DMA, IMU_DMA_RX_CH, (uint32_t)imu_burst_buf);
+    LL_DMA_SetDataLength(IMU_DMA, IMU_DMA_RX_CH, len);
+    LL_DMA_SetDataLength(IMU_DMA, IMU_DMA_TX_CH, len);
+
+    LL_SPI_EnableDMAReq_RX(IMU_SPI);
+    LL_DMA_EnableChannel(IMU_DMA, IMU_DMA_RX_CH);
+    LL_DMA_EnableChannel(IMU_DMA, IMU_DMA_TX_CH);
+    LL_SPI_EnableDMAReq_TX(IMU_SPI);
+
+    imu_fifo_stats.bursts++;
+}
+
+static uint8_t imu_spi_xfer (uint8_t out)
+{
+    while (!LL_SPI_IsActiveFlag_TXE(IMU_SPI))
+    {
+    }
+    LL_SPI_TransmitData8(IMU_SPI, out);
+
+    while (!LL_SPI_IsActiveFlag_RXNE(IMU_SPI))
+    {
+    }
+
+    return LL_SPI_ReceiveData8(IMU_SPI);
+}
+
+static void imu_spi_burst_cfg (void)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t br = 0u;
+
+    // Fastest prescaler (2 << br) within the IMU limit.
+    while ((7u > br) && ((pclk / (2u << br)) > IMU_SPI_MAX_HZ))
+    {
+        br++;
+    }
+
+    imu_spi_cr1 = IMU_SPI->CR1;
+    imu_spi_cr2 = IMU_SPI->CR2;
+
+    LL_SPI_Disable(IMU_SPI);
+    IMU_SPI->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI |
+                   (br << SPI_CR1_BR_Pos);
+    IMU_SPI->CR2 = LL_SPI_DATAWIDTH_8BIT | SPI_CR2_FRXTH;
+    LL_SPI_Enable(IMU_SPI);
+}
+
+static void imu_spi_burst_end (void)
+{
+    while (LL_SPI_IsActiveFlag_BSY(IMU_SPI))
+    {
+    }
+    HAL_GPIO_WritePin(IMU_CS_PORT, IMU_CS_PIN, GPIO_PIN_SET);
+
+    LL_SPI_Disable(IMU_SPI);
+    IMU_SPI->CR2 = imu_spi_cr2;
+    IMU_SPI->CR1 = imu_spi_cr1;
+
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_IMU_SPI, false);
+    __atomic_store_n(&imu_spi_owner, IMU_SPI_FREE, __ATOMIC_RELEASE);
+}
+
+static void imu_period_update (uint32_t tick, uint32_t new_sets)
+{
+    if (imu_prev_valid && (0u < new_sets))
+    {
+        uint32_t period_q16 = (uint32_t)(((uint64_t)(tick - imu_prev_tick)
+                                          << 16) / new_sets);
+        int32_t err = (int32_t)(period_q16 - imu_period_q16);
+
+        imu_period_q16 += (uint32_t)(err / (1 << IMU_PERIOD_EMA_SHIFT));
+    }
+
+    imu_prev_tick = tick;
+    imu_prev_valid = true;
+}
+
 //--------------------------- INTERRUPT HANDLERS ------------------------------
+
+void DMA2_Channel3_IRQHandler (void)
+{
+    uint32_t shift = IMU_DMA_RX_CH * 4u;
+    bool is_err = (0u != (IMU_DMA->ISR & (DMA_ISR_TEIF1 << shift)));
+
+    IMU_DMA->IFCR = (DMA_IFCR_CGIF1 << shift);
+    IMU_DMA->IFCR = (DMA_IFCR_CGIF1 << (IMU_DMA_TX_CH * 4u));
+
+    LL_SPI_DisableDMAReq_TX(IMU_SPI);
+    LL_DMA_DisableChannel(IMU_DMA, IMU_DMA_TX_CH);
+    LL_DMA_DisableChannel(IMU_DMA, IMU_DMA_RX_CH);
+    LL_SPI_DisableDMAReq_RX(IMU_SPI);
+
+    imu_spi_burst_end();
+
+    if (is_err)
+    {
+        // Retried from bsp_imu_fifo_process().
+        imu_fifo_stats.errors++;
+        imu_prev_valid = false;
+        imu_fifo_pending = true;
+    }
+    else
+    {
+        imu_burst_ready = true;
+    }
+
+    if (NULL != imu_fifo_signal)
+    {
+        imu_fifo_signal();
+    }
+}
@@ -16,11 +16,45 @@ extern "C" {
 
 //------------------------------ INCLUDES -------------------------------------
 #include <stdint.h>
+#include <stddef.h>
 
 //-------------------------- CONSTANTS & MACROS -------------------------------
 
 //----------------------------- DATA TYPES ------------------------------------
 
+/**
+ * @brief One FIFO data set, raw sensor values at +-8 g and +-2000 dps.
+ */
+typedef struct {
+    uint32_t tick;              // bsp_rtc_tick_get() time of the sample, ms
+    int16_t gyro[3];
+    int16_t acc[3];
+} bsp_imu_sample_t;
+
+/**
+ * @brief FIFO acquisition statistics.
+ */
+typedef struct {
+    uint32_t irqs;              // watermark interrupts
+    uint32_t bursts;            // DMA bursts started
+    uint32_t samples;           // samples handed to consumer
+    uint32_t overruns;          // FIFO overruns, samples were lost
+    uint32_t errors;            // DMA errors
+    uint32_t period_q16;        // estimated sample period, ms in Q16
+} bsp_imu_fifo_stats_t;
+
+/**
+ * @brief Consumer of decoded samples, called from bsp_imu_fifo_process().
+ */
+typedef void (*bsp_imu_fifo_cb_t)(const bsp_imu_sample_t *p_samples,
+                                  size_t cnt);
+
+/**
+ * @brief Called from ISR when bsp_imu_fifo_process() has work, e.g. gives
+ *        a semaphore of the processing task.
+ */
+typedef void (*bsp_imu_fifo_signal_t)(void);
+
 //---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
 /**
  * @brief Initialize IMU SPI.
@@ -49,6 +83,42 @@ uint8_t bsp_imu_spi_read (uint8_t reg_addr, uint8_t *p_buff, uint16_t buff_len);
  */
 uint8_t bsp_imu_spi_write (uint8_t reg_addr, uint8_t *p_buff, uint16_t buff_len);
 
+/**
+ * @brief Start FIFO acquisition of gyro and accelerometer. FIFO watermark
+ *        raises INT1, the whole FIFO is then read in one SPI DMA burst.
+ * @param odr_hz : Output data rate, 13, 26, 52, 104, 208, 416, 833 or 1660.
+ * @param watermark : Samples in FIFO that raise INT1, 1 to 341.
+ * @param cb : Consumer of samples.
+ * @param signal : Called from ISR when a burst is ready, may be NULL if
+ *                 bsp_imu_fifo_process() is polled.
+ * @return 0 -> ok
+ *         not 0 -> fail
+ */
+uint8_t bsp_imu_fifo_start (uint16_t odr_hz, uint16_t watermark,
+                            bsp_imu_fifo_cb_t cb, bsp_imu_fifo_signal_t signal);
+
+/**
+ * @brief Stop FIFO acquisition and clear the FIFO.
+ */
+void bsp_imu_fifo_stop (void);
+
+/**
+ * @brief Decode finished burst and pass samples to the consumer. Called from
+ *        task context after signal.
+ */
+void bsp_imu_fifo_process (void);
+
+/**
+ * @brief INT1 (PB11) EXTI handler, called from HAL_GPIO_EXTI_Callback.
+ */
+void bsp_imu_fifo_irq_handler (void);
+
+/**
+ * @brief Get FIFO acquisition statistics.
+ * @param p_stats : Output.
+ */
+void bsp_imu_fifo_stats_get (bsp_imu_fifo_stats_t *p_stats);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,306 @@
+/** @file imu_fusion.c
+*
+* @brief Streaming IMU orientation filter (Mahony) with step and motion
+*        events, fed by IMU FIFO batches.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/imu_fusion.h>
+#include <cycles.h>
+#include <math.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+
+// Raw sensor scale at +-2000 dps and +-8 g, see bsp_imu_fifo_start().
+#define IMU_FUSION_GYRO_RAD_PER_LSB (0.070f * 3.14159265f / 180.0f)
+#define IMU_FUSION_ACC_MG_PER_LSB   (0.244f)
+
+// Steps closer than this are taken as bounce of the same step.
+#define IMU_FUSION_STEP_MIN_MS      (250u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+typedef struct {
+    bsp_imu_fusion_cfg_t cfg;
+    bsp_imu_fusion_quat_cb_t quat_cb;
+    bsp_imu_fusion_event_cb_t event_cb;
+    float dt;
+    float q[4];                     // w x y z
+    float integral[3];
+    uint16_t decim_cnt;
+    bool step_armed;
+    uint32_t step_tick;
+    bool moving;
+    uint32_t motion_tick;
+    float motion_threshold;         // rad/s squared
+    float step_threshold;           // mg above 1 g
+    uint64_t cycles_total;
+    bsp_imu_fusion_stats_t stats;
+} imu_fusion_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Mahony update with one sample.
+ * @param g rotation rate, rad/s
+ * @param a acceleration, any unit
+ */
+static void imu_fusion_mahony(const float g[3], const float a[3]);
+
+/**
+ * @brief Detect steps and motion start/stop from one sample.
+ * @param tick sample time
+ * @param g rotation rate, rad/s
+ * @param a acceleration, mg
+ */
+static void imu_fusion_events(uint32_t tick, const float g[3],
+                              const float a[3]);
+
+/**
+ * @brief Output event.
+ * @param tick event time
+ * @param type event type
+ */
+static void imu_fusion_event_emit(uint32_t tick, bsp_imu_event_type_t type);
+
+/**
+ * @brief Output current orientation.
+ * @param tick sample time
+ */
+static void imu_fusion_quat_emit(uint32_t tick);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+static imu_fusion_t imu_fusion;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+bool bsp_imu_fusion_init(const bsp_imu_fusion_cfg_t *p_cfg,
+                         bsp_imu_fusion_quat_cb_t quat_cb,
+                         bsp_imu_fusion_event_cb_t event_cb)
+{
+    bool is_ok = (NULL != p_cfg) && (0u < p_cfg->odr_hz) &&
+                 (0u < p_cfg->decimation);
+
+    if (is_ok)
+    {
+        float motion = (float)p_cfg->motion_threshold_dps *
+                       (3.14159265f / 180.0f);
+
+        memset(&imu_fusion, 0, sizeof(imu_fusion));
+        imu_fusion.cfg = *p_cfg;
+        imu_fusion.quat_cb = quat_cb;
+        imu_fusion.event_cb = event_cb;
+        imu_fusion.dt = 1.0f / (float)p_cfg->odr_hz;
+        imu_fusion.q[0] = 1.0f;
+        imu_fusion.step_armed = true;
+        imu_fusion.motion_threshold = motion * motion;
+        imu_fusion.step_threshold = (float)p_cfg->step_threshold_mg;
+
+        CYCLES_INIT();
+    }
+
+    return is_ok;
+}
+
+void bsp_imu_fusion_process(const bsp_imu_sample_t *p_samples, size_t cnt)
+{
+    for (size_t index = 0u; index < cnt; index++)
+    {
+        const bsp_imu_sample_t *p_sample = &p_samples[index];
+        uint32_t start = CYCLES();
+        float g[3];
+        float a[3];
+
+        for (uint32_t axis = 0u; axis < 3u; axis++)
+        {
+            g[axis] = (float)p_sample->gyro[axis] * IMU_FUSION_GYRO_RAD_PER_LSB;
+            a[axis] = (float)p_sample->acc[axis] * IMU_FUSION_ACC_MG_PER_LSB;
+        }
+
+        imu_fusion_mahony(g, a);
+        imu_fusion_events(p_sample->tick, g, a);
+
+        imu_fusion.decim_cnt++;
+        if (imu_fusion.cfg.decimation <= imu_fusion.decim_cnt)
+        {
+            imu_fusion.decim_cnt = 0u;
+            imu_fusion_quat_emit(p_sample->tick);
+        }
+
+        // Callbacks are part of the cost, they run inline.
+        uint32_t cycles = CYCLES() - start;
+
+        imu_fusion.cycles_total += cycles;
+        imu_fusion.stats.samples++;
+        if (imu_fusion.stats.cycles_max < cycles)
+        {
+            imu_fusion.stats.cycles_max = cycles;
+        }
+    }
+}
+
+void bsp_imu_fusion_stats_get(bsp_imu_fusion_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        *p_stats = imu_fusion.stats;
+
+        if (0u < p_stats->samples)
+        {
+            p_stats->cycles_per_sample = (uint32_t)(imu_fusion.cycles_total /
+                                                    p_stats->samples);
+        }
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void imu_fusion_mahony(const float g[3], const float a[3])
+{
+    float *q = imu_fusion.q;
+    float gx = g[0];
+    float gy = g[1];
+    float gz = g[2];
+    float norm = (a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2]);
+
+    // Free fall leaves no gravity reference, gyro only then.
+    if (0.0f < norm)
+    {
+        norm = 1.0f / sqrtf(norm);
+
+        float ax = a[0] * norm;
+        float ay = a[1] * norm;
+        float az = a[2] * norm;
+
+        // Gravity direction in sensor frame from current estimate.
+        float vx = 2.0f * ((q[1] * q[3]) - (q[0] * q[2]));
+        float vy = 2.0f * ((q[0] * q[1]) + (q[2] * q[3]));
+        float vz = (q[0] * q[0]) - (q[1] * q[1]) - (q[2] * q[2]) +
+                   (q[3] * q[3]);
+
+        // Error is the rotation between measured and estimated gravity.
+        float ex = (ay * vz) - (az * vy);
+        float ey = (az * vx) - (ax * vz);
+        float ez = (ax * vy) - (ay * vx);
+
+        if (0.0f < imu_fusion.cfg.ki)
+        {
+            imu_fusion.integral[0] += imu_fusion.cfg.ki * ex * imu_fusion.dt;
+            imu_fusion.integral[1] += imu_fusion.cfg.ki * ey * imu_fusion.dt;
+            imu_fusion.integral[2] += imu_fusion.cfg.ki * ez * imu_fusion.dt;
+            gx += imu_fusion.integral[0];
+            gy += imu_fusion.integral[1];
+            gz += imu_fusion.integral[2];
+        }
+
+        gx += imu_fusion.cfg.kp * ex;
+        gy += imu_fusion.cfg.kp * ey;
+        gz += imu_fusion.cfg.kp * ez;
+    }
+
+    // Integrate q' = 0.5 * q * (0, g).
+    float half_dt = 0.5f * imu_fusion.dt;
+    float qw = q[0];
+    float qx = q[1];
+    float qy = q[2];
+    float qz = q[3];
+
+    q[0] += (-(qx * gx) - (qy * gy) - (qz * gz)) * half_dt;
+    q[1] += ((qw * gx) + (qy * gz) - (qz * gy)) * half_dt;
+    q[2] += ((qw * gy) - (qx * gz) + (qz * gx)) * half_dt;
+    q[3] += ((qw * gz) + (qx * gy) - (qy * gx)) * half_dt;
+
+    norm = 1.0f / sqrtf((q[0] * q[0]) + (q[1] * q[1]) + (q[2] * q[2]) +
+                        (q[3] * q[3]));
+    q[0] *= norm;
+    q[1] *= norm;
+    q[2] *= norm;
+    q[3] *= norm;
+}
+
+static void imu_fusion_events(uint32_t tick, const float g[3],
+                              const float a[3])
+{
+    float rate = (g[0] * g[0]) + (g[1] * g[1]) + (g[2] * g[2]);
+    float acc = sqrtf((a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2]));
+
+    // Step is a peak above 1 g plus threshold, re-armed below 1 g.
+    if (imu_fusion.step_armed)
+    {
+        if ((0.0f < imu_fusion.step_threshold) &&
+            ((1000.0f + imu_fusion.step_threshold) < acc) &&
+            (IMU_FUSION_STEP_MIN_MS <= (tick - imu_fusion.step_tick)))
+        {
+            imu_fusion.step_armed = false;
+            imu_fusion.step_tick = tick;
+            imu_fusion_event_emit(tick, BSP_IMU_EVENT_STEP);
+        }
+    }
+    else if (1000.0f > acc)
+    {
+        imu_fusion.step_armed = true;
+    }
+
+    if (imu_fusion.motion_threshold < rate)
+    {
+        imu_fusion.motion_tick = tick;
+
+        if (!imu_fusion.moving)
+        {
+            imu_fusion.moving = true;
+            imu_fusion_event_emit(tick, BSP_IMU_EVENT_MOTION_START);
+        }
+    }
+    else if ((imu_fusion.moving) &&
+             (imu_fusion.cfg.still_time_ms <= (tick - imu_fusion.motion_tick)))
+    {
+        imu_fusion.moving = false;
+        imu_fusion_event_emit(tick, BSP_IMU_EVENT_MOTION_STOP);
+    }
+}
+
+static void imu_fusion_event_emit(uint32_t tick, bsp_imu_event_type_t type)
+{
+    bsp_imu_event_t event = {
+        .tick = tick,
+        .type = type,
+    };
+
+    imu_fusion.stats.events++;
+
+    if (NULL != imu_fusion.event_cb)
+    {
+        imu_fusion.event_cb(&event);
+    }
+}
+
+static void imu_fusion_quat_emit(uint32_t tick)
+{
+    bsp_imu_fusion_quat_t quat = {
+        .tick = tick,
+    };
+
+    for (uint32_t index = 0u; index < 4u; index++)
+    {
+        // Unit quaternion components stay within +-1, no overflow.
+        quat.q[index] = (int16_t)lrintf(imu_fusion.q[index] *
+                                        (float)BSP_IMU_FUSION_Q_ONE);
+    }
+
+    imu_fusion.stats.outputs++;
+
+    if (NULL != imu_fusion.quat_cb)
+    {
+        imu_fusion.quat_cb(&quat);
+    }
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,99 @@
+/** @file imu_fusion.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_IMU_FUSION_H
+#define CROSSBOX_IMU_FUSION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <inc/bsp/imu.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Quaternion output scale, 1.0 is 1 << 14.
+#define BSP_IMU_FUSION_Q_ONE    (16384)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+typedef struct {
+    uint16_t odr_hz;                // IMU sample rate, sets filter time step
+    uint16_t decimation;            // one quaternion output per N samples
+    float kp;                       // Mahony proportional gain
+    float ki;                       // Mahony integral gain, 0 disables
+    uint16_t step_threshold_mg;     // acceleration above 1 g counted as step
+    uint16_t motion_threshold_dps;  // rotation rate that starts motion
+    uint16_t still_time_ms;         // time below threshold that stops motion
+} bsp_imu_fusion_cfg_t;
+
+/// Orientation, w x y z scaled by BSP_IMU_FUSION_Q_ONE.
+typedef struct {
+    uint32_t tick;
+    int16_t q[4];
+} bsp_imu_fusion_quat_t;
+
+typedef enum {
+    BSP_IMU_EVENT_STEP = 0,
+    BSP_IMU_EVENT_MOTION_START,
+    BSP_IMU_EVENT_MOTION_STOP,
+} bsp_imu_event_type_t;
+
+typedef struct {
+    uint32_t tick;
+    bsp_imu_event_type_t type;
+} bsp_imu_event_t;
+
+typedef struct {
+    uint32_t samples;               // samples run through the filter
+    uint32_t outputs;               // quaternions output
+    uint32_t events;                // events output
+    uint32_t cycles_per_sample;     // average filter cost, CPU cycles
+    uint32_t cycles_max;            // worst single sample
+} bsp_imu_fusion_stats_t;
+
+typedef void (*bsp_imu_fusion_quat_cb_t)(const bsp_imu_fusion_quat_t *p_quat);
+typedef void (*bsp_imu_fusion_event_cb_t)(const bsp_imu_event_t *p_event);
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Reset filter to identity orientation and set configuration.
+ * @param p_cfg configuration, copied
+ * @param quat_cb decimated quaternion output, may be NULL
+ * @param event_cb step and motion event output, may be NULL
+ * @return true on valid configuration
+ */
+bool bsp_imu_fusion_init(const bsp_imu_fusion_cfg_t *p_cfg,
+                         bsp_imu_fusion_quat_cb_t quat_cb,
+                         bsp_imu_fusion_event_cb_t event_cb);
+
+/**
+ * @brief Run batch of samples through the filter. Matches bsp_imu_fifo_cb_t
+ *        so it can be passed to bsp_imu_fifo_start() directly.
+ * @param p_samples samples in time order
+ * @param cnt number of samples
+ */
+void bsp_imu_fusion_process(const bsp_imu_sample_t *p_samples, size_t cnt);
+
+/**
+ * @brief Get filter statistics.
+ * @param p_stats output
+ */
+void bsp_imu_fusion_stats_get(bsp_imu_fusion_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_IMU_FUSION_H
@@ -0,0 +1,170 @@
+/** @file imu_fusion_host.c
+*
+* @brief Host replay of the IMU orientation filter. Reads raw samples as
+*        the FIFO driver decodes them, runs them through
+*        bsp_imu_fusion_process in FIFO sized batches and prints decimated
+*        quaternions and events as CSV. Filter cost per sample comes from
+*        CYCLES() of cycles.h, here the host time stamp counter:
+*
+*        gcc -O2 -DIMU_FUSION_HOST \
+*            -D'CYCLES()=((uint32_t)__builtin_ia32_rdtsc())' \
+*            -Ihost -I. imu_fusion.c imu_fusion_host.c -lm -o imu_fusion
+*        ./imu_fusion [-o odr_hz] [-d decimation] [-b batch] [imu.csv] > q.csv
+*
+*        Input columns: tick ms, gyro x y z, acc x y z, raw LSB at +-2000 dps
+*        and +-8 g. Lines that do not parse are skipped. Output rows are
+*        "q,tick,w,x,y,z" with components as float, and "e,tick,type".
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/imu_fusion.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_ODR_HZ                 (104u)
+#define HOST_DECIMATION             (4u)
+// Samples per call, as one FIFO watermark burst.
+#define HOST_BATCH                  (32u)
+#define HOST_BATCH_MAX              (512u)
+#define HOST_LINE_LEN               (128u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static void host_quat(const bsp_imu_fusion_quat_t *p_quat);
+static void host_event(const bsp_imu_event_t *p_event);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static const char * const host_event_name[] = {
+    [BSP_IMU_EVENT_STEP] = "step",
+    [BSP_IMU_EVENT_MOTION_START] = "motion_start",
+    [BSP_IMU_EVENT_MOTION_STOP] = "motion_stop",
+};
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef IMU_FUSION_HOST
+int main(int argc, char **argv)
+{
+    static bsp_imu_sample_t batch[HOST_BATCH_MAX];
+    bsp_imu_fusion_cfg_t cfg = {
+        .odr_hz = HOST_ODR_HZ,
+        .decimation = HOST_DECIMATION,
+        .kp = 1.0f,
+        .ki = 0.0f,
+        .step_threshold_mg = 300u,
+        .motion_threshold_dps = 20u,
+        .still_time_ms = 2000u,
+    };
+    bsp_imu_fusion_stats_t stats;
+    char line[HOST_LINE_LEN];
+    FILE *p_input = stdin;
+    uint32_t batch_len = HOST_BATCH;
+    uint32_t cnt = 0u;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "o:d:b:")))
+    {
+        switch (opt)
+        {
+            case 'o':
+                cfg.odr_hz = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                cfg.decimation = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                batch_len = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o odr_hz] [-d decimation] "
+                        "[-b batch] [imu.csv]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((0u == batch_len) || (HOST_BATCH_MAX < batch_len))
+    {
+        fprintf(stderr, "batch 1 to %u\n", HOST_BATCH_MAX);
+        return 1;
+    }
+
+    if ((optind < argc) && (NULL == (p_input = fopen(argv[optind], "r"))))
+    {
+        fprintf(stderr, "can not open %s\n", argv[optind]);
+        return 1;
+    }
+
+    if (!bsp_imu_fusion_init(&cfg, host_quat, host_event))
+    {
+        fprintf(stderr, "invalid configuration\n");
+        return 1;
+    }
+
+    while (NULL != fgets(line, sizeof(line), p_input))
+    {
+        bsp_imu_sample_t *p_sample = &batch[cnt];
+        int gyro[3];
+        int acc[3];
+
+        if (7 != sscanf(line, "%u,%d,%d,%d,%d,%d,%d", &p_sample->tick,
+                        &gyro[0], &gyro[1], &gyro[2],
+                        &acc[0], &acc[1], &acc[2]))
+        {
+            continue;
+        }
+
+        for (uint32_t axis = 0u; axis < 3u; axis++)
+        {
+            p_sample->gyro[axis] = (int16_t)gyro[axis];
+            p_sample->acc[axis] = (int16_t)acc[axis];
+        }
+
+        if (batch_len <= ++cnt)
+        {
+            bsp_imu_fusion_process(batch, cnt);
+            cnt = 0u;
+        }
+    }
+
+    bsp_imu_fusion_process(batch, cnt);
+
+    if (stdin != p_input)
+    {
+        fclose(p_input);
+    }
+
+    bsp_imu_fusion_stats_get(&stats);
+    fprintf(stderr, "%u samples, %u quaternions, %u events, "
+            "%u cycles/sample, %u max\n", stats.samples, stats.outputs,
+            stats.events, stats.cycles_per_sample, stats.cycles_max);
+
+    return 0;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void host_quat(const bsp_imu_fusion_quat_t *p_quat)
+{
+    printf("q,%u,%.4f,%.4f,%.4f,%.4f\n", p_quat->tick,
+           (double)p_quat->q[0] / BSP_IMU_FUSION_Q_ONE,
+           (double)p_quat->q[1] / BSP_IMU_FUSION_Q_ONE,
+           (double)p_quat->q[2] / BSP_IMU_FUSION_Q_ONE,
+           (double)p_quat->q[3] / BSP_IMU_FUSION_Q_ONE);
+}
+
+static void host_event(const bsp_imu_event_t *p_event)
+{
+    printf("e,%u,%s\n", p_event->tick, host_event_name[p_event->type]);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,463 @@
+/** @file lowpower.c
+*
+* @brief Tickless idle for FreeRTOS. SysTick is replaced by LPTIM1 on LSE
+*        while idle, the core enters STOP2 unless a peripheral user vetoes
+*        it. Every wakeup is attributed to the interrupt that caused it.
+*        Requires configUSE_TICKLESS_IDLE set to 2 in FreeRTOSConfig.h.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/lowpower.h>
+#include <inc/bsp/timestamp.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <stm32l4xx_hal.h>
+#include <RTT.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define LOWPOWER_LPTIM              LPTIM1
+#define LOWPOWER_LPTIM_HZ           (32768u)
+#define LOWPOWER_LPTIM_MAX          (0xFFFFu)
+#define LOWPOWER_IRQ_PRIO           (15u)
+
+// Shorter idle is not worth LPTIM start and clock restore.
+#define LOWPOWER_MIN_IDLE_TICKS     (2u)
+#define LOWPOWER_MAX_IDLE_TICKS     ((LOWPOWER_LPTIM_MAX * configTICK_RATE_HZ) / \
+                                     LOWPOWER_LPTIM_HZ)
+
+// Device interrupts, FPU is the last one on STM32L476.
+#define LOWPOWER_IRQ_CNT            ((uint32_t)FPU_IRQn + 1u)
+#define LOWPOWER_IRQ_WORDS          ((LOWPOWER_IRQ_CNT + 31u) / 32u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Start LPTIM to match after given time.
+ * @param cyc time in SysTick cycles.
+ * @param tick_cyc SysTick cycles per tick.
+ */
+static void lowpower_lptim_start(uint64_t cyc, uint32_t tick_cyc);
+
+/**
+ * @brief Stop LPTIM.
+ * @return LPTIM counts since start.
+ */
+static uint32_t lowpower_lptim_stop(void);
+
+/**
+ * @brief Get SysTick cycles since the last tick the kernel counted,
+ *      including a tick that expired with interrupts masked. Exact once
+ *      SysTick is stopped.
+ * @param tick_cyc SysTick cycles per tick.
+ */
+static uint32_t lowpower_systick_since(uint32_t tick_cyc);
+
+/**
+ * @brief Check if a UART still shifts out data, it would stall in STOP2.
+ */
+static bool lowpower_uart_busy(void);
+
+/**
+ * @brief Restore system clock after wakeup from STOP2 on MSI.
+ * @param cfgr RCC CFGR before entering STOP2.
+ */
+static void lowpower_clock_restore(uint32_t cfgr);
+
+/**
+ * @brief Count pending interrupts as wakeup sources.
+ */
+static void lowpower_wakeup_count(void);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static USART_TypeDef * const lowpower_uarts[] = {
+    USART1,                                         // BLE
+    USART3,                                         // WiFi
+    UART4,                                          // GPS
+};
+
+static volatile uint32_t lowpower_veto_mask;
+
+// Idle task only.
+static bsp_lowpower_stats_t lowpower_stats;
+static uint32_t lowpower_wakeup_cnt[LOWPOWER_IRQ_CNT];
+static uint32_t lowpower_veto_cnt[BSP_LOWPOWER_CNT];
+// Parts of a SysTick cycle and of a microsecond not yet accounted, in
+// 1/LOWPOWER_LPTIM_HZ units.
+static uint32_t lowpower_cyc_rem;
+static uint32_t lowpower_us_rem;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void bsp_lowpower_init(void)
+{
+    memset(&lowpower_stats, 0, sizeof(lowpower_stats));
+    memset(lowpower_wakeup_cnt, 0, sizeof(lowpower_wakeup_cnt));
+    memset(lowpower_veto_cnt, 0, sizeof(lowpower_veto_cnt));
+
+    __HAL_RCC_LPTIM1_CONFIG(RCC_LPTIM1CLKSOURCE_LSE);
+    __HAL_RCC_LPTIM1_CLK_ENABLE();
+
+    // Internal clock undivided, interrupt enable is written while disabled.
+    LOWPOWER_LPTIM->CR = 0u;
+    LOWPOWER_LPTIM->CFGR = 0u;
+    LOWPOWER_LPTIM->IER = LPTIM_IER_CMPMIE;
+
+    // EXTI line 32 carries LPTIM1 wakeup out of STOP2.
+    SET_BIT(EXTI->IMR2, EXTI_IMR2_IM32);
+
+    NVIC_SetPriority(LPTIM1_IRQn,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(),
+                                         LOWPOWER_IRQ_PRIO, 0));
+    NVIC_EnableIRQ(LPTIM1_IRQn);
+}
+
+void bsp_lowpower_stop_veto(bsp_lowpower_client_t client, bool veto)
+{
+    if (BSP_LOWPOWER_CNT > client)
+    {
+        if (veto)
+        {
+            __atomic_fetch_or(&lowpower_veto_mask, (1u << client),
+                              __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_fetch_and(&lowpower_veto_mask, ~(1u << client),
+                               __ATOMIC_RELAXED);
+        }
+    }
+}
+
+uint32_t bsp_lowpower_veto_get(void)
+{
+    return lowpower_veto_mask;
+}
+
+void bsp_lowpower_stats_get(bsp_lowpower_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        *p_stats = lowpower_stats;
+    }
+}
+
+uint32_t bsp_lowpower_wakeup_cnt_get(int32_t irqn)
+{
+    return ((0 <= irqn) && (LOWPOWER_IRQ_CNT > (uint32_t)irqn)) ?
+           lowpower_wakeup_cnt[irqn] : 0u;
+}
+
+uint32_t bsp_lowpower_veto_cnt_get(bsp_lowpower_client_t client)
+{
+    return (BSP_LOWPOWER_CNT > client) ? lowpower_veto_cnt[client] : 0u;
+}
+
+void bsp_lowpower_stats_dump(void)
+{
+    dprintf("\nIdle stop %lu/%lu ticks sleep %lu/%lu ticks abort %lu"
+            " drain %lu unknown %lu",
+            (unsigned long)lowpower_stats.stop_cnt,
+            (unsigned long)lowpower_stats.stop_ticks,
+            (unsigned long)lowpower_stats.sleep_cnt,
+            (unsigned long)lowpower_stats.sleep_ticks,
+            (unsigned long)lowpower_stats.abort_cnt,
+            (unsigned long)lowpower_stats.drain_cnt,
+            (unsigned long)lowpower_stats.unknown_cnt);
+
+    dprintf("\n wakeup irq:");
+    for (uint32_t irqn = 0u; irqn < LOWPOWER_IRQ_CNT; irqn++)
+    {
+        if (0u < lowpower_wakeup_cnt[irqn])
+        {
+            dprintf(" %lu:%lu", (unsigned long)irqn,
+                    (unsigned long)lowpower_wakeup_cnt[irqn]);
+        }
+    }
+
+    dprintf("\n veto client:");
+    for (uint32_t client = 0u; client < BSP_LOWPOWER_CNT; client++)
+    {
+        if (0u < lowpower_veto_cnt[client])
+        {
+            dprintf(" %lu:%lu", (unsigned long)client,
+                    (unsigned long)lowpower_veto_cnt[client]);
+        }
+    }
+}
+
+/**
+ * @brief FreeRTOS tickless idle hook, called from idle task with scheduler
+ *      suspended. Time is kept in SysTick cycles: the part of the tick in
+ *      progress at entry and the part of a tick left at wakeup are carried
+ *      in SysTick, as in the reference Cortex-M port, so sleeps do not
+ *      drop or round time.
+ * @param xExpectedIdleTime ticks until next task timeout.
+ */
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime)
+{
+    uint32_t ticks = xExpectedIdleTime;
+    uint32_t tick_cyc;
+    uint32_t since;
+    uint32_t veto;
+    uint32_t cfgr;
+    uint32_t cnt;
+    uint64_t slept;
+    bool stop;
+
+    if (LOWPOWER_MIN_IDLE_TICKS > ticks)
+    {
+        return;
+    }
+    if (LOWPOWER_MAX_IDLE_TICKS < ticks)
+    {
+        ticks = LOWPOWER_MAX_IDLE_TICKS;
+    }
+
+    __disable_irq();
+
+    if (eAbortSleep == eTaskConfirmSleepModeStatus())
+    {
+        lowpower_stats.abort_cnt++;
+        __enable_irq();
+        return;
+    }
+
+    // LPTIM registers take a few LSE cycles to write, SysTick keeps counting
+    // meanwhile and is stopped once LPTIM runs. Expired tick is taken over
+    // from the pending interrupt.
+    tick_cyc = SysTick->LOAD + 1u;
+    lowpower_lptim_start(((uint64_t)ticks * tick_cyc) -
+                         lowpower_systick_since(tick_cyc), tick_cyc);
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    since = lowpower_systick_since(tick_cyc);
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+
+    veto = lowpower_veto_mask;
+    stop = (0u == veto) && (!lowpower_uart_busy());
+
+    if (stop)
+    {
+        cfgr = RCC->CFGR;
+
+        HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+
+        lowpower_clock_restore(cfgr);
+    }
+    else
+    {
+        if (0u == veto)
+        {
+            lowpower_stats.drain_cnt++;
+        }
+        for (uint32_t client = 0u; client < BSP_LOWPOWER_CNT; client++)
+        {
+            if (0u != (veto & (1u << client)))
+            {
+                lowpower_veto_cnt[client]++;
+            }
+        }
+
+        __DSB();
+        __WFI();
+    }
+
+    cnt = lowpower_lptim_stop();
+    lowpower_wakeup_count();
+
+    // LPTIM counts in SysTick cycles, remainder of the division is kept for
+    // the next sleep so the fraction of a cycle per count is not lost.
+    slept = ((uint64_t)cnt * tick_cyc * configTICK_RATE_HZ) + lowpower_cyc_rem;
+    lowpower_cyc_rem = (uint32_t)(slept % LOWPOWER_LPTIM_HZ);
+    slept = (slept / LOWPOWER_LPTIM_HZ) + since;
+
+    ticks = (uint32_t)(slept / tick_cyc);
+    since = (uint32_t)(slept % tick_cyc);
+    if (xExpectedIdleTime < ticks)
+    {
+        // Wakeup from STOP2 overran the timeout, next tick is due now.
+        ticks = xExpectedIdleTime;
+        since = tick_cyc;
+    }
+
+    // SysTick does not interrupt with reload value 0.
+    if ((tick_cyc - since) < 2u)
+    {
+        since = tick_cyc - 2u;
+    }
+
+    if (stop)
+    {
+        // TIM2 did not count in STOP2.
+        uint64_t us = ((uint64_t)cnt * 1000000u) + lowpower_us_rem;
+
+        lowpower_us_rem = (uint32_t)(us % LOWPOWER_LPTIM_HZ);
+        bsp_timestamp_stop_compensate((uint32_t)(us / LOWPOWER_LPTIM_HZ));
+        lowpower_stats.stop_cnt++;
+        lowpower_stats.stop_ticks += ticks;
+    }
+    else
+    {
+        lowpower_stats.sleep_cnt++;
+        lowpower_stats.sleep_ticks += ticks;
+    }
+
+    // Rest of the tick in progress, full ticks again after the first reload.
+    // Core clock SysTick loads right away, LOAD is restored after it did.
+    SysTick->LOAD = tick_cyc - since - 1u;
+    SysTick->VAL = 0u;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    vTaskStepTick(ticks);
+    uwTick += ticks * portTICK_PERIOD_MS;
+
+    SysTick->LOAD = tick_cyc - 1u;
+
+    __enable_irq();
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void lowpower_lptim_start(uint64_t cyc, uint32_t tick_cyc)
+{
+    uint64_t cyc_hz = (uint64_t)tick_cyc * configTICK_RATE_HZ;
+    // Rounded up, waking before the tick would sleep again right away.
+    uint64_t cmp = ((cyc * LOWPOWER_LPTIM_HZ) + cyc_hz - 1u) / cyc_hz;
+
+    if (LOWPOWER_LPTIM_MAX <= cmp)
+    {
+        cmp = LOWPOWER_LPTIM_MAX - 1u;
+    }
+
+    LOWPOWER_LPTIM->ICR = LPTIM_ICR_CMPMCF | LPTIM_ICR_ARRMCF |
+                          LPTIM_ICR_CMPOKCF | LPTIM_ICR_ARROKCF;
+    LOWPOWER_LPTIM->CR = LPTIM_CR_ENABLE;
+
+    // Registers are written in LSE domain, each write has to complete.
+    LOWPOWER_LPTIM->ARR = LOWPOWER_LPTIM_MAX;
+    while (0u == (LOWPOWER_LPTIM->ISR & LPTIM_ISR_ARROK))
+    {
+    }
+    LOWPOWER_LPTIM->CMP = (uint32_t)cmp;
+    while (0u == (LOWPOWER_LPTIM->ISR & LPTIM_ISR_CMPOK))
+    {
+    }
+
+    LOWPOWER_LPTIM->CR = LPTIM_CR_ENABLE | LPTIM_CR_CNTSTRT;
+}
+
+static uint32_t lowpower_lptim_stop(void)
+{
+    uint32_t cnt;
+
+    // Counter is asynchronous, two equal reads are a valid value.
+    do
+    {
+        cnt = LOWPOWER_LPTIM->CNT;
+    } while (cnt != LOWPOWER_LPTIM->CNT);
+
+    LOWPOWER_LPTIM->CR = 0u;
+    LOWPOWER_LPTIM->ICR = LPTIM_ICR_CMPMCF;
+
+    return cnt;
+}
+
+static uint32_t lowpower_systick_since(uint32_t tick_cyc)
+{
+    uint32_t val = SysTick->VAL;
+    // Zero means a full tick is left, interrupt comes on the 1 to 0 decrement.
+    uint32_t since = tick_cyc - ((0u != val) ? val : tick_cyc);
+
+    if (0u != (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+    {
+        since += tick_cyc;
+    }
+
+    return since;
+}
+
+static bool lowpower_uart_busy(void)
+{
+    for (uint32_t index = 0u;
+         index < (sizeof(lowpower_uarts) / sizeof(lowpower_uarts[0]));
+         index++)
+    {
+        USART_TypeDef *p_uart = lowpower_uarts[index];
+
+        if ((0u != (p_uart->CR1 & USART_CR1_UE)) &&
+            (0u != (p_uart->CR1 & USART_CR1_TE)) &&
+            (0u == (p_uart->ISR & USART_ISR_TC)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void lowpower_clock_restore(uint32_t cfgr)
+{
+    // Wakeup clock is MSI at MSISRANGE, select 48 MHz range again.
+    __HAL_RCC_MSI_RANGE_CONFIG(RCC_MSIRANGE_11);
+    while (0u == (RCC->CR & RCC_CR_MSIRDY))
+    {
+    }
+
+    if (RCC_CFGR_SWS_PLL == (cfgr & RCC_CFGR_SWS))
+    {
+        __HAL_RCC_PLL_ENABLE();
+        while (0u == (RCC->CR & RCC_CR_PLLRDY))
+        {
+        }
+
+        __HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_PLLCLK);
+        while (RCC_CFGR_SWS_PLL != (RCC->CFGR & RCC_CFGR_SWS))
+        {
+        }
+    }
+}
+
+static void lowpower_wakeup_count(void)
+{
+    bool found = false;
+
+    for (uint32_t word = 0u; word < LOWPOWER_IRQ_WORDS; word++)
+    {
+        uint32_t pending = NVIC->ISPR[word] & NVIC->ISER[word];
+
+        while (0u != pending)
+        {
+            uint32_t bit = 31u - __CLZ(pending);
+            uint32_t irqn = (word * 32u) + bit;
+
+            if (LOWPOWER_IRQ_CNT > irqn)
+            {
+                lowpower_wakeup_cnt[irqn]++;
+                found = true;
+            }
+            pending &= ~(1u << bit);
+        }
+    }
+
+    if (!found)
+    {
+        lowpower_stats.unknown_cnt++;
+    }
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
+
+void LPTIM1_IRQHandler(void)
+{
+    // Match is handled by idle hook, interrupt only ends WFI.
+    LOWPOWER_LPTIM->ICR = LPTIM_ICR_CMPMCF;
+}
@@ -0,0 +1,102 @@
+/** @file lowpower.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __BSP_LOWPOWER_H__
+#define __BSP_LOWPOWER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+/// Users of clocks or peripherals that do not run in STOP2.
+typedef enum {
+    BSP_LOWPOWER_I2C1 = 0,                          // I2C job queue busy, by instance.
+    BSP_LOWPOWER_I2C2,
+    BSP_LOWPOWER_I2C3,
+    BSP_LOWPOWER_IMU_SPI,                           // SPI bus taken, burst DMA or register access.
+    BSP_LOWPOWER_ADC,                               // Timer triggered sampling.
+    BSP_LOWPOWER_BLE_TX,                            // DMA TX queue, by bsp_dma_tx_id_t.
+    BSP_LOWPOWER_WIFI_TX,
+    BSP_LOWPOWER_BLE_RX,                            // UART reception may start any time.
+    BSP_LOWPOWER_WIFI_RX,
+    BSP_LOWPOWER_GPS_RX,
+    BSP_LOWPOWER_HW_TIMER,                          // TIM3 user timer.
+    BSP_LOWPOWER_BUZZER,
+    BSP_LOWPOWER_CNT
+} bsp_lowpower_client_t;
+
+/// Idle statistics.
+typedef struct {
+    uint32_t stop_cnt;                              // Idle periods in STOP2.
+    uint32_t sleep_cnt;                             // Tickless idle in SLEEP, STOP2 vetoed.
+    uint32_t abort_cnt;                             // Idle left before sleeping.
+    uint32_t drain_cnt;                             // SLEEP while UART shifted out last byte.
+    uint32_t stop_ticks;                            // RTOS ticks spent in STOP2.
+    uint32_t sleep_ticks;                           // RTOS ticks spent in SLEEP.
+    uint32_t unknown_cnt;                           // Wakeups without pending interrupt.
+} bsp_lowpower_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Configure LPTIM1 as tick replacement during tickless idle. Call
+ *      before scheduler is started.
+ */
+void bsp_lowpower_init(void);
+
+/**
+ * @brief Allow or prevent STOP2 in idle. While any client vetoes, idle
+ *      stays tickless but in SLEEP. Callable from any task or ISR.
+ * @param client peripheral user.
+ * @param veto true while the client needs clocks running.
+ */
+void bsp_lowpower_stop_veto(bsp_lowpower_client_t client, bool veto);
+
+/**
+ * @brief Get clients vetoing STOP2 now.
+ * @return mask of (1 << bsp_lowpower_client_t).
+ */
+uint32_t bsp_lowpower_veto_get(void);
+
+/**
+ * @brief Get idle statistics.
+ * @param p_stats output.
+ */
+void bsp_lowpower_stats_get(bsp_lowpower_stats_t *p_stats);
+
+/**
+ * @brief Get number of idle periods ended by an interrupt.
+ * @param irqn device interrupt number.
+ * @return wakeup count, 0 for invalid irqn.
+ */
+uint32_t bsp_lowpower_wakeup_cnt_get(int32_t irqn);
+
+/**
+ * @brief Get number of idle periods a client kept out of STOP2.
+ * @param client peripheral user.
+ * @return veto count.
+ */
+uint32_t bsp_lowpower_veto_cnt_get(bsp_lowpower_client_t client);
+
+/**
+ * @brief Print idle statistics, wakeup sources and vetoes over RTT.
+ */
+void bsp_lowpower_stats_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BSP_LOWPOWER_H__
@@ -0,0 +1,623 @@
+/** @file nmea.c
+*
+* @brief Incremental NMEA 0183 parser. Decodes RMC, GGA, GSA and GSV field by
+*        field while bytes arrive, without buffering sentences.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/nmea.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+// Standard limit is 82 characters including $ and CR LF.
+#define NMEA_SENTENCE_LEN_MAX   (96u)
+// Fraction digits kept, more are dropped. Keeps dddmm.mmmmm within 32 bits.
+#define NMEA_FRAC_DIGITS_MAX    (5u)
+#define NMEA_INT_DIGITS_MAX     (9u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef enum {
+    NMEA_STATE_IDLE = 0,                            // Waiting for $.
+    NMEA_STATE_FIELD,                               // Inside field, summing checksum.
+    NMEA_STATE_CHECKSUM_HI,
+    NMEA_STATE_CHECKSUM_LO,
+} nmea_state_t;
+
+typedef struct {
+    char id[3];
+    void (*field)(nmea_parser_t *p_parser);         // Field complete.
+    void (*commit)(nmea_parser_t *p_parser);        // Checksum matched.
+} nmea_handler_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Handle one byte.
+ */
+static void nmea_byte(nmea_parser_t *p_parser, uint8_t c);
+
+/**
+ * @brief Accumulate one character of current field.
+ */
+static void nmea_field_char(nmea_parser_t *p_parser, uint8_t c);
+
+/**
+ * @brief Complete current field and dispatch it to the sentence handler.
+ */
+static void nmea_field_end(nmea_parser_t *p_parser);
+
+/**
+ * @brief Reset field accumulator.
+ */
+static void nmea_field_reset(nmea_parser_t *p_parser);
+
+/**
+ * @brief Look up sentence type from address field, talker is ignored.
+ */
+static nmea_sentence_t nmea_type_get(const nmea_parser_t *p_parser);
+
+/**
+ * @brief Current numeric field scaled to given fraction digits.
+ */
+static int32_t nmea_num_scaled(const nmea_parser_t *p_parser, uint8_t digits);
+
+/**
+ * @brief Current field as time of day hhmmss.sss in ms.
+ */
+static uint32_t nmea_num_time(const nmea_parser_t *p_parser);
+
+/**
+ * @brief Current field as ddmm.mmmmm or dddmm.mmmmm in degrees * 1e7.
+ */
+static int32_t nmea_num_coord(const nmea_parser_t *p_parser);
+
+/**
+ * @brief Hex digit value, negative if not a hex digit.
+ */
+static int nmea_hex(uint8_t c);
+
+static void nmea_rmc_field(nmea_parser_t *p_parser);
+static void nmea_rmc_commit(nmea_parser_t *p_parser);
+static void nmea_gga_field(nmea_parser_t *p_parser);
+static void nmea_gga_commit(nmea_parser_t *p_parser);
+static void nmea_gsa_field(nmea_parser_t *p_parser);
+static void nmea_gsa_commit(nmea_parser_t *p_parser);
+static void nmea_gsv_field(nmea_parser_t *p_parser);
+static void nmea_gsv_commit(nmea_parser_t *p_parser);
+
+/**
+ * @brief Publish working fix to the latest-value slot.
+ */
+static void nmea_fix_publish(nmea_parser_t *p_parser);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+// Indexed by nmea_sentence_t.
+static const nmea_handler_t nmea_handler[NMEA_SENTENCE_CNT] = {
+    { { 'R', 'M', 'C' }, nmea_rmc_field, nmea_rmc_commit },
+    { { 'G', 'G', 'A' }, nmea_gga_field, nmea_gga_commit },
+    { { 'G', 'S', 'A' }, nmea_gsa_field, nmea_gsa_commit },
+    { { 'G', 'S', 'V' }, nmea_gsv_field, nmea_gsv_commit },
+};
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void nmea_init(nmea_parser_t *p_parser, nmea_sentence_cb_t cb, void *p_ctx)
+{
+    memset(p_parser, 0, sizeof(nmea_parser_t));
+    p_parser->cb = cb;
+    p_parser->p_ctx = p_ctx;
+}
+
+void nmea_parse(nmea_parser_t *p_parser, const volatile uint8_t *p_data,
+                size_t len)
+{
+    for (size_t index = 0u; index < len; index++)
+    {
+        nmea_byte(p_parser, p_data[index]);
+    }
+}
+
+bool nmea_fix_get(nmea_parser_t *p_parser, nmea_fix_t *p_fix)
+{
+    uint32_t seq;
+
+    // Parser writes the inactive slot only, retry if it flipped meanwhile.
+    do
+    {
+        seq = p_parser->fix_seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        *p_fix = p_parser->fix[p_parser->fix_active];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != p_parser->fix_seq);
+
+    return (0u != seq);
+}
+
+bool nmea_sky_get(nmea_parser_t *p_parser, nmea_sky_t *p_sky)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = p_parser->sky_seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        *p_sky = p_parser->sky[p_parser->sky_active];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != p_parser->sky_seq);
+
+    return (0u != seq);
+}
+
+void nmea_stats_get(const nmea_parser_t *p_parser, nmea_stats_t *p_stats)
+{
+    *p_stats = p_parser->stats;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void nmea_byte(nmea_parser_t *p_parser, uint8_t c)
+{
+    if ('$' == c)
+    {
+        // Start of sentence resynchronises from any state.
+        if (NMEA_STATE_IDLE != p_parser->state)
+        {
+            p_parser->stats.format_errors++;
+        }
+        p_parser->state = NMEA_STATE_FIELD;
+        p_parser->checksum = 0u;
+        p_parser->field = 0u;
+        p_parser->length = 0u;
+        p_parser->addr_len = 0u;
+        p_parser->type = NMEA_SENTENCE_UNKNOWN;
+        memset(&p_parser->data, 0, sizeof(p_parser->data));
+        nmea_field_reset(p_parser);
+        return;
+    }
+
+    if (NMEA_STATE_IDLE == p_parser->state)
+    {
+        return;
+    }
+
+    p_parser->length++;
+    if ((NMEA_SENTENCE_LEN_MAX < p_parser->length) || ('\r' == c) ||
+        ('\n' == c))
+    {
+        // Line ended before checksum or sentence is garbage.
+        p_parser->stats.format_errors++;
+        p_parser->state = NMEA_STATE_IDLE;
+        return;
+    }
+
+    switch (p_parser->state)
+    {
+        case NMEA_STATE_FIELD:
+            if ('*' == c)
+            {
+                nmea_field_end(p_parser);
+                p_parser->state = NMEA_STATE_CHECKSUM_HI;
+            }
+            else
+            {
+                p_parser->checksum ^= c;
+
+                if (',' == c)
+                {
+                    nmea_field_end(p_parser);
+                    p_parser->field++;
+                    nmea_field_reset(p_parser);
+                }
+                else
+                {
+                    nmea_field_char(p_parser, c);
+                }
+            }
+            break;
+
+        case NMEA_STATE_CHECKSUM_HI:
+        case NMEA_STATE_CHECKSUM_LO:
+        {
+            int digit = nmea_hex(c);
+
+            if (0 > digit)
+            {
+                p_parser->stats.format_errors++;
+                p_parser->state = NMEA_STATE_IDLE;
+            }
+            else if (NMEA_STATE_CHECKSUM_HI == p_parser->state)
+            {
+                p_parser->checksum_rx = (uint8_t)(digit << 4);
+                p_parser->state = NMEA_STATE_CHECKSUM_LO;
+            }
+            else
+            {
+                p_parser->checksum_rx |= (uint8_t)digit;
+                p_parser->state = NMEA_STATE_IDLE;
+
+                if (p_parser->checksum_rx != p_parser->checksum)
+                {
+                    p_parser->stats.checksum_errors++;
+                }
+                else if (NMEA_SENTENCE_UNKNOWN == p_parser->type)
+                {
+                    p_parser->stats.unknown++;
+                }
+                else
+                {
+                    p_parser->stats.sentences++;
+                    nmea_handler[p_parser->type].commit(p_parser);
+
+                    if (NULL != p_parser->cb)
+                    {
+                        p_parser->cb(p_parser->type, &p_parser->data,
+                                     p_parser->p_ctx);
+                    }
+                }
+            }
+            break;
+        }
+
+        default:
+            p_parser->state = NMEA_STATE_IDLE;
+            break;
+    }
+}
+
+static void nmea_field_char(nmea_parser_t *p_parser, uint8_t c)
+{
+    if (0u == p_parser->field)
+    {
+        if (sizeof(p_parser->addr) > p_parser->addr_len)
+        {
+            p_parser->addr[p_parser->addr_len] = (char)c;
+        }
+        p_parser->addr_len++;
+    }
+    else if (('0' <= c) && ('9' >= c))
+    {
+        if (p_parser->num_dot)
+        {
+            if (NMEA_FRAC_DIGITS_MAX > p_parser->num_frac)
+            {
+                p_parser->num = (p_parser->num * 10u) + (c - '0');
+                p_parser->num_frac++;
+            }
+        }
+        else if (NMEA_INT_DIGITS_MAX > p_parser->num_digits)
+        {
+            p_parser->num = (p_parser->num * 10u) + (c - '0');
+            p_parser->num_digits++;
+        }
+    }
+    else if ('.' == c)
+    {
+        p_parser->num_dot = true;
+    }
+    else if ('-' == c)
+    {
+        p_parser->num_neg = true;
+    }
+    else
+    {
+        p_parser->chr = (char)c;
+    }
+}
+
+static void nmea_field_end(nmea_parser_t *p_parser)
+{
+    if (0u == p_parser->field)
+    {
+        p_parser->type = nmea_type_get(p_parser);
+    }
+    else if (NMEA_SENTENCE_UNKNOWN != p_parser->type)
+    {
+        nmea_handler[p_parser->type].field(p_parser);
+    }
+}
+
+static void nmea_field_reset(nmea_parser_t *p_parser)
+{
+    p_parser->num = 0u;
+    p_parser->num_frac = 0u;
+    p_parser->num_digits = 0u;
+    p_parser->num_dot = false;
+    p_parser->num_neg = false;
+    p_parser->chr = '\0';
+}
+
+static nmea_sentence_t nmea_type_get(const nmea_parser_t *p_parser)
+{
+    nmea_sentence_t type = NMEA_SENTENCE_UNKNOWN;
+
+    // Two character talker followed by three character sentence id.
+    if (sizeof(p_parser->addr) == p_parser->addr_len)
+    {
+        for (uint32_t index = 0u; index < NMEA_SENTENCE_CNT; index++)
+        {
+            if (0 == memcmp(&p_parser->addr[2], nmea_handler[index].id, 3u))
+            {
+                type = (nmea_sentence_t)index;
+                break;
+            }
+        }
+    }
+
+    return type;
+}
+
+static int32_t nmea_num_scaled(const nmea_parser_t *p_parser, uint8_t digits)
+{
+    uint32_t value = p_parser->num;
+
+    for (uint8_t frac = p_parser->num_frac; frac < digits; frac++)
+    {
+        value *= 10u;
+    }
+    for (uint8_t frac = digits; frac < p_parser->num_frac; frac++)
+    {
+        value /= 10u;
+    }
+
+    return p_parser->num_neg ? -(int32_t)value : (int32_t)value;
+}
+
+static uint32_t nmea_num_time(const nmea_parser_t *p_parser)
+{
+    uint32_t hhmmss_ms = (uint32_t)nmea_num_scaled(p_parser, 3u);
+    uint32_t hhmmss = hhmmss_ms / 1000u;
+
+    return ((((hhmmss / 10000u) * 3600u) + (((hhmmss / 100u) % 100u) * 60u) +
+             (hhmmss % 100u)) * 1000u) + (hhmmss_ms % 1000u);
+}
+
+static int32_t nmea_num_coord(const nmea_parser_t *p_parser)
+{
+    uint32_t value = (uint32_t)nmea_num_scaled(p_parser, 5u);
+    uint32_t deg = value / 10000000u;
+    uint32_t min_e5 = value % 10000000u;
+
+    // Minutes to degrees: min_e5 * 1e7 / (60 * 1e5).
+    return (int32_t)((deg * 10000000u) + ((min_e5 * 10u) / 6u));
+}
+
+static int nmea_hex(uint8_t c)
+{
+    int digit = -1;
+
+    if (('0' <= c) && ('9' >= c))
+    {
+        digit = c - '0';
+    }
+    else if (('A' <= c) && ('F' >= c))
+    {
+        digit = c - 'A' + 10;
+    }
+    else if (('a' <= c) && ('f' >= c))
+    {
+        digit = c - 'a' + 10;
+    }
+
+    return digit;
+}
+
+static void nmea_rmc_field(nmea_parser_t *p_parser)
+{
+    nmea_rmc_t *p_rmc = &p_parser->data.rmc;
+
+    switch (p_parser->field)
+    {
+        case 1: p_rmc->time_ms = nmea_num_time(p_parser); break;
+        case 2: p_rmc->valid = ('A' == p_parser->chr); break;
+        case 3: p_rmc->lat_e7 = nmea_num_coord(p_parser); break;
+        case 4: if ('S' == p_parser->chr) { p_rmc->lat_e7 = -p_rmc->lat_e7; } break;
+        case 5: p_rmc->lon_e7 = nmea_num_coord(p_parser); break;
+        case 6: if ('W' == p_parser->chr) { p_rmc->lon_e7 = -p_rmc->lon_e7; } break;
+        case 7:
+            // Knots to mm/s, 1 kn = 514.444 mm/s.
+            p_rmc->speed_mmps = (uint32_t)(((uint64_t)nmea_num_scaled(p_parser, 3u) *
+                                            514444u) / 1000000u);
+            break;
+        case 8: p_rmc->course_cdeg = (uint16_t)nmea_num_scaled(p_parser, 2u); break;
+        case 9: p_rmc->date = (uint32_t)nmea_num_scaled(p_parser, 0u); break;
+        default: break;
+    }
+}
+
+static void nmea_rmc_commit(nmea_parser_t *p_parser)
+{
+    const nmea_rmc_t *p_rmc = &p_parser->data.rmc;
+    nmea_fix_t *p_fix = &p_parser->fix_work;
+
+    p_fix->time_ms = p_rmc->time_ms;
+    p_fix->date = p_rmc->date;
+    p_fix->valid = p_rmc->valid;
+    p_fix->speed_mmps = p_rmc->speed_mmps;
+    p_fix->course_cdeg = p_rmc->course_cdeg;
+    if (p_rmc->valid)
+    {
+        p_fix->lat_e7 = p_rmc->lat_e7;
+        p_fix->lon_e7 = p_rmc->lon_e7;
+    }
+
+    nmea_fix_publish(p_parser);
+}
+
+static void nmea_gga_field(nmea_parser_t *p_parser)
+{
+    nmea_gga_t *p_gga = &p_parser->data.gga;
+
+    switch (p_parser->field)
+    {
+        case 1: p_gga->time_ms = nmea_num_time(p_parser); break;
+        case 2: p_gga->lat_e7 = nmea_num_coord(p_parser); break;
+        case 3: if ('S' == p_parser->chr) { p_gga->lat_e7 = -p_gga->lat_e7; } break;
+        case 4: p_gga->lon_e7 = nmea_num_coord(p_parser); break;
+        case 5: if ('W' == p_parser->chr) { p_gga->lon_e7 = -p_gga->lon_e7; } break;
+        case 6: p_gga->quality = (uint8_t)p_parser->num; break;
+        case 7: p_gga->sats_used = (uint8_t)p_parser->num; break;
+        case 8: p_gga->hdop_c = (uint16_t)nmea_num_scaled(p_parser, 2u); break;
+        case 9: p_gga->alt_mm = nmea_num_scaled(p_parser, 3u); break;
+        case 11: p_gga->geoid_sep_mm = nmea_num_scaled(p_parser, 3u); break;
+        default: break;
+    }
+}
+
+static void nmea_gga_commit(nmea_parser_t *p_parser)
+{
+    const nmea_gga_t *p_gga = &p_parser->data.gga;
+    nmea_fix_t *p_fix = &p_parser->fix_work;
+
+    p_fix->time_ms = p_gga->time_ms;
+    p_fix->quality = p_gga->quality;
+    p_fix->sats_used = p_gga->sats_used;
+    p_fix->hdop_c = p_gga->hdop_c;
+    if (0u < p_gga->quality)
+    {
+        p_fix->lat_e7 = p_gga->lat_e7;
+        p_fix->lon_e7 = p_gga->lon_e7;
+        p_fix->alt_mm = p_gga->alt_mm;
+    }
+
+    nmea_fix_publish(p_parser);
+}
+
+static void nmea_gsa_field(nmea_parser_t *p_parser)
+{
+    nmea_gsa_t *p_gsa = &p_parser->data.gsa;
+
+    if (2u == p_parser->field)
+    {
+        p_gsa->fix_type = (uint8_t)p_parser->num;
+    }
+    else if ((3u <= p_parser->field) &&
+             ((3u + NMEA_GSA_SV_MAX) > p_parser->field))
+    {
+        if (0u < p_parser->num_digits)
+        {
+            p_gsa->sv[p_gsa->sv_cnt] = (uint8_t)p_parser->num;
+            p_gsa->sv_cnt++;
+        }
+    }
+    else if ((3u + NMEA_GSA_SV_MAX) == p_parser->field)
+    {
+        p_gsa->pdop_c = (uint16_t)nmea_num_scaled(p_parser, 2u);
+    }
+    else if ((4u + NMEA_GSA_SV_MAX) == p_parser->field)
+    {
+        p_gsa->hdop_c = (uint16_t)nmea_num_scaled(p_parser, 2u);
+    }
+    else if ((5u + NMEA_GSA_SV_MAX) == p_parser->field)
+    {
+        p_gsa->vdop_c = (uint16_t)nmea_num_scaled(p_parser, 2u);
+    }
+}
+
+static void nmea_gsa_commit(nmea_parser_t *p_parser)
+{
+    const nmea_gsa_t *p_gsa = &p_parser->data.gsa;
+    nmea_fix_t *p_fix = &p_parser->fix_work;
+
+    p_fix->fix_type = p_gsa->fix_type;
+    p_fix->pdop_c = p_gsa->pdop_c;
+    p_fix->vdop_c = p_gsa->vdop_c;
+
+    nmea_fix_publish(p_parser);
+}
+
+static void nmea_gsv_field(nmea_parser_t *p_parser)
+{
+    nmea_gsv_t *p_gsv = &p_parser->data.gsv;
+
+    if (1u == p_parser->field)
+    {
+        p_gsv->msg_cnt = (uint8_t)p_parser->num;
+    }
+    else if (2u == p_parser->field)
+    {
+        p_gsv->msg_num = (uint8_t)p_parser->num;
+    }
+    else if (3u == p_parser->field)
+    {
+        p_gsv->sats_in_view = (uint8_t)p_parser->num;
+    }
+    else if ((4u <= p_parser->field) &&
+             ((4u + (4u * NMEA_GSV_SAT_PER_MSG)) > p_parser->field))
+    {
+        uint8_t index = (p_parser->field - 4u) / 4u;
+        nmea_sat_t *p_sat = &p_gsv->sat[index];
+
+        switch ((p_parser->field - 4u) % 4u)
+        {
+            case 0:
+                p_sat->prn = (uint8_t)p_parser->num;
+                p_gsv->sat_cnt = index + 1u;
+                break;
+            case 1: p_sat->elevation = (uint8_t)p_parser->num; break;
+            case 2: p_sat->azimuth = (uint16_t)p_parser->num; break;
+            default: p_sat->snr = (uint8_t)p_parser->num; break;
+        }
+    }
+}
+
+static void nmea_gsv_commit(nmea_parser_t *p_parser)
+{
+    const nmea_gsv_t *p_gsv = &p_parser->data.gsv;
+    nmea_sky_t *p_sky = &p_parser->sky_work;
+
+    // Every talker (GP, GL, GA...) sends its own cycle, the view restarts
+    // when the talker that opened the epoch starts a new cycle.
+    if (1u == p_gsv->msg_num)
+    {
+        if (p_parser->sky_talker == p_parser->addr[1])
+        {
+            p_sky->sat_cnt = 0u;
+        }
+
+        if (0u == p_sky->sat_cnt)
+        {
+            p_parser->sky_talker = p_parser->addr[1];
+        }
+    }
+
+    for (uint8_t index = 0u;
+         (index < p_gsv->sat_cnt) && (NMEA_SKY_SAT_MAX > p_sky->sat_cnt);
+         index++)
+    {
+        p_sky->sat[p_sky->sat_cnt] = p_gsv->sat[index];
+        p_sky->sat_cnt++;
+    }
+
+    if (p_gsv->msg_num == p_gsv->msg_cnt)
+    {
+        p_parser->sky_seq++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        p_parser->sky[p_parser->sky_active ^ 1u] = *p_sky;
+        p_parser->sky_active ^= 1u;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        p_parser->sky_seq++;
+    }
+}
+
+static void nmea_fix_publish(nmea_parser_t *p_parser)
+{
+    p_parser->fix_seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    p_parser->fix[p_parser->fix_active ^ 1u] = p_parser->fix_work;
+    p_parser->fix_active ^= 1u;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    p_parser->fix_seq++;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
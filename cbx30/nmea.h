@@ -0,0 +1,204 @@
+/** @file nmea.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __NMEA_H__
+#define __NMEA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+#define NMEA_GSA_SV_MAX         (12u)
+#define NMEA_GSV_SAT_PER_MSG    (4u)
+#define NMEA_SKY_SAT_MAX        (32u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef enum {
+    NMEA_SENTENCE_RMC = 0,
+    NMEA_SENTENCE_GGA,
+    NMEA_SENTENCE_GSA,
+    NMEA_SENTENCE_GSV,
+    NMEA_SENTENCE_CNT,
+    NMEA_SENTENCE_UNKNOWN = NMEA_SENTENCE_CNT,
+} nmea_sentence_t;
+
+typedef struct {
+    uint32_t time_ms;                               // UTC time of day.
+    uint32_t date;                                  // ddmmyy.
+    int32_t lat_e7;                                 // Degrees * 1e7, north positive.
+    int32_t lon_e7;                                 // Degrees * 1e7, east positive.
+    uint32_t speed_mmps;
+    uint16_t course_cdeg;                           // Course over ground, 0.01 deg.
+    bool valid;                                     // Status A.
+} nmea_rmc_t;
+
+typedef struct {
+    uint32_t time_ms;
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int32_t alt_mm;                                 // Above mean sea level.
+    int32_t geoid_sep_mm;
+    uint16_t hdop_c;                                // HDOP * 100.
+    uint8_t quality;                                // 0 no fix, 1 GPS, 2 DGPS...
+    uint8_t sats_used;
+} nmea_gga_t;
+
+typedef struct {
+    uint8_t fix_type;                               // 1 none, 2 2D, 3 3D.
+    uint8_t sv_cnt;
+    uint8_t sv[NMEA_GSA_SV_MAX];                    // Satellites used in fix.
+    uint16_t pdop_c;
+    uint16_t hdop_c;
+    uint16_t vdop_c;
+} nmea_gsa_t;
+
+typedef struct {
+    uint8_t prn;
+    uint8_t elevation;                              // Degrees.
+    uint16_t azimuth;                               // Degrees.
+    uint8_t snr;                                    // dBHz, 0 when not tracked.
+} nmea_sat_t;
+
+typedef struct {
+    uint8_t msg_cnt;
+    uint8_t msg_num;                                // 1 based.
+    uint8_t sats_in_view;
+    uint8_t sat_cnt;                                // Satellites in this message.
+    nmea_sat_t sat[NMEA_GSV_SAT_PER_MSG];
+} nmea_gsv_t;
+
+/// Latest fix, merged from RMC, GGA and GSA.
+typedef struct {
+    uint32_t time_ms;
+    uint32_t date;
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int32_t alt_mm;
+    uint32_t speed_mmps;
+    uint16_t course_cdeg;
+    uint16_t hdop_c;
+    uint16_t pdop_c;
+    uint16_t vdop_c;
+    uint8_t fix_type;
+    uint8_t quality;
+    uint8_t sats_used;
+    bool valid;
+} nmea_fix_t;
+
+/// Satellites in view, published once all GSV messages of a cycle arrived.
+typedef struct {
+    uint8_t sat_cnt;
+    nmea_sat_t sat[NMEA_SKY_SAT_MAX];
+} nmea_sky_t;
+
+typedef struct {
+    uint32_t sentences;                             // Valid sentences of known type.
+    uint32_t unknown;                               // Valid sentences of other types.
+    uint32_t checksum_errors;
+    uint32_t format_errors;                         // Too long or no checksum.
+} nmea_stats_t;
+
+typedef union {
+    nmea_rmc_t rmc;
+    nmea_gga_t gga;
+    nmea_gsa_t gsa;
+    nmea_gsv_t gsv;
+} nmea_data_t;
+
+/**
+ * @brief Called for every valid sentence of known type with its decoded data.
+ */
+typedef void (*nmea_sentence_cb_t)(nmea_sentence_t type,
+                                   const nmea_data_t *p_data, void *p_ctx);
+
+/// Parser state, contents are private.
+typedef struct {
+    uint8_t state;
+    uint8_t checksum;
+    uint8_t checksum_rx;
+    uint8_t field;
+    uint8_t length;
+    uint8_t addr_len;
+    char addr[5];
+    nmea_sentence_t type;
+    bool num_neg;
+    uint8_t num_frac;
+    uint8_t num_digits;
+    bool num_dot;
+    uint32_t num;
+    char chr;
+    nmea_data_t data;
+    nmea_fix_t fix_work;
+    nmea_sky_t sky_work;
+    char sky_talker;                                // Talker opening GSV epoch.
+    nmea_sentence_cb_t cb;
+    void *p_ctx;
+    nmea_stats_t stats;
+    // Latest-value slots, written by parser only.
+    nmea_fix_t fix[2];
+    nmea_sky_t sky[2];
+    volatile uint8_t fix_active;
+    volatile uint8_t sky_active;
+    volatile uint32_t fix_seq;
+    volatile uint32_t sky_seq;
+} nmea_parser_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Reset parser.
+ * @param p_parser parser.
+ * @param cb optional per-sentence callback, called from nmea_parse.
+ * @param p_ctx callback context.
+ */
+void nmea_init(nmea_parser_t *p_parser, nmea_sentence_cb_t cb, void *p_ctx);
+
+/**
+ * @brief Feed received bytes. Runs over the data in place, sentences may be
+ *      split across calls at any byte.
+ * @param p_parser parser.
+ * @param p_data received bytes, e.g. a DMA RX span.
+ * @param len number of bytes.
+ */
+void nmea_parse(nmea_parser_t *p_parser, const volatile uint8_t *p_data,
+                size_t len);
+
+/**
+ * @brief Copy latest fix. Lock free, safe from any task while parser runs.
+ * @param p_parser parser.
+ * @param p_fix output.
+ * @return false if no fix data was received yet.
+ */
+bool nmea_fix_get(nmea_parser_t *p_parser, nmea_fix_t *p_fix);
+
+/**
+ * @brief Copy latest complete satellite view. Lock free like nmea_fix_get.
+ * @param p_parser parser.
+ * @param p_sky output.
+ * @return false if no complete GSV cycle was received yet.
+ */
+bool nmea_sky_get(nmea_parser_t *p_parser, nmea_sky_t *p_sky);
+
+/**
+ * @brief Get parser statistics.
+ * @param p_parser parser.
+ * @param p_stats output.
+ */
+void nmea_stats_get(const nmea_parser_t *p_parser, nmea_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__NMEA_H__
@@ -0,0 +1,378 @@
+/** @file nmea_host.c
+*
+* @brief Host benchmark of the NMEA parser. Feeds a log in DMA span sized
+*        chunks and reports sentences per second and the stack the parser
+*        used, measured by painting the stack of the thread that runs it.
+*        Stack depth is of the host build, it tracks changes on target but
+*        is not the Cortex-M figure.
+*
+*        gcc -O2 -DNMEA_HOST -Ihost -I. nmea.c nmea_host.c -lpthread -o nmea
+*        ./nmea [-c chunk] [-r repeat] [-e epochs] [gps.log]
+*
+*        Without a log, one is generated: a 1 Hz receiver sending RMC, GGA,
+*        GSA, three GSV and a VTG per epoch, with a corrupted checksum every
+*        NMEA_HOST_BAD_EVERY epochs. Parsed counts and the last fix are then
+*        checked against what was generated.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/nmea.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define NMEA_HOST_EPOCHS            (100000u)
+#define NMEA_HOST_CHUNK             (64u)
+#define NMEA_HOST_REPEAT            (5u)
+#define NMEA_HOST_BAD_EVERY         (97u)
+#define NMEA_HOST_EPOCH_LEN         (640u)
+#define NMEA_HOST_STACK_LEN         (64u * 1024u)
+#define NMEA_HOST_STACK_PAINT       (0xA5u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint8_t *p_data;
+    size_t len;
+    size_t chunk;
+} host_log_t;
+
+typedef struct {
+    uint32_t epochs;
+    uint32_t known;
+    uint32_t unknown;
+    uint32_t bad;
+    uint32_t time_ms;
+    int32_t lat_e7;
+    int32_t lon_e7;
+} host_expect_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static bool host_log_load(host_log_t *p_log, const char *p_path);
+static bool host_log_generate(host_log_t *p_log, host_expect_t *p_expect);
+static size_t host_sentence(char *p_out, const char *p_body, bool corrupt);
+static void host_parse(nmea_parser_t *p_parser, const host_log_t *p_log);
+static void *host_stack_thread(void *p_arg);
+static size_t host_stack_used(const host_log_t *p_log);
+static void host_cb(nmea_sentence_t type, const nmea_data_t *p_data,
+                    void *p_ctx);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static uint8_t *host_stack;
+static uintptr_t host_stack_top;
+static uint32_t host_cb_cnt[NMEA_SENTENCE_CNT];
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef NMEA_HOST
+int main(int argc, char **argv)
+{
+    static nmea_parser_t parser;
+    host_log_t log = { .chunk = NMEA_HOST_CHUNK };
+    host_expect_t expect = { .epochs = NMEA_HOST_EPOCHS };
+    uint32_t repeat = NMEA_HOST_REPEAT;
+    bool generated = false;
+    bool is_ok = true;
+    nmea_stats_t stats;
+    nmea_fix_t fix;
+    nmea_sky_t sky;
+    struct timespec start;
+    struct timespec end;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "c:r:e:")))
+    {
+        switch (opt)
+        {
+            case 'c':
+                log.chunk = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeat = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                expect.epochs = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-c chunk] [-r repeat] "
+                        "[-e epochs] [gps.log]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((0u == log.chunk) || (0u == repeat))
+    {
+        fprintf(stderr, "chunk and repeat must be above 0\n");
+        return 1;
+    }
+
+    if (optind < argc)
+    {
+        is_ok = host_log_load(&log, argv[optind]);
+    }
+    else
+    {
+        is_ok = host_log_generate(&log, &expect);
+        generated = true;
+    }
+
+    if (!is_ok)
+    {
+        fprintf(stderr, "no log\n");
+        return 1;
+    }
+
+    // Callback counts one pass, timing passes run without it.
+    nmea_init(&parser, host_cb, NULL);
+    host_parse(&parser, &log);
+    nmea_stats_get(&parser, &stats);
+
+    if (generated)
+    {
+        is_ok = (expect.known == stats.sentences) &&
+                (expect.unknown == stats.unknown) &&
+                (expect.bad == stats.checksum_errors) &&
+                (0u == stats.format_errors) &&
+                (expect.known == (host_cb_cnt[NMEA_SENTENCE_RMC] +
+                                  host_cb_cnt[NMEA_SENTENCE_GGA] +
+                                  host_cb_cnt[NMEA_SENTENCE_GSA] +
+                                  host_cb_cnt[NMEA_SENTENCE_GSV]));
+
+        is_ok = is_ok && nmea_fix_get(&parser, &fix) &&
+                (expect.time_ms == fix.time_ms) &&
+                (expect.lat_e7 == fix.lat_e7) &&
+                (expect.lon_e7 == fix.lon_e7) &&
+                fix.valid && (3u == fix.fix_type) && (8u == fix.sats_used);
+
+        is_ok = is_ok && nmea_sky_get(&parser, &sky) && (12u == sky.sat_cnt);
+    }
+
+    // After a full pass, library calls are bound and lazy symbol lookup of
+    // the dynamic linker does not count as parser stack.
+    size_t stack = host_stack_used(&log);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t pass = 0u; pass < repeat; pass++)
+    {
+        nmea_init(&parser, NULL, NULL);
+        host_parse(&parser, &log);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (double)(end.tv_sec - start.tv_sec) +
+                     ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+    double total = (double)stats.sentences + stats.unknown +
+                   stats.checksum_errors + stats.format_errors;
+
+    printf("%zu bytes, %u known, %u unknown, %u checksum errors, "
+           "%u format errors\n", log.len, stats.sentences, stats.unknown,
+           stats.checksum_errors, stats.format_errors);
+    printf("%zu byte chunks: %.0f sentences/s, %.1f MB/s, %.1f ns/byte\n",
+           log.chunk, (total * repeat) / elapsed,
+           ((double)log.len * repeat) / elapsed / 1e6,
+           (elapsed * 1e9) / ((double)log.len * repeat));
+    printf("stack: %zu bytes below caller\n", stack);
+
+    if (generated)
+    {
+        printf("%s\n", is_ok ? "ok" : "failed");
+    }
+
+    free(log.p_data);
+
+    return !is_ok;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static bool host_log_load(host_log_t *p_log, const char *p_path)
+{
+    FILE *p_file = fopen(p_path, "rb");
+    long len;
+
+    if (NULL == p_file)
+    {
+        return false;
+    }
+
+    fseek(p_file, 0, SEEK_END);
+    len = ftell(p_file);
+    fseek(p_file, 0, SEEK_SET);
+
+    p_log->p_data = (0 < len) ? malloc((size_t)len) : NULL;
+    p_log->len = (NULL != p_log->p_data) ?
+                 fread(p_log->p_data, 1u, (size_t)len, p_file) : 0u;
+
+    fclose(p_file);
+
+    return (0u < p_log->len);
+}
+
+static bool host_log_generate(host_log_t *p_log, host_expect_t *p_expect)
+{
+    static const uint8_t prn[12] = { 1, 3, 6, 9, 12, 17, 19, 22, 25, 28, 31,
+                                     32 };
+    char body[128];
+    char *p_out;
+
+    p_log->p_data = malloc((size_t)p_expect->epochs * NMEA_HOST_EPOCH_LEN);
+    if (NULL == p_log->p_data)
+    {
+        return false;
+    }
+    p_out = (char *)p_log->p_data;
+
+    for (uint32_t epoch = 0u; epoch < p_expect->epochs; epoch++)
+    {
+        uint32_t sec = (36000u + epoch) % 86400u;
+        // Slow drift north east, minutes with four decimals.
+        uint32_t lat = 481234u + (epoch % 10000u);
+        uint32_t lon = 585678u + ((epoch * 3u) % 10000u);
+        char utc[16];
+        char pos[48];
+        bool bad = (0u == ((epoch + 1u) % NMEA_HOST_BAD_EVERY));
+
+        snprintf(utc, sizeof(utc), "%02u%02u%02u.00", sec / 3600u,
+                 (sec / 60u) % 60u, sec % 60u);
+        snprintf(pos, sizeof(pos), "45%02u.%04u,N,015%02u.%04u,E",
+                 lat / 10000u, lat % 10000u, lon / 10000u, lon % 10000u);
+
+        snprintf(body, sizeof(body), "GPRMC,%s,A,%s,1.234,45.67,170126,,,A",
+                 utc, pos);
+        p_out += host_sentence(p_out, body, false);
+
+        // Bad checksum lands on GGA, fix keeps the RMC position.
+        snprintf(body, sizeof(body), "GPGGA,%s,%s,1,08,0.92,123.4,M,45.6,M,,",
+                 utc, pos);
+        p_out += host_sentence(p_out, body, bad);
+
+        p_out += host_sentence(p_out, "GPGSA,A,3,01,03,06,09,12,17,19,22,,,,,"
+                               "1.60,0.92,1.31", false);
+
+        for (uint32_t msg = 0u; msg < 3u; msg++)
+        {
+            int len = snprintf(body, sizeof(body), "GPGSV,3,%u,12", msg + 1u);
+
+            for (uint32_t sat = msg * 4u; sat < ((msg + 1u) * 4u); sat++)
+            {
+                len += snprintf(&body[len], sizeof(body) - (size_t)len,
+                                ",%02u,%02u,%03u,%02u", prn[sat],
+                                (sat * 7u) % 90u, (sat * 31u) % 360u,
+                                (8u > sat) ? (30u + sat) : 0u);
+            }
+            p_out += host_sentence(p_out, body, false);
+        }
+
+        p_out += host_sentence(p_out, "GPVTG,45.67,T,,M,1.234,N,2.285,K,A",
+                               false);
+
+        p_expect->known += bad ? 5u : 6u;
+        p_expect->unknown++;
+        p_expect->bad += bad ? 1u : 0u;
+        p_expect->time_ms = sec * 1000u;
+        // ddmm.mmmm to degrees * 1e7.
+        p_expect->lat_e7 = 450000000 + (int32_t)((lat * 100u) / 6u);
+        p_expect->lon_e7 = 150000000 + (int32_t)((lon * 100u) / 6u);
+    }
+
+    p_log->len = (size_t)(p_out - (char *)p_log->p_data);
+
+    return true;
+}
+
+static size_t host_sentence(char *p_out, const char *p_body, bool corrupt)
+{
+    uint8_t checksum = 0u;
+
+    for (const char *p_c = p_body; '\0' != *p_c; p_c++)
+    {
+        checksum ^= (uint8_t)*p_c;
+    }
+
+    if (corrupt)
+    {
+        checksum ^= 0x01u;
+    }
+
+    return (size_t)sprintf(p_out, "$%s*%02X\r\n", p_body, checksum);
+}
+
+static void host_parse(nmea_parser_t *p_parser, const host_log_t *p_log)
+{
+    for (size_t pos = 0u; pos < p_log->len; pos += p_log->chunk)
+    {
+        size_t len = p_log->len - pos;
+
+        nmea_parse(p_parser, &p_log->p_data[pos],
+                   (len < p_log->chunk) ? len : p_log->chunk);
+    }
+}
+
+static void *host_stack_thread(void *p_arg)
+{
+    static nmea_parser_t parser;
+
+    // Everything below this frame is parser, callback and their calls.
+    host_stack_top = (uintptr_t)__builtin_frame_address(0);
+
+    nmea_init(&parser, host_cb, NULL);
+    host_parse(&parser, (const host_log_t *)p_arg);
+
+    return NULL;
+}
+
+static size_t host_stack_used(const host_log_t *p_log)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    size_t deepest = 0u;
+
+    host_stack = aligned_alloc(4096u, NMEA_HOST_STACK_LEN);
+    if (NULL == host_stack)
+    {
+        return 0u;
+    }
+    memset(host_stack, NMEA_HOST_STACK_PAINT, NMEA_HOST_STACK_LEN);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, host_stack, NMEA_HOST_STACK_LEN);
+    if (0 == pthread_create(&thread, &attr, host_stack_thread, (void *)p_log))
+    {
+        pthread_join(thread, NULL);
+
+        // Stack grows down, first byte not painted is the deepest reached.
+        while ((deepest < NMEA_HOST_STACK_LEN) &&
+               (NMEA_HOST_STACK_PAINT == host_stack[deepest]))
+        {
+            deepest++;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    size_t used = host_stack_top - (uintptr_t)&host_stack[deepest];
+
+    free(host_stack);
+
+    return used;
+}
+
+static void host_cb(nmea_sentence_t type, const nmea_data_t *p_data,
+                    void *p_ctx)
+{
+    (void)p_data;
+    (void)p_ctx;
+
+    host_cb_cnt[type]++;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <error_handler.h>
 #include <inc/bsp/bsp.h>
+#include <inc/bsp/timestamp.h>
 #include <RTT.h>
 #include <time.h>
 #include <helpers.h>
@@ -170,6 +171,7 @@ void bsp_rtc_data_set (rtc_data_t *p_data)
     if (result)
     {
         HAL_RTCEx_BKUPWrite(p_handle,RTC_BKP_DR31, rtc_set_val);
+        bsp_timestamp_unix_set(rtc_to_unix(p_data));
     }
 
     if (!result)
@@ -374,11 +376,11 @@ static inline uint32_t rtc_current_tick_calc (void)
         subs2 = (uint16_t)(hrtc.Instance->SSR);
     } while ((subs1 != subs2) || (sec1 != rtc_sec_ticks));
 
-    uint64_t ticks = rtc_sec_ticks + (RTC_PREDIV_S - subs1);
+    uint32_t ticks = sec1 + (RTC_PREDIV_S - subs1);
 
-    // Convert to miliseconds.
-    ticks = (1000 * ticks) / (RTC_PREDIV_S +1);
-    return (uint32_t)ticks;
+    // Convert 1/1024 s ticks to miliseconds with shifts only, whole seconds
+    // separately so 32 bits do not overflow.
+    return ((ticks >> 10) * 1000u) + (((ticks & 1023u) * 1000u) >> 10);
 }
 
 
@@ -533,10 +535,45 @@ static void rtc_second_interrupt (bool enable)
 }
 
 
-// Suppress warnings, DO NOT CALL !
-void bsp_rtc_dummy (void)
+void bsp_rtc_unix_set (int32_t unix_timestamp)
 {
-    (void)unix_to_rtc;
+    rtc_data_t rtc_data;
+
+    memset(&rtc_data, 0, sizeof(rtc_data));
+    unix_to_rtc((uint32_t)unix_timestamp, &rtc_data);
+    bsp_rtc_data_set(&rtc_data);
+}
+
+
+int32_t bsp_rtc_smooth_calib_set (int32_t ppb)
+{
+    // One CALM pulse per 2^20 RTCCLK cycles is 953.67 ppb.
+    int32_t pulses = (int32_t)((((int64_t)ppb << 20) +
+                                ((0 > ppb) ? -500000000 : 500000000)) /
+                               1000000000);
+    uint32_t plus = RTC_SMOOTHCALIB_PLUSPULSES_RESET;
+    uint32_t calm;
+
+    if (0 < pulses)
+    {
+        // CALP adds 512 pulses, CALM takes the surplus back.
+        plus = RTC_SMOOTHCALIB_PLUSPULSES_SET;
+        calm = (512 > pulses) ? (uint32_t)(512 - pulses) : 0u;
+        pulses = 512 - (int32_t)calm;
+    }
+    else
+    {
+        calm = (511 > -pulses) ? (uint32_t)(-pulses) : 511u;
+        pulses = -(int32_t)calm;
+    }
+
+    if (HAL_OK != HAL_RTCEx_SetSmoothCalib(&hrtc, RTC_SMOOTHCALIB_PERIOD_32SEC,
+                                           plus, calm))
+    {
+        EPRINT("RTC smooth calibration failed\n");
+    }
+
+    return (int32_t)(((int64_t)pulses * 1000000000) >> 20);
 }
 
 //--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -544,6 +581,7 @@ void bsp_rtc_dummy (void)
 void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef *hrtc)
 {
     rtc_sec_ticks = rtc_sec_ticks + (RTC_PREDIV_S + 1);
+    bsp_timestamp_rtc_second();
 }
 
 void RTC_Alarm_IRQHandler(void)
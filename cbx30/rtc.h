@@ -91,6 +91,20 @@ uint8_t bsp_rtc_osc_test (void);
  */
 bool bsp_rtc_subseconds_offset_set(int16_t offset);
 
+/**
+ * @brief Set RTC date and time from unix time.
+ * @param unix_timestamp unix time in seconds.
+ */
+void bsp_rtc_unix_set(int32_t unix_timestamp);
+
+/**
+ * @brief Trim RTC frequency with smooth calibration.
+ * @param ppb frequency correction in ppb, positive speeds RTC up. Range is
+ *      about -487 to +488 ppm in 953.67 ppb steps.
+ * @return Correction actually applied in ppb.
+ */
+int32_t bsp_rtc_smooth_calib_set(int32_t ppb);
+
 /**
  * @brief Reset millisecond tick.
  */
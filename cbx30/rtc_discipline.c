@@ -0,0 +1,271 @@
+/** @file rtc_discipline.c
+*
+* @brief Keeps RTC on GNSS time. Phase is compared at every valid NAV-PVT,
+*        averaged over a window and fed to a PI loop driving RTC smooth
+*        calibration. Large phase errors are removed with sub-second shifts.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/rtc_discipline.h>
+#include <inc/bsp/rtc.h>
+#include <inc/bsp/gps.h>
+#include <inc/bsp/timestamp.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+// NAV-PVT validDate, validTime and fullyResolved.
+#define RTC_DISC_PVT_VALID          (0x07u)
+#define RTC_DISC_T_ACC_MAX_NS       (1000000u)
+
+// NAV-PVT output delay after the epoch plus transfer at 115200 baud. Same
+// on every unit, so devices stay aligned to each other even if it is off.
+#define RTC_DISC_LATENCY_US         (30000)
+
+#define RTC_DISC_WINDOW_US          (64000000u)
+// Timestamp service slews RTC changes in at 500 ppm, fixes are not used
+// until it caught up.
+#define RTC_DISC_SETTLE_US          (16000000u)
+// Offsets above are fixed by setting RTC, above SHIFT by sub-second shift.
+#define RTC_DISC_STEP_US            (1000000)
+#define RTC_DISC_SHIFT_US           (3000)
+
+// PI gains as divisors of the per-window frequency error.
+#define RTC_DISC_KP_DIV             (2)
+#define RTC_DISC_KI_DIV             (8)
+#define RTC_DISC_FREQ_MAX_PPB       (400000)
+
+#define RTC_DISC_SUBSEC_HZ          (1024)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint64_t last_rx_us;
+    uint64_t settle_us;                             // Fixes before are skipped.
+    uint64_t window_start_us;
+    int64_t window_sum;
+    uint32_t window_cnt;
+    int32_t window_min;
+    int32_t window_max;
+    int32_t freq_integ_ppb;
+    bsp_rtc_discipline_stats_t stats;
+} rtc_disc_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief UTC time of NAV-PVT epoch.
+ * @return unix time in microseconds.
+ */
+static int64_t rtc_disc_pvt_us(const ubx_nav_pvt_t *p_pvt);
+
+/**
+ * @brief Days since 1970-01-01 of a civil date.
+ */
+static int32_t rtc_disc_days(int32_t year, uint32_t month, uint32_t day);
+
+/**
+ * @brief Set RTC to GNSS time.
+ * @param gnss_us GNSS time at rx_us.
+ * @param rx_us monotonic time of GNSS time.
+ */
+static void rtc_disc_step(int64_t gnss_us, uint64_t rx_us);
+
+/**
+ * @brief Run PI loop with offsets of finished window.
+ * @param now_us monotonic time.
+ */
+static void rtc_disc_update(uint64_t now_us);
+
+/**
+ * @brief Start new averaging window.
+ */
+static void rtc_disc_window_reset(uint64_t now_us);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static rtc_disc_t rtc_disc;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void bsp_rtc_discipline_init(void)
+{
+    memset(&rtc_disc, 0, sizeof(rtc_disc));
+}
+
+void bsp_rtc_discipline_process(void)
+{
+    ubx_nav_pvt_t pvt;
+    uint64_t rx_us;
+    int32_t rtc_sec;
+    uint32_t rtc_us;
+
+    if ((!bsp_gps_pvt_get(&pvt, &rx_us)) || (rx_us == rtc_disc.last_rx_us))
+    {
+        return;
+    }
+    rtc_disc.last_rx_us = rx_us;
+
+    if ((RTC_DISC_PVT_VALID != (pvt.valid & RTC_DISC_PVT_VALID)) ||
+        (RTC_DISC_T_ACC_MAX_NS < pvt.t_acc_ns) ||
+        (rx_us < rtc_disc.settle_us) ||
+        (!bsp_timestamp_to_unix(rx_us, &rtc_sec, &rtc_us)))
+    {
+        return;
+    }
+
+    int64_t gnss_us = rtc_disc_pvt_us(&pvt) + RTC_DISC_LATENCY_US;
+    int64_t offset = gnss_us - (((int64_t)rtc_sec * 1000000) + rtc_us);
+
+    rtc_disc.stats.fixes++;
+
+    if ((!rtc_disc.stats.synced) || (RTC_DISC_STEP_US <= offset) ||
+        (-RTC_DISC_STEP_US >= offset))
+    {
+        rtc_disc_step(gnss_us, rx_us);
+        return;
+    }
+
+    if (0u == rtc_disc.window_cnt)
+    {
+        rtc_disc.window_start_us = rx_us;
+        rtc_disc.window_min = (int32_t)offset;
+        rtc_disc.window_max = (int32_t)offset;
+    }
+    else if (rtc_disc.window_min > offset)
+    {
+        rtc_disc.window_min = (int32_t)offset;
+    }
+    else if (rtc_disc.window_max < offset)
+    {
+        rtc_disc.window_max = (int32_t)offset;
+    }
+
+    rtc_disc.window_sum += offset;
+    rtc_disc.window_cnt++;
+
+    if (RTC_DISC_WINDOW_US <= (rx_us - rtc_disc.window_start_us))
+    {
+        rtc_disc_update(rx_us);
+    }
+}
+
+void bsp_rtc_discipline_stats_get(bsp_rtc_discipline_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        *p_stats = rtc_disc.stats;
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static int64_t rtc_disc_pvt_us(const ubx_nav_pvt_t *p_pvt)
+{
+    int64_t sec = ((int64_t)rtc_disc_days(p_pvt->year, p_pvt->month,
+                                          p_pvt->day) * 86400) +
+                  ((int64_t)p_pvt->hour * 3600) + (p_pvt->min * 60) +
+                  p_pvt->sec;
+
+    // Nano is signed, time fields are rounded to the nearest second.
+    return (sec * 1000000) + (p_pvt->nano / 1000);
+}
+
+static int32_t rtc_disc_days(int32_t year, uint32_t month, uint32_t day)
+{
+    // Civil calendar with March as first month, leap day last.
+    year -= (2u >= month) ? 1 : 0;
+
+    int32_t era = year / 400;
+    uint32_t yoe = (uint32_t)(year - (era * 400));
+    uint32_t doy = (((153u * ((2u < month) ? (month - 3u) : (month + 9u))) +
+                     2u) / 5u) + day - 1u;
+    uint32_t doe = (yoe * 365u) + (yoe / 4u) - (yoe / 100u) + doy;
+
+    return (era * 146097) + (int32_t)doe - 719468;
+}
+
+static void rtc_disc_step(int64_t gnss_us, uint64_t rx_us)
+{
+    uint64_t now_us = bsp_timestamp_now();
+    int32_t sec;
+    int16_t ticks;
+
+    // Setting time restarts the RTC second, fraction is shifted in after.
+    gnss_us += (int64_t)(now_us - rx_us);
+    sec = (int32_t)((gnss_us + 500000) / 1000000);
+    ticks = (int16_t)(((gnss_us - ((int64_t)sec * 1000000)) *
+                       RTC_DISC_SUBSEC_HZ) / 1000000);
+
+    bsp_rtc_unix_set(sec);
+    if (0 != ticks)
+    {
+        (void)bsp_rtc_subseconds_offset_set(ticks);
+    }
+
+    rtc_disc.stats.steps++;
+    rtc_disc.stats.synced = true;
+    rtc_disc.settle_us = now_us + RTC_DISC_SETTLE_US;
+    rtc_disc_window_reset(now_us);
+}
+
+static void rtc_disc_update(uint64_t now_us)
+{
+    int32_t dt_s = (int32_t)((now_us - rtc_disc.window_start_us) / 1000000u);
+    int32_t phase = (int32_t)(rtc_disc.window_sum /
+                              (int32_t)rtc_disc.window_cnt);
+
+    rtc_disc.stats.offset_us = phase;
+    rtc_disc.stats.offset_min_us = rtc_disc.window_min;
+    rtc_disc.stats.offset_max_us = rtc_disc.window_max;
+    rtc_disc.stats.updates++;
+
+    if ((RTC_DISC_SHIFT_US <= phase) || (-RTC_DISC_SHIFT_US >= phase))
+    {
+        int16_t ticks = (int16_t)(((int64_t)phase * RTC_DISC_SUBSEC_HZ) /
+                                  1000000);
+
+        if (bsp_rtc_subseconds_offset_set(ticks))
+        {
+            // PI only sees what the shift did not remove.
+            phase -= (int32_t)(((int64_t)ticks * 1000000) /
+                               RTC_DISC_SUBSEC_HZ);
+            rtc_disc.stats.shifts++;
+            rtc_disc.settle_us = now_us + RTC_DISC_SETTLE_US;
+        }
+    }
+
+    if (0 < dt_s)
+    {
+        // Frequency error that would clear the phase over one window.
+        int32_t err_ppb = (int32_t)(((int64_t)phase * 1000) / dt_s);
+        int32_t freq;
+
+        rtc_disc.freq_integ_ppb += err_ppb / RTC_DISC_KI_DIV;
+        if (RTC_DISC_FREQ_MAX_PPB < rtc_disc.freq_integ_ppb)
+        {
+            rtc_disc.freq_integ_ppb = RTC_DISC_FREQ_MAX_PPB;
+        }
+        else if (-RTC_DISC_FREQ_MAX_PPB > rtc_disc.freq_integ_ppb)
+        {
+            rtc_disc.freq_integ_ppb = -RTC_DISC_FREQ_MAX_PPB;
+        }
+
+        freq = rtc_disc.freq_integ_ppb + (err_ppb / RTC_DISC_KP_DIV);
+        rtc_disc.stats.freq_ppb = bsp_rtc_smooth_calib_set(freq);
+    }
+
+    rtc_disc_window_reset(now_us);
+}
+
+static void rtc_disc_window_reset(uint64_t now_us)
+{
+    rtc_disc.window_start_us = now_us;
+    rtc_disc.window_sum = 0;
+    rtc_disc.window_cnt = 0u;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
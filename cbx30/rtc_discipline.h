@@ -0,0 +1,59 @@
+/** @file rtc_discipline.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __BSP_RTC_DISCIPLINE_H__
+#define __BSP_RTC_DISCIPLINE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint32_t fixes;                                 // GNSS times compared.
+    uint32_t updates;                               // Loop iterations.
+    uint32_t steps;                                 // RTC set to GNSS time.
+    uint32_t shifts;                                // Sub-second shifts applied.
+    int32_t offset_us;                              // Last window mean, GNSS - RTC.
+    int32_t offset_min_us;                          // Last window extremes.
+    int32_t offset_max_us;
+    int32_t freq_ppb;                               // Applied RTC calibration.
+    bool synced;                                    // RTC follows GNSS time.
+} bsp_rtc_discipline_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Reset discipline loop. RTC calibration is left as it is.
+ */
+void bsp_rtc_discipline_init(void);
+
+/**
+ * @brief Compare RTC to latest GNSS time and trim RTC. Call about once per
+ *      second from a task while GPS runs in UBX mode, may block ~20 ms
+ *      when RTC is adjusted.
+ */
+void bsp_rtc_discipline_process(void);
+
+/**
+ * @brief Get discipline loop statistics.
+ * @param p_stats output.
+ */
+void bsp_rtc_discipline_stats_get(bsp_rtc_discipline_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BSP_RTC_DISCIPLINE_H__
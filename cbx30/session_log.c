@@ -0,0 +1,446 @@
+/** @file session_log.c
+*
+* @brief Logger input. Every source has a single producer, single consumer
+*        ring of fixed size record slots, producers fill a slot in place and
+*        publish it without locks or queue copies. Logger task sleeps until a
+*        ring reaches its watermark or the flush timeout passes, then drains
+*        all rings in one pass, oldest record first, into the session writer.
+*        One wake per batch instead of one per record.
+*
+*        Built with SESSION_LOG_HOST rings are drained in the caller.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_log.h>
+#include <session_writer.h>
+#include <circular_buffer.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef SESSION_LOG_HOST
+#include <time.h>
+#else
+#include <FreeRTOS.h>
+#include <task.h>
+#include <stm32l4xx_hal.h>
+#include <inc/bsp/timestamp.h>
+#endif
+
+//-------------------------------- MACROS -------------------------------------
+#define SESSION_LOG_STACK           (384u)
+#define SESSION_LOG_PRIORITY        (2u)
+
+// Records per ring and records that wake the logger. Watermark at half
+// leaves the other half for logger latency.
+#define LOG_HRM_DEPTH               (8u)
+#define LOG_HRM_MARK                (4u)
+#define LOG_IMU_DEPTH               (64u)
+#define LOG_IMU_MARK                (32u)
+#define LOG_QUAT_DEPTH              (32u)
+#define LOG_QUAT_MARK               (16u)
+#define LOG_GPS_DEPTH               (16u)
+#define LOG_GPS_MARK                (8u)
+#define LOG_BATTERY_DEPTH           (4u)
+#define LOG_BATTERY_MARK            (2u)
+#define LOG_EVENT_DEPTH             (16u)
+#define LOG_EVENT_MARK              (8u)
+#define LOG_HRV_DEPTH               (4u)
+#define LOG_HRV_MARK                (2u)
+
+// Slot holds only the channels of its source, 8 byte aligned.
+#define LOG_SLOT_SIZE(cnt)          ((offsetof(session_log_slot_t, rec.ch) + \
+                                      ((cnt) * sizeof(int32_t)) + 7u) & ~7u)
+// Ring keeps one slot empty, slots never wrap.
+#define LOG_RING_SIZE(cnt, depth)   (LOG_SLOT_SIZE(cnt) * ((depth) + 1u))
+
+#define LOG_MEM_SIZE                                                        \
+    (LOG_RING_SIZE(SESSION_LOG_HRM_CH, LOG_HRM_DEPTH) +                     \
+     LOG_RING_SIZE(SESSION_LOG_IMU_CH, LOG_IMU_DEPTH) +                     \
+     LOG_RING_SIZE(SESSION_LOG_QUAT_CH, LOG_QUAT_DEPTH) +                   \
+     LOG_RING_SIZE(SESSION_LOG_GPS_CH, LOG_GPS_DEPTH) +                     \
+     LOG_RING_SIZE(SESSION_LOG_BATTERY_CH, LOG_BATTERY_DEPTH) +             \
+     LOG_RING_SIZE(SESSION_LOG_EVENT_CH, LOG_EVENT_DEPTH) +                 \
+     LOG_RING_SIZE(SESSION_LOG_HRV_CH, LOG_HRV_DEPTH))
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint32_t stamp_us;                              // Commit time, low bits.
+    uint32_t cnt;                                   // Channels reserved.
+    session_record_t rec;                           // Truncated to source.
+} session_log_slot_t;
+
+typedef struct {
+    uint8_t type;                                   // session_record_type_t
+    uint8_t ch_max;
+    uint16_t depth;
+    uint16_t watermark;
+    uint16_t slot_size;
+} session_log_cfg_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Hand everything committed so far to the session writer, merged by
+ *      record time so references and keyframes follow one clock.
+ */
+static void session_log_drain(void);
+
+/**
+ * @brief Oldest committed slot of a source, NULL if ring is empty.
+ */
+static session_log_slot_t *session_log_head(session_log_source_t source);
+
+/**
+ * @brief Wake logger, from task or ISR.
+ */
+static void session_log_notify(void);
+
+static void session_log_critical_enter(void);
+static void session_log_critical_exit(void);
+static uint64_t session_log_now_us(void);
+
+#ifndef SESSION_LOG_HOST
+static void session_log_task(void *p_arg);
+#endif
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static const session_log_cfg_t log_cfg[SESSION_LOG_SOURCE_CNT] = {
+    [SESSION_LOG_HRM] = {
+        SESSION_RECORD_HRM, SESSION_LOG_HRM_CH, LOG_HRM_DEPTH, LOG_HRM_MARK,
+        LOG_SLOT_SIZE(SESSION_LOG_HRM_CH)
+    },
+    [SESSION_LOG_IMU] = {
+        SESSION_RECORD_IMU, SESSION_LOG_IMU_CH, LOG_IMU_DEPTH, LOG_IMU_MARK,
+        LOG_SLOT_SIZE(SESSION_LOG_IMU_CH)
+    },
+    [SESSION_LOG_QUAT] = {
+        SESSION_RECORD_QUAT, SESSION_LOG_QUAT_CH, LOG_QUAT_DEPTH,
+        LOG_QUAT_MARK, LOG_SLOT_SIZE(SESSION_LOG_QUAT_CH)
+    },
+    [SESSION_LOG_GPS] = {
+        SESSION_RECORD_GPS, SESSION_LOG_GPS_CH, LOG_GPS_DEPTH, LOG_GPS_MARK,
+        LOG_SLOT_SIZE(SESSION_LOG_GPS_CH)
+    },
+    [SESSION_LOG_BATTERY] = {
+        SESSION_RECORD_BATTERY, SESSION_LOG_BATTERY_CH, LOG_BATTERY_DEPTH,
+        LOG_BATTERY_MARK, LOG_SLOT_SIZE(SESSION_LOG_BATTERY_CH)
+    },
+    [SESSION_LOG_EVENT] = {
+        SESSION_RECORD_EVENT, SESSION_LOG_EVENT_CH, LOG_EVENT_DEPTH,
+        LOG_EVENT_MARK, LOG_SLOT_SIZE(SESSION_LOG_EVENT_CH)
+    },
+    [SESSION_LOG_HRV] = {
+        SESSION_RECORD_HRV, SESSION_LOG_HRV_CH, LOG_HRV_DEPTH, LOG_HRV_MARK,
+        LOG_SLOT_SIZE(SESSION_LOG_HRV_CH)
+    },
+};
+
+static uint64_t log_mem[LOG_MEM_SIZE / sizeof(uint64_t)];
+static circ_buff_t log_ring[SESSION_LOG_SOURCE_CNT];
+static session_log_slot_t *log_slot[SESSION_LOG_SOURCE_CNT]; // Producer only.
+static session_log_stats_t log_stats;
+
+#ifndef SESSION_LOG_HOST
+static TaskHandle_t log_task;
+#endif
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+bool session_log_init(void)
+{
+    uint8_t *p_mem = (uint8_t *)log_mem;
+
+    memset(&log_stats, 0, sizeof(log_stats));
+
+    for (uint32_t source = 0u; source < SESSION_LOG_SOURCE_CNT; source++)
+    {
+        size_t size = log_cfg[source].slot_size *
+                      (log_cfg[source].depth + 1u);
+
+        circ_buff_spsc_init(&log_ring[source], p_mem, size);
+        log_slot[source] = NULL;
+        p_mem += size;
+    }
+
+#ifndef SESSION_LOG_HOST
+    return (pdPASS == xTaskCreate(session_log_task, "log", SESSION_LOG_STACK,
+                                  NULL, SESSION_LOG_PRIORITY, &log_task));
+#else
+    return true;
+#endif
+}
+
+session_record_t *session_log_reserve(session_log_source_t source,
+                                      uint8_t cnt)
+{
+    session_log_slot_t *p_slot;
+    uint8_t *p_data;
+    size_t len = 0u;
+
+    if (SESSION_LOG_SOURCE_CNT <= source)
+    {
+        return NULL;
+    }
+
+    // Channels past the source maximum would land in the next slot, refused
+    // before the producer writes them.
+    if (log_cfg[source].ch_max >= cnt)
+    {
+        circ_buff_reserve(&log_ring[source], &p_data, &len);
+    }
+
+    if (len < log_cfg[source].slot_size)
+    {
+        log_slot[source] = NULL;
+        log_stats.source[source].drops++;
+        return NULL;
+    }
+
+    p_slot = (session_log_slot_t *)p_data;
+    p_slot->rec.type = log_cfg[source].type;
+    p_slot->rec.cnt = cnt;
+    p_slot->cnt = cnt;
+    log_slot[source] = p_slot;
+
+    return &p_slot->rec;
+}
+
+bool session_log_commit(session_log_source_t source)
+{
+    session_log_source_stats_t *p_stats;
+    session_log_slot_t *p_slot;
+    uint32_t used;
+
+    if ((SESSION_LOG_SOURCE_CNT <= source) || (NULL == log_slot[source]))
+    {
+        return false;
+    }
+
+    p_stats = &log_stats.source[source];
+    p_slot = log_slot[source];
+    log_slot[source] = NULL;
+
+    if (p_slot->cnt < p_slot->rec.cnt)
+    {
+        p_stats->drops++;
+        return false;
+    }
+
+    p_slot->stamp_us = (uint32_t)session_log_now_us();
+    (void)circ_buff_commit(&log_ring[source], log_cfg[source].slot_size);
+
+    used = (uint32_t)(circ_buff_get_used_size(&log_ring[source]) /
+                      log_cfg[source].slot_size);
+    if (p_stats->used_max < used)
+    {
+        p_stats->used_max = used;
+    }
+
+    // Only on crossing, logger drains everything once awake.
+    if (log_cfg[source].watermark == used)
+    {
+        p_stats->wakes++;
+        session_log_notify();
+    }
+
+    return true;
+}
+
+bool session_log_put(session_log_source_t source, const session_record_t *p_rec)
+{
+    session_record_t *p_slot_rec;
+
+    p_slot_rec = session_log_reserve(source, p_rec->cnt);
+    if (NULL == p_slot_rec)
+    {
+        return false;
+    }
+
+    p_slot_rec->time_us = p_rec->time_us;
+    memcpy(p_slot_rec->ch, p_rec->ch, p_rec->cnt * sizeof(p_rec->ch[0]));
+
+    return session_log_commit(source);
+}
+
+void session_log_stats_get(session_log_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        session_log_critical_enter();
+        *p_stats = log_stats;
+        session_log_critical_exit();
+    }
+}
+
+#ifdef SESSION_LOG_HOST
+void session_log_flush(void)
+{
+    log_stats.passes++;
+    session_log_drain();
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void session_log_drain(void)
+{
+    session_log_slot_t *p_head[SESSION_LOG_SOURCE_CNT];
+    uint32_t left[SESSION_LOG_SOURCE_CNT];
+
+    // Records committed during the pass wait for the next one.
+    for (uint32_t source = 0u; source < SESSION_LOG_SOURCE_CNT; source++)
+    {
+        left[source] = (uint32_t)(circ_buff_get_used_size(&log_ring[source]) /
+                                  log_cfg[source].slot_size);
+        p_head[source] = (0u != left[source]) ?
+                         session_log_head((session_log_source_t)source) : NULL;
+    }
+
+    for (;;)
+    {
+        session_log_source_stats_t *p_stats;
+        uint32_t next = SESSION_LOG_SOURCE_CNT;
+        uint32_t latency;
+        bool is_ok;
+
+        for (uint32_t source = 0u; source < SESSION_LOG_SOURCE_CNT; source++)
+        {
+            if ((NULL != p_head[source]) &&
+                ((SESSION_LOG_SOURCE_CNT == next) ||
+                 (p_head[source]->rec.time_us < p_head[next]->rec.time_us)))
+            {
+                next = source;
+            }
+        }
+
+        if (SESSION_LOG_SOURCE_CNT == next)
+        {
+            break;
+        }
+
+        is_ok = session_writer_record_write(&p_head[next]->rec,
+                                            SESSION_LOG_WRITE_MS);
+        latency = (uint32_t)session_log_now_us() - p_head[next]->stamp_us;
+
+        p_stats = &log_stats.source[next];
+
+        session_log_critical_enter();
+        if (is_ok)
+        {
+            p_stats->records++;
+        }
+        else
+        {
+            p_stats->rejected++;
+        }
+        p_stats->latency_us_total += latency;
+        if (p_stats->latency_us_max < latency)
+        {
+            p_stats->latency_us_max = latency;
+        }
+        session_log_critical_exit();
+
+        (void)circ_buff_consume(&log_ring[next], log_cfg[next].slot_size);
+
+        left[next]--;
+        p_head[next] = (0u != left[next]) ?
+                       session_log_head((session_log_source_t)next) : NULL;
+    }
+}
+
+static session_log_slot_t *session_log_head(session_log_source_t source)
+{
+    uint8_t *p_data;
+    size_t len;
+
+    circ_buff_peek_contiguous(&log_ring[source], &p_data, &len);
+
+    return (session_log_slot_t *)p_data;
+}
+
+#ifndef SESSION_LOG_HOST
+
+static void session_log_task(void *p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        uint32_t notified = ulTaskNotifyTake(pdTRUE,
+                                             pdMS_TO_TICKS(SESSION_LOG_FLUSH_MS));
+
+        session_log_critical_enter();
+        log_stats.passes++;
+        if (0u == notified)
+        {
+            log_stats.timeouts++;
+        }
+        session_log_critical_exit();
+
+        session_log_drain();
+    }
+}
+
+static void session_log_notify(void)
+{
+    if (0u != __get_IPSR())
+    {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(log_task, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+    else
+    {
+        xTaskNotifyGive(log_task);
+    }
+}
+
+static void session_log_critical_enter(void)
+{
+    taskENTER_CRITICAL();
+}
+
+static void session_log_critical_exit(void)
+{
+    taskEXIT_CRITICAL();
+}
+
+static uint64_t session_log_now_us(void)
+{
+    return bsp_timestamp_now();
+}
+
+#else
+
+// Host drains at the watermark before returning to the producer.
+static void session_log_notify(void)
+{
+    session_log_flush();
+}
+
+static void session_log_critical_enter(void)
+{
+}
+
+static void session_log_critical_exit(void)
+{
+}
+
+static uint64_t session_log_now_us(void)
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000u) + ((uint64_t)now.tv_nsec / 1000u);
+}
+
+#endif
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
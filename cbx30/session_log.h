@@ -0,0 +1,123 @@
+/** @file session_log.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_SESSION_LOG_H
+#define CROSSBOX_SESSION_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <session_record.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Logger drains rings at least this often, sources below watermark included.
+#define SESSION_LOG_FLUSH_MS        (500u)
+/// Time logger waits for a free session writer buffer.
+#define SESSION_LOG_WRITE_MS        (50u)
+
+/// Channels stored per source, records with more are dropped.
+#define SESSION_LOG_HRM_CH          (11u)   // hr, up to 10 rr intervals
+#define SESSION_LOG_IMU_CH          (6u)
+#define SESSION_LOG_QUAT_CH         (4u)
+#define SESSION_LOG_GPS_CH          (7u)
+#define SESSION_LOG_BATTERY_CH      (2u)
+#define SESSION_LOG_EVENT_CH        (2u)
+#define SESSION_LOG_HRV_CH          (7u)    // see HRV_RECORD_CH
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// Record sources, each has its own ring and exactly one producer context.
+typedef enum {
+    SESSION_LOG_HRM = 0,
+    SESSION_LOG_IMU,
+    SESSION_LOG_QUAT,
+    SESSION_LOG_GPS,
+    SESSION_LOG_BATTERY,
+    SESSION_LOG_EVENT,
+    SESSION_LOG_HRV,
+    SESSION_LOG_SOURCE_CNT
+} session_log_source_t;
+
+typedef struct {
+    uint32_t records;               // handed to session writer
+    uint32_t drops;                 // ring full or too many channels
+    uint32_t rejected;              // refused by session writer
+    uint32_t wakes;                 // logger woken at watermark
+    uint32_t used_max;              // most records waiting in ring
+    uint32_t latency_us_max;        // commit to session writer
+    uint64_t latency_us_total;
+} session_log_source_stats_t;
+
+typedef struct {
+    session_log_source_stats_t source[SESSION_LOG_SOURCE_CNT];
+    uint32_t passes;                // logger drain passes
+    uint32_t timeouts;              // passes started by flush timeout
+} session_log_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Set up source rings and create logger task.
+ * @return true on success, false otherwise
+ */
+bool session_log_init(void);
+
+/**
+ * @brief Get next free record of a source to fill in place. Type and count
+ *      are set, producer fills time and cnt channels. Slot holds no more
+ *      than the source maximum, count may be lowered but not raised.
+ *      May be called from ISR, only from the one context producing the source.
+ * @param source record source
+ * @param cnt channels to be filled
+ * @return record, NULL if ring is full or cnt is above the source maximum,
+ *      counted as drop
+ */
+session_record_t *session_log_reserve(session_log_source_t source,
+                                      uint8_t cnt);
+
+/**
+ * @brief Publish reserved record to logger. Logger is woken when the ring
+ *      reaches its watermark, otherwise the record waits for the flush timeout.
+ * @param source record source
+ * @return false if nothing was reserved, or count was raised above the
+ *      reserved one and the record was dropped
+ */
+bool session_log_commit(session_log_source_t source);
+
+/**
+ * @brief Reserve, copy and commit, for producers that already hold a record.
+ * @param source record source
+ * @param p_rec record, type is taken from source
+ * @return false if record was dropped
+ */
+bool session_log_put(session_log_source_t source, const session_record_t *p_rec);
+
+/**
+ * @brief Get logger statistics.
+ * @param p_stats output
+ */
+void session_log_stats_get(session_log_stats_t *p_stats);
+
+#ifdef SESSION_LOG_HOST
+/**
+ * @brief Drain all rings, host has no logger task.
+ */
+void session_log_flush(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_SESSION_LOG_H
@@ -0,0 +1,336 @@
+/** @file session_log_host.c
+*
+* @brief Host test of the logger input rings. Session writer is replaced by a
+*        stub keeping every record handed to it, rings are drained at the
+*        watermark and on session_log_flush in the caller:
+*
+*        gcc -DSESSION_LOG_HOST -DSESSION_LOG_TEST -I. session_log.c \
+*            session_log_host.c circular_buffer.c -o session_log_test
+*        ./session_log_test
+*
+*        Sources are interleaved by time well past their ring depth, so every
+*        ring wraps many times, and each record is checked for loss, order and
+*        channels overwritten by a neighbouring slot.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_log.h>
+#include <session_writer.h>
+#include <stdio.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_RECORDS_MAX            (8192u)
+// Wrap run length, source periods are in host_source.
+#define HOST_WRAP_MS                (20000u)
+#define HOST_TIME_START_US          (1546300800000000ull)
+
+#define TEST_CHECK(cond)            do { if (!(cond)) { \
+                                        test_fail(__LINE__, #cond); \
+                                        return false; } } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    session_log_source_t source;
+    uint8_t type;
+    uint8_t ch_max;
+    uint32_t period_ms;
+} host_source_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+#ifdef SESSION_LOG_TEST
+static bool test_reserve(void);
+static bool test_flush(void);
+static bool test_wrap(void);
+static uint8_t host_cnt(const host_source_t *p_src, uint32_t seq);
+static int32_t host_value(const host_source_t *p_src, uint32_t seq,
+                          uint32_t ch);
+static void test_fail(int line, const char *p_cond);
+#endif
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+#ifdef SESSION_LOG_TEST
+static const host_source_t host_source[] = {
+    { SESSION_LOG_HRM, SESSION_RECORD_HRM, SESSION_LOG_HRM_CH, 1000u },
+    { SESSION_LOG_IMU, SESSION_RECORD_IMU, SESSION_LOG_IMU_CH, 10u },
+    { SESSION_LOG_QUAT, SESSION_RECORD_QUAT, SESSION_LOG_QUAT_CH, 20u },
+    { SESSION_LOG_GPS, SESSION_RECORD_GPS, SESSION_LOG_GPS_CH, 250u },
+    { SESSION_LOG_BATTERY, SESSION_RECORD_BATTERY, SESSION_LOG_BATTERY_CH,
+      5000u },
+    { SESSION_LOG_EVENT, SESSION_RECORD_EVENT, SESSION_LOG_EVENT_CH, 70u },
+    { SESSION_LOG_HRV, SESSION_RECORD_HRV, SESSION_LOG_HRV_CH, 3000u },
+};
+
+static session_record_t host_rec[HOST_RECORDS_MAX];
+static uint32_t host_rec_cnt;
+static bool host_reject;
+#endif
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef SESSION_LOG_TEST
+bool session_writer_record_write(const session_record_t *p_rec,
+                                 uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+
+    if (HOST_RECORDS_MAX > host_rec_cnt)
+    {
+        host_rec[host_rec_cnt] = *p_rec;
+    }
+    host_rec_cnt++;
+
+    return !host_reject;
+}
+
+int main(void)
+{
+    static bool (*const test[])(void) = {
+        test_reserve, test_flush, test_wrap
+    };
+    int failed = 0;
+
+    for (size_t index = 0u; index < (sizeof(test) / sizeof(test[0])); index++)
+    {
+        host_rec_cnt = 0u;
+        host_reject = false;
+
+        if ((!session_log_init()) || (!test[index]()))
+        {
+            fprintf(stderr, "  test %zu\n", index);
+            failed++;
+        }
+    }
+
+    printf("%s\n", (0 == failed) ? "ok" : "failed");
+
+    return (0 != failed);
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+#ifdef SESSION_LOG_TEST
+static bool test_reserve(void)
+{
+    session_log_stats_t stats;
+    session_record_t *p_rec;
+    session_record_t *p_next;
+    session_record_t rec;
+
+    // Count is bounded before anything is written.
+    TEST_CHECK(NULL == session_log_reserve(SESSION_LOG_IMU,
+                                           SESSION_LOG_IMU_CH + 1u));
+    TEST_CHECK(NULL == session_log_reserve(SESSION_LOG_SOURCE_CNT, 0u));
+    TEST_CHECK(!session_log_commit(SESSION_LOG_IMU));
+
+    memset(&rec, 0, sizeof(rec));
+    rec.cnt = SESSION_LOG_HRM_CH + 1u;
+    TEST_CHECK(!session_log_put(SESSION_LOG_HRM, &rec));
+
+    session_log_stats_get(&stats);
+    TEST_CHECK(1u == stats.source[SESSION_LOG_IMU].drops);
+    TEST_CHECK(1u == stats.source[SESSION_LOG_HRM].drops);
+
+    // Full slot, the next one starts past its last channel.
+    p_rec = session_log_reserve(SESSION_LOG_IMU, SESSION_LOG_IMU_CH);
+    TEST_CHECK(NULL != p_rec);
+    TEST_CHECK((SESSION_RECORD_IMU == p_rec->type) &&
+               (SESSION_LOG_IMU_CH == p_rec->cnt));
+    p_rec->time_us = 1u;
+    for (uint32_t ch = 0u; ch < SESSION_LOG_IMU_CH; ch++)
+    {
+        p_rec->ch[ch] = (int32_t)(0x100u + ch);
+    }
+    TEST_CHECK(session_log_commit(SESSION_LOG_IMU));
+
+    p_next = session_log_reserve(SESSION_LOG_IMU, SESSION_LOG_IMU_CH);
+    TEST_CHECK(NULL != p_next);
+    TEST_CHECK((uint8_t *)&p_next->ch[0] >=
+               (uint8_t *)&p_rec->ch[SESSION_LOG_IMU_CH]);
+    p_next->time_us = 2u;
+    for (uint32_t ch = 0u; ch < SESSION_LOG_IMU_CH; ch++)
+    {
+        p_next->ch[ch] = -1;
+    }
+
+    // Raised count would run into the next slot, record is dropped.
+    p_next->cnt = SESSION_LOG_IMU_CH + 1u;
+    TEST_CHECK(!session_log_commit(SESSION_LOG_IMU));
+
+    // Lowered count is kept.
+    p_next = session_log_reserve(SESSION_LOG_IMU, SESSION_LOG_IMU_CH);
+    TEST_CHECK(NULL != p_next);
+    p_next->time_us = 3u;
+    p_next->cnt = 2u;
+    p_next->ch[0] = 7;
+    p_next->ch[1] = 8;
+    TEST_CHECK(session_log_commit(SESSION_LOG_IMU));
+
+    session_log_flush();
+
+    TEST_CHECK(2u == host_rec_cnt);
+    TEST_CHECK((1u == host_rec[0].time_us) &&
+               (SESSION_LOG_IMU_CH == host_rec[0].cnt));
+    for (uint32_t ch = 0u; ch < SESSION_LOG_IMU_CH; ch++)
+    {
+        TEST_CHECK((int32_t)(0x100u + ch) == host_rec[0].ch[ch]);
+    }
+    TEST_CHECK((3u == host_rec[1].time_us) && (2u == host_rec[1].cnt) &&
+               (7 == host_rec[1].ch[0]) && (8 == host_rec[1].ch[1]));
+
+    session_log_stats_get(&stats);
+    TEST_CHECK(2u == stats.source[SESSION_LOG_IMU].drops);
+    TEST_CHECK(2u == stats.source[SESSION_LOG_IMU].records);
+
+    return true;
+}
+
+static bool test_flush(void)
+{
+    session_log_stats_t stats;
+    session_record_t rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.cnt = SESSION_LOG_BATTERY_CH;
+
+    // Below watermark records wait for the flush timeout.
+    rec.time_us = 10u;
+    TEST_CHECK(session_log_put(SESSION_LOG_BATTERY, &rec));
+    TEST_CHECK(0u == host_rec_cnt);
+
+    session_log_flush();
+    TEST_CHECK(1u == host_rec_cnt);
+
+    // Refused records still leave the ring.
+    host_reject = true;
+    rec.time_us = 20u;
+    TEST_CHECK(session_log_put(SESSION_LOG_BATTERY, &rec));
+    session_log_flush();
+    session_log_flush();
+    TEST_CHECK(2u == host_rec_cnt);
+
+    session_log_stats_get(&stats);
+    TEST_CHECK(1u == stats.source[SESSION_LOG_BATTERY].records);
+    TEST_CHECK(1u == stats.source[SESSION_LOG_BATTERY].rejected);
+    TEST_CHECK(0u == stats.source[SESSION_LOG_BATTERY].wakes);
+
+    return true;
+}
+
+static bool test_wrap(void)
+{
+    const size_t src_cnt = sizeof(host_source) / sizeof(host_source[0]);
+    uint32_t produced[sizeof(host_source) / sizeof(host_source[0])] = { 0u };
+    uint32_t seen[sizeof(host_source) / sizeof(host_source[0])] = { 0u };
+    session_log_stats_t stats;
+    uint64_t prev_us = 0u;
+    uint32_t total = 0u;
+
+    // Producers are interleaved by time, logger runs at watermarks only.
+    for (uint32_t ms = 0u; ms < HOST_WRAP_MS; ms++)
+    {
+        for (size_t index = 0u; index < src_cnt; index++)
+        {
+            const host_source_t *p_src = &host_source[index];
+            uint32_t seq = produced[index];
+            session_record_t *p_rec;
+
+            if (0u != (ms % p_src->period_ms))
+            {
+                continue;
+            }
+
+            p_rec = session_log_reserve(p_src->source, host_cnt(p_src, seq));
+            TEST_CHECK(NULL != p_rec);
+
+            p_rec->time_us = HOST_TIME_START_US + ((uint64_t)ms * 1000u);
+            for (uint32_t ch = 0u; ch < p_rec->cnt; ch++)
+            {
+                p_rec->ch[ch] = host_value(p_src, seq, ch);
+            }
+            TEST_CHECK(session_log_commit(p_src->source));
+
+            produced[index]++;
+            total++;
+        }
+    }
+
+    session_log_flush();
+
+    TEST_CHECK(total == host_rec_cnt);
+    TEST_CHECK(HOST_RECORDS_MAX >= host_rec_cnt);
+
+    // Every record once, in time order, channels as written.
+    for (uint32_t num = 0u; num < host_rec_cnt; num++)
+    {
+        const session_record_t *p_rec = &host_rec[num];
+        const host_source_t *p_src = NULL;
+        size_t index;
+
+        for (index = 0u; index < src_cnt; index++)
+        {
+            if (host_source[index].type == p_rec->type)
+            {
+                p_src = &host_source[index];
+                break;
+            }
+        }
+
+        TEST_CHECK(NULL != p_src);
+        TEST_CHECK(prev_us <= p_rec->time_us);
+        TEST_CHECK(host_cnt(p_src, seen[index]) == p_rec->cnt);
+        for (uint32_t ch = 0u; ch < p_rec->cnt; ch++)
+        {
+            TEST_CHECK(host_value(p_src, seen[index], ch) == p_rec->ch[ch]);
+        }
+
+        prev_us = p_rec->time_us;
+        seen[index]++;
+    }
+
+    session_log_stats_get(&stats);
+
+    for (size_t index = 0u; index < src_cnt; index++)
+    {
+        const session_log_source_stats_t *p_stats =
+            &stats.source[host_source[index].source];
+
+        TEST_CHECK(produced[index] == seen[index]);
+        TEST_CHECK(produced[index] == p_stats->records);
+        TEST_CHECK((0u == p_stats->drops) && (0u == p_stats->rejected));
+    }
+
+    // IMU and quaternion rings went round many times.
+    TEST_CHECK(produced[1] > (20u * stats.source[SESSION_LOG_IMU].used_max));
+    TEST_CHECK(0u < stats.source[SESSION_LOG_QUAT].wakes);
+
+    return true;
+}
+
+static uint8_t host_cnt(const host_source_t *p_src, uint32_t seq)
+{
+    // Heart rate carries a varying number of intervals, others are full.
+    return (SESSION_LOG_HRM == p_src->source) ?
+           (uint8_t)(1u + (seq % p_src->ch_max)) : p_src->ch_max;
+}
+
+static int32_t host_value(const host_source_t *p_src, uint32_t seq,
+                          uint32_t ch)
+{
+    return (int32_t)((p_src->type << 24) | (seq << 4) | ch);
+}
+
+static void test_fail(int line, const char *p_cond)
+{
+    fprintf(stderr, "line %d: %s\n", line, p_cond);
+}
+#endif
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
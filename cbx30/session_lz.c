@@ -0,0 +1,296 @@
+/** @file session_lz.c
+*
+* @brief Single pass LZ block compressor writing the LZ4 block format, so
+*        host tools may also use liblz4. Greedy matching through one hash
+*        table of 16 bit positions, no other memory. Compression gives up
+*        once its cycle budget is spent, caller then stores the block as is.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_lz.h>
+#include <cycles.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define LZ_MIN_MATCH                (4u)
+// Format limits: last 5 bytes are literals, last match starts 12 before end.
+#define LZ_LAST_LITERALS            (5u)
+#define LZ_MATCH_LIMIT              (12u)
+#define LZ_HASH_SIZE                (1u << SESSION_LZ_HASH_LOG)
+// Input bytes between budget checks.
+#define LZ_CHECK_STEP               (256u)
+// Literal runs skip ahead faster the longer nothing matches.
+#define LZ_SKIP_SHIFT               (5u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+static uint32_t lz_read32(const uint8_t *p_data);
+static uint32_t lz_hash(uint32_t seq);
+
+/**
+ * @brief Write length continuation bytes after a token nibble of 15.
+ * @return output position after them
+ */
+static uint32_t lz_len_put(uint8_t *p_out, uint32_t pos, uint32_t len);
+
+/**
+ * @brief Write literals and, if match_len is not 0, a match.
+ * @return output position, 0 if size would be exceeded
+ */
+static uint32_t lz_sequence_put(uint8_t *p_out, uint32_t pos, uint32_t size,
+                                const uint8_t *p_lit, uint32_t lit_len,
+                                uint32_t offset, uint32_t match_len);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static uint16_t lz_table[LZ_HASH_SIZE];
+static bool lz_cycles_started;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+uint32_t session_lz_compress(const uint8_t *p_in, uint32_t len, uint8_t *p_out,
+                             uint32_t size, uint32_t budget_cycles)
+{
+    uint32_t start;
+    uint32_t check;
+    uint32_t anchor = 0u;
+    uint32_t ip = 0u;
+    uint32_t op = 0u;
+
+    if (SESSION_LZ_BLOCK_MAX < len)
+    {
+        return 0u;
+    }
+
+    if (!lz_cycles_started)
+    {
+        CYCLES_INIT();
+        lz_cycles_started = true;
+    }
+
+    start = CYCLES();
+    check = LZ_CHECK_STEP;
+
+    memset(lz_table, 0, sizeof(lz_table));
+
+    if (LZ_MATCH_LIMIT < len)
+    {
+        uint32_t limit = len - LZ_MATCH_LIMIT;
+
+        while (ip < limit)
+        {
+            uint32_t seq = lz_read32(&p_in[ip]);
+            uint32_t hash = lz_hash(seq);
+            uint32_t ref = lz_table[hash];
+
+            lz_table[hash] = (uint16_t)ip;
+
+            if (ip >= check)
+            {
+                check = ip + LZ_CHECK_STEP;
+                if ((0u != budget_cycles) &&
+                    ((CYCLES() - start) > budget_cycles))
+                {
+                    return 0u;
+                }
+            }
+
+            if ((ref >= ip) || (seq != lz_read32(&p_in[ref])))
+            {
+                ip += 1u + ((ip - anchor) >> LZ_SKIP_SHIFT);
+                continue;
+            }
+
+            uint32_t match_len = LZ_MIN_MATCH;
+            uint32_t match_end = len - LZ_LAST_LITERALS;
+
+            while (((ip + match_len) < match_end) &&
+                   (p_in[ref + match_len] == p_in[ip + match_len]))
+            {
+                match_len++;
+            }
+
+            op = lz_sequence_put(p_out, op, size, &p_in[anchor], ip - anchor,
+                                 ip - ref, match_len);
+            if (0u == op)
+            {
+                return 0u;
+            }
+
+            ip += match_len;
+            anchor = ip;
+
+            // Position inside match keeps table fresh for repeating data.
+            if (ip < limit)
+            {
+                lz_table[lz_hash(lz_read32(&p_in[ip - 2u]))] =
+                    (uint16_t)(ip - 2u);
+            }
+        }
+    }
+
+    op = lz_sequence_put(p_out, op, size, &p_in[anchor], len - anchor, 0u, 0u);
+
+    return op;
+}
+
+int32_t session_lz_decompress(const uint8_t *p_in, uint32_t len,
+                              uint8_t *p_out, uint32_t size)
+{
+    uint32_t ip = 0u;
+    uint32_t op = 0u;
+
+    while (ip < len)
+    {
+        uint32_t token = p_in[ip++];
+        uint32_t lit_len = token >> 4;
+        uint32_t match_len = token & 0x0Fu;
+        uint32_t offset;
+        uint32_t byte;
+
+        if (15u == lit_len)
+        {
+            do
+            {
+                if (ip >= len)
+                {
+                    return -1;
+                }
+                byte = p_in[ip++];
+                lit_len += byte;
+            } while (255u == byte);
+        }
+
+        if (((len - ip) < lit_len) || ((size - op) < lit_len))
+        {
+            return -1;
+        }
+
+        memcpy(&p_out[op], &p_in[ip], lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // Last sequence has no match.
+        if (ip == len)
+        {
+            break;
+        }
+
+        if ((len - ip) < 2u)
+        {
+            return -1;
+        }
+
+        offset = p_in[ip] | ((uint32_t)p_in[ip + 1u] << 8);
+        ip += 2u;
+
+        if ((0u == offset) || (offset > op))
+        {
+            return -1;
+        }
+
+        if (15u == match_len)
+        {
+            do
+            {
+                if (ip >= len)
+                {
+                    return -1;
+                }
+                byte = p_in[ip++];
+                match_len += byte;
+            } while (255u == byte);
+        }
+        match_len += LZ_MIN_MATCH;
+
+        if ((size - op) < match_len)
+        {
+            return -1;
+        }
+
+        // Byte by byte, match may overlap its own output.
+        for (uint32_t index = 0u; index < match_len; index++)
+        {
+            p_out[op] = p_out[op - offset];
+            op++;
+        }
+    }
+
+    return (int32_t)op;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static uint32_t lz_read32(const uint8_t *p_data)
+{
+    uint32_t value;
+
+    memcpy(&value, p_data, sizeof(value));
+
+    return value;
+}
+
+static uint32_t lz_hash(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32u - SESSION_LZ_HASH_LOG);
+}
+
+static uint32_t lz_len_put(uint8_t *p_out, uint32_t pos, uint32_t len)
+{
+    while (255u <= len)
+    {
+        p_out[pos++] = 255u;
+        len -= 255u;
+    }
+    p_out[pos++] = (uint8_t)len;
+
+    return pos;
+}
+
+static uint32_t lz_sequence_put(uint8_t *p_out, uint32_t pos, uint32_t size,
+                                const uint8_t *p_lit, uint32_t lit_len,
+                                uint32_t offset, uint32_t match_len)
+{
+    uint32_t token = pos++;
+    uint32_t ml = (0u != match_len) ? (match_len - LZ_MIN_MATCH) : 0u;
+
+    // Token, literal lengths, literals, offset, match lengths.
+    if ((size < pos) ||
+        ((size - pos) < (lit_len + (lit_len / 255u) + 1u + 2u +
+                         (ml / 255u) + 1u)))
+    {
+        return 0u;
+    }
+
+    p_out[token] = (uint8_t)(((15u < lit_len) ? 15u : lit_len) << 4);
+    if (15u <= lit_len)
+    {
+        pos = lz_len_put(p_out, pos, lit_len - 15u);
+    }
+
+    memcpy(&p_out[pos], p_lit, lit_len);
+    pos += lit_len;
+
+    if (0u != match_len)
+    {
+        p_out[pos++] = (uint8_t)offset;
+        p_out[pos++] = (uint8_t)(offset >> 8);
+
+        p_out[token] |= (uint8_t)((15u < ml) ? 15u : ml);
+        if (15u <= ml)
+        {
+            pos = lz_len_put(p_out, pos, ml - 15u);
+        }
+    }
+
+    return pos;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
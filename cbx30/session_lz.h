@@ -0,0 +1,60 @@
+/** @file session_lz.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_SESSION_LZ_H
+#define CROSSBOX_SESSION_LZ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Match finder table, 2 bytes per entry.
+#define SESSION_LZ_HASH_LOG         (11u)
+/// Largest block, offsets are 16 bit.
+#define SESSION_LZ_BLOCK_MAX        (65535u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Compress block in LZ4 block format. Uses a static match table, one
+ *      caller at a time.
+ * @param p_in input block
+ * @param len input length, up to SESSION_LZ_BLOCK_MAX
+ * @param p_out output
+ * @param size output size, compression stops when it would be exceeded
+ * @param budget_cycles CPU cycles allowed, 0 for no limit
+ * @return compressed length, 0 if output is full or budget is exceeded
+ */
+uint32_t session_lz_compress(const uint8_t *p_in, uint32_t len, uint8_t *p_out,
+                             uint32_t size, uint32_t budget_cycles);
+
+/**
+ * @brief Decompress LZ4 block.
+ * @param p_in compressed block
+ * @param len compressed length
+ * @param p_out output
+ * @param size output size
+ * @return decompressed length, -1 if block is invalid or does not fit
+ */
+int32_t session_lz_decompress(const uint8_t *p_in, uint32_t len,
+                              uint8_t *p_out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_SESSION_LZ_H
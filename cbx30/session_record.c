@@ -0,0 +1,365 @@
+/** @file session_record.c
+*
+* @brief Session record codec, shared by firmware and host tools.
+*
+*        Record:   type, zigzag varint time delta in us, channel count,
+*                  zigzag varint per channel, delta to same type and channel
+*                  in the previous record.
+*        Keyframe: 0xA5 0x5A, version, varint unix time in us, crc16 of
+*                  version and time. Resets time and channel references, so
+*                  decoding can start at any keyframe.
+*
+*        Keyframes are emitted at least every SESSION_RECORD_KEY_US and
+*        SESSION_RECORD_KEY_BYTES, and whenever a time delta does not fit.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_record.h>
+#include <helpers.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define RECORD_SYNC_0               (0xA5u)
+#define RECORD_SYNC_1               (0x5Au)
+// Record without channels: type, time delta, count.
+#define RECORD_HEAD_SIZE_MAX        (7u)
+#define RECORD_VARINT32_MAX         (5u)
+#define RECORD_VARINT64_MAX         (10u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Write unsigned LEB128.
+ * @return bytes written
+ */
+static uint32_t record_varint_put(uint8_t *p_out, uint64_t value);
+
+/**
+ * @brief Read unsigned LEB128.
+ * @return bytes read, 0 if incomplete, -1 if longer than max bytes
+ */
+static int32_t record_varint_get(const uint8_t *p_in, uint32_t len,
+                                 uint32_t max, uint64_t *p_value);
+
+static uint32_t record_zigzag(int32_t value);
+static int32_t record_unzigzag(uint32_t value);
+
+/**
+ * @brief Write keyframe and reset references.
+ * @return bytes written
+ */
+static uint32_t record_key_put(session_record_ctx_t *p_ctx, uint8_t *p_out,
+                               uint64_t time_us);
+
+/**
+ * @brief Read keyframe and reset references.
+ * @return bytes read, 0 if incomplete, -1 if invalid
+ */
+static int32_t record_key_get(session_record_ctx_t *p_ctx, const uint8_t *p_in,
+                              uint32_t len, uint64_t *p_time_us);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void session_record_init(session_record_ctx_t *p_ctx)
+{
+    memset(p_ctx, 0, sizeof(*p_ctx));
+    p_ctx->key_due = true;
+}
+
+void session_record_key_force(session_record_ctx_t *p_ctx)
+{
+    p_ctx->key_due = true;
+}
+
+uint16_t session_record_encode(session_record_ctx_t *p_ctx,
+                               const session_record_t *p_rec,
+                               uint8_t *p_out, uint16_t size)
+{
+    int32_t *p_prev;
+    int64_t dt = (int64_t)(p_rec->time_us - p_ctx->time_us);
+    int64_t since_key = (int64_t)(p_rec->time_us - p_ctx->key_time_us);
+    bool key = p_ctx->key_due;
+    uint32_t pos = 0u;
+
+    if ((SESSION_RECORD_KEY == p_rec->type) ||
+        (SESSION_RECORD_TYPE_CNT <= p_rec->type) ||
+        (SESSION_RECORD_CH_MAX < p_rec->cnt))
+    {
+        return 0u;
+    }
+
+    if ((0 > since_key) || (SESSION_RECORD_KEY_US <= since_key) ||
+        (SESSION_RECORD_KEY_BYTES <= p_ctx->key_bytes) ||
+        (INT32_MAX < dt) || (INT32_MIN > dt))
+    {
+        key = true;
+    }
+
+    // Worst case checked up front, state is left alone on failure.
+    if (size < ((key ? SESSION_RECORD_KEY_SIZE_MAX : 0u) + RECORD_HEAD_SIZE_MAX +
+                (RECORD_VARINT32_MAX * p_rec->cnt)))
+    {
+        return 0u;
+    }
+
+    if (key)
+    {
+        pos = record_key_put(p_ctx, p_out, p_rec->time_us);
+        dt = 0;
+    }
+
+    p_out[pos++] = p_rec->type;
+    pos += record_varint_put(&p_out[pos], record_zigzag((int32_t)dt));
+    p_out[pos++] = p_rec->cnt;
+
+    p_prev = p_ctx->prev[p_rec->type];
+    for (uint32_t index = 0u; index < p_rec->cnt; index++)
+    {
+        // Wraps, decoder wraps back.
+        int32_t delta = (int32_t)((uint32_t)p_rec->ch[index] -
+                                  (uint32_t)p_prev[index]);
+
+        pos += record_varint_put(&p_out[pos], record_zigzag(delta));
+        p_prev[index] = p_rec->ch[index];
+    }
+
+    p_ctx->time_us = p_rec->time_us;
+    p_ctx->key_bytes += pos;
+
+    return (uint16_t)pos;
+}
+
+int32_t session_record_decode(session_record_ctx_t *p_ctx, const uint8_t *p_in,
+                              uint32_t len, session_record_t *p_rec)
+{
+    uint64_t value;
+    int32_t *p_prev;
+    int32_t used;
+    uint32_t pos;
+
+    if (0u == len)
+    {
+        return 0;
+    }
+
+    if (RECORD_SYNC_0 == p_in[0])
+    {
+        used = record_key_get(p_ctx, p_in, len, &p_rec->time_us);
+        if (0 < used)
+        {
+            p_rec->type = SESSION_RECORD_KEY;
+            p_rec->cnt = 0u;
+        }
+        return used;
+    }
+
+    if (p_ctx->key_due || (SESSION_RECORD_KEY == p_in[0]) ||
+        (SESSION_RECORD_TYPE_CNT <= p_in[0]))
+    {
+        return -1;
+    }
+
+    pos = 1u;
+    used = record_varint_get(&p_in[pos], len - pos, RECORD_VARINT32_MAX, &value);
+    if (0 >= used)
+    {
+        return used;
+    }
+    pos += (uint32_t)used;
+
+    if (pos >= len)
+    {
+        return 0;
+    }
+    if (SESSION_RECORD_CH_MAX < p_in[pos])
+    {
+        return -1;
+    }
+
+    p_rec->type = p_in[0];
+    p_rec->cnt = p_in[pos++];
+    p_rec->time_us = p_ctx->time_us +
+                     (uint64_t)(int64_t)record_unzigzag((uint32_t)value);
+
+    // References are updated only once the whole record is there.
+    p_prev = p_ctx->prev[p_rec->type];
+    for (uint32_t index = 0u; index < p_rec->cnt; index++)
+    {
+        used = record_varint_get(&p_in[pos], len - pos, RECORD_VARINT32_MAX,
+                                 &value);
+        if (0 >= used)
+        {
+            return used;
+        }
+        pos += (uint32_t)used;
+
+        p_rec->ch[index] = (int32_t)((uint32_t)p_prev[index] +
+                                     (uint32_t)record_unzigzag((uint32_t)value));
+    }
+
+    memcpy(p_prev, p_rec->ch, p_rec->cnt * sizeof(p_rec->ch[0]));
+    p_ctx->time_us = p_rec->time_us;
+
+    return (int32_t)pos;
+}
+
+int32_t session_record_sync(const uint8_t *p_in, uint32_t len)
+{
+    session_record_ctx_t ctx;
+    uint64_t time_us;
+
+    for (uint32_t pos = 0u; (pos + 1u) < len; pos++)
+    {
+        if ((RECORD_SYNC_0 != p_in[pos]) || (RECORD_SYNC_1 != p_in[pos + 1u]))
+        {
+            continue;
+        }
+
+        int32_t used = record_key_get(&ctx, &p_in[pos], len - pos, &time_us);
+
+        if (0 < used)
+        {
+            return (int32_t)pos;
+        }
+        if (0 == used)
+        {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static uint32_t record_varint_put(uint8_t *p_out, uint64_t value)
+{
+    uint32_t pos = 0u;
+
+    while (0x80u <= value)
+    {
+        p_out[pos++] = (uint8_t)(value | 0x80u);
+        value >>= 7;
+    }
+    p_out[pos++] = (uint8_t)value;
+
+    return pos;
+}
+
+static int32_t record_varint_get(const uint8_t *p_in, uint32_t len,
+                                 uint32_t max, uint64_t *p_value)
+{
+    uint64_t value = 0u;
+
+    for (uint32_t pos = 0u; pos < max; pos++)
+    {
+        if (pos >= len)
+        {
+            return 0;
+        }
+
+        value |= (uint64_t)(p_in[pos] & 0x7Fu) << (7u * pos);
+
+        if (0u == (p_in[pos] & 0x80u))
+        {
+            *p_value = value;
+            return (int32_t)(pos + 1u);
+        }
+    }
+
+    return -1;
+}
+
+static uint32_t record_zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t record_unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1u);
+}
+
+static uint32_t record_key_put(session_record_ctx_t *p_ctx, uint8_t *p_out,
+                               uint64_t time_us)
+{
+    uint32_t pos = 2u;
+    uint16_t crc;
+
+    p_out[0] = RECORD_SYNC_0;
+    p_out[1] = RECORD_SYNC_1;
+    p_out[pos++] = SESSION_RECORD_VERSION;
+    pos += record_varint_put(&p_out[pos], time_us);
+
+    crc = crc16(&p_out[2], (uint16_t)(pos - 2u));
+    p_out[pos++] = (uint8_t)crc;
+    p_out[pos++] = (uint8_t)(crc >> 8);
+
+    memset(p_ctx->prev, 0, sizeof(p_ctx->prev));
+    p_ctx->time_us = time_us;
+    p_ctx->key_time_us = time_us;
+    p_ctx->key_bytes = 0u;
+    p_ctx->key_due = false;
+
+    return pos;
+}
+
+static int32_t record_key_get(session_record_ctx_t *p_ctx, const uint8_t *p_in,
+                              uint32_t len, uint64_t *p_time_us)
+{
+    uint64_t time_us;
+    int32_t used;
+    uint32_t pos = 3u;
+
+    if (len < pos)
+    {
+        return 0;
+    }
+
+    if ((RECORD_SYNC_0 != p_in[0]) || (RECORD_SYNC_1 != p_in[1]) ||
+        (SESSION_RECORD_VERSION != p_in[2]))
+    {
+        return -1;
+    }
+
+    used = record_varint_get(&p_in[pos], len - pos, RECORD_VARINT64_MAX,
+                             &time_us);
+    if (0 >= used)
+    {
+        return used;
+    }
+    pos += (uint32_t)used;
+
+    if (len < (pos + 2u))
+    {
+        return 0;
+    }
+
+    if (crc16(&p_in[2], (uint16_t)(pos - 2u)) !=
+        (uint16_t)(p_in[pos] | ((uint16_t)p_in[pos + 1u] << 8)))
+    {
+        return -1;
+    }
+    pos += 2u;
+
+    memset(p_ctx->prev, 0, sizeof(p_ctx->prev));
+    p_ctx->time_us = time_us;
+    p_ctx->key_time_us = time_us;
+    p_ctx->key_bytes = 0u;
+    p_ctx->key_due = false;
+    *p_time_us = time_us;
+
+    return (int32_t)pos;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
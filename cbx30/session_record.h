@@ -0,0 +1,123 @@
+/** @file session_record.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_SESSION_RECORD_H
+#define CROSSBOX_SESSION_RECORD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Format version, carried by every keyframe.
+#define SESSION_RECORD_VERSION      (1u)
+/// Channels per record.
+#define SESSION_RECORD_CH_MAX       (16u)
+/// Longest encoded record, keyframe in front included.
+#define SESSION_RECORD_SIZE_MAX     (SESSION_RECORD_KEY_SIZE_MAX + 7u + \
+                                     (5u * SESSION_RECORD_CH_MAX))
+#define SESSION_RECORD_KEY_SIZE_MAX (15u)
+
+/// Keyframe is emitted when either is exceeded since the last one.
+#define SESSION_RECORD_KEY_US       (1000000u)
+#define SESSION_RECORD_KEY_BYTES    (4096u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// Record types, channel layout in comments. Values are delta coded against
+/// the previous record of the same type.
+typedef enum {
+    SESSION_RECORD_KEY = 0,         // keyframe, no channels
+    SESSION_RECORD_HRM,             // hr, rr intervals in 1/1024 s
+    SESSION_RECORD_IMU,             // ax, ay, az, gx, gy, gz raw
+    SESSION_RECORD_QUAT,            // w, x, y, z, 1.0 is 1 << 14
+    SESSION_RECORD_GPS,             // lat, lon 1e-7 deg, alt mm, speed mm/s,
+                                    // heading 1e-5 deg, fix, satellites
+    SESSION_RECORD_BATTERY,         // mV, percent
+    SESSION_RECORD_EVENT,           // event id, argument
+    SESSION_RECORD_HRV,             // rmssd, sdnn 0.01 ms, pnn50 0.01 %,
+                                    // mean rr ms, intervals, differences,
+                                    // artifacts
+    SESSION_RECORD_TYPE_CNT = 16
+} session_record_type_t;
+
+typedef struct {
+    uint8_t type;                   // session_record_type_t
+    uint8_t cnt;                    // channels used
+    uint64_t time_us;               // unix time in microseconds
+    int32_t ch[SESSION_RECORD_CH_MAX];
+} session_record_t;
+
+/// Encoder or decoder state of one stream.
+typedef struct {
+    uint64_t time_us;               // time of previous record
+    uint64_t key_time_us;           // time of last keyframe
+    uint32_t key_bytes;             // bytes since last keyframe
+    bool key_due;                   // next record starts with a keyframe
+    int32_t prev[SESSION_RECORD_TYPE_CNT][SESSION_RECORD_CH_MAX];
+} session_record_ctx_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Reset stream state, next encoded record starts with a keyframe and
+ *      decoding waits for one.
+ * @param p_ctx stream state
+ */
+void session_record_init(session_record_ctx_t *p_ctx);
+
+/**
+ * @brief Start next record with a keyframe, e.g. after encoded bytes were
+ *      lost.
+ * @param p_ctx stream state
+ */
+void session_record_key_force(session_record_ctx_t *p_ctx);
+
+/**
+ * @brief Encode record, preceded by a keyframe when one is due.
+ * @param p_ctx stream state
+ * @param p_rec record, type above SESSION_RECORD_KEY
+ * @param p_out output
+ * @param size output size, SESSION_RECORD_SIZE_MAX always fits
+ * @return bytes written, 0 if record is invalid or does not fit
+ */
+uint16_t session_record_encode(session_record_ctx_t *p_ctx,
+                               const session_record_t *p_rec,
+                               uint8_t *p_out, uint16_t size);
+
+/**
+ * @brief Decode one record or keyframe. Records before the first keyframe
+ *      can not be decoded, use session_record_sync to find it.
+ * @param p_ctx stream state
+ * @param p_in encoded data
+ * @param len bytes available
+ * @param p_rec output
+ * @return bytes consumed, 0 if more data is needed, -1 if data is invalid
+ */
+int32_t session_record_decode(session_record_ctx_t *p_ctx, const uint8_t *p_in,
+                              uint32_t len, session_record_t *p_rec);
+
+/**
+ * @brief Find next keyframe, for decoding from an arbitrary offset.
+ * @param p_in encoded data
+ * @param len bytes available
+ * @return offset of keyframe, -1 if none is complete within len
+ */
+int32_t session_record_sync(const uint8_t *p_in, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_SESSION_RECORD_H
@@ -0,0 +1,219 @@
+/** @file session_record_host.c
+*
+* @brief Host decoder of session data files, prints records as CSV:
+*        time in us, type, channels. Data that does not decode is skipped up
+*        to the next keyframe. Compressed sessions are read block by block
+*        through their index file.
+*
+*        gcc -DSESSION_RECORD_DECODE -D'CYCLES()=0u' -I. \
+*            session_record.c session_record_host.c session_lz.c \
+*            host/helpers_host.c -o session_decode
+*        ./session_decode session.dat [session.idx] > session.csv
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_record.h>
+#include <session_writer.h>
+#include <session_lz.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define DECODE_CHUNK                (64u * 1024u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Read uncompressed session stream.
+ * @return bytes read, 0 at end or on a damaged block
+ */
+static uint32_t decode_read(uint8_t *p_out, uint32_t size);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static const char * const decode_type_name[SESSION_RECORD_TYPE_CNT] = {
+    [SESSION_RECORD_KEY] = "key",
+    [SESSION_RECORD_HRM] = "hrm",
+    [SESSION_RECORD_IMU] = "imu",
+    [SESSION_RECORD_QUAT] = "quat",
+    [SESSION_RECORD_GPS] = "gps",
+    [SESSION_RECORD_BATTERY] = "battery",
+    [SESSION_RECORD_EVENT] = "event",
+    [SESSION_RECORD_HRV] = "hrv",
+};
+
+static FILE *decode_data;
+static FILE *decode_index;                          // NULL reads data as is.
+static uint8_t decode_block[SESSION_WRITER_BUF_SIZE];
+static uint32_t decode_block_len;
+static uint32_t decode_block_pos;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef SESSION_RECORD_DECODE
+int main(int argc, char **argv)
+{
+    static uint8_t buf[DECODE_CHUNK];
+    session_record_ctx_t ctx;
+    session_record_t rec;
+    uint32_t records = 0u;
+    uint32_t keys = 0u;
+    uint64_t skipped = 0u;
+    uint32_t len = 0u;
+    uint32_t pos = 0u;
+    bool eof = false;
+
+    if ((2 > argc) || (NULL == (decode_data = fopen(argv[1], "rb"))) ||
+        ((2 < argc) && (NULL == (decode_index = fopen(argv[2], "rb")))))
+    {
+        fprintf(stderr, "usage: %s <session data file> [index file]\n",
+                argv[0]);
+        return 1;
+    }
+
+    session_record_init(&ctx);
+
+    while ((!eof) || (pos < len))
+    {
+        int32_t used;
+
+        // Keep unused tail, a record may continue in the next chunk.
+        if ((!eof) && ((len - pos) < SESSION_RECORD_SIZE_MAX))
+        {
+            memmove(buf, &buf[pos], len - pos);
+            len -= pos;
+            pos = 0u;
+            uint32_t got = decode_read(&buf[len], sizeof(buf) - len);
+
+            len += got;
+            eof = (0u == got);
+        }
+
+        used = session_record_decode(&ctx, &buf[pos], len - pos, &rec);
+
+        if (0 < used)
+        {
+            pos += (uint32_t)used;
+
+            if (SESSION_RECORD_KEY == rec.type)
+            {
+                keys++;
+                continue;
+            }
+
+            records++;
+            printf("%llu,%s", (unsigned long long)rec.time_us,
+                   (NULL != decode_type_name[rec.type]) ?
+                   decode_type_name[rec.type] : "unknown");
+            for (uint32_t index = 0u; index < rec.cnt; index++)
+            {
+                printf(",%ld", (long)rec.ch[index]);
+            }
+            printf("\n");
+        }
+        else if ((0 == used) && eof)
+        {
+            // Record cut at file end.
+            skipped += len - pos;
+            pos = len;
+        }
+        else if (0 > used)
+        {
+            int32_t next = session_record_sync(&buf[pos + 1u], len - pos - 1u);
+            uint32_t skip = (0 > next) ? (len - pos) : ((uint32_t)next + 1u);
+
+            // Keyframe may start in the tail, keep it for the next chunk.
+            if ((0 > next) && (!eof))
+            {
+                skip = len - pos - (SESSION_RECORD_KEY_SIZE_MAX - 1u);
+            }
+
+            skipped += skip;
+            pos += skip;
+            session_record_init(&ctx);
+        }
+    }
+
+    fclose(decode_data);
+    if (NULL != decode_index)
+    {
+        fclose(decode_index);
+    }
+
+    fprintf(stderr, "%u records, %u keyframes, %llu bytes skipped\n",
+            records, keys, (unsigned long long)skipped);
+
+    return 0;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static uint32_t decode_read(uint8_t *p_out, uint32_t size)
+{
+    static uint8_t stored[SESSION_WRITER_BUF_SIZE];
+    session_index_entry_t entry;
+    uint32_t done = 0u;
+
+    if (NULL == decode_index)
+    {
+        return (uint32_t)fread(p_out, 1u, size, decode_data);
+    }
+
+    while (done < size)
+    {
+        uint32_t chunk;
+
+        if (decode_block_pos == decode_block_len)
+        {
+            if ((1u != fread(&entry, sizeof(entry), 1u, decode_index)) ||
+                (sizeof(stored) < entry.raw_len) ||
+                (entry.raw_len < entry.len) ||
+                (0 != fseek(decode_data, (long)entry.offset, SEEK_SET)) ||
+                (entry.len != fread(stored, 1u, entry.len, decode_data)))
+            {
+                break;
+            }
+
+            if (entry.len < entry.raw_len)
+            {
+                if (entry.raw_len != (uint32_t)session_lz_decompress(
+                        stored, entry.len, decode_block, sizeof(decode_block)))
+                {
+                    fprintf(stderr, "block %u does not decompress\n",
+                            entry.seq);
+                    break;
+                }
+            }
+            else
+            {
+                memcpy(decode_block, stored, entry.len);
+            }
+
+            decode_block_len = entry.raw_len;
+            decode_block_pos = 0u;
+        }
+
+        chunk = decode_block_len - decode_block_pos;
+        if (chunk > (size - done))
+        {
+            chunk = size - done;
+        }
+
+        memcpy(&p_out[done], &decode_block[decode_block_pos], chunk);
+        decode_block_pos += chunk;
+        done += chunk;
+    }
+
+    return done;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,1346 @@
+/** @file session_writer.c
+*
+* @brief Log structured session writer. Producers copy records into one of
+*        two buffers while the writer task writes the other one to eMMC in
+*        whole blocks. Each data write is synced and then described by an
+*        index entry, so after power loss the index gives the last data that
+*        is known to be on the card. Files are allocated contiguously at
+*        start and written in whole blocks, index entries through a copy of
+*        the blocks holding them. Data writes then touch neither FAT nor
+*        directory clusters, the FatFs backend syncs them with a device
+*        flush instead of f_sync. Size and time of the directory entry are
+*        updated once, when the session stops.
+*        Optionally each write is LZ4 compressed, the index then maps
+*        uncompressed offsets to blocks in the data file.
+*
+*        Time is indexed in two levels. Keyframe times and their uncompressed
+*        offsets are kept in RAM, every keyframe at first, every second one
+*        once the table is full and so on, and saved when the session stops.
+*        Index entries then give the writes holding an offset, so a time
+*        window is found with two binary searches.
+*
+*        Built with SESSION_WRITER_HOST the writer runs in the caller instead
+*        of a task and files are accessed through the host backend.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_writer.h>
+#include <session_lz.h>
+#include <helpers.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef SESSION_WRITER_HOST
+#include <time.h>
+#else
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <ff.h>
+#include <diskio.h>
+#include <inc/bsp/clock.h>
+#include <inc/bsp/timestamp.h>
+#endif
+
+//-------------------------------- MACROS -------------------------------------
+#define SESSION_WRITER_STACK        (512u)
+#define SESSION_WRITER_PRIORITY     (2u)
+
+// No buffer handed over to the writer.
+#define SESSION_WRITER_NONE         (0xFFFFFFFFu)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint8_t data[SESSION_WRITER_BUF_SIZE];
+    volatile uint32_t len;                          // Filled, producers only.
+    uint32_t written;                               // Written, writer only.
+} session_buf_t;
+
+// Time index file contents, crc follows the points.
+typedef struct {
+    session_time_header_t header;
+    session_time_point_t points[SESSION_WRITER_TIME_POINTS];
+} session_time_index_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Copy into buffer being filled, hand it over when full. Producer
+ *      lock held.
+ * @return false if record was dropped
+ */
+static bool session_writer_append(const uint8_t *p_data, uint16_t len,
+                                  uint32_t timeout_ms);
+
+/**
+ * @brief Write what producers handed over, then whole blocks of the buffer
+ *      being filled. On final also the incomplete last block.
+ */
+static void session_writer_service(bool final);
+
+/**
+ * @brief Write buffer up to end, sync and append index entry.
+ */
+static void session_writer_flush(session_buf_t *p_buf, uint32_t end);
+
+/**
+ * @brief Allocate session files for expected size, limited by free space.
+ * @return data file size allocated, 0 if none
+ */
+static uint32_t session_writer_prealloc(uint32_t duration_s, uint32_t rate_bps);
+
+/**
+ * @brief Add time index point if keyframe falls on the point spacing.
+ *      Producer lock held.
+ * @param time_us keyframe time
+ * @param raw_offset keyframe offset in uncompressed stream
+ */
+static void session_writer_time_add(uint64_t time_us, uint32_t raw_offset);
+
+/**
+ * @brief Write index entry as the whole blocks holding it.
+ * @param p_entry entry, written at its sequence number
+ */
+static bool session_writer_index_write(const session_index_entry_t *p_entry);
+
+/**
+ * @brief Write time index file.
+ */
+static bool session_writer_time_save(void);
+
+/**
+ * @brief Read and check time index file of a stopped session.
+ */
+static bool session_writer_time_load(void);
+
+/**
+ * @brief First time index point after time.
+ * @return point number, point count if none
+ */
+static uint32_t session_writer_time_find(uint32_t time_ms);
+
+/**
+ * @brief Find last write starting at or before an uncompressed offset.
+ * @param entries index entries in file
+ * @param raw_offset uncompressed offset
+ * @param p_entry output
+ * @return false if entry can not be read or is damaged
+ */
+static bool session_writer_entry_find(uint32_t entries, uint32_t raw_offset,
+                                      session_index_entry_t *p_entry);
+
+/**
+ * @brief Check index entry against data file.
+ * @param p_entry entry read from index file
+ * @param seq expected write number
+ * @param offset expected data offset
+ * @param raw_offset expected uncompressed offset
+ * @param data_size data file size
+ */
+static bool session_writer_entry_check(const session_index_entry_t *p_entry,
+                                       uint32_t seq, uint32_t offset,
+                                       uint32_t raw_offset, uint32_t data_size);
+
+/**
+ * @brief Data file bytes taken by a write, padding of compressed ones
+ *      included.
+ */
+static uint32_t session_writer_stride(const session_index_entry_t *p_entry);
+
+/**
+ * @brief One writer iteration, on notification or sync timeout.
+ */
+static void session_writer_run(void);
+
+/**
+ * @brief Wake writer.
+ */
+static void session_writer_notify(void);
+
+static void session_writer_lock(void);
+static void session_writer_unlock(void);
+static void session_writer_critical_enter(void);
+static void session_writer_critical_exit(void);
+
+/**
+ * @brief Vote system clock for a flush, released when it is done.
+ */
+static void session_writer_clock_vote(bool flushing);
+
+/**
+ * @brief Take the buffer the writer is done with.
+ */
+static bool session_writer_buf_take(uint32_t timeout_ms);
+
+/**
+ * @brief Return written buffer to producers.
+ */
+static void session_writer_buf_give(void);
+
+static uint64_t session_writer_now_us(void);
+
+/**
+ * @brief Session tag, differs between sessions on the same card.
+ */
+static uint32_t session_writer_id(void);
+
+#ifndef SESSION_WRITER_HOST
+static void session_writer_task(void *p_arg);
+
+static bool session_fatfs_open(session_file_t file, const char *p_name,
+                               bool create);
+static bool session_fatfs_expand(session_file_t file, uint32_t size);
+static bool session_fatfs_write(session_file_t file, uint32_t offset,
+                                const void *p_data, uint32_t len);
+static bool session_fatfs_sync(session_file_t file);
+static bool session_fatfs_read(session_file_t file, uint32_t offset,
+                               void *p_data, uint32_t len);
+static uint32_t session_fatfs_size(session_file_t file);
+static bool session_fatfs_truncate(session_file_t file, uint32_t size);
+static void session_fatfs_close(session_file_t file);
+static uint64_t session_fatfs_free_space(void);
+#endif
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+#ifndef SESSION_WRITER_HOST
+static const session_backend_t session_fatfs_backend = {
+    .open = session_fatfs_open,
+    .expand = session_fatfs_expand,
+    .write = session_fatfs_write,
+    .sync = session_fatfs_sync,
+    .read = session_fatfs_read,
+    .size = session_fatfs_size,
+    .truncate = session_fatfs_truncate,
+    .close = session_fatfs_close,
+    .free_space = session_fatfs_free_space,
+};
+
+static FIL session_fatfs_fil[SESSION_FILE_CNT];
+// Preallocated file, and whether a write since last sync needs its directory
+// entry or sector buffer written by f_sync.
+static bool session_fatfs_expanded[SESSION_FILE_CNT];
+static bool session_fatfs_dirty[SESSION_FILE_CNT];
+
+static TaskHandle_t sw_task;
+static SemaphoreHandle_t sw_mutex;                  // Between producers.
+static SemaphoreHandle_t sw_free_sem;               // Other buffer written.
+static SemaphoreHandle_t sw_done_sem;               // Stop handled.
+#endif
+
+static const session_backend_t *sw_backend;
+
+static session_buf_t sw_buf[2];
+static volatile uint32_t sw_fill;                   // Buffer being filled.
+static volatile uint32_t sw_pending;                // Buffer to be written.
+
+static volatile bool sw_active;
+static volatile bool sw_stop;
+static volatile bool sw_failed;
+
+// Writer only.
+static uint32_t sw_id;
+static uint32_t sw_offset;                          // Data file size.
+static uint32_t sw_raw_offset;                      // Before compression.
+static uint32_t sw_seq;
+// Index file blocks around the last entry, entries may straddle two.
+static uint8_t sw_index_blk[2u * SESSION_WRITER_BLOCK];
+static uint32_t sw_index_base;
+
+static session_writer_stats_t sw_stats;
+
+// Set before session start, output used by writer only.
+static bool sw_lz;
+static uint32_t sw_lz_budget;
+static uint8_t sw_lz_buf[SESSION_WRITER_BUF_SIZE];
+
+// Producer lock held.
+static session_record_ctx_t sw_record_ctx;
+static uint8_t sw_record_buf[SESSION_RECORD_SIZE_MAX];
+static uint32_t sw_time_keys;                       // Keyframes in session.
+
+// Filled under producer lock, saved by writer once session stops. Range
+// queries use it between sessions.
+static session_time_index_t sw_time;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+bool session_writer_init(const session_backend_t *p_backend)
+{
+    sw_backend = p_backend;
+    sw_active = false;
+
+#ifndef SESSION_WRITER_HOST
+    if (NULL == sw_backend)
+    {
+        sw_backend = &session_fatfs_backend;
+    }
+
+    sw_mutex = xSemaphoreCreateMutex();
+    sw_free_sem = xSemaphoreCreateBinary();
+    sw_done_sem = xSemaphoreCreateBinary();
+
+    if ((NULL == sw_mutex) || (NULL == sw_free_sem) || (NULL == sw_done_sem))
+    {
+        return false;
+    }
+
+    return (pdPASS == xTaskCreate(session_writer_task, "session",
+                                  SESSION_WRITER_STACK, NULL,
+                                  SESSION_WRITER_PRIORITY, &sw_task));
+#else
+    return (NULL != sw_backend);
+#endif
+}
+
+void session_writer_compress_set(bool enable, uint32_t budget_cycles)
+{
+    if (!sw_active)
+    {
+        sw_lz = enable;
+        sw_lz_budget = budget_cycles;
+    }
+}
+
+bool session_writer_start(const char *p_data_name, const char *p_index_name,
+                          const char *p_time_name, uint32_t duration_s,
+                          uint32_t rate_bps)
+{
+    if (sw_active || (NULL == sw_backend))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_DATA, p_data_name, true))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_INDEX, p_index_name, true))
+    {
+        sw_backend->close(SESSION_FILE_DATA);
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_TIME, p_time_name, true))
+    {
+        sw_backend->close(SESSION_FILE_INDEX);
+        sw_backend->close(SESSION_FILE_DATA);
+        return false;
+    }
+
+    memset(&sw_stats, 0, sizeof(sw_stats));
+    sw_buf[0].len = 0u;
+    sw_buf[0].written = 0u;
+    sw_buf[1].len = 0u;
+    sw_buf[1].written = 0u;
+    sw_fill = 0u;
+    sw_pending = SESSION_WRITER_NONE;
+    session_record_init(&sw_record_ctx);
+    sw_id = session_writer_id();
+    sw_offset = 0u;
+    sw_raw_offset = 0u;
+    sw_seq = 0u;
+    memset(sw_index_blk, 0, sizeof(sw_index_blk));
+    sw_index_base = 0u;
+    sw_time_keys = 0u;
+    sw_time.header.magic = SESSION_WRITER_TIME_MAGIC;
+    sw_time.header.session = sw_id;
+    sw_time.header.time_us = 0u;
+    sw_time.header.stride = 1u;
+    sw_time.header.cnt = 0u;
+    sw_stop = false;
+    sw_failed = false;
+
+    sw_stats.prealloc = session_writer_prealloc(duration_s, rate_bps);
+
+#ifndef SESSION_WRITER_HOST
+    // Buffer 1 is free, buffer 0 is filled first.
+    (void)xSemaphoreTake(sw_free_sem, 0);
+    (void)xSemaphoreGive(sw_free_sem);
+    (void)xSemaphoreTake(sw_done_sem, 0);
+#endif
+
+    sw_active = true;
+
+    return true;
+}
+
+bool session_writer_write(const uint8_t *p_data, uint16_t len,
+                          uint32_t timeout_ms)
+{
+    bool is_ok;
+
+    if ((!sw_active) || sw_stop || sw_failed || (0u == len) ||
+        (SESSION_WRITER_BUF_SIZE < len))
+    {
+        return false;
+    }
+
+    session_writer_lock();
+    is_ok = session_writer_append(p_data, len, timeout_ms);
+    session_writer_unlock();
+
+    return is_ok;
+}
+
+bool session_writer_record_write(const session_record_t *p_rec,
+                                 uint32_t timeout_ms)
+{
+    uint32_t raw_offset;
+    uint16_t len;
+    bool is_ok;
+
+    if ((!sw_active) || sw_stop || sw_failed)
+    {
+        return false;
+    }
+
+    session_writer_lock();
+
+    raw_offset = sw_stats.bytes;
+    len = session_record_encode(&sw_record_ctx, p_rec, sw_record_buf,
+                                sizeof(sw_record_buf));
+    is_ok = (0u != len) && session_writer_append(sw_record_buf, len,
+                                                 timeout_ms);
+
+    if ((0u != len) && (!is_ok))
+    {
+        // Next record must not be a delta to the dropped one.
+        session_record_key_force(&sw_record_ctx);
+    }
+    else if (is_ok && (len == sw_record_ctx.key_bytes))
+    {
+        // Keyframe restarted the byte count, record starts with it.
+        session_writer_time_add(p_rec->time_us, raw_offset);
+    }
+
+    session_writer_unlock();
+
+    return is_ok;
+}
+
+bool session_writer_stop(void)
+{
+    if (!sw_active)
+    {
+        return false;
+    }
+
+    // No producer is copying once lock is held.
+    session_writer_lock();
+
+    sw_stop = true;
+    session_writer_notify();
+
+#ifndef SESSION_WRITER_HOST
+    (void)xSemaphoreTake(sw_done_sem, portMAX_DELAY);
+#endif
+
+    session_writer_unlock();
+
+    return !sw_failed;
+}
+
+bool session_writer_recover(const char *p_data_name, const char *p_index_name,
+                            session_recover_t *p_result)
+{
+    session_index_entry_t entry;
+    uint32_t data_size;
+    uint32_t entries;
+    uint32_t offset = 0u;
+    uint32_t raw_offset = 0u;
+    uint32_t seq = 0u;
+    uint32_t id = 0u;
+    bool is_ok;
+
+    if (sw_active || (NULL == sw_backend))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_DATA, p_data_name, false))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_INDEX, p_index_name, false))
+    {
+        sw_backend->close(SESSION_FILE_DATA);
+        return false;
+    }
+
+    data_size = sw_backend->size(SESSION_FILE_DATA);
+    entries = sw_backend->size(SESSION_FILE_INDEX) / sizeof(entry);
+
+    // Entries are appended in order, first bad one ends the session.
+    while (seq < entries)
+    {
+        if (!sw_backend->read(SESSION_FILE_INDEX, seq * sizeof(entry), &entry,
+                              sizeof(entry)))
+        {
+            break;
+        }
+
+        if (0u == seq)
+        {
+            id = entry.session;
+        }
+
+        if ((id != entry.session) ||
+            (!session_writer_entry_check(&entry, seq, offset, raw_offset,
+                                         data_size)))
+        {
+            break;
+        }
+
+        offset += session_writer_stride(&entry);
+        raw_offset += entry.raw_len;
+        seq++;
+    }
+
+    is_ok = sw_backend->truncate(SESSION_FILE_INDEX, seq * sizeof(entry));
+    is_ok = sw_backend->truncate(SESSION_FILE_DATA, offset) && is_ok;
+    is_ok = sw_backend->sync(SESSION_FILE_INDEX) && is_ok;
+    is_ok = sw_backend->sync(SESSION_FILE_DATA) && is_ok;
+
+    sw_backend->close(SESSION_FILE_INDEX);
+    sw_backend->close(SESSION_FILE_DATA);
+
+    if (NULL != p_result)
+    {
+        p_result->entries = seq;
+        p_result->bytes = offset;
+        p_result->lost = data_size - offset;
+    }
+
+    return is_ok;
+}
+
+bool session_writer_range_get(const char *p_index_name, const char *p_time_name,
+                              uint64_t from_us, uint64_t to_us,
+                              session_range_t *p_range)
+{
+    session_index_entry_t first;
+    session_index_entry_t last;
+    uint64_t from_ms;
+    uint64_t to_ms;
+    uint32_t entries;
+    uint32_t raw_start;
+    uint32_t raw_end;
+    uint32_t point;
+    bool is_ok;
+
+    if (sw_active || (NULL == sw_backend) || (from_us > to_us))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_TIME, p_time_name, false))
+    {
+        return false;
+    }
+
+    is_ok = session_writer_time_load();
+    sw_backend->close(SESSION_FILE_TIME);
+
+    if ((!is_ok) || (0u == sw_time.header.cnt) ||
+        (to_us < sw_time.header.time_us))
+    {
+        return false;
+    }
+
+    if (!sw_backend->open(SESSION_FILE_INDEX, p_index_name, false))
+    {
+        return false;
+    }
+
+    from_ms = (from_us > sw_time.header.time_us) ?
+              ((from_us - sw_time.header.time_us) / 1000u) : 0u;
+    to_ms = (to_us - sw_time.header.time_us) / 1000u;
+
+    // Last keyframe not after window start, first one after window end.
+    point = session_writer_time_find((UINT32_MAX < from_ms) ?
+                                     UINT32_MAX : (uint32_t)from_ms);
+    raw_start = sw_time.points[(0u != point) ? (point - 1u) : 0u].raw_offset;
+
+    point = session_writer_time_find((UINT32_MAX < to_ms) ?
+                                     UINT32_MAX : (uint32_t)to_ms);
+    raw_end = (point < sw_time.header.cnt) ?
+              sw_time.points[point].raw_offset : UINT32_MAX;
+
+    entries = sw_backend->size(SESSION_FILE_INDEX) / sizeof(first);
+
+    is_ok = (raw_start < raw_end) && (0u != entries) &&
+            session_writer_entry_find(entries, raw_start, &first) &&
+            session_writer_entry_find(entries, raw_end - 1u, &last);
+
+    sw_backend->close(SESSION_FILE_INDEX);
+
+    // Keyframe must be in the file, lost with a failed write otherwise.
+    if ((!is_ok) || (sw_time.header.session != first.session) ||
+        (sw_time.header.session != last.session) ||
+        ((first.raw_offset + first.raw_len) <= raw_start))
+    {
+        return false;
+    }
+
+    if (raw_end > (last.raw_offset + last.raw_len))
+    {
+        raw_end = last.raw_offset + last.raw_len;
+    }
+
+    p_range->offset = first.offset;
+    p_range->len = last.offset + session_writer_stride(&last) - first.offset;
+    p_range->raw_offset = first.raw_offset;
+    p_range->raw_skip = raw_start - first.raw_offset;
+    p_range->raw_len = raw_end - raw_start;
+    p_range->seq = first.seq;
+    p_range->entries = last.seq - first.seq + 1u;
+
+    return true;
+}
+
+void session_writer_stats_get(session_writer_stats_t *p_stats)
+{
+    if (NULL != p_stats)
+    {
+        session_writer_critical_enter();
+        *p_stats = sw_stats;
+        session_writer_critical_exit();
+    }
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static bool session_writer_append(const uint8_t *p_data, uint16_t len,
+                                  uint32_t timeout_ms)
+{
+    session_buf_t *p_buf = &sw_buf[sw_fill];
+    uint32_t room = SESSION_WRITER_BUF_SIZE - p_buf->len;
+    uint16_t total = len;
+
+    if (room < len)
+    {
+        // Record continues in the other buffer, it must be written first.
+        if (!session_writer_buf_take(0u))
+        {
+            sw_stats.waits++;
+
+            if (!session_writer_buf_take(timeout_ms))
+            {
+                sw_stats.drops++;
+                return false;
+            }
+        }
+
+        memcpy(&p_buf->data[p_buf->len], p_data, room);
+
+        session_writer_critical_enter();
+        p_buf->len = SESSION_WRITER_BUF_SIZE;
+        sw_pending = sw_fill;
+        sw_fill ^= 1u;
+        sw_buf[sw_fill].len = 0u;
+        session_writer_critical_exit();
+
+        session_writer_notify();
+
+        p_buf = &sw_buf[sw_fill];
+        p_data += room;
+        len -= (uint16_t)room;
+    }
+
+    memcpy(&p_buf->data[p_buf->len], p_data, len);
+
+    session_writer_critical_enter();
+    p_buf->len += len;
+    session_writer_critical_exit();
+
+    sw_stats.bytes += total;
+
+    return true;
+}
+
+static void session_writer_service(bool final)
+{
+    uint32_t pending;
+    uint32_t fill;
+    uint32_t end;
+
+    // Both taken together, handed over data goes to the file first.
+    session_writer_critical_enter();
+    pending = sw_pending;
+    fill = sw_fill;
+    end = sw_buf[fill].len;
+    session_writer_critical_exit();
+
+    if (SESSION_WRITER_NONE != pending)
+    {
+        session_writer_flush(&sw_buf[pending], SESSION_WRITER_BUF_SIZE);
+        sw_buf[pending].written = 0u;
+
+        session_writer_critical_enter();
+        sw_pending = SESSION_WRITER_NONE;
+        session_writer_critical_exit();
+
+        session_writer_buf_give();
+
+        // Anything filled meanwhile is left for the next run.
+        session_writer_critical_enter();
+        end = sw_buf[fill].len;
+        session_writer_critical_exit();
+    }
+
+    if (!final)
+    {
+        end -= end % SESSION_WRITER_BLOCK;
+    }
+
+    if (end > sw_buf[fill].written)
+    {
+        session_writer_flush(&sw_buf[fill], end);
+    }
+}
+
+static void session_writer_flush(session_buf_t *p_buf, uint32_t end)
+{
+    session_index_entry_t entry;
+    const uint8_t *p_data = &p_buf->data[p_buf->written];
+    uint32_t len = end - p_buf->written;
+    uint32_t stored = len;
+    uint64_t start_us;
+    uint32_t write_us;
+    bool is_ok;
+
+    p_buf->written = end;
+
+    if (sw_failed || (0u == len))
+    {
+        return;
+    }
+
+    session_writer_clock_vote(true);
+    start_us = session_writer_now_us();
+
+    entry.session = sw_id;
+    entry.seq = sw_seq;
+    entry.offset = sw_offset;
+    entry.raw_offset = sw_raw_offset;
+    entry.len = (uint16_t)len;
+    entry.raw_len = (uint16_t)len;
+
+    if (sw_lz)
+    {
+        uint32_t lz_len = session_lz_compress(p_data, len, sw_lz_buf, len - 1u,
+                                              sw_lz_budget);
+        uint32_t lz_us = (uint32_t)(session_writer_now_us() - start_us);
+        uint32_t padded = lz_len + ((SESSION_WRITER_BLOCK -
+                                     (lz_len % SESSION_WRITER_BLOCK)) %
+                                    SESSION_WRITER_BLOCK);
+
+        if (sw_stats.lz_us_max < lz_us)
+        {
+            sw_stats.lz_us_max = lz_us;
+        }
+
+        // Kept only if whole blocks are saved, file offsets stay aligned.
+        if ((0u != lz_len) && (padded < len))
+        {
+            memset(&sw_lz_buf[lz_len], 0, padded - lz_len);
+            entry.len = (uint16_t)lz_len;
+            p_data = sw_lz_buf;
+            stored = padded;
+            sw_stats.lz_blocks++;
+        }
+        else
+        {
+            sw_stats.lz_bypass++;
+        }
+    }
+
+    entry.data_crc = crc16(p_data, entry.len);
+    entry.crc = crc16((const uint8_t *)&entry,
+                      offsetof(session_index_entry_t, crc));
+
+    // Entry reaches the card only after the data it describes.
+    is_ok = sw_backend->write(SESSION_FILE_DATA, sw_offset, p_data, stored) &&
+            sw_backend->sync(SESSION_FILE_DATA) &&
+            session_writer_index_write(&entry) &&
+            sw_backend->sync(SESSION_FILE_INDEX);
+
+    write_us = (uint32_t)(session_writer_now_us() - start_us);
+    session_writer_clock_vote(false);
+
+    session_writer_critical_enter();
+    if (is_ok)
+    {
+        sw_stats.written += len;
+        sw_stats.stored += stored;
+        sw_stats.writes++;
+        sw_stats.write_us_total += write_us;
+        if (sw_stats.write_us_max < write_us)
+        {
+            sw_stats.write_us_max = write_us;
+        }
+    }
+    else
+    {
+        sw_stats.errors++;
+    }
+    session_writer_critical_exit();
+
+    if (!is_ok)
+    {
+        // File position is unknown, recovery keeps what was indexed.
+        sw_failed = true;
+        return;
+    }
+
+    sw_offset += stored;
+    sw_raw_offset += len;
+    sw_seq++;
+}
+
+static uint32_t session_writer_prealloc(uint32_t duration_s, uint32_t rate_bps)
+{
+    uint64_t size = (uint64_t)duration_s * rate_bps;
+    uint64_t avail = sw_backend->free_space();
+    uint64_t index_size;
+
+    if ((0u == size) || (SESSION_WRITER_FREE_RESERVE >= avail))
+    {
+        return 0u;
+    }
+
+    // Whole erase groups, whatever fits next to the reserve.
+    avail -= SESSION_WRITER_FREE_RESERVE;
+    size += SESSION_WRITER_ERASE_SIZE - 1u;
+    size -= size % SESSION_WRITER_ERASE_SIZE;
+
+    // A full buffer and a sync each second at most, one entry each.
+    index_size = (((size / SESSION_WRITER_BUF_SIZE) + duration_s) *
+                  sizeof(session_index_entry_t)) + SESSION_WRITER_BLOCK - 1u;
+    index_size -= index_size % SESSION_WRITER_BLOCK;
+
+    if (size + index_size > avail)
+    {
+        size = (avail * SESSION_WRITER_BUF_SIZE) /
+               (SESSION_WRITER_BUF_SIZE + (2u * sizeof(session_index_entry_t)));
+        size -= size % SESSION_WRITER_ERASE_SIZE;
+        index_size = avail - size;
+        index_size -= index_size % SESSION_WRITER_BLOCK;
+    }
+
+    if ((0u == size) || (UINT32_MAX < size) || (UINT32_MAX < index_size))
+    {
+        return 0u;
+    }
+
+    // Index first, it is small and the data extent stays behind it.
+    if ((!sw_backend->expand(SESSION_FILE_INDEX, (uint32_t)index_size)) ||
+        (!sw_backend->expand(SESSION_FILE_DATA, (uint32_t)size)))
+    {
+        // Not enough contiguous space, files grow while writing.
+        return 0u;
+    }
+
+    return (uint32_t)size;
+}
+
+static bool session_writer_index_write(const session_index_entry_t *p_entry)
+{
+    uint32_t offset = p_entry->seq * sizeof(session_index_entry_t);
+    uint32_t start;
+    uint32_t end;
+
+    // Window moves by a block once the entry starts in its second half.
+    if (offset >= (sw_index_base + SESSION_WRITER_BLOCK))
+    {
+        memcpy(sw_index_blk, &sw_index_blk[SESSION_WRITER_BLOCK],
+               SESSION_WRITER_BLOCK);
+        memset(&sw_index_blk[SESSION_WRITER_BLOCK], 0, SESSION_WRITER_BLOCK);
+        sw_index_base += SESSION_WRITER_BLOCK;
+    }
+
+    memcpy(&sw_index_blk[offset - sw_index_base], p_entry,
+           sizeof(session_index_entry_t));
+
+    // Zeroed rest of the block fails the entry check in recovery.
+    start = offset - (offset % SESSION_WRITER_BLOCK);
+    end = offset + sizeof(session_index_entry_t) + SESSION_WRITER_BLOCK - 1u;
+    end -= end % SESSION_WRITER_BLOCK;
+
+    return sw_backend->write(SESSION_FILE_INDEX, start,
+                             &sw_index_blk[start - sw_index_base],
+                             end - start);
+}
+
+static void session_writer_time_add(uint64_t time_us, uint32_t raw_offset)
+{
+    session_time_header_t *p_header = &sw_time.header;
+    uint64_t time_ms;
+
+    if (0u != (sw_time_keys++ % p_header->stride))
+    {
+        return;
+    }
+
+    if (SESSION_WRITER_TIME_POINTS == p_header->cnt)
+    {
+        // Every second point stays, still on keyframes stride apart.
+        for (uint32_t index = 1u; index < (SESSION_WRITER_TIME_POINTS / 2u);
+             index++)
+        {
+            sw_time.points[index] = sw_time.points[index * 2u];
+        }
+        p_header->cnt = SESSION_WRITER_TIME_POINTS / 2u;
+        p_header->stride *= 2u;
+
+        if (0u != ((sw_time_keys - 1u) % p_header->stride))
+        {
+            sw_stats.time_points = p_header->cnt;
+            sw_stats.time_stride = p_header->stride;
+            return;
+        }
+    }
+
+    if (0u == p_header->cnt)
+    {
+        p_header->time_us = time_us;
+    }
+
+    time_ms = (time_us > p_header->time_us) ?
+              ((time_us - p_header->time_us) / 1000u) : 0u;
+    if (UINT32_MAX < time_ms)
+    {
+        time_ms = UINT32_MAX;
+    }
+
+    // Clock set back, points stay sorted for the search.
+    if ((0u != p_header->cnt) &&
+        (sw_time.points[p_header->cnt - 1u].time_ms > time_ms))
+    {
+        time_ms = sw_time.points[p_header->cnt - 1u].time_ms;
+    }
+
+    sw_time.points[p_header->cnt].time_ms = (uint32_t)time_ms;
+    sw_time.points[p_header->cnt].raw_offset = raw_offset;
+    p_header->cnt++;
+
+    sw_stats.time_points = p_header->cnt;
+    sw_stats.time_stride = p_header->stride;
+}
+
+static bool session_writer_time_save(void)
+{
+    uint32_t len = sizeof(sw_time.header) +
+                   (sw_time.header.cnt * sizeof(sw_time.points[0]));
+    uint16_t crc = crc16((const uint8_t *)&sw_time, (uint16_t)len);
+
+    return sw_backend->write(SESSION_FILE_TIME, 0u, &sw_time, len) &&
+           sw_backend->write(SESSION_FILE_TIME, len, &crc, sizeof(crc)) &&
+           sw_backend->sync(SESSION_FILE_TIME);
+}
+
+static bool session_writer_time_load(void)
+{
+    uint32_t len = sizeof(sw_time.header);
+    uint16_t crc;
+
+    if ((!sw_backend->read(SESSION_FILE_TIME, 0u, &sw_time.header, len)) ||
+        (SESSION_WRITER_TIME_MAGIC != sw_time.header.magic) ||
+        (SESSION_WRITER_TIME_POINTS < sw_time.header.cnt))
+    {
+        return false;
+    }
+
+    len += sw_time.header.cnt * sizeof(sw_time.points[0]);
+
+    if ((!sw_backend->read(SESSION_FILE_TIME, sizeof(sw_time.header),
+                           sw_time.points, len - sizeof(sw_time.header))) ||
+        (!sw_backend->read(SESSION_FILE_TIME, len, &crc, sizeof(crc))))
+    {
+        return false;
+    }
+
+    return (crc == crc16((const uint8_t *)&sw_time, (uint16_t)len));
+}
+
+static uint32_t session_writer_time_find(uint32_t time_ms)
+{
+    uint32_t low = 0u;
+    uint32_t high = sw_time.header.cnt;
+
+    while (low < high)
+    {
+        uint32_t mid = low + ((high - low) / 2u);
+
+        if (sw_time.points[mid].time_ms > time_ms)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1u;
+        }
+    }
+
+    return low;
+}
+
+static bool session_writer_entry_find(uint32_t entries, uint32_t raw_offset,
+                                      session_index_entry_t *p_entry)
+{
+    uint32_t low = 0u;
+    uint32_t high = entries;
+
+    // Entry low starts at or before offset, or is the first one.
+    while ((high - low) > 1u)
+    {
+        uint32_t mid = low + ((high - low) / 2u);
+
+        if (!sw_backend->read(SESSION_FILE_INDEX, mid * sizeof(*p_entry),
+                              p_entry, sizeof(*p_entry)))
+        {
+            return false;
+        }
+
+        if (p_entry->raw_offset <= raw_offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (!sw_backend->read(SESSION_FILE_INDEX, low * sizeof(*p_entry), p_entry,
+                          sizeof(*p_entry)))
+    {
+        return false;
+    }
+
+    return (p_entry->seq == low) &&
+           (p_entry->crc == crc16((const uint8_t *)p_entry,
+                                  offsetof(session_index_entry_t, crc)));
+}
+
+static bool session_writer_entry_check(const session_index_entry_t *p_entry,
+                                       uint32_t seq, uint32_t offset,
+                                       uint32_t raw_offset, uint32_t data_size)
+{
+    // Writer is stopped, its buffer holds the data read back.
+    uint8_t *p_data = sw_buf[0].data;
+
+    if ((p_entry->crc != crc16((const uint8_t *)p_entry,
+                               offsetof(session_index_entry_t, crc))) ||
+        (p_entry->seq != seq) || (p_entry->offset != offset) ||
+        (p_entry->raw_offset != raw_offset) || (0u == p_entry->len) ||
+        (p_entry->raw_len < p_entry->len) ||
+        (SESSION_WRITER_BUF_SIZE < p_entry->raw_len) ||
+        ((data_size - offset) < session_writer_stride(p_entry)))
+    {
+        return false;
+    }
+
+    if (!sw_backend->read(SESSION_FILE_DATA, offset, p_data, p_entry->len))
+    {
+        return false;
+    }
+
+    return (p_entry->data_crc == crc16(p_data, (uint16_t)p_entry->len));
+}
+
+static uint32_t session_writer_stride(const session_index_entry_t *p_entry)
+{
+    uint32_t len = p_entry->len;
+
+    if (len < p_entry->raw_len)
+    {
+        len += (SESSION_WRITER_BLOCK - (len % SESSION_WRITER_BLOCK)) %
+               SESSION_WRITER_BLOCK;
+    }
+
+    return len;
+}
+
+static void session_writer_run(void)
+{
+    if (!sw_active)
+    {
+        return;
+    }
+
+    if (!sw_stop)
+    {
+        session_writer_service(false);
+        return;
+    }
+
+    session_writer_service(true);
+
+    // Unused preallocation is released, size becomes what was written.
+    if (!(sw_backend->truncate(SESSION_FILE_INDEX,
+                               sw_seq * sizeof(session_index_entry_t)) &&
+          sw_backend->truncate(SESSION_FILE_DATA, sw_offset) &&
+          sw_backend->sync(SESSION_FILE_INDEX) &&
+          sw_backend->sync(SESSION_FILE_DATA)))
+    {
+        sw_failed = true;
+    }
+
+    if (!session_writer_time_save())
+    {
+        sw_failed = true;
+    }
+
+    sw_backend->close(SESSION_FILE_TIME);
+    sw_backend->close(SESSION_FILE_INDEX);
+    sw_backend->close(SESSION_FILE_DATA);
+
+    sw_active = false;
+
+#ifndef SESSION_WRITER_HOST
+    (void)xSemaphoreGive(sw_done_sem);
+#endif
+}
+
+#ifndef SESSION_WRITER_HOST
+
+static void session_writer_task(void *p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SESSION_WRITER_SYNC_MS));
+        session_writer_run();
+    }
+}
+
+static void session_writer_notify(void)
+{
+    xTaskNotifyGive(sw_task);
+}
+
+static void session_writer_lock(void)
+{
+    (void)xSemaphoreTake(sw_mutex, portMAX_DELAY);
+}
+
+static void session_writer_unlock(void)
+{
+    (void)xSemaphoreGive(sw_mutex);
+}
+
+static void session_writer_critical_enter(void)
+{
+    taskENTER_CRITICAL();
+}
+
+static void session_writer_critical_exit(void)
+{
+    taskEXIT_CRITICAL();
+}
+
+static void session_writer_clock_vote(bool flushing)
+{
+    // CPU compresses and copies SDMMC FIFO, low clock between flushes.
+    (void)bsp_clock_vote(BSP_CLOCK_EMMC, flushing ? BSP_CLOCK_48MHZ :
+                                                    BSP_CLOCK_LOW);
+}
+
+static bool session_writer_buf_take(uint32_t timeout_ms)
+{
+    return (pdTRUE == xSemaphoreTake(sw_free_sem, pdMS_TO_TICKS(timeout_ms)));
+}
+
+static void session_writer_buf_give(void)
+{
+    (void)xSemaphoreGive(sw_free_sem);
+}
+
+static uint64_t session_writer_now_us(void)
+{
+    return bsp_timestamp_now();
+}
+
+static uint32_t session_writer_id(void)
+{
+    int32_t unix_timestamp = 0;
+    uint32_t us = 0u;
+
+    (void)bsp_timestamp_to_unix(bsp_timestamp_now(), &unix_timestamp, &us);
+
+    return ((uint32_t)unix_timestamp << 8) ^ us;
+}
+
+static bool session_fatfs_open(session_file_t file, const char *p_name,
+                               bool create)
+{
+    BYTE mode = FA_READ | FA_WRITE |
+                (create ? FA_CREATE_ALWAYS : FA_OPEN_EXISTING);
+
+    session_fatfs_expanded[file] = false;
+    session_fatfs_dirty[file] = false;
+
+    return (FR_OK == f_open(&session_fatfs_fil[file], p_name, mode));
+}
+
+static bool session_fatfs_expand(session_file_t file, uint32_t size)
+{
+    FIL *p_fil = &session_fatfs_fil[file];
+
+    // Contiguous clusters, allocated now and set as file size. Needs
+    // FF_USE_EXPAND.
+    session_fatfs_expanded[file] = (FR_OK == f_expand(p_fil, size, 1u));
+    session_fatfs_dirty[file] = true;
+
+    return session_fatfs_expanded[file];
+}
+
+static bool session_fatfs_write(session_file_t file, uint32_t offset,
+                                const void *p_data, uint32_t len)
+{
+    FIL *p_fil = &session_fatfs_fil[file];
+    UINT written = 0u;
+
+    if ((offset != f_tell(p_fil)) && (FR_OK != f_lseek(p_fil, offset)))
+    {
+        return false;
+    }
+
+    // Whole blocks inside the allocation go straight to the card, anything
+    // else leaves the sector buffer or file size to f_sync.
+    if ((!session_fatfs_expanded[file]) ||
+        (0u != (offset % SESSION_WRITER_BLOCK)) ||
+        (0u != (len % SESSION_WRITER_BLOCK)) ||
+        ((offset + len) > f_size(p_fil)))
+    {
+        session_fatfs_dirty[file] = true;
+    }
+
+    return (FR_OK == f_write(p_fil, p_data, len, &written)) &&
+           (len == written);
+}
+
+static bool session_fatfs_sync(session_file_t file)
+{
+    FIL *p_fil = &session_fatfs_fil[file];
+
+    if (!session_fatfs_dirty[file])
+    {
+        // Only data sectors changed, f_sync would rewrite the directory
+        // entry for the modification time alone.
+        return (RES_OK == disk_ioctl(p_fil->obj.fs->pdrv, CTRL_SYNC, NULL));
+    }
+
+    session_fatfs_dirty[file] = (FR_OK != f_sync(p_fil));
+
+    return !session_fatfs_dirty[file];
+}
+
+static bool session_fatfs_read(session_file_t file, uint32_t offset,
+                               void *p_data, uint32_t len)
+{
+    UINT read = 0u;
+
+    return (FR_OK == f_lseek(&session_fatfs_fil[file], offset)) &&
+           (FR_OK == f_read(&session_fatfs_fil[file], p_data, len, &read)) &&
+           (len == read);
+}
+
+static uint32_t session_fatfs_size(session_file_t file)
+{
+    return (uint32_t)f_size(&session_fatfs_fil[file]);
+}
+
+static bool session_fatfs_truncate(session_file_t file, uint32_t size)
+{
+    session_fatfs_dirty[file] = true;
+
+    return (FR_OK == f_lseek(&session_fatfs_fil[file], size)) &&
+           (FR_OK == f_truncate(&session_fatfs_fil[file]));
+}
+
+static void session_fatfs_close(session_file_t file)
+{
+    (void)f_close(&session_fatfs_fil[file]);
+}
+
+static uint64_t session_fatfs_free_space(void)
+{
+    FATFS *p_fs;
+    DWORD clusters;
+
+    if (FR_OK != f_getfree("", &clusters, &p_fs))
+    {
+        return 0u;
+    }
+
+    return (uint64_t)clusters * p_fs->csize * SESSION_WRITER_BLOCK;
+}
+
+#else
+
+// Host has no writer task, handed over buffer is written before returning,
+// so the other buffer is always free.
+static void session_writer_notify(void)
+{
+    session_writer_run();
+}
+
+static void session_writer_lock(void)
+{
+}
+
+static void session_writer_unlock(void)
+{
+}
+
+static void session_writer_critical_enter(void)
+{
+}
+
+static void session_writer_critical_exit(void)
+{
+}
+
+static void session_writer_clock_vote(bool flushing)
+{
+    (void)flushing;
+}
+
+static bool session_writer_buf_take(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    return true;
+}
+
+static void session_writer_buf_give(void)
+{
+}
+
+static uint64_t session_writer_now_us(void)
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000u) + ((uint64_t)now.tv_nsec / 1000u);
+}
+
+static uint32_t session_writer_id(void)
+{
+    return ((uint32_t)time(NULL) << 8) ^ (uint32_t)session_writer_now_us();
+}
+
+#endif
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,239 @@
+/** @file session_writer.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef CROSSBOX_SESSION_WRITER_H
+#define CROSSBOX_SESSION_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <emmc_helper.h>
+#include <session_record.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+/// Ping-pong buffer size, multiple of SESSION_WRITER_BLOCK. Each buffer
+/// covers one aligned stretch of the data file, no write crosses it.
+#define SESSION_WRITER_BUF_SIZE     (EMMC_DATA_BUFFER_SIZE)
+/// eMMC block, every write but the last one of a session is a multiple.
+#define SESSION_WRITER_BLOCK        (512u)
+/// Filled blocks are written at least this often.
+#define SESSION_WRITER_SYNC_MS      (1000u)
+/// eMMC erase group, preallocation is a multiple.
+#define SESSION_WRITER_ERASE_SIZE   (512u * 1024u)
+/// Free space left to other files when preallocating.
+#define SESSION_WRITER_FREE_RESERVE (4u * 1024u * 1024u)
+/// Time index points kept in RAM, spacing doubles whenever they run out.
+#define SESSION_WRITER_TIME_POINTS  (256u)
+/// Time index file magic, "CBXT".
+#define SESSION_WRITER_TIME_MAGIC   (0x54584243u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+typedef enum {
+    SESSION_FILE_DATA = 0,
+    SESSION_FILE_INDEX,
+    SESSION_FILE_TIME,
+    SESSION_FILE_CNT
+} session_file_t;
+
+/// File access used by the writer, FatFs on target, stdio on host.
+typedef struct {
+    bool (*open)(session_file_t file, const char *p_name, bool create);
+    bool (*expand)(session_file_t file, uint32_t size);
+    bool (*write)(session_file_t file, uint32_t offset, const void *p_data,
+                  uint32_t len);
+    bool (*sync)(session_file_t file);
+    bool (*read)(session_file_t file, uint32_t offset, void *p_data,
+                 uint32_t len);
+    uint32_t (*size)(session_file_t file);
+    bool (*truncate)(session_file_t file, uint32_t size);
+    void (*close)(session_file_t file);
+    uint64_t (*free_space)(void);
+} session_backend_t;
+
+/// Index file entry, one per data write. Written after the data is synced.
+/// Compressed blocks are padded to SESSION_WRITER_BLOCK in the data file.
+typedef struct {
+    uint32_t session;               // start time, tells apart stale entries
+                                    // left in preallocated clusters
+    uint32_t seq;                   // write number within session
+    uint32_t offset;                // data file offset
+    uint32_t raw_offset;            // offset in uncompressed stream
+    uint16_t len;                   // bytes stored, LZ4 block if < raw_len
+    uint16_t raw_len;               // bytes before compression
+    uint16_t data_crc;              // crc16 of stored bytes
+    uint16_t crc;                   // crc16 of fields above
+} session_index_entry_t;
+
+/// Time index point, a keyframe the record stream may be decoded from.
+typedef struct {
+    uint32_t time_ms;               // keyframe time, since first point
+    uint32_t raw_offset;            // keyframe offset in uncompressed stream
+} session_time_point_t;
+
+/// Time index file header, followed by points and crc16 of both.
+typedef struct {
+    uint32_t magic;                 // SESSION_WRITER_TIME_MAGIC
+    uint32_t session;               // matches index entries
+    uint64_t time_us;               // time of first point
+    uint32_t stride;                // keyframes per point
+    uint32_t cnt;                   // points
+} session_time_header_t;
+
+/// Data file range holding a time window.
+typedef struct {
+    uint32_t offset;                // data file offset, first whole write
+    uint32_t len;                   // data file bytes, whole writes
+    uint32_t raw_offset;            // uncompressed offset of first write
+    uint32_t raw_skip;              // uncompressed bytes before keyframe
+    uint32_t raw_len;               // uncompressed bytes from keyframe on
+    uint32_t seq;                   // first write, index entry number
+    uint32_t entries;               // writes in range
+} session_range_t;
+
+typedef struct {
+    uint32_t bytes;                 // bytes accepted from producers
+    uint32_t written;               // bytes written, before compression
+    uint32_t stored;                // data file bytes, padding included
+    uint32_t writes;                // data writes
+    uint32_t waits;                 // producer waited for a free buffer
+    uint32_t drops;                 // records dropped, both buffers full
+    uint32_t errors;                // backend failures, session stopped
+    uint32_t prealloc;              // contiguous data file size, 0 if none
+    uint32_t lz_blocks;             // writes stored compressed
+    uint32_t lz_bypass;             // over budget or incompressible, raw
+    uint32_t lz_us_max;             // longest compression
+    uint32_t write_us_max;          // longest data write with sync
+    uint64_t write_us_total;        // time spent writing
+    uint32_t time_points;           // time index points
+    uint32_t time_stride;           // keyframes per time index point
+} session_writer_stats_t;
+
+typedef struct {
+    uint32_t entries;               // valid index entries
+    uint32_t bytes;                 // data bytes covered by them
+    uint32_t lost;                  // bytes cut from data file, unused
+                                    // preallocation included
+} session_recover_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Set file backend and create writer task.
+ * @param p_backend file access, NULL selects FatFs.
+ * @return true on success, false otherwise
+ */
+bool session_writer_init(const session_backend_t *p_backend);
+
+/**
+ * @brief Compress data writes of following sessions. A write that does not
+ *      compress within the budget is stored as is.
+ * @param enable true to compress
+ * @param budget_cycles CPU cycles allowed per 8 KB write, 0 for no limit
+ */
+void session_writer_compress_set(bool enable, uint32_t budget_cycles);
+
+/**
+ * @brief Create session files and start accepting data. Data file is
+ *      allocated contiguously for the expected duration, limited by free
+ *      space, so writes do not update the FAT. Longer sessions grow the file
+ *      as usual. File is cut to written size when session stops.
+ * @param p_data_name data file name
+ * @param p_index_name index file name
+ * @param p_time_name time index file name, written when session stops
+ * @param duration_s expected session duration, 0 disables preallocation
+ * @param rate_bps expected data rate in bytes per second
+ * @return true on success, false otherwise
+ */
+bool session_writer_start(const char *p_data_name, const char *p_index_name,
+                          const char *p_time_name, uint32_t duration_s,
+                          uint32_t rate_bps);
+
+/**
+ * @brief Append data. Copies into the buffer being filled, the other one is
+ *      written by the writer task meanwhile. Records may span both buffers.
+ * @param p_data record
+ * @param len record length
+ * @param timeout_ms time to wait when both buffers are full
+ * @return false if record was dropped or no session is running
+ */
+bool session_writer_write(const uint8_t *p_data, uint16_t len,
+                          uint32_t timeout_ms);
+
+/**
+ * @brief Encode and append record. Delta references and keyframes are kept
+ *      per session, so a session holds either records or raw writes. A
+ *      dropped record makes the next one start with a keyframe.
+ * @param p_rec record
+ * @param timeout_ms time to wait when both buffers are full
+ * @return false if record was dropped, invalid or no session is running
+ */
+bool session_writer_record_write(const session_record_t *p_rec,
+                                 uint32_t timeout_ms);
+
+/**
+ * @brief Write remaining data, cut preallocated files to written size, sync
+ *      and close them. Blocks until writer task is done.
+ * @return false if any write failed during the session
+ */
+bool session_writer_stop(void);
+
+/**
+ * @brief Replay index of a session that was not stopped, e.g. after power
+ *      loss. Index and data files are cut back to the last write whose data
+ *      matches its index entry. Call while no session is running.
+ * @param p_data_name data file name
+ * @param p_index_name index file name
+ * @param p_result output, may be NULL
+ * @return false if files can not be opened
+ */
+bool session_writer_recover(const char *p_data_name, const char *p_index_name,
+                            session_recover_t *p_result);
+
+/**
+ * @brief Find data file range covering a time window of a stopped session,
+ *      for sync to stream a slice instead of the whole session. Time index
+ *      gives the keyframes around the window, index entries give the writes
+ *      holding them. Range starts at a keyframe, so it decodes on its own, and
+ *      may begin and end up to one time index point outside the window.
+ *      Call while no session is running.
+ * @param p_index_name index file name
+ * @param p_time_name time index file name
+ * @param from_us window start, unix time in us
+ * @param to_us window end, unix time in us
+ * @param p_range output
+ * @return false if files can not be read or window holds no data
+ */
+bool session_writer_range_get(const char *p_index_name, const char *p_time_name,
+                              uint64_t from_us, uint64_t to_us,
+                              session_range_t *p_range);
+
+/**
+ * @brief Get writer statistics of current or last session.
+ * @param p_stats output
+ */
+void session_writer_stats_get(session_writer_stats_t *p_stats);
+
+#ifdef SESSION_WRITER_HOST
+/**
+ * @brief Host backend on stdio files, for benchmarking the writer.
+ */
+const session_backend_t *session_writer_host_backend(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CROSSBOX_SESSION_WRITER_H
@@ -0,0 +1,633 @@
+/** @file session_writer_host.c
+*
+* @brief Host backend of the session writer on stdio files. Syncs are
+*        counted the way the FatFs backend issues them: a device flush after
+*        whole block writes inside the preallocation, f_sync with its
+*        directory entry write otherwise. Built with SESSION_WRITER_BENCH it
+*        measures sustained write rate, compression ratio, directory entry
+*        writes and recovery of a session cut short. With -t timed records go
+*        through the encoder, past the time index capacity, and time window
+*        queries are checked against the keyframes written:
+*
+*        gcc -DSESSION_WRITER_HOST -DSESSION_WRITER_BENCH \
+*            -D'CYCLES()=0u' -I. session_writer.c \
+*            session_writer_host.c session_record.c session_lz.c \
+*            host/helpers_host.c -o sw_bench
+*        ./sw_bench [-z] [-n] [-t] [-f recorded.dat] [megabytes] [record bytes]
+*
+*        -z compresses, -n disables preallocation, -f replays a recorded
+*        session data file instead of synthetic records, -t writes timed
+*        records, 10 ms apart with a pause now and then.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <session_writer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define BENCH_DATA_NAME             "sw_bench.dat"
+#define BENCH_INDEX_NAME            "sw_bench.idx"
+#define BENCH_TIME_NAME             "sw_bench.tix"
+// Whole size is expected within this time.
+#define BENCH_DURATION_S            (60u)
+// Timed records, first one at 2019-01-01.
+#define BENCH_TIME_START_US         (1546300800000000ull)
+#define BENCH_TIME_STEP_US          (10000u)
+#define BENCH_TIME_PAUSE_US         (2500000u)
+#define BENCH_TIME_PAUSE_EVERY      (997u)
+
+//----------------------------- DATA TYPES ------------------------------------
+#ifdef SESSION_WRITER_BENCH
+/// Keyframe written by the timed run.
+typedef struct {
+    uint64_t time_us;
+    uint32_t raw_offset;
+} bench_key_t;
+#endif
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static bool session_host_open(session_file_t file, const char *p_name,
+                              bool create);
+static bool session_host_expand(session_file_t file, uint32_t size);
+static bool session_host_write(session_file_t file, uint32_t offset,
+                               const void *p_data, uint32_t len);
+static bool session_host_sync(session_file_t file);
+static bool session_host_read(session_file_t file, uint32_t offset,
+                              void *p_data, uint32_t len);
+static uint32_t session_host_size(session_file_t file);
+static bool session_host_truncate(session_file_t file, uint32_t size);
+static void session_host_close(session_file_t file);
+static uint64_t session_host_free_space(void);
+#ifdef SESSION_WRITER_BENCH
+static bool bench_timed_write(uint64_t total);
+static bool bench_range_check(uint64_t from_us, uint64_t to_us);
+static bool bench_timed_check(void);
+#endif
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static const session_backend_t session_host_backend = {
+    .open = session_host_open,
+    .expand = session_host_expand,
+    .write = session_host_write,
+    .sync = session_host_sync,
+    .read = session_host_read,
+    .size = session_host_size,
+    .truncate = session_host_truncate,
+    .close = session_host_close,
+    .free_space = session_host_free_space,
+};
+
+static FILE *session_host_file[SESSION_FILE_CNT];
+static bool session_host_expanded[SESSION_FILE_CNT];
+static bool session_host_dirty[SESSION_FILE_CNT];
+static uint32_t session_host_dir_syncs;
+static uint32_t session_host_flushes;
+#ifdef SESSION_WRITER_BENCH
+static bench_key_t *bench_key;
+static uint32_t bench_key_cnt;
+static uint32_t bench_raw_total;
+#endif
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+const session_backend_t *session_writer_host_backend(void)
+{
+    return &session_host_backend;
+}
+
+#ifdef SESSION_WRITER_BENCH
+int main(int argc, char **argv)
+{
+    static uint8_t record[SESSION_WRITER_BUF_SIZE];
+    session_writer_stats_t stats;
+    session_recover_t result;
+    struct timespec start;
+    struct timespec end;
+    FILE *p_input = NULL;
+    uint64_t total;
+    uint64_t sent = 0u;
+    uint16_t len;
+    bool prealloc = true;
+    bool compress = false;
+    bool timed = false;
+    double sec;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "zntf:")))
+    {
+        switch (opt)
+        {
+            case 'z':
+                compress = true;
+                break;
+            case 'n':
+                prealloc = false;
+                break;
+            case 't':
+                timed = true;
+                break;
+            case 'f':
+                p_input = fopen(optarg, "rb");
+                if (NULL == p_input)
+                {
+                    printf("can not open %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                return 1;
+        }
+    }
+
+    total = ((optind < argc) ? strtoull(argv[optind], NULL, 0) : 64u) *
+            1024u * 1024u;
+    len = (uint16_t)(((optind + 1) < argc) ?
+                     strtoul(argv[optind + 1], NULL, 0) : 64u);
+
+    if ((0u == len) || (sizeof(record) < len))
+    {
+        printf("record length 1..%u\n", (unsigned)sizeof(record));
+        return 1;
+    }
+
+    for (uint32_t index = 0u; index < sizeof(record); index++)
+    {
+        record[index] = (uint8_t)(index * 31u);
+    }
+
+    session_writer_compress_set(compress, 0u);
+
+    if ((!session_writer_init(&session_host_backend)) ||
+        (!session_writer_start(BENCH_DATA_NAME, BENCH_INDEX_NAME,
+                               BENCH_TIME_NAME,
+                               prealloc ? BENCH_DURATION_S : 0u,
+                               (uint32_t)(total / BENCH_DURATION_S))))
+    {
+        printf("start failed\n");
+        return 1;
+    }
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (timed && (!bench_timed_write(total)))
+    {
+        printf("timed write failed at %u\n", bench_raw_total);
+        return 1;
+    }
+
+    while ((!timed) && (sent < total))
+    {
+        uint16_t chunk = len;
+
+        if (NULL != p_input)
+        {
+            // Recorded session is replayed in record sized pieces.
+            chunk = (uint16_t)fread(record, 1u, len, p_input);
+            if (0u == chunk)
+            {
+                break;
+            }
+        }
+        else
+        {
+            record[0] = (uint8_t)sent;
+        }
+
+        if (!session_writer_write(record, chunk, 0u))
+        {
+            printf("write failed at %llu\n", (unsigned long long)sent);
+            return 1;
+        }
+        sent += chunk;
+    }
+
+    (void)session_writer_stop();
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (NULL != p_input)
+    {
+        fclose(p_input);
+    }
+
+    session_writer_stats_get(&stats);
+    sec = (double)(end.tv_sec - start.tv_sec) +
+          ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+
+    printf("%u bytes in %u writes, %.3f s, %.2f MB/s\n",
+           stats.written, stats.writes, sec,
+           (double)stats.written / sec / (1024.0 * 1024.0));
+    printf("stored %u bytes, ratio %.3f, %u compressed, %u raw, "
+           "compress max %u us\n",
+           stats.stored, (double)stats.stored /
+           (double)((0u != stats.written) ? stats.written : 1u),
+           stats.lz_blocks, stats.lz_bypass, stats.lz_us_max);
+    printf("write avg %llu us, max %u us, drops %u, errors %u, "
+           "prealloc %u\n",
+           (unsigned long long)(stats.write_us_total /
+                                ((0u != stats.writes) ? stats.writes : 1u)),
+           stats.write_us_max, stats.drops, stats.errors, stats.prealloc);
+    printf("syncs: %u device flushes, %u with directory entry write\n",
+           session_host_flushes, session_host_dir_syncs);
+
+    if (timed && (!bench_timed_check()))
+    {
+        printf("time window check failed\n");
+        return 1;
+    }
+
+    // Power loss in the middle of a data write: torn tail, no index entry.
+    if (session_host_open(SESSION_FILE_DATA, BENCH_DATA_NAME, false))
+    {
+        uint32_t size = session_host_size(SESSION_FILE_DATA);
+
+        (void)session_host_truncate(SESSION_FILE_DATA,
+                                    size - (SESSION_WRITER_BLOCK / 2u));
+        session_host_close(SESSION_FILE_DATA);
+    }
+
+    if (!session_writer_recover(BENCH_DATA_NAME, BENCH_INDEX_NAME, &result))
+    {
+        printf("recover failed\n");
+        return 1;
+    }
+
+    printf("recovered %u entries, %u bytes, %u bytes cut\n",
+           result.entries, result.bytes, result.lost);
+
+    // Time index is written at stop, a session cut short leaves it empty or
+    // missing. Query must fail rather than return a range of the old one.
+    if (timed)
+    {
+        session_range_t range;
+        bool is_found;
+
+        if (session_host_open(SESSION_FILE_TIME, BENCH_TIME_NAME, false))
+        {
+            (void)session_host_truncate(SESSION_FILE_TIME, 0u);
+            session_host_close(SESSION_FILE_TIME);
+        }
+        is_found = session_writer_range_get(BENCH_INDEX_NAME, BENCH_TIME_NAME,
+                                            0u, UINT64_MAX, &range);
+
+        (void)remove(BENCH_TIME_NAME);
+        is_found = session_writer_range_get(BENCH_INDEX_NAME, BENCH_TIME_NAME,
+                                            0u, UINT64_MAX, &range) ||
+                   is_found;
+
+        printf("query without time index: %s\n", is_found ? "found" : "none");
+        if (is_found)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static bool session_host_open(session_file_t file, const char *p_name,
+                              bool create)
+{
+    session_host_file[file] = fopen(p_name, create ? "w+b" : "r+b");
+    session_host_expanded[file] = false;
+    session_host_dirty[file] = false;
+
+    return (NULL != session_host_file[file]);
+}
+
+static bool session_host_expand(session_file_t file, uint32_t size)
+{
+    FILE *p_file = session_host_file[file];
+
+    session_host_expanded[file] =
+        (0 == posix_fallocate(fileno(p_file), 0, (off_t)size));
+    session_host_dirty[file] = true;
+
+    return session_host_expanded[file];
+}
+
+static bool session_host_write(session_file_t file, uint32_t offset,
+                               const void *p_data, uint32_t len)
+{
+    FILE *p_file = session_host_file[file];
+
+    if ((!session_host_expanded[file]) ||
+        (0u != (offset % SESSION_WRITER_BLOCK)) ||
+        (0u != (len % SESSION_WRITER_BLOCK)) ||
+        ((offset + len) > session_host_size(file)))
+    {
+        session_host_dirty[file] = true;
+    }
+
+    return (0 == fseek(p_file, (long)offset, SEEK_SET)) &&
+           (len == fwrite(p_data, 1u, len, p_file));
+}
+
+static bool session_host_sync(session_file_t file)
+{
+    FILE *p_file = session_host_file[file];
+
+    session_host_dir_syncs += session_host_dirty[file];
+    session_host_flushes += !session_host_dirty[file];
+    session_host_dirty[file] = false;
+
+    return (0 == fflush(p_file)) && (0 == fsync(fileno(p_file)));
+}
+
+static bool session_host_read(session_file_t file, uint32_t offset,
+                              void *p_data, uint32_t len)
+{
+    FILE *p_file = session_host_file[file];
+
+    return (0 == fseek(p_file, (long)offset, SEEK_SET)) &&
+           (len == fread(p_data, 1u, len, p_file));
+}
+
+static uint32_t session_host_size(session_file_t file)
+{
+    FILE *p_file = session_host_file[file];
+
+    if (0 != fseek(p_file, 0, SEEK_END))
+    {
+        return 0u;
+    }
+
+    return (uint32_t)ftell(p_file);
+}
+
+static bool session_host_truncate(session_file_t file, uint32_t size)
+{
+    FILE *p_file = session_host_file[file];
+
+    session_host_dirty[file] = true;
+
+    return (0 == fflush(p_file)) &&
+           (0 == ftruncate(fileno(p_file), (off_t)size));
+}
+
+static void session_host_close(session_file_t file)
+{
+    if (NULL != session_host_file[file])
+    {
+        (void)fclose(session_host_file[file]);
+        session_host_file[file] = NULL;
+    }
+}
+
+static uint64_t session_host_free_space(void)
+{
+    struct statvfs fs;
+
+    if (0 != statvfs(".", &fs))
+    {
+        return 0u;
+    }
+
+    return (uint64_t)fs.f_bavail * fs.f_frsize;
+}
+
+#ifdef SESSION_WRITER_BENCH
+static bool bench_timed_write(uint64_t total)
+{
+    static uint8_t out[SESSION_RECORD_SIZE_MAX];
+    session_record_ctx_t ctx;
+    session_record_t rec;
+    uint64_t time_us = BENCH_TIME_START_US;
+    uint32_t key_max = 0u;
+
+    // Same encoder as the writer, keyframes fall on the same records.
+    session_record_init(&ctx);
+    memset(&rec, 0, sizeof(rec));
+    rec.type = SESSION_RECORD_IMU;
+    rec.cnt = 6u;
+
+    for (uint32_t num = 1u; bench_raw_total < total; num++)
+    {
+        uint16_t len;
+
+        for (uint32_t ch = 0u; ch < rec.cnt; ch++)
+        {
+            rec.ch[ch] = (int32_t)((num * ((ch * 7u) + 3u)) % 4001u) - 2000;
+        }
+        rec.time_us = time_us;
+
+        len = session_record_encode(&ctx, &rec, out, sizeof(out));
+        if ((0u == len) || (!session_writer_record_write(&rec, 0u)))
+        {
+            return false;
+        }
+
+        if (len == ctx.key_bytes)
+        {
+            if (key_max == bench_key_cnt)
+            {
+                key_max = (0u != key_max) ? (key_max * 2u) : 1024u;
+                bench_key = realloc(bench_key, key_max * sizeof(bench_key[0]));
+                if (NULL == bench_key)
+                {
+                    return false;
+                }
+            }
+
+            bench_key[bench_key_cnt].time_us = time_us;
+            bench_key[bench_key_cnt].raw_offset = bench_raw_total;
+            bench_key_cnt++;
+        }
+
+        bench_raw_total += len;
+        time_us += BENCH_TIME_STEP_US;
+
+        if (0u == (num % BENCH_TIME_PAUSE_EVERY))
+        {
+            time_us += BENCH_TIME_PAUSE_US;
+        }
+    }
+
+    return true;
+}
+
+static bool bench_range_check(uint64_t from_us, uint64_t to_us)
+{
+    static uint8_t data[SESSION_RECORD_KEY_SIZE_MAX];
+    session_writer_stats_t stats;
+    session_index_entry_t first;
+    session_index_entry_t last;
+    session_record_ctx_t ctx;
+    session_record_t rec;
+    session_range_t range;
+    uint64_t start_us = bench_key[0].time_us;
+    uint64_t from_ms = 0u;
+    uint64_t to_ms = 0u;
+    uint32_t raw_start = bench_key[0].raw_offset;
+    uint32_t raw_end = bench_raw_total;
+    uint32_t key = 0u;
+    bool is_expected = (from_us <= to_us) && (start_us <= to_us);
+    bool is_ok;
+
+    session_writer_stats_get(&stats);
+
+    if (is_expected)
+    {
+        from_ms = (from_us > start_us) ? ((from_us - start_us) / 1000u) : 0u;
+        to_ms = (to_us - start_us) / 1000u;
+    }
+
+    // Keyframes kept in the time index are stride apart from the first one.
+    // Range runs from the last one not after the window start to the first
+    // one after its end.
+    for (uint32_t index = 0u; index < bench_key_cnt; index += stats.time_stride)
+    {
+        uint64_t time_ms = (bench_key[index].time_us - start_us) / 1000u;
+
+        if (time_ms > to_ms)
+        {
+            raw_end = bench_key[index].raw_offset;
+            break;
+        }
+        if (time_ms <= from_ms)
+        {
+            raw_start = bench_key[index].raw_offset;
+            key = index;
+        }
+    }
+
+    if (session_writer_range_get(BENCH_INDEX_NAME, BENCH_TIME_NAME, from_us,
+                                 to_us, &range) != is_expected)
+    {
+        printf("window %llu..%llu: %s\n", (unsigned long long)from_us,
+               (unsigned long long)to_us, is_expected ? "none" : "found");
+        return false;
+    }
+
+    if (!is_expected)
+    {
+        return true;
+    }
+
+    is_ok = ((range.raw_offset + range.raw_skip) == raw_start) &&
+            (range.raw_len == (raw_end - raw_start)) &&
+            (0u < range.entries) &&
+            session_host_open(SESSION_FILE_INDEX, BENCH_INDEX_NAME, false);
+
+    // Writes in range hold both ends, nothing more than block padding.
+    if (is_ok)
+    {
+        is_ok = session_host_read(SESSION_FILE_INDEX,
+                                  range.seq * sizeof(first), &first,
+                                  sizeof(first)) &&
+                session_host_read(SESSION_FILE_INDEX,
+                                  (range.seq + range.entries - 1u) *
+                                  sizeof(last), &last, sizeof(last));
+        session_host_close(SESSION_FILE_INDEX);
+    }
+
+    is_ok = is_ok && (first.seq == range.seq) &&
+            (first.offset == range.offset) &&
+            (first.raw_offset == range.raw_offset) &&
+            (range.raw_skip < first.raw_len) &&
+            (last.raw_offset < raw_end) &&
+            (raw_end <= (last.raw_offset + last.raw_len)) &&
+            ((range.offset + range.len) >= (last.offset + last.len)) &&
+            ((range.offset + range.len) <
+             (last.offset + last.len + SESSION_WRITER_BLOCK));
+
+    // Stored raw, the range decodes from its first byte on.
+    if (is_ok && (first.len == first.raw_len) &&
+        ((range.raw_skip + sizeof(data)) <= first.raw_len))
+    {
+        session_record_init(&ctx);
+
+        is_ok = session_host_open(SESSION_FILE_DATA, BENCH_DATA_NAME, false);
+        if (is_ok)
+        {
+            is_ok = session_host_read(SESSION_FILE_DATA,
+                                      range.offset + range.raw_skip, data,
+                                      sizeof(data));
+            session_host_close(SESSION_FILE_DATA);
+        }
+
+        is_ok = is_ok &&
+                (0 < session_record_decode(&ctx, data, sizeof(data), &rec)) &&
+                (SESSION_RECORD_KEY == rec.type) &&
+                (bench_key[key].time_us == rec.time_us);
+    }
+
+    if (!is_ok)
+    {
+        printf("window %llu..%llu: keyframes %u..%u, range %u+%u raw %u+%u\n",
+               (unsigned long long)from_us, (unsigned long long)to_us,
+               raw_start, raw_end, range.offset, range.len,
+               range.raw_offset + range.raw_skip, range.raw_len);
+    }
+
+    return is_ok;
+}
+
+static bool bench_timed_check(void)
+{
+    session_writer_stats_t stats;
+    uint64_t first_us;
+    uint64_t last_us;
+    uint64_t mid_us;
+    bool is_ok;
+
+    session_writer_stats_get(&stats);
+
+    printf("%u keyframes, %u time points, stride %u\n", bench_key_cnt,
+           stats.time_points, stats.time_stride);
+
+    // Run must have outgrown the time index at least once.
+    is_ok = (1u < stats.time_stride) && (0u == stats.drops) &&
+            (stats.time_points ==
+             ((bench_key_cnt + stats.time_stride - 1u) / stats.time_stride));
+    if (!is_ok)
+    {
+        return false;
+    }
+
+    first_us = bench_key[0].time_us;
+    last_us = bench_key[bench_key_cnt - 1u].time_us;
+    mid_us = first_us + ((last_us - first_us) / 3u);
+
+    const uint64_t window[][2] = {
+        { 0u, UINT64_MAX },                                 // whole session
+        { 0u, first_us - 1u },                              // before it
+        { first_us - 5000000u, first_us + 10000000u },      // its start
+        { mid_us, mid_us },                                 // an instant
+        { mid_us, mid_us + 60000000u },                     // a minute
+        { bench_key[bench_key_cnt / 2u].time_us,            // on a keyframe
+          bench_key[bench_key_cnt / 2u].time_us + 1000u },
+        { last_us - 30000000u, last_us + 3600000000u },     // its end
+        { last_us + 3600000000u, last_us + 7200000000u },   // after it
+        { mid_us + 1000u, mid_us },                         // reversed
+    };
+
+    for (uint32_t index = 0u; index < (sizeof(window) / sizeof(window[0]));
+         index++)
+    {
+        is_ok = bench_range_check(window[index][0], window[index][1]) && is_ok;
+    }
+
+    printf("time windows: %u checked, %s\n",
+           (unsigned)(sizeof(window) / sizeof(window[0])),
+           is_ok ? "ok" : "failed");
+
+    return is_ok;
+}
+#endif
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -54,7 +54,18 @@ void DebugMon_Handler(void);
 void SysTick_Handler(void);
 void OTG_FS_IRQHandler(void);
 void EXTI15_10_IRQHandler(void);
+void DMA1_Channel2_IRQHandler(void);
 void DMA1_Channel3_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void DMA1_Channel6_IRQHandler(void);
+void DMA1_Channel7_IRQHandler(void);
+void DMA2_Channel3_IRQHandler(void);
+void DMA2_Channel5_IRQHandler(void);
+void DMA2_Channel6_IRQHandler(void);
+void DMA2_Channel7_IRQHandler(void);
+void ADC3_IRQHandler(void);
+void LPTIM1_IRQHandler(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,357 @@
+/** @file timestamp.c
+*
+* @brief Monotonic microsecond timestamps from free running TIM2, disciplined
+*        to the RTC second alarm.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/timestamp.h>
+#include <inc/bsp/rtc.h>
+#include <stm32l4xx_hal.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define TIMESTAMP_TIM               TIM2
+#define TIMESTAMP_HZ                (1000000u)
+// Microseconds per timer tick in Q16.
+#define TIMESTAMP_RATE_SHIFT        (16u)
+#define TIMESTAMP_RATE_ONE          (1u << TIMESTAMP_RATE_SHIFT)
+
+// Larger difference to RTC is stepped out instead of slewed, e.g. after
+// timer was stopped in STOP mode.
+#define TIMESTAMP_STEP_US           (10000)
+// Slew limit per second, 500 ppm.
+#define TIMESTAMP_SLEW_MAX_US       (500)
+// Ticks per second outside this range do not give a rate estimate.
+#define TIMESTAMP_TICKS_TOL         (10000u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef struct {
+    uint64_t base_us;                               // Monotonic time at base_cnt.
+    uint32_t base_cnt;                              // Timer count at last RTC second.
+    uint32_t rate;                                  // Microseconds per tick, Q16.
+    int32_t unix_sec;                               // Wall clock second at base_cnt.
+} timestamp_slot_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Copy active slot and timer count consistently.
+ * @param p_slot output slot
+ * @return timer count
+ */
+static uint32_t timestamp_snapshot(timestamp_slot_t *p_slot);
+
+/**
+ * @brief Microseconds since slot base.
+ * @param p_slot slot
+ * @param cnt timer count
+ * @return elapsed microseconds
+ */
+static uint64_t timestamp_elapsed(const timestamp_slot_t *p_slot, uint32_t cnt);
+
+/**
+ * @brief Make next slot active.
+ */
+static void timestamp_publish(void);
+
+/**
+ * @brief Timer prescaler for 1 MHz at current APB1 clock.
+ */
+static uint32_t timestamp_prescaler(void);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+static TIM_HandleTypeDef timestamp_tim;
+
+// Written by RTC alarm ISR, or by task with interrupts off. Readers copy the
+// active slot, writer only touches the other one. Publish count selects the
+// active slot with its low bit and tells readers a slot was rewritten: two
+// publishes while copying bring the same slot back but not the same count.
+static timestamp_slot_t timestamp_slot[2];
+static volatile uint32_t timestamp_seq;
+static volatile bool timestamp_started;
+
+// RTC alarm ISR only.
+static uint64_t timestamp_ref_us;                   // RTC time of last second.
+static uint32_t timestamp_prev_cnt;
+static bool timestamp_ref_valid;
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void bsp_timestamp_init(void)
+{
+    rtc_data_t rtc_data = { 0 };
+
+    __HAL_RCC_TIM2_CLK_ENABLE();
+
+    timestamp_tim.Instance = TIMESTAMP_TIM;
+    timestamp_tim.Init.Prescaler = timestamp_prescaler();
+    timestamp_tim.Init.CounterMode = TIM_COUNTERMODE_UP;
+    timestamp_tim.Init.Period = 0xFFFFFFFFu;
+    timestamp_tim.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    timestamp_tim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+    HAL_TIM_Base_Init(&timestamp_tim);
+    HAL_TIM_Base_Start(&timestamp_tim);
+
+    bsp_rtc_data_get(&rtc_data);
+
+    // Slot base is the start of current RTC second.
+    timestamp_slot[0].base_us = (uint64_t)rtc_data.milisecs * 1000u;
+    timestamp_slot[0].base_cnt = TIMESTAMP_TIM->CNT -
+                                 ((uint32_t)rtc_data.milisecs * 1000u);
+    timestamp_slot[0].rate = TIMESTAMP_RATE_ONE;
+    timestamp_slot[0].unix_sec = bsp_get_unix_timestamp(&rtc_data);
+
+    timestamp_ref_valid = false;
+    timestamp_seq = 0u;
+    timestamp_started = true;
+}
+
+uint64_t bsp_timestamp_now(void)
+{
+    timestamp_slot_t slot;
+    uint32_t cnt = timestamp_snapshot(&slot);
+
+    return slot.base_us + timestamp_elapsed(&slot, cnt);
+}
+
+bool bsp_timestamp_unix_get(int32_t *p_unix_timestamp, uint16_t *p_milisec)
+{
+    timestamp_slot_t slot;
+    uint32_t cnt = timestamp_snapshot(&slot);
+    uint32_t us = (uint32_t)timestamp_elapsed(&slot, cnt);
+    int32_t sec = slot.unix_sec;
+
+    // Normally within the second, more only while alarm is held off.
+    while (TIMESTAMP_HZ <= us)
+    {
+        us -= TIMESTAMP_HZ;
+        sec++;
+    }
+
+    *p_unix_timestamp = sec;
+    *p_milisec = (uint16_t)(us / 1000u);
+
+    return timestamp_started;
+}
+
+bool bsp_timestamp_to_unix(uint64_t time_us, int32_t *p_unix_timestamp,
+                           uint32_t *p_us)
+{
+    timestamp_slot_t slot;
+    int64_t us;
+    int32_t sec;
+
+    (void)timestamp_snapshot(&slot);
+
+    us = (int64_t)(time_us - slot.base_us);
+    sec = slot.unix_sec + (int32_t)(us / TIMESTAMP_HZ);
+    us %= TIMESTAMP_HZ;
+    if (0 > us)
+    {
+        us += TIMESTAMP_HZ;
+        sec--;
+    }
+
+    *p_unix_timestamp = sec;
+    *p_us = (uint32_t)us;
+
+    return timestamp_started;
+}
+
+void bsp_timestamp_unix_set(int32_t unix_timestamp)
+{
+    if (timestamp_started)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        uint32_t active = timestamp_seq & 1u;
+        const timestamp_slot_t *p_cur = &timestamp_slot[active];
+        timestamp_slot_t *p_next = &timestamp_slot[active ^ 1u];
+        uint32_t cnt = TIMESTAMP_TIM->CNT;
+
+        // RTC second restarts when time is set.
+        p_next->base_us = p_cur->base_us + timestamp_elapsed(p_cur, cnt);
+        p_next->base_cnt = cnt;
+        p_next->rate = p_cur->rate;
+        p_next->unix_sec = unix_timestamp;
+        timestamp_publish();
+
+        __set_PRIMASK(primask);
+    }
+}
+
+void bsp_timestamp_stop_compensate(uint32_t slept_us)
+{
+    if (timestamp_started)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        uint32_t active = timestamp_seq & 1u;
+        const timestamp_slot_t *p_cur = &timestamp_slot[active];
+        timestamp_slot_t *p_next = &timestamp_slot[active ^ 1u];
+        uint32_t ticks = (uint32_t)(((uint64_t)slept_us <<
+                                     TIMESTAMP_RATE_SHIFT) / p_cur->rate);
+
+        // Timer counts as if it kept running, next RTC second sees a
+        // normal tick count for the rate estimate.
+        *p_next = *p_cur;
+        p_next->base_cnt -= ticks;
+        timestamp_prev_cnt -= ticks;
+        timestamp_publish();
+
+        __set_PRIMASK(primask);
+    }
+}
+
+void bsp_timestamp_clock_update(void)
+{
+    if (timestamp_started)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        uint32_t active = timestamp_seq & 1u;
+        const timestamp_slot_t *p_cur = &timestamp_slot[active];
+        timestamp_slot_t *p_next = &timestamp_slot[active ^ 1u];
+
+        // Prescaler is loaded by update event, which also clears the counter.
+        timestamp_tim.Init.Prescaler = timestamp_prescaler();
+        TIMESTAMP_TIM->PSC = timestamp_tim.Init.Prescaler;
+
+        uint32_t cnt = TIMESTAMP_TIM->CNT;
+        TIMESTAMP_TIM->EGR = TIM_EGR_UG;
+
+        // Same time base, counted from zero.
+        *p_next = *p_cur;
+        p_next->base_cnt -= cnt;
+        timestamp_prev_cnt -= cnt;
+        timestamp_publish();
+
+        __set_PRIMASK(primask);
+    }
+}
+
+void bsp_timestamp_rtc_second(void)
+{
+    if (!timestamp_started)
+    {
+        return;
+    }
+
+    uint32_t active = timestamp_seq & 1u;
+    const timestamp_slot_t *p_cur = &timestamp_slot[active];
+    timestamp_slot_t *p_next = &timestamp_slot[active ^ 1u];
+    uint32_t cnt = TIMESTAMP_TIM->CNT;
+    uint32_t ticks = cnt - timestamp_prev_cnt;
+    uint64_t now_us = p_cur->base_us + timestamp_elapsed(p_cur, cnt);
+
+    p_next->base_us = now_us;
+    p_next->base_cnt = cnt;
+    p_next->rate = p_cur->rate;
+    p_next->unix_sec = p_cur->unix_sec + 1;
+
+    if (timestamp_ref_valid)
+    {
+        int64_t err;
+
+        timestamp_ref_us += TIMESTAMP_HZ;
+        err = (int64_t)(timestamp_ref_us - now_us);
+
+        if (TIMESTAMP_STEP_US < err)
+        {
+            // Timer lost time, step forward keeps it monotonic.
+            p_next->base_us = timestamp_ref_us;
+            err = 0;
+        }
+        else if (-TIMESTAMP_STEP_US > err)
+        {
+            // Alarm was missed, follow timer instead of going back.
+            timestamp_ref_us = now_us;
+            err = 0;
+        }
+        else if (TIMESTAMP_SLEW_MAX_US < err)
+        {
+            err = TIMESTAMP_SLEW_MAX_US;
+        }
+        else if (-TIMESTAMP_SLEW_MAX_US > err)
+        {
+            err = -TIMESTAMP_SLEW_MAX_US;
+        }
+
+        if ((TIMESTAMP_HZ - TIMESTAMP_TICKS_TOL < ticks) &&
+            (TIMESTAMP_HZ + TIMESTAMP_TICKS_TOL > ticks))
+        {
+            // Next second spans about as many ticks as the last one and
+            // should advance one second plus remaining error.
+            p_next->rate = (uint32_t)(((uint64_t)((int64_t)TIMESTAMP_HZ + err) <<
+                                       TIMESTAMP_RATE_SHIFT) / ticks);
+        }
+    }
+    else
+    {
+        timestamp_ref_us = now_us;
+        timestamp_ref_valid = true;
+    }
+
+    timestamp_prev_cnt = cnt;
+    timestamp_publish();
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static uint32_t timestamp_snapshot(timestamp_slot_t *p_slot)
+{
+    uint32_t seq;
+    uint32_t cnt;
+
+    // Retry only if the writer published meanwhile, never spins on a writer
+    // this context preempted.
+    do
+    {
+        seq = timestamp_seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        *p_slot = timestamp_slot[seq & 1u];
+        cnt = TIMESTAMP_TIM->CNT;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != timestamp_seq);
+
+    return cnt;
+}
+
+static uint64_t timestamp_elapsed(const timestamp_slot_t *p_slot, uint32_t cnt)
+{
+    return ((uint64_t)(cnt - p_slot->base_cnt) * p_slot->rate) >>
+           TIMESTAMP_RATE_SHIFT;
+}
+
+static void timestamp_publish(void)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    timestamp_seq = timestamp_seq + 1u;
+}
+
+static uint32_t timestamp_prescaler(void)
+{
+    uint32_t tim_clk = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at double PCLK1 once APB1 is divided.
+    if (0u != (RCC->CFGR & RCC_CFGR_PPRE1_2))
+    {
+        tim_clk *= 2u;
+    }
+
+    return (tim_clk / TIMESTAMP_HZ) - 1u;
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,86 @@
+/** @file timestamp.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __BSP_TIMESTAMP_H__
+#define __BSP_TIMESTAMP_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+
+//----------------------------- DATA TYPES ------------------------------------
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief Start free running microsecond timer and align it with RTC time.
+ *      Call after bsp_rtc_init.
+ */
+void bsp_timestamp_init(void);
+
+/**
+ * @brief Get monotonic time since bsp_timestamp_init. Lock free, callable
+ *      from any task or ISR.
+ * @return Time in microseconds.
+ */
+uint64_t bsp_timestamp_now(void);
+
+/**
+ * @brief Get wall clock time, without reading RTC registers.
+ * @param p_unix_timestamp output, unix time in seconds.
+ * @param p_milisec output, milliseconds within the second.
+ * @return false if service is not started.
+ */
+bool bsp_timestamp_unix_get(int32_t *p_unix_timestamp, uint16_t *p_milisec);
+
+/**
+ * @brief Convert recent monotonic time, e.g. a captured bsp_timestamp_now,
+ *      to wall clock time.
+ * @param time_us monotonic time in microseconds.
+ * @param p_unix_timestamp output, unix time in seconds.
+ * @param p_us output, microseconds within the second.
+ * @return false if service is not started.
+ */
+bool bsp_timestamp_to_unix(uint64_t time_us, int32_t *p_unix_timestamp,
+                           uint32_t *p_us);
+
+/**
+ * @brief Restart wall clock at the beginning of given second, used when RTC
+ *      date and time is set. Monotonic time is not affected.
+ * @param unix_timestamp new unix time.
+ */
+void bsp_timestamp_unix_set(int32_t unix_timestamp);
+
+/**
+ * @brief Add time the timer was stopped in STOP2.
+ * @param slept_us time spent in STOP2, measured on a low power clock.
+ */
+void bsp_timestamp_stop_compensate(uint32_t slept_us);
+
+/**
+ * @brief Keep timer at 1 MHz after system clock changed. Call with
+ *      SystemCoreClock already updated.
+ */
+void bsp_timestamp_clock_update(void);
+
+/**
+ * @brief Discipline timer to RTC. Called from RTC second alarm.
+ */
+void bsp_timestamp_rtc_second(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BSP_TIMESTAMP_H__
@@ -0,0 +1,343 @@
+/** @file ubx.c
+*
+* @brief u-blox UBX binary protocol frame encoder and streaming decoder.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/ubx.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define UBX_SYNC_1              (0xB5u)
+#define UBX_SYNC_2              (0x62u)
+
+// CFG-PRT fields.
+#define UBX_PRT_PORT_UART1      (1u)
+#define UBX_PRT_MODE_8N1        (0x000008D0u)
+#define UBX_PRT_PROTO_UBX       (0x0001u)
+#define UBX_PRT_PROTO_NMEA      (0x0002u)
+
+// CFG-RATE time reference.
+#define UBX_RATE_TIME_REF_GPS   (1u)
+
+//----------------------------- DATA TYPES ------------------------------------
+typedef enum {
+    UBX_STATE_SYNC_1 = 0,
+    UBX_STATE_SYNC_2,
+    UBX_STATE_CLASS,
+    UBX_STATE_ID,
+    UBX_STATE_LEN_LO,
+    UBX_STATE_LEN_HI,
+    UBX_STATE_PAYLOAD,
+    UBX_STATE_CK_A,
+    UBX_STATE_CK_B,
+} ubx_state_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+
+/**
+ * @brief Handle one byte.
+ */
+static void ubx_byte(ubx_decoder_t *p_decoder, uint8_t c);
+
+/**
+ * @brief Add byte to running checksum.
+ */
+static void ubx_ck_add(ubx_decoder_t *p_decoder, uint8_t c);
+
+static void ubx_put_u16(uint8_t *p_buf, uint16_t value);
+static void ubx_put_u32(uint8_t *p_buf, uint32_t value);
+static uint16_t ubx_get_u16(const uint8_t *p_buf);
+static uint32_t ubx_get_u32(const uint8_t *p_buf);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+void ubx_checksum(const uint8_t *p_data, size_t len, uint8_t *p_ck_a,
+                  uint8_t *p_ck_b)
+{
+    uint8_t ck_a = 0u;
+    uint8_t ck_b = 0u;
+
+    for (size_t index = 0u; index < len; index++)
+    {
+        ck_a += p_data[index];
+        ck_b += ck_a;
+    }
+
+    *p_ck_a = ck_a;
+    *p_ck_b = ck_b;
+}
+
+size_t ubx_frame_encode(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                        uint16_t len, uint8_t *p_buf, size_t size)
+{
+    size_t frame_len = (size_t)len + UBX_FRAME_OVERHEAD;
+
+    if ((NULL == p_buf) || (size < frame_len) ||
+        ((NULL == p_payload) && (0u < len)))
+    {
+        return 0u;
+    }
+
+    p_buf[0] = UBX_SYNC_1;
+    p_buf[1] = UBX_SYNC_2;
+    p_buf[2] = cls;
+    p_buf[3] = id;
+    ubx_put_u16(&p_buf[4], len);
+    if (0u < len)
+    {
+        memmove(&p_buf[6], p_payload, len);
+    }
+
+    ubx_checksum(&p_buf[2], (size_t)len + 4u, &p_buf[frame_len - 2u],
+                 &p_buf[frame_len - 1u]);
+
+    return frame_len;
+}
+
+size_t ubx_cfg_prt_encode(uint32_t baud, uint8_t *p_buf, size_t size)
+{
+    uint8_t payload[20u] = { 0u };
+
+    payload[0] = UBX_PRT_PORT_UART1;
+    ubx_put_u32(&payload[4], UBX_PRT_MODE_8N1);
+    ubx_put_u32(&payload[8], baud);
+    ubx_put_u16(&payload[12], UBX_PRT_PROTO_UBX | UBX_PRT_PROTO_NMEA);
+    ubx_put_u16(&payload[14], UBX_PRT_PROTO_UBX);
+
+    return ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_PRT, payload,
+                            sizeof(payload), p_buf, size);
+}
+
+size_t ubx_cfg_msg_encode(uint8_t cls, uint8_t id, uint8_t rate,
+                          uint8_t *p_buf, size_t size)
+{
+    const uint8_t payload[3u] = { cls, id, rate };
+
+    return ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_MSG, payload,
+                            sizeof(payload), p_buf, size);
+}
+
+size_t ubx_cfg_rate_encode(uint16_t meas_ms, uint8_t *p_buf, size_t size)
+{
+    uint8_t payload[6u];
+
+    ubx_put_u16(&payload[0], meas_ms);
+    ubx_put_u16(&payload[2], 1u);
+    ubx_put_u16(&payload[4], UBX_RATE_TIME_REF_GPS);
+
+    return ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_RATE, payload,
+                            sizeof(payload), p_buf, size);
+}
+
+void ubx_decoder_init(ubx_decoder_t *p_decoder, ubx_frame_cb_t cb, void *p_ctx)
+{
+    memset(p_decoder, 0, sizeof(ubx_decoder_t));
+    p_decoder->cb = cb;
+    p_decoder->p_ctx = p_ctx;
+}
+
+void ubx_decode(ubx_decoder_t *p_decoder, const volatile uint8_t *p_data,
+                size_t len)
+{
+    for (size_t index = 0u; index < len; index++)
+    {
+        ubx_byte(p_decoder, p_data[index]);
+    }
+}
+
+void ubx_stats_get(const ubx_decoder_t *p_decoder, ubx_stats_t *p_stats)
+{
+    *p_stats = p_decoder->stats;
+}
+
+bool ubx_nav_pvt_decode(const uint8_t *p_payload, uint16_t len,
+                        ubx_nav_pvt_t *p_pvt)
+{
+    if (UBX_NAV_PVT_LEN > len)
+    {
+        return false;
+    }
+
+    p_pvt->itow_ms = ubx_get_u32(&p_payload[0]);
+    p_pvt->year = ubx_get_u16(&p_payload[4]);
+    p_pvt->month = p_payload[6];
+    p_pvt->day = p_payload[7];
+    p_pvt->hour = p_payload[8];
+    p_pvt->min = p_payload[9];
+    p_pvt->sec = p_payload[10];
+    p_pvt->valid = p_payload[11];
+    p_pvt->t_acc_ns = ubx_get_u32(&p_payload[12]);
+    p_pvt->nano = (int32_t)ubx_get_u32(&p_payload[16]);
+    p_pvt->fix_type = p_payload[20];
+    p_pvt->flags = p_payload[21];
+    p_pvt->num_sv = p_payload[23];
+    p_pvt->lon_e7 = (int32_t)ubx_get_u32(&p_payload[24]);
+    p_pvt->lat_e7 = (int32_t)ubx_get_u32(&p_payload[28]);
+    p_pvt->height_mm = (int32_t)ubx_get_u32(&p_payload[32]);
+    p_pvt->hmsl_mm = (int32_t)ubx_get_u32(&p_payload[36]);
+    p_pvt->h_acc_mm = ubx_get_u32(&p_payload[40]);
+    p_pvt->v_acc_mm = ubx_get_u32(&p_payload[44]);
+    p_pvt->vel_n_mmps = (int32_t)ubx_get_u32(&p_payload[48]);
+    p_pvt->vel_e_mmps = (int32_t)ubx_get_u32(&p_payload[52]);
+    p_pvt->vel_d_mmps = (int32_t)ubx_get_u32(&p_payload[56]);
+    p_pvt->g_speed_mmps = (int32_t)ubx_get_u32(&p_payload[60]);
+    p_pvt->head_mot_e5 = (int32_t)ubx_get_u32(&p_payload[64]);
+    p_pvt->s_acc_mmps = ubx_get_u32(&p_payload[68]);
+    p_pvt->head_acc_e5 = ubx_get_u32(&p_payload[72]);
+    p_pvt->pdop_c = ubx_get_u16(&p_payload[76]);
+
+    return true;
+}
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static void ubx_byte(ubx_decoder_t *p_decoder, uint8_t c)
+{
+    switch (p_decoder->state)
+    {
+        case UBX_STATE_SYNC_1:
+            if (UBX_SYNC_1 == c)
+            {
+                p_decoder->state = UBX_STATE_SYNC_2;
+            }
+            break;
+
+        case UBX_STATE_SYNC_2:
+            if (UBX_SYNC_2 == c)
+            {
+                p_decoder->ck_a = 0u;
+                p_decoder->ck_b = 0u;
+                p_decoder->state = UBX_STATE_CLASS;
+            }
+            else if (UBX_SYNC_1 != c)
+            {
+                p_decoder->state = UBX_STATE_SYNC_1;
+            }
+            break;
+
+        case UBX_STATE_CLASS:
+            ubx_ck_add(p_decoder, c);
+            p_decoder->cls = c;
+            p_decoder->state = UBX_STATE_ID;
+            break;
+
+        case UBX_STATE_ID:
+            ubx_ck_add(p_decoder, c);
+            p_decoder->id = c;
+            p_decoder->state = UBX_STATE_LEN_LO;
+            break;
+
+        case UBX_STATE_LEN_LO:
+            ubx_ck_add(p_decoder, c);
+            p_decoder->len = c;
+            p_decoder->state = UBX_STATE_LEN_HI;
+            break;
+
+        case UBX_STATE_LEN_HI:
+            ubx_ck_add(p_decoder, c);
+            p_decoder->len |= (uint16_t)((uint16_t)c << 8);
+            p_decoder->index = 0u;
+
+            if (UBX_PAYLOAD_MAX < p_decoder->len)
+            {
+                // Not a frame of interest or false sync, resync.
+                p_decoder->stats.oversize++;
+                p_decoder->state = UBX_STATE_SYNC_1;
+            }
+            else
+            {
+                p_decoder->state = (0u < p_decoder->len) ? UBX_STATE_PAYLOAD :
+                                                           UBX_STATE_CK_A;
+            }
+            break;
+
+        case UBX_STATE_PAYLOAD:
+            ubx_ck_add(p_decoder, c);
+            p_decoder->payload[p_decoder->index] = c;
+            p_decoder->index++;
+
+            if (p_decoder->len <= p_decoder->index)
+            {
+                p_decoder->state = UBX_STATE_CK_A;
+            }
+            break;
+
+        case UBX_STATE_CK_A:
+            if (p_decoder->ck_a == c)
+            {
+                p_decoder->state = UBX_STATE_CK_B;
+            }
+            else
+            {
+                p_decoder->stats.checksum_errors++;
+                p_decoder->state = UBX_STATE_SYNC_1;
+            }
+            break;
+
+        case UBX_STATE_CK_B:
+            p_decoder->state = UBX_STATE_SYNC_1;
+
+            if (p_decoder->ck_b == c)
+            {
+                p_decoder->stats.frames++;
+
+                if (NULL != p_decoder->cb)
+                {
+                    p_decoder->cb(p_decoder->cls, p_decoder->id,
+                                  p_decoder->payload, p_decoder->len,
+                                  p_decoder->p_ctx);
+                }
+            }
+            else
+            {
+                p_decoder->stats.checksum_errors++;
+            }
+            break;
+
+        default:
+            p_decoder->state = UBX_STATE_SYNC_1;
+            break;
+    }
+}
+
+static void ubx_ck_add(ubx_decoder_t *p_decoder, uint8_t c)
+{
+    p_decoder->ck_a += c;
+    p_decoder->ck_b += p_decoder->ck_a;
+}
+
+static void ubx_put_u16(uint8_t *p_buf, uint16_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+}
+
+static void ubx_put_u32(uint8_t *p_buf, uint32_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    p_buf[2] = (uint8_t)(value >> 16);
+    p_buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint16_t ubx_get_u16(const uint8_t *p_buf)
+{
+    return (uint16_t)(p_buf[0] | ((uint16_t)p_buf[1] << 8));
+}
+
+static uint32_t ubx_get_u32(const uint8_t *p_buf)
+{
+    return (uint32_t)p_buf[0] | ((uint32_t)p_buf[1] << 8) |
+           ((uint32_t)p_buf[2] << 16) | ((uint32_t)p_buf[3] << 24);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
@@ -0,0 +1,200 @@
+/** @file ubx.h
+*
+* @brief See source file.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+#ifndef __UBX_H__
+#define __UBX_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------ INCLUDES -------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//-------------------------- CONSTANTS & MACROS -------------------------------
+/// Sync chars, class, id, length and checksum around the payload.
+#define UBX_FRAME_OVERHEAD      (8u)
+/// Largest payload received, NAV-PVT is 92 bytes.
+#define UBX_PAYLOAD_MAX         (100u)
+
+#define UBX_CLASS_NAV           (0x01u)
+#define UBX_CLASS_ACK           (0x05u)
+#define UBX_CLASS_CFG           (0x06u)
+#define UBX_CLASS_NMEA          (0xF0u)
+
+#define UBX_ID_NAV_PVT          (0x07u)
+#define UBX_ID_ACK_NAK          (0x00u)
+#define UBX_ID_ACK_ACK          (0x01u)
+#define UBX_ID_CFG_PRT          (0x00u)
+#define UBX_ID_CFG_MSG          (0x01u)
+#define UBX_ID_CFG_RATE         (0x08u)
+
+#define UBX_NAV_PVT_LEN         (92u)
+
+/// Frame sizes of the configuration messages.
+#define UBX_CFG_PRT_FRAME_LEN   (UBX_FRAME_OVERHEAD + 20u)
+#define UBX_CFG_MSG_FRAME_LEN   (UBX_FRAME_OVERHEAD + 3u)
+#define UBX_CFG_RATE_FRAME_LEN  (UBX_FRAME_OVERHEAD + 6u)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// NAV-PVT, units as sent by the receiver.
+typedef struct {
+    uint32_t itow_ms;                               // GPS time of week.
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t valid;                                  // Date/time validity flags.
+    uint32_t t_acc_ns;
+    int32_t nano;                                   // Fraction of second, ns.
+    uint8_t fix_type;                               // 0 none, 2 2D, 3 3D...
+    uint8_t flags;                                  // Bit 0 gnssFixOK.
+    uint8_t num_sv;
+    int32_t lon_e7;
+    int32_t lat_e7;
+    int32_t height_mm;                              // Above ellipsoid.
+    int32_t hmsl_mm;                                // Above mean sea level.
+    uint32_t h_acc_mm;
+    uint32_t v_acc_mm;
+    int32_t vel_n_mmps;
+    int32_t vel_e_mmps;
+    int32_t vel_d_mmps;
+    int32_t g_speed_mmps;                           // Ground speed.
+    int32_t head_mot_e5;                            // Heading of motion, deg * 1e5.
+    uint32_t s_acc_mmps;
+    uint32_t head_acc_e5;
+    uint16_t pdop_c;                                // PDOP * 100.
+} ubx_nav_pvt_t;
+
+typedef struct {
+    uint32_t frames;                                // Frames with valid checksum.
+    uint32_t checksum_errors;
+    uint32_t oversize;                              // Payload over UBX_PAYLOAD_MAX.
+} ubx_stats_t;
+
+/**
+ * @brief Called for every frame with valid checksum.
+ */
+typedef void (*ubx_frame_cb_t)(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                               uint16_t len, void *p_ctx);
+
+/// Decoder state, contents are private.
+typedef struct {
+    uint8_t state;
+    uint8_t cls;
+    uint8_t id;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    uint16_t len;
+    uint16_t index;
+    uint8_t payload[UBX_PAYLOAD_MAX];
+    ubx_frame_cb_t cb;
+    void *p_ctx;
+    ubx_stats_t stats;
+} ubx_decoder_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES ---------------------------
+/**
+ * @brief 8-bit Fletcher checksum of UBX frames.
+ * @param p_data class, id, length and payload.
+ * @param len number of bytes.
+ * @param p_ck_a output, CK_A.
+ * @param p_ck_b output, CK_B.
+ */
+void ubx_checksum(const uint8_t *p_data, size_t len, uint8_t *p_ck_a,
+                  uint8_t *p_ck_b);
+
+/**
+ * @brief Encode frame.
+ * @param cls message class.
+ * @param id message id.
+ * @param p_payload payload, may be NULL if len is 0.
+ * @param len payload length.
+ * @param p_buf output.
+ * @param size output size.
+ * @return Frame length, 0 if it does not fit.
+ */
+size_t ubx_frame_encode(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                        uint16_t len, uint8_t *p_buf, size_t size);
+
+/**
+ * @brief Encode CFG-PRT for UART1 8N1, UBX and NMEA in, UBX only out.
+ * @param baud new baud rate, applied by the receiver after the frame.
+ * @param p_buf output, UBX_CFG_PRT_FRAME_LEN bytes.
+ * @param size output size.
+ * @return Frame length, 0 if it does not fit.
+ */
+size_t ubx_cfg_prt_encode(uint32_t baud, uint8_t *p_buf, size_t size);
+
+/**
+ * @brief Encode CFG-MSG setting output rate of a message on current port.
+ * @param cls message class.
+ * @param id message id.
+ * @param rate one message per rate navigation solutions, 0 disables.
+ * @param p_buf output, UBX_CFG_MSG_FRAME_LEN bytes.
+ * @param size output size.
+ * @return Frame length, 0 if it does not fit.
+ */
+size_t ubx_cfg_msg_encode(uint8_t cls, uint8_t id, uint8_t rate,
+                          uint8_t *p_buf, size_t size);
+
+/**
+ * @brief Encode CFG-RATE, one navigation solution per measurement.
+ * @param meas_ms measurement period.
+ * @param p_buf output, UBX_CFG_RATE_FRAME_LEN bytes.
+ * @param size output size.
+ * @return Frame length, 0 if it does not fit.
+ */
+size_t ubx_cfg_rate_encode(uint16_t meas_ms, uint8_t *p_buf, size_t size);
+
+/**
+ * @brief Reset decoder.
+ * @param p_decoder decoder.
+ * @param cb frame callback, called from ubx_decode.
+ * @param p_ctx callback context.
+ */
+void ubx_decoder_init(ubx_decoder_t *p_decoder, ubx_frame_cb_t cb, void *p_ctx);
+
+/**
+ * @brief Feed received bytes. Frames may be split across calls at any byte,
+ *      bytes outside frames (e.g. NMEA) are skipped.
+ * @param p_decoder decoder.
+ * @param p_data received bytes, e.g. a DMA RX span.
+ * @param len number of bytes.
+ */
+void ubx_decode(ubx_decoder_t *p_decoder, const volatile uint8_t *p_data,
+                size_t len);
+
+/**
+ * @brief Get decoder statistics.
+ * @param p_decoder decoder.
+ * @param p_stats output.
+ */
+void ubx_stats_get(const ubx_decoder_t *p_decoder, ubx_stats_t *p_stats);
+
+/**
+ * @brief Decode NAV-PVT payload.
+ * @param p_payload payload.
+ * @param len payload length.
+ * @param p_pvt output.
+ * @return false if payload is too short.
+ */
+bool ubx_nav_pvt_decode(const uint8_t *p_payload, uint16_t len,
+                        ubx_nav_pvt_t *p_pvt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__UBX_H__
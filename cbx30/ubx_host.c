@@ -0,0 +1,418 @@
+/** @file ubx_host.c
+*
+* @brief Host check of the UBX encoder and streaming decoder. Encoded CFG
+*        frames are compared with the bytes the receiver documentation gives
+*        for them, and a receiver stream (NMEA before the switch, a stray
+*        sync char, ACK, NAV-PVT, ACK-NAK) is fed split at every chunk size.
+*        Corrupted and oversize frames must be counted and dropped without
+*        losing the frame that follows them.
+*
+*        gcc -DUBX_HOST -Ihost -I. ubx.c ubx_host.c -o ubx
+*        ./ubx [capture.ubx]
+*
+*        With a raw receiver capture (e.g. a u-center .ubx log) the file is
+*        decoded in DMA span sized chunks instead, NAV-PVT rows are printed
+*        as "tow_ms,fix,sv,lat_e7,lon_e7,hmsl_mm,speed_mmps" and frame
+*        statistics go to stderr.
+*
+* @par
+* COPYRIGHT NOTICE: (c) 2019 Byte Lab Grupa d.o.o.
+* All rights reserved.
+*/
+
+//------------------------------ INCLUDES -------------------------------------
+#include <inc/bsp/ubx.h>
+#include <stdio.h>
+#include <string.h>
+
+//-------------------------------- MACROS -------------------------------------
+#define HOST_CHUNK                  (64u)
+#define HOST_FRAMES_MAX             (8u)
+
+#define HOST_CHECK(cond)            do { if (!(cond)) { \
+                                        host_fail(__LINE__, #cond); \
+                                        return false; } } while (0)
+
+//----------------------------- DATA TYPES ------------------------------------
+
+/// Frame as seen by the decoder callback.
+typedef struct {
+    uint8_t cls;
+    uint8_t id;
+    uint16_t len;
+    uint8_t payload[UBX_PAYLOAD_MAX];
+} host_frame_t;
+
+typedef struct {
+    host_frame_t frame[HOST_FRAMES_MAX];
+    uint32_t cnt;
+} host_rx_t;
+
+//--------------------- PRIVATE FUNCTION PROTOTYPES ---------------------------
+static bool test_encode(void);
+static bool test_stream(void);
+static bool test_corrupt(void);
+static bool test_round_trip(void);
+static bool host_replay(const char *p_path);
+static void host_decode(ubx_decoder_t *p_decoder, const uint8_t *p_data,
+                        size_t len, size_t chunk);
+static void host_frame(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                       uint16_t len, void *p_ctx);
+static void host_pvt_print(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                           uint16_t len, void *p_ctx);
+static void host_fail(int line, const char *p_cond);
+
+//----------------------- STATIC DATA & CONSTANTS -----------------------------
+
+// CFG-RATE 1000 ms, one solution per measurement, GPS time.
+static const uint8_t host_cfg_rate[] = {
+    0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xE8, 0x03, 0x01, 0x00, 0x01, 0x00,
+    0x01, 0x39,
+};
+
+// CFG-MSG NAV-PVT on every solution.
+static const uint8_t host_cfg_msg[] = {
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x07, 0x01, 0x13, 0x51,
+};
+
+// CFG-PRT UART1 115200 8N1, UBX and NMEA in, UBX out.
+static const uint8_t host_cfg_prt[] = {
+    0xB5, 0x62, 0x06, 0x00, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00, 0xD0, 0x08,
+    0x00, 0x00, 0x00, 0xC2, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xBA, 0x52,
+};
+
+// Receiver output around the switch to UBX. Offsets of the frames are used
+// by the corruption tests.
+#define HOST_STREAM_ACK             (78u)
+#define HOST_STREAM_PVT             (88u)
+#define HOST_STREAM_NAK             (188u)
+static const uint8_t host_stream[] = {
+    // $GNRMC,120448.00,A,4548.90426,N,01558.79538,E,0.674,281.23,140619,,,A*72
+    0x24, 0x47, 0x4E, 0x52, 0x4D, 0x43, 0x2C, 0x31, 0x32, 0x30, 0x34, 0x34,
+    0x38, 0x2E, 0x30, 0x30, 0x2C, 0x41, 0x2C, 0x34, 0x35, 0x34, 0x38, 0x2E,
+    0x39, 0x30, 0x34, 0x32, 0x36, 0x2C, 0x4E, 0x2C, 0x30, 0x31, 0x35, 0x35,
+    0x38, 0x2E, 0x37, 0x39, 0x35, 0x33, 0x38, 0x2C, 0x45, 0x2C, 0x30, 0x2E,
+    0x36, 0x37, 0x34, 0x2C, 0x32, 0x38, 0x31, 0x2E, 0x32, 0x33, 0x2C, 0x31,
+    0x34, 0x30, 0x36, 0x31, 0x39, 0x2C, 0x2C, 0x2C, 0x41, 0x2A, 0x37, 0x32,
+    0x0D, 0x0A,
+    // Line noise while the baud changes, ends in a false first sync char.
+    0x00, 0xF8, 0x80, 0xB5,
+    // ACK-ACK for CFG-MSG.
+    0xB5, 0x62, 0x05, 0x01, 0x02, 0x00, 0x06, 0x01, 0x0F, 0x38,
+    // NAV-PVT.
+    0xB5, 0x62, 0x01, 0x07, 0x5C, 0x00, 0x50, 0x49, 0x31, 0x17, 0xE3, 0x07,
+    0x06, 0x0E, 0x0C, 0x04, 0x30, 0x37, 0x15, 0x00, 0x00, 0x00, 0xC0, 0x1D,
+    0xFE, 0xFF, 0x03, 0x01, 0x00, 0x0B, 0x9E, 0x09, 0x86, 0x09, 0x36, 0xD3,
+    0x4E, 0x1B, 0x80, 0xDC, 0x02, 0x00, 0xCE, 0x2F, 0x02, 0x00, 0x8A, 0x0C,
+    0x00, 0x00, 0x06, 0x13, 0x00, 0x00, 0x68, 0xFF, 0xFF, 0xFF, 0x37, 0x01,
+    0x00, 0x00, 0x1B, 0x00, 0x00, 0x00, 0x5B, 0x01, 0x00, 0x00, 0x40, 0x21,
+    0xAD, 0x01, 0xA4, 0x01, 0x00, 0x00, 0x42, 0x5D, 0x87, 0x00, 0xA2, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xFC, 0x6F,
+    // ACK-NAK for CFG-RATE.
+    0xB5, 0x62, 0x05, 0x00, 0x02, 0x00, 0x06, 0x08, 0x15, 0x3A,
+};
+
+//------------------------------ GLOBAL DATA ----------------------------------
+
+//---------------------------- PUBLIC FUNCTIONS -------------------------------
+
+#ifdef UBX_HOST
+int main(int argc, char **argv)
+{
+    bool is_ok;
+
+    if (1 < argc)
+    {
+        return !host_replay(argv[1]);
+    }
+
+    is_ok = test_encode();
+    is_ok = is_ok && test_stream();
+    is_ok = is_ok && test_corrupt();
+    is_ok = is_ok && test_round_trip();
+
+    printf("%s\n", is_ok ? "ok" : "failed");
+
+    return !is_ok;
+}
+#endif
+
+//--------------------------- PRIVATE FUNCTIONS -------------------------------
+
+static bool test_encode(void)
+{
+    uint8_t buf[UBX_CFG_PRT_FRAME_LEN];
+    uint8_t ck_a;
+    uint8_t ck_b;
+
+    HOST_CHECK(sizeof(host_cfg_rate) ==
+               ubx_cfg_rate_encode(1000u, buf, sizeof(buf)));
+    HOST_CHECK(0 == memcmp(buf, host_cfg_rate, sizeof(host_cfg_rate)));
+
+    HOST_CHECK(sizeof(host_cfg_msg) ==
+               ubx_cfg_msg_encode(UBX_CLASS_NAV, UBX_ID_NAV_PVT, 1u, buf,
+                                  sizeof(buf)));
+    HOST_CHECK(0 == memcmp(buf, host_cfg_msg, sizeof(host_cfg_msg)));
+
+    HOST_CHECK(sizeof(host_cfg_prt) ==
+               ubx_cfg_prt_encode(115200u, buf, sizeof(buf)));
+    HOST_CHECK(0 == memcmp(buf, host_cfg_prt, sizeof(host_cfg_prt)));
+
+    // Checksum runs over class to the end of payload.
+    ubx_checksum(&host_cfg_prt[2], sizeof(host_cfg_prt) - 4u, &ck_a, &ck_b);
+    HOST_CHECK((0xBAu == ck_a) && (0x52u == ck_b));
+
+    // Frames that do not fit are not written.
+    memset(buf, 0xEE, sizeof(buf));
+    HOST_CHECK(0u == ubx_cfg_prt_encode(115200u, buf,
+                                        UBX_CFG_PRT_FRAME_LEN - 1u));
+    HOST_CHECK(0xEEu == buf[0]);
+    HOST_CHECK(0u == ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_MSG, NULL, 3u,
+                                      buf, sizeof(buf)));
+    HOST_CHECK(0u == ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_MSG, NULL, 0u,
+                                      NULL, sizeof(buf)));
+
+    // Poll request, empty payload.
+    HOST_CHECK(UBX_FRAME_OVERHEAD ==
+               ubx_frame_encode(UBX_CLASS_CFG, UBX_ID_CFG_RATE, NULL, 0u, buf,
+                                sizeof(buf)));
+    HOST_CHECK((0x0Eu == buf[6]) && (0x30u == buf[7]));
+
+    return true;
+}
+
+static bool test_stream(void)
+{
+    static host_rx_t rx;
+    ubx_decoder_t decoder;
+    ubx_nav_pvt_t pvt;
+    ubx_stats_t stats;
+
+    // Any split of the stream, down to single bytes, decodes the same.
+    for (size_t chunk = 1u; chunk <= sizeof(host_stream); chunk++)
+    {
+        memset(&rx, 0, sizeof(rx));
+        ubx_decoder_init(&decoder, host_frame, &rx);
+        host_decode(&decoder, host_stream, sizeof(host_stream), chunk);
+
+        ubx_stats_get(&decoder, &stats);
+        HOST_CHECK(3u == stats.frames);
+        HOST_CHECK(0u == stats.checksum_errors);
+        HOST_CHECK(0u == stats.oversize);
+        HOST_CHECK(3u == rx.cnt);
+
+        HOST_CHECK((UBX_CLASS_ACK == rx.frame[0].cls) &&
+                   (UBX_ID_ACK_ACK == rx.frame[0].id) &&
+                   (2u == rx.frame[0].len));
+        HOST_CHECK((UBX_CLASS_CFG == rx.frame[0].payload[0]) &&
+                   (UBX_ID_CFG_MSG == rx.frame[0].payload[1]));
+
+        HOST_CHECK((UBX_CLASS_NAV == rx.frame[1].cls) &&
+                   (UBX_ID_NAV_PVT == rx.frame[1].id) &&
+                   (UBX_NAV_PVT_LEN == rx.frame[1].len));
+
+        HOST_CHECK((UBX_CLASS_ACK == rx.frame[2].cls) &&
+                   (UBX_ID_ACK_NAK == rx.frame[2].id));
+        HOST_CHECK(UBX_ID_CFG_RATE == rx.frame[2].payload[1]);
+    }
+
+    HOST_CHECK(!ubx_nav_pvt_decode(rx.frame[1].payload, UBX_NAV_PVT_LEN - 1u,
+                                   &pvt));
+    HOST_CHECK(ubx_nav_pvt_decode(rx.frame[1].payload, rx.frame[1].len, &pvt));
+
+    HOST_CHECK(389106000u == pvt.itow_ms);
+    HOST_CHECK((2019u == pvt.year) && (6u == pvt.month) && (14u == pvt.day));
+    HOST_CHECK((12u == pvt.hour) && (4u == pvt.min) && (48u == pvt.sec));
+    HOST_CHECK((0x37u == pvt.valid) && (21u == pvt.t_acc_ns));
+    HOST_CHECK(-123456 == pvt.nano);
+    HOST_CHECK((3u == pvt.fix_type) && (0x01u == pvt.flags) &&
+               (11u == pvt.num_sv));
+    HOST_CHECK((159779230 == pvt.lon_e7) && (458150710 == pvt.lat_e7));
+    HOST_CHECK((187520 == pvt.height_mm) && (143310 == pvt.hmsl_mm));
+    HOST_CHECK((3210u == pvt.h_acc_mm) && (4870u == pvt.v_acc_mm));
+    HOST_CHECK((-152 == pvt.vel_n_mmps) && (311 == pvt.vel_e_mmps) &&
+               (27 == pvt.vel_d_mmps));
+    HOST_CHECK((347 == pvt.g_speed_mmps) && (28123456 == pvt.head_mot_e5));
+    HOST_CHECK((420u == pvt.s_acc_mmps) && (8871234u == pvt.head_acc_e5));
+    HOST_CHECK(162u == pvt.pdop_c);
+
+    return true;
+}
+
+static bool test_corrupt(void)
+{
+    static host_rx_t rx;
+    static uint8_t stream[sizeof(host_stream) + 16u];
+    ubx_decoder_t decoder;
+    ubx_stats_t stats;
+
+    // Every payload and checksum byte of NAV-PVT: the frame is dropped with
+    // one checksum error and the NAK behind it still decodes.
+    for (size_t pos = HOST_STREAM_PVT + 6u; pos < HOST_STREAM_NAK; pos++)
+    {
+        memcpy(stream, host_stream, sizeof(host_stream));
+        stream[pos] ^= 0x10u;
+
+        memset(&rx, 0, sizeof(rx));
+        ubx_decoder_init(&decoder, host_frame, &rx);
+        host_decode(&decoder, stream, sizeof(host_stream), HOST_CHUNK);
+
+        ubx_stats_get(&decoder, &stats);
+        HOST_CHECK(2u == stats.frames);
+        HOST_CHECK(1u == stats.checksum_errors);
+        HOST_CHECK((2u == rx.cnt) && (UBX_ID_ACK_NAK == rx.frame[1].id));
+    }
+
+    // Length over UBX_PAYLOAD_MAX resyncs right after the length field, so
+    // only the frame itself is lost.
+    memcpy(stream, host_stream, sizeof(host_stream));
+    stream[HOST_STREAM_ACK + 5u] = 0x01u;
+
+    memset(&rx, 0, sizeof(rx));
+    ubx_decoder_init(&decoder, host_frame, &rx);
+    host_decode(&decoder, stream, sizeof(host_stream), HOST_CHUNK);
+
+    ubx_stats_get(&decoder, &stats);
+    HOST_CHECK(1u == stats.oversize);
+    HOST_CHECK(2u == stats.frames);
+    HOST_CHECK((UBX_ID_NAV_PVT == rx.frame[0].id) &&
+               (UBX_ID_ACK_NAK == rx.frame[1].id));
+
+    // Frame cut short by a receiver reset: the start of the next frame is
+    // taken as the rest of its payload, the checksum fails and the frame
+    // after that decodes.
+    memset(&rx, 0, sizeof(rx));
+    ubx_decoder_init(&decoder, host_frame, &rx);
+    host_decode(&decoder, &host_stream[HOST_STREAM_PVT], 40u, HOST_CHUNK);
+    for (uint32_t cnt = 0u; cnt < 2u; cnt++)
+    {
+        host_decode(&decoder, &host_stream[HOST_STREAM_PVT],
+                    HOST_STREAM_NAK - HOST_STREAM_PVT, HOST_CHUNK);
+    }
+
+    ubx_stats_get(&decoder, &stats);
+    HOST_CHECK(1u == stats.checksum_errors);
+    HOST_CHECK((1u == rx.cnt) && (UBX_ID_NAV_PVT == rx.frame[0].id));
+
+    return true;
+}
+
+static bool test_round_trip(void)
+{
+    static host_rx_t rx;
+    uint8_t payload[UBX_PAYLOAD_MAX];
+    uint8_t buf[UBX_PAYLOAD_MAX + UBX_FRAME_OVERHEAD];
+    ubx_decoder_t decoder;
+    uint32_t seed = 1u;
+
+    // Payloads full of sync chars and every length the decoder accepts.
+    for (uint16_t len = 0u; len <= UBX_PAYLOAD_MAX; len++)
+    {
+        for (uint16_t index = 0u; index < len; index++)
+        {
+            seed = (seed * 1103515245u) + 12345u;
+            payload[index] = (0u == (index % 3u)) ? 0xB5u :
+                             (1u == (index % 3u)) ? 0x62u :
+                                                    (uint8_t)(seed >> 16);
+        }
+
+        size_t frame_len = ubx_frame_encode(UBX_CLASS_NAV, (uint8_t)len,
+                                            payload, len, buf, sizeof(buf));
+        HOST_CHECK((len + UBX_FRAME_OVERHEAD) == frame_len);
+
+        memset(&rx, 0, sizeof(rx));
+        ubx_decoder_init(&decoder, host_frame, &rx);
+        host_decode(&decoder, buf, frame_len, 7u);
+
+        HOST_CHECK(1u == rx.cnt);
+        HOST_CHECK((UBX_CLASS_NAV == rx.frame[0].cls) &&
+                   ((uint8_t)len == rx.frame[0].id) &&
+                   (len == rx.frame[0].len));
+        HOST_CHECK(0 == memcmp(rx.frame[0].payload, payload, len));
+    }
+
+    return true;
+}
+
+static bool host_replay(const char *p_path)
+{
+    uint8_t chunk[HOST_CHUNK];
+    ubx_decoder_t decoder;
+    ubx_stats_t stats;
+    size_t len;
+    FILE *p_input = fopen(p_path, "rb");
+
+    if (NULL == p_input)
+    {
+        fprintf(stderr, "can not open %s\n", p_path);
+        return false;
+    }
+
+    ubx_decoder_init(&decoder, host_pvt_print, NULL);
+
+    while (0u < (len = fread(chunk, 1u, sizeof(chunk), p_input)))
+    {
+        ubx_decode(&decoder, chunk, len);
+    }
+
+    fclose(p_input);
+
+    ubx_stats_get(&decoder, &stats);
+    fprintf(stderr, "%u frames, %u checksum errors, %u oversize\n",
+            stats.frames, stats.checksum_errors, stats.oversize);
+
+    return true;
+}
+
+static void host_decode(ubx_decoder_t *p_decoder, const uint8_t *p_data,
+                        size_t len, size_t chunk)
+{
+    for (size_t offset = 0u; offset < len; offset += chunk)
+    {
+        ubx_decode(p_decoder, &p_data[offset],
+                   ((len - offset) < chunk) ? (len - offset) : chunk);
+    }
+}
+
+static void host_frame(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                       uint16_t len, void *p_ctx)
+{
+    host_rx_t *p_rx = p_ctx;
+
+    if (HOST_FRAMES_MAX > p_rx->cnt)
+    {
+        host_frame_t *p_frame = &p_rx->frame[p_rx->cnt];
+
+        p_frame->cls = cls;
+        p_frame->id = id;
+        p_frame->len = len;
+        memcpy(p_frame->payload, p_payload, len);
+    }
+
+    p_rx->cnt++;
+}
+
+static void host_pvt_print(uint8_t cls, uint8_t id, const uint8_t *p_payload,
+                           uint16_t len, void *p_ctx)
+{
+    ubx_nav_pvt_t pvt;
+
+    (void)p_ctx;
+
+    if ((UBX_CLASS_NAV == cls) && (UBX_ID_NAV_PVT == id) &&
+        ubx_nav_pvt_decode(p_payload, len, &pvt))
+    {
+        printf("%u,%u,%u,%d,%d,%d,%d\n", pvt.itow_ms, pvt.fix_type,
+               pvt.num_sv, pvt.lat_e7, pvt.lon_e7, pvt.hmsl_mm,
+               pvt.g_speed_mmps);
+    }
+}
+
+static void host_fail(int line, const char *p_cond)
+{
+    fprintf(stderr, "ubx_host.c:%d: %s\n", line, p_cond);
+}
+
+//--------------------------- INTERRUPT HANDLERS ------------------------------
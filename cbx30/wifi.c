@@ -15,6 +15,8 @@
 #include <bluart-stm32-hal.h>
 #include <RTT.h>
 #include <wifi_task.h>
+#include <inc/bsp/dma.h>
+#include <inc/bsp/lowpower.h>
 //-------------------------------- MACROS -------------------------------------
 
 #define     UART_WIFI_RX_BUF_LEN    (512u)
@@ -61,6 +63,21 @@ static void bsp_wifi_dma_init(void);
  */
 static bluart_error_t bluart_stm32_hal_start_dma_read (bluart_hw_t *hw);
 
+/**
+ * Overrides default bluart start_write op, serializes bluart writes with
+ * the DMA TX queue of the link
+ * @param hw bluart_hw_t instance
+ * @return bluart error status
+ */
+static bluart_error_t bsp_wifi_start_write(bluart_hw_t *hw);
+
+/**
+ * Runs default bluart start_write op, called by DMA TX queue when idle
+ * @param p_ctx bluart_hw_t instance
+ * @return true if write was started
+ */
+static bool bsp_wifi_start_write_now(void *p_ctx);
+
 /**
  * DMA Thread for processing data copied from RX line
  * @param arg
@@ -75,11 +92,14 @@ static void bsp_wifi_process_dma_data(void);
 //----------------------- STATIC DATA & CONSTANTS -----------------------------
 static bluart_stm32_hal_hw_t bluartstmhw0;
 static bluart_hw_ops_t wifi_uart_ops;
+static const bluart_hw_ops_t *p_wifi_uart_hal_ops;
+static volatile bluart_error_t wifi_write_err;
 
 static char uart_wifi_buf[UART_WIFI_RX_BUF_LEN + UART_WIFI_TX_BUF_LEN];
 
+static volatile bool wifi_powered;
+
 //------------------------------ GLOBAL DATA ----------------------------------
-extern SemaphoreHandle_t osid_wifi_dma_smphr;
 bluart_t g_uart_wifi;
 
 //---------------------------- PUBLIC FUNCTIONS -------------------------------
@@ -98,18 +118,42 @@ void bsp_wifi_turn_off(void)
 {
     blgpio_dir(PIN_WIFI_PWR_EN, BLGPIO_DIR_OUT);
     blgpio_set(PIN_WIFI_PWR_EN, false);
+    wifi_powered = false;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_WIFI_RX, false);
 }
 
 void bsp_wifi_turn_on(void)
 {
     blgpio_dir(PIN_WIFI_PWR_EN, BLGPIO_DIR_OUT);
     blgpio_set(PIN_WIFI_PWR_EN, true);
+    wifi_powered = true;
+    bsp_lowpower_stop_veto(BSP_LOWPOWER_WIFI_RX, true);
+}
+
+bool bsp_wifi_is_on(void)
+{
+    return wifi_powered;
 }
 
 void bsp_wifi_enable_rx_flags(void)
 {
-    LL_USART_EnableDMAReq_RX(USART3);
-    LL_USART_EnableIT_IDLE(USART3);
+    bsp_dma_rx_uart_enable(BSP_DMA_RX_WIFI);
+}
+
+bool bsp_wifi_send(const uint8_t *p_data, size_t len, bsp_dma_tx_cb_t cb,
+                   void *p_ctx)
+{
+    return bsp_dma_tx_enqueue(BSP_DMA_TX_WIFI, p_data, len, cb, p_ctx);
+}
+
+size_t bsp_wifi_dma_rx_consumer(bsp_dma_rx_id_t id,
+                                const volatile uint8_t *p_data, size_t len,
+                                uint64_t rx_us)
+{
+    bluart_rx_data(g_uart_wifi.hw, (const uint8_t *)p_data, len);
+    bsp_dma_rx_release(id, len);
+
+    return len;
 }
 //--------------------------- PRIVATE FUNCTIONS -------------------------------
 static bool bsp_wifi_module_init(void)
@@ -134,10 +178,13 @@ static bool bsp_wifi_uart_init(void)
                                      -1, -1);
     }
 
-    // overriding default start_read to do nothing
+    // overriding default start_read to do nothing, start_write to wait for
+    // DMA TX queue
+    p_wifi_uart_hal_ops = bluartstmhw0.hw.ops;
     memcpy(&wifi_uart_ops, bluartstmhw0.hw.ops,  sizeof(bluart_hw_ops_t));
     bluartstmhw0.hw.ops = &wifi_uart_ops;
     bluartstmhw0.hw.ops->start_read = bluart_stm32_hal_start_dma_read;
+    bluartstmhw0.hw.ops->start_write = bsp_wifi_start_write;
 
     if (!berr)
     {
@@ -159,53 +206,26 @@ static bluart_error_t bluart_stm32_hal_start_dma_read (bluart_hw_t *hw)
     return BLUART_ERROR_OK;
 }
 
-//--------------------------- INTERRUPT HANDLERS ------------------------------
-
-void bsp_wifi_USART3_IRQHandler(UART_HandleTypeDef *huart)
+static bluart_error_t bsp_wifi_start_write(bluart_hw_t *hw)
 {
-    uint32_t isrflags   = READ_REG(huart->Instance->ISR);
-    uint32_t cr1its     = READ_REG(huart->Instance->CR1);
-    uint32_t cr3its     = READ_REG(huart->Instance->CR3);
-    uint32_t errorflags;
-
-    // Next part is copied from HAL IRQ Handler to ensure bluart TX compatibility
-
-    /* UART in mode Transmitter ------------------------------------------------*/
-#if defined(USART_CR1_FIFOEN)
-    if(((isrflags & USART_ISR_TXE_TXFNF) != RESET)
-     && (   ((cr1its & USART_CR1_TXEIE_TXFNFIE) != RESET)
-         || ((cr3its & USART_CR3_TXFTIE) != RESET)) )
-#else
-    if(((isrflags & USART_ISR_TXE) != RESET)
-       && ((cr1its & USART_CR1_TXEIE) != RESET))
-#endif
-    {
-        if (huart->TxISR != NULL) {huart->TxISR(huart);}
-        return;
-    }
-
-    /* UART in mode Transmitter (transmission end) -----------------------------*/
-    if(((isrflags & USART_ISR_TC) != RESET) && ((cr1its & USART_CR1_TCIE) != RESET))
-    {
-        /* Disable the UART Transmit Complete Interrupt */
-        CLEAR_BIT(huart->Instance->CR1, USART_CR1_TCIE);
-
-        /* Tx process is ended, restore huart->gState to Ready */
-        huart->gState = HAL_UART_STATE_READY;
+    // Set by the default op when it runs right away, deferred start reports
+    // its failure from DMA ISR.
+    wifi_write_err = BLUART_ERROR_OK;
+    bsp_dma_tx_hal_start(BSP_DMA_TX_WIFI, bsp_wifi_start_write_now, hw);
 
-        /* Cleat TxISR function pointer */
-        huart->TxISR = NULL;
+    return wifi_write_err;
+}
 
-        HAL_UART_TxCpltCallback(huart);
-        return;
-    }
+static bool bsp_wifi_start_write_now(void *p_ctx)
+{
+    wifi_write_err = p_wifi_uart_hal_ops->start_write((bluart_hw_t *)p_ctx);
 
-    // Code for catching IDLE interrupt which HAL handler is missing
+    return (BLUART_ERROR_OK == wifi_write_err);
+}
 
-    /* Check for IDLE line interrupt */
-    if (LL_USART_IsEnabledIT_IDLE(USART3) && LL_USART_IsActiveFlag_IDLE(USART3)) {
-        LL_USART_ClearFlag_IDLE(USART3);        /* Clear IDLE line flag */
+//--------------------------- INTERRUPT HANDLERS ------------------------------
 
-        xSemaphoreGiveFromISR(osid_wifi_dma_smphr, NULL);
-    }
-}
\ No newline at end of file
+void bsp_wifi_USART3_IRQHandler(UART_HandleTypeDef *huart)
+{
+    bsp_dma_rx_uart_irq_handler(huart, BSP_DMA_RX_WIFI);
+}
@@ -15,8 +15,10 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #include <stm32l4xx_ll_usart.h>
+#include <inc/bsp/dma.h>
 //-------------------------- CONSTANTS & MACROS -------------------------------
 
 #define     WIFI_DEFAULT_BAUD    (115200u)
@@ -46,9 +48,36 @@ void bsp_wifi_turn_off(void);
  */
 void bsp_wifi_turn_on(void);
 
+/**
+ * Checks whether wifi module power is enabled
+ * @return true if wifi is on
+ */
+bool bsp_wifi_is_on(void);
+
 /**
  * Reenables wifi ISR flags which get reset when changing baud rate
  */
 void bsp_wifi_enable_rx_flags(void);
 
+/**
+ * Queues data for DMA transmission on wifi UART without copying. Queued data
+ * and g_uart_wifi writes never interleave: queued data waits for a running
+ * bluart write to end, a bluart write waits for the request in flight.
+ * @param p_data data, valid until cb is called
+ * @param len data length
+ * @param cb completion callback called from ISR, may be NULL
+ * @param p_ctx callback context
+ * @return true if queued, false if queue is full
+ */
+bool bsp_wifi_send(const uint8_t *p_data, size_t len, bsp_dma_tx_cb_t cb,
+                   void *p_ctx);
+
+/**
+ * Default DMA consumer of the wifi link, copies data into g_uart_wifi
+ * @return number of accepted bytes
+ */
+size_t bsp_wifi_dma_rx_consumer(bsp_dma_rx_id_t id,
+                                const volatile uint8_t *p_data, size_t len,
+                                uint64_t rx_us);
+
 #endif //CROSSBOX_BSP_WIFI_H